@@ -0,0 +1,448 @@
+/**
+ * decode_bench.cpp
+ *
+ * Command-line decode benchmark for FFmpegDecoder and the native decoders.
+ *
+ * Opens a file and decodes it to EOF several times per I/O mode, then prints
+ * open latency, decode throughput and speed relative to real time.
+ *
+ * Usage:
+ *   decode_bench <file> [--iterations N] [--threads N] [--codec-threads N]
+ *
+ * Modes compared:
+ *   - avformat : avformat's own buffered read() path
+ *   - mmap     : custom AVIOContext backed by MappedFile
+ *   - pcm      : native PcmDecoder (WAV/AIFF only; skipped for other files)
+ *   - flac     : native FlacDecoder, sequential decode() (FLAC only)
+ *
+ * Decoders are opened with DecodeWorkload::Offline; --codec-threads overrides
+ * the automatic FFmpeg codec thread count (1 = single-threaded baseline).
+ *
+ * Per-track setup cost (open + first decode() + close, as on a track change)
+ * is measured with and without DecoderPool recycling.
+ *
+ * SegmentDecoder (segment-parallel FFmpeg decode) is timed with 1..N threads
+ * and its output checked against a sequential decode.
+ *
+ * For FLAC input it also times FlacDecoder::decodeAll() with 1..N threads
+ * and the latency of sample-exact seeks to random positions.
+ *
+ * The decoded float PCM is run through the PcmBlockCache codec (compression
+ * ratio, compress/decompress throughput, round-trip check), and random seeks
+ * are timed through a PcmBlockCache holding the whole track.
+ *
+ * A PcmCache in a scratch directory records one play and replays it; the
+ * replay must return the same float samples (exit status 1 otherwise).
+ */
+
+#include "decoder/ffmpeg_decoder.h"
+#include "decoder/pcm_decoder.h"
+#include "decoder/flac_decoder.h"
+#include "decoder/decoder_pool.h"
+#include "decoder/segment_decoder.h"
+#include "decoder/pcm_block_codec.h"
+#include "io/pcm_block_cache.h"
+#include "io/pcm_cache.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct RunResult {
+    double openMs = 0.0;
+    double decodeMs = 0.0;
+    size_t samples = 0;
+    int sampleRate = 0;
+    int channels = 0;
+    int codecThreads = 1;
+    bool ok = false;
+};
+
+enum class Mode { Avformat, Mmap, Pcm, Flac };
+
+static RunResult runOnce(const std::string& path, Mode mode, int codecThreads) {
+    using clock = std::chrono::steady_clock;
+    RunResult r;
+    std::unique_ptr<AudioDecoder> owned;
+    if (mode == Mode::Pcm) {
+        owned.reset(new PcmDecoder());
+    } else if (mode == Mode::Flac) {
+        owned.reset(new FlacDecoder());
+    } else {
+        FFmpegDecoder* ffmpeg = new FFmpegDecoder();
+        ffmpeg->setUseMappedIO(mode == Mode::Mmap);
+        owned.reset(ffmpeg);
+    }
+    AudioDecoder& decoder = *owned;
+    decoder.setWorkload(DecodeWorkload::Offline, codecThreads);
+
+    auto t0 = clock::now();
+    if (!decoder.open(path)) {
+        return r;
+    }
+    auto t1 = clock::now();
+
+    std::vector<int16_t> buffer;
+    while (true) {
+        buffer.clear();
+        int n = decoder.decode(buffer);
+        if (n <= 0) break;
+        r.samples += static_cast<size_t>(n);
+    }
+    auto t2 = clock::now();
+
+    r.openMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    r.decodeMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+    r.sampleRate = decoder.getSampleRate();
+    r.channels = decoder.getChannels();
+    if (mode == Mode::Avformat || mode == Mode::Mmap) {
+        r.codecThreads = static_cast<FFmpegDecoder&>(decoder).getCodecThreads();
+    }
+    r.ok = true;
+    return r;
+}
+
+static void report(const char* mode, const std::vector<RunResult>& runs) {
+    double openMs = 0.0, decodeMs = 0.0;
+    for (const auto& r : runs) {
+        openMs += r.openMs;
+        decodeMs += r.decodeMs;
+    }
+    openMs /= runs.size();
+    decodeMs /= runs.size();
+
+    const RunResult& first = runs.front();
+    double frames = static_cast<double>(first.samples) / first.channels;
+    double audioSeconds = frames / first.sampleRate;
+    std::printf("%-9s open %8.3f ms   decode %9.2f ms   %8.2f Mframes/s   %7.1fx realtime   %d codec thread(s)\n",
+                mode, openMs, decodeMs,
+                frames / (decodeMs * 1000.0),
+                audioSeconds / (decodeMs / 1000.0),
+                first.codecThreads);
+}
+
+// Average open + first decode() + close time over `tracks` track changes.
+static void benchSetup(const std::string& path, bool pooled, int tracks) {
+    using clock = std::chrono::steady_clock;
+    DecoderPool::instance().clear();
+    DecoderPool::Stats before = DecoderPool::instance().stats();
+    std::vector<int16_t> buffer;
+    double totalMs = 0.0;
+    for (int i = 0; i < tracks; ++i) {
+        auto t0 = clock::now();
+        FFmpegDecoder decoder;
+        decoder.setUsePool(pooled);
+        if (!decoder.open(path)) return;
+        buffer.clear();
+        decoder.decode(buffer);
+        decoder.close();
+        totalMs += std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+    }
+    DecoderPool::Stats after = DecoderPool::instance().stats();
+    std::printf("setup %-8s %8.3f ms per track   (codec contexts reused %llu, resamplers reused %llu)\n",
+                pooled ? "pooled" : "fresh", totalMs / tracks,
+                static_cast<unsigned long long>(after.codecReused - before.codecReused),
+                static_cast<unsigned long long>(after.resamplerReused - before.resamplerReused));
+}
+
+// SegmentDecoder throughput with `threads` workers; `reference` is the
+// sequential decode the output must match.
+static void benchSegmented(const std::string& path, unsigned threads, int iterations, const std::vector<int16_t>& reference) {
+    using clock = std::chrono::steady_clock;
+    SegmentDecoder decoder(threads);
+    // Short test files still get one segment per thread.
+    decoder.setMinSegment(1.0);
+    std::vector<int16_t> pcm;
+    double totalMs = 0.0;
+    for (int i = 0; i < iterations; ++i) {
+        auto t0 = clock::now();
+        if (!decoder.decodeFile(path, pcm)) {
+            std::printf("segm x%-3u decode failed\n", threads);
+            return;
+        }
+        totalMs += std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+    }
+    double decodeMs = totalMs / iterations;
+    double frames = static_cast<double>(pcm.size()) / decoder.getChannels();
+    std::printf("segm x%-3u                    decode %9.2f ms   %8.2f Mframes/s   %7.1fx realtime   %u segment(s), %s\n",
+                threads, decodeMs, frames / (decodeMs * 1000.0),
+                frames / decoder.getSampleRate() / (decodeMs / 1000.0),
+                decoder.getSegmentsUsed(), pcm == reference ? "identical" : "MISMATCH");
+}
+
+// FlacDecoder::decodeAll() throughput with `threads` workers.
+static void benchFlacParallel(const std::string& path, unsigned threads, int iterations) {
+    using clock = std::chrono::steady_clock;
+    FlacDecoder decoder;
+    if (!decoder.open(path)) return;
+    std::vector<int16_t> pcm;
+    double totalMs = 0.0;
+    for (int i = 0; i < iterations; ++i) {
+        auto t0 = clock::now();
+        if (!decoder.decodeAll(pcm, threads)) {
+            std::printf("flac x%-3u decodeAll failed\n", threads);
+            return;
+        }
+        totalMs += std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+    }
+    double decodeMs = totalMs / iterations;
+    double frames = static_cast<double>(pcm.size()) / decoder.getChannels();
+    std::printf("flac x%-3u                    decode %9.2f ms   %8.2f Mframes/s   %7.1fx realtime\n",
+                threads, decodeMs, frames / (decodeMs * 1000.0),
+                frames / decoder.getSampleRate() / (decodeMs / 1000.0));
+}
+
+// Average latency of seek + first decode() at random sample positions.
+static void benchFlacSeek(const std::string& path, int seeks) {
+    using clock = std::chrono::steady_clock;
+    FlacDecoder decoder;
+    if (!decoder.open(path) || decoder.streamInfo().totalSamples == 0) return;
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<uint64_t> pick(0, decoder.streamInfo().totalSamples - 1);
+    std::vector<int16_t> buffer;
+    double totalMs = 0.0;
+    for (int i = 0; i < seeks; ++i) {
+        uint64_t target = pick(rng);
+        buffer.clear();
+        auto t0 = clock::now();
+        if (!decoder.seekToSample(target) || decoder.decode(buffer) <= 0) {
+            std::printf("flac seek to sample %llu failed\n", static_cast<unsigned long long>(target));
+            return;
+        }
+        totalMs += std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+    }
+    std::printf("flac seek  %d random positions: %.3f ms average (seek + first frame)\n", seeks, totalMs / seeks);
+}
+
+// Block codec on `pcm` (decodeFloat() output) in PcmBlockCache-sized blocks:
+// lossless on the quantized samples, within half a 24-bit step of the input.
+static void benchBlockCodec(const std::vector<float>& pcm, int channels, int iterations) {
+    using clock = std::chrono::steady_clock;
+    const size_t blockFrames = PcmBlockCache::kBlockFrames;
+    const size_t frames = pcm.size() / channels;
+    std::vector<int32_t> quantized(pcm.size());
+    quantizePcmBlock(pcm.data(), quantized.data(), pcm.size());
+    std::vector<std::vector<uint8_t>> blocks((frames + blockFrames - 1) / blockFrames);
+    std::vector<int32_t> out(blockFrames * channels);
+    double compressMs = 0.0, decompressMs = 0.0;
+    size_t compressed = 0;
+    bool lossless = true;
+    for (int it = 0; it < iterations; ++it) {
+        auto t0 = clock::now();
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            size_t n = std::min(blockFrames, frames - b * blockFrames);
+            compressPcmBlock(quantized.data() + b * blockFrames * channels, n, channels, blocks[b]);
+        }
+        auto t1 = clock::now();
+        for (size_t b = 0; b < blocks.size(); ++b) {
+            size_t n = std::min(blockFrames, frames - b * blockFrames);
+            if (!decompressPcmBlock(blocks[b].data(), blocks[b].size(), n, channels, out.data()) ||
+                std::memcmp(out.data(), quantized.data() + b * blockFrames * channels, n * channels * sizeof(int32_t)) != 0) {
+                lossless = false;
+            }
+        }
+        auto t2 = clock::now();
+        compressMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+        decompressMs += std::chrono::duration<double, std::milli>(t2 - t1).count();
+    }
+    for (const auto& b : blocks) compressed += b.size();
+
+    std::vector<float> restored(pcm.size());
+    dequantizePcmBlock(quantized.data(), restored.data(), pcm.size());
+    float maxError = 0.0f, peak = 0.0f;
+    for (size_t i = 0; i < pcm.size(); ++i) {
+        maxError = std::max(maxError, std::fabs(restored[i] - pcm[i]));
+        peak = std::max(peak, std::fabs(pcm[i]));
+    }
+    const double rawMB = pcm.size() * sizeof(float) / 1e6;
+    std::printf("blockcodec ratio %.3f of float32   compress %8.1f MB/s   decompress %8.1f MB/s   %s   "
+                "peak %.3f   max error %.2g\n",
+                static_cast<double>(compressed) / (pcm.size() * sizeof(float)),
+                rawMB / (compressMs / iterations / 1000.0), rawMB / (decompressMs / iterations / 1000.0),
+                lossless && maxError <= 0.5f / kPcmBlockScale ? "ok" : "MISMATCH", peak, maxError);
+}
+
+// Seek + first decode() latency through a PcmBlockCache after one full play,
+// next to the same seeks on the bare decoder.
+static void benchBlockCacheSeek(const std::string& path, int seeks) {
+    using clock = std::chrono::steady_clock;
+    PcmBlockCache cache(uint64_t(1) << 30);
+    std::unique_ptr<AudioDecoder> bare = AudioDecoder::openFile(path);
+    std::unique_ptr<AudioDecoder> inner = AudioDecoder::openFile(path);
+    if (!bare || !inner || bare->getDuration() <= 0.0) return;
+    std::unique_ptr<AudioDecoder> cached = cache.wrap(std::move(inner), path);
+    std::vector<float> buffer;
+    while (cached->decodeFloat(buffer) > 0) {
+        buffer.clear();
+    }
+
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> pick(0.0, bare->getDuration() * 0.99);
+    double bareMs = 0.0, cachedMs = 0.0;
+    for (int i = 0; i < seeks; ++i) {
+        double target = pick(rng);
+        auto t0 = clock::now();
+        buffer.clear();
+        bool ok = bare->seek(target) && bare->decodeFloat(buffer) > 0;
+        auto t1 = clock::now();
+        buffer.clear();
+        ok = ok && cached->seek(target) && cached->decodeFloat(buffer) > 0;
+        auto t2 = clock::now();
+        if (!ok) {
+            std::printf("blockcache seek to %.3f s failed\n", target);
+            return;
+        }
+        bareMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+        cachedMs += std::chrono::duration<double, std::milli>(t2 - t1).count();
+    }
+    PcmBlockCache::Stats st = cache.stats();
+    std::printf("blockcache %d random seeks: %.3f ms cached vs %.3f ms %s   (%llu blocks, %.1f MB for %.1f MB PCM)\n",
+                seeks, cachedMs / seeks, bareMs / seeks, bare->name(),
+                static_cast<unsigned long long>(st.blocks), st.usedBytes / 1e6, st.rawBytes / 1e6);
+}
+
+// PcmCache round trip in a scratch directory: the first play must be
+// recorded (FFmpeg's float output for lossy codecs included) and the second
+// served from the cache with the same float samples. False on a failure.
+static bool benchPcmCache(const std::string& path) {
+    using clock = std::chrono::steady_clock;
+    char dirTemplate[] = "/tmp/decode_bench_pcm.XXXXXX";
+    if (!::mkdtemp(dirTemplate)) return true;
+    const std::string dir = dirTemplate;
+    bool ok = true;
+    {
+        PcmCache cache(dir, uint64_t(4) << 30);
+        std::vector<float> first, second;
+        auto t0 = clock::now();
+        std::unique_ptr<AudioDecoder> decoder = cache.openFile(path);
+        if (decoder) {
+            const std::string source = decoder->name();
+            const int bits = decoder->getSourceBits();
+            while (decoder->decodeFloat(first) > 0) {
+            }
+            decoder.reset();
+            auto t1 = clock::now();
+            if (source == "pcm") {
+                std::printf("pcmcache  n/a (WAV/AIFF is not recorded)\n");
+            } else {
+                const bool recorded = cache.contains(path);
+                std::unique_ptr<AudioDecoder> replay = cache.openFile(path);
+                ok = recorded && replay && std::strcmp(replay->name(), "pcm-cache") == 0;
+                if (ok) {
+                    while (replay->decodeFloat(second) > 0) {
+                    }
+                    ok = second == first;
+                }
+                auto t2 = clock::now();
+                float peak = 0.0f;
+                for (float v : first) peak = std::max(peak, std::fabs(v));
+                std::printf("pcmcache  %s %d-bit: record %9.2f ms   replay %9.2f ms   peak %.3f   %s\n",
+                            source.c_str(), bits, std::chrono::duration<double, std::milli>(t1 - t0).count(),
+                            std::chrono::duration<double, std::milli>(t2 - t1).count(), peak,
+                            ok ? "identical" : recorded ? "MISMATCH" : "NOT RECORDED");
+            }
+        }
+    }
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <file> [--iterations N] [--threads N] [--codec-threads N]\n", argv[0]);
+        return 1;
+    }
+    std::string path = argv[1];
+    int iterations = 5;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    int codecThreads = 0;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else if (std::strcmp(argv[i], "--codec-threads") == 0 && i + 1 < argc) {
+            codecThreads = std::max(0, std::atoi(argv[++i]));
+        }
+    }
+
+    Logger::instance().setLogFile("decode_bench.log");
+
+    // Warm the page cache so both modes measure the demux/decode path rather
+    // than the first disk read.
+    runOnce(path, Mode::Avformat, codecThreads);
+
+    struct NamedMode { const char* name; Mode mode; };
+    const NamedMode modes[] = { { "avformat", Mode::Avformat }, { "mmap", Mode::Mmap }, { "pcm", Mode::Pcm }, { "flac", Mode::Flac } };
+
+    for (const NamedMode& mode : modes) {
+        if (mode.mode == Mode::Pcm && !PcmDecoder().open(path)) {
+            std::printf("%-9s n/a (not a PCM WAV/AIFF file)\n", mode.name);
+            continue;
+        }
+        if (mode.mode == Mode::Flac && !FlacDecoder().open(path)) {
+            std::printf("%-9s n/a (not a native FLAC file)\n", mode.name);
+            continue;
+        }
+        std::vector<RunResult> runs;
+        for (int i = 0; i < iterations; ++i) {
+            RunResult r = runOnce(path, mode.mode, codecThreads);
+            if (!r.ok) {
+                std::fprintf(stderr, "Failed to decode %s\n", path.c_str());
+                return 1;
+            }
+            runs.push_back(r);
+        }
+        report(mode.name, runs);
+    }
+
+    benchSetup(path, false, iterations * 20);
+    benchSetup(path, true, iterations * 20);
+
+    {
+        FFmpegDecoder sequential;
+        sequential.setWorkload(DecodeWorkload::Offline, 1);
+        std::vector<int16_t> reference;
+        if (sequential.open(path)) {
+            while (sequential.decode(reference) > 0) {
+            }
+            for (unsigned n = 1; n <= threads; n *= 2) {
+                benchSegmented(path, n, iterations, reference);
+                if (n < threads && n * 2 > threads) n = threads / 2;
+            }
+        }
+    }
+
+    {
+        std::unique_ptr<AudioDecoder> decoder = AudioDecoder::openFile(path);
+        std::vector<float> pcm;
+        if (decoder) {
+            while (decoder->decodeFloat(pcm) > 0) {
+            }
+            benchBlockCodec(pcm, decoder->getChannels(), iterations);
+        }
+        benchBlockCacheSeek(path, 200);
+    }
+
+    const bool pcmCacheOk = benchPcmCache(path);
+
+    if (FlacDecoder().open(path)) {
+        for (unsigned n = 1; n <= threads; n *= 2) {
+            benchFlacParallel(path, n, iterations);
+            if (n < threads && n * 2 > threads) n = threads / 2;   // always finish with `threads`
+        }
+        benchFlacSeek(path, 200);
+    }
+    return pcmCacheOk ? 0 : 1;
+}
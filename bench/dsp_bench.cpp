@@ -0,0 +1,670 @@
+/**
+ * dsp_bench.cpp
+ *
+ * Cost of the player's DSP stage (src/dsp), as the share of one core it
+ * takes to keep up with real time. Everything runs on planar pool blocks
+ * (planar.h), as in the player.
+ *
+ * ParametricEq: every kernel variant the host can run, for stereo, 5.1 and
+ * 7.1 with the given number of bands, in blocks of the player's block size.
+ * Each variant's output is checked against the scalar one (SSE2 must match
+ * exactly, AVX2 uses FMA and is checked to within 1e-6). A "ramp" row
+ * changes a band's gain every block, so the coefficients are always being
+ * smoothed. The variant simdLevel() selects is marked with '*'.
+ *
+ * Limiter: the true-peak detector per variant (checked against the scalar
+ * one like the EQ), then the whole limiter with a 2x volume boost on noise
+ * that peaks at full scale, so it is reducing the gain all the time. The
+ * boosted output is measured with the 4x true-peak detector and must stay
+ * under the ceiling.
+ *
+ * Convolver: one 1024-frame level step (FFT, 6 partition products, inverse
+ * FFT) per variant, checked against the scalar one (SSE2 exactly, AVX2 to
+ * 1e-5 of the peak), then the whole convolver in stereo for impulse
+ * responses of 4k to 256k taps (or --ir-taps N), as the share of a core
+ * per channel spent inline (in process()) and on the worker thread. Its
+ * output is checked against a direct convolution over a window of frames.
+ *
+ * DspChain: the player's chain (EQ, gain, crossfeed matrix, convolver
+ * without a response, limiter with a 2x boost) in stereo, while the gain
+ * and the matrix change every few blocks. Its output is checked against
+ * the same nodes called one after the other, and the per-node costs the
+ * chain reports (costs()) are listed with the chain's own overhead (wall
+ * time of process() minus the nodes' share). A "stage" row adds what the
+ * decode thread does around the chain: deinterleave the decoder's block
+ * and interleave the result (as AudioOutput::writePlanar() does).
+ *
+ * Parallel chain: EQ, convolver (65536 taps) and limiter on 7.1, on the
+ * processing thread alone and forked over 2, 4 and 8 workers
+ * (DspWorkerPool). The output must match the serial chain exactly. Rows
+ * give the wall time of process() as the share of a core; below them the
+ * CPU time summed over all threads, the speed-up over serial and the blocks
+ * that took longer than their duration (DspChain::deadlineMisses()). With
+ * fewer cores than threads the workers neither spin nor get pinned, and
+ * the fork only costs.
+ *
+ * Governor: EQ, convolver (--ir-taps, at least 262144) and limiter on 7.1
+ * at each quality tier (DspNode::setQualityTier()), with the taps the
+ * convolver keeps and the limiter's detector. Then DspChain's governor:
+ * with a deadline of half of tier 0's time it must step down, and with
+ * plenty of headroom back up to tier 0 (after kCalmBlocks per tier).
+ *
+ * Exits non-zero if a check fails, the selected EQ variant or the whole
+ * limiter needs more than 1% of a core at 48 kHz stereo (EQ: 10 bands), or
+ * the convolver more than 2% per channel for 65536 taps at 48 kHz.
+ *
+ * Usage:
+ *   dsp_bench [--rate HZ] [--bands N] [--ir-taps N] [--ms MILLISECONDS]
+ */
+
+#include "dsp/convolver.h"
+#include "dsp/dsp_chain.h"
+#include "dsp/dsp_nodes.h"
+#include "dsp/dsp_workers.h"
+#include "dsp/fft.h"
+#include "dsp/limiter.h"
+#include "dsp/parametric_eq.h"
+#include "audio/planar.h"
+#include "player/player.h"
+#include "utils/cpu_features.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const SimdLevel kLevels[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 };
+
+/**
+ * Run `block` (which processes `frames` frames) repeatedly for about `ms`
+ * milliseconds and return the percentage of one core needed for real time
+ * at `rate` frames per second.
+ */
+static double corePercent(const std::function<void()>& block, size_t frames, int rate, int ms) {
+    using clock = std::chrono::steady_clock;
+    block();
+    size_t runs = 0;
+    const auto start = clock::now();
+    const auto stop = start + std::chrono::milliseconds(ms);
+    auto now = start;
+    do {
+        for (int k = 0; k < 16; ++k) block();
+        runs += 16;
+        now = clock::now();
+    } while (now < stop);
+    const double seconds = std::chrono::duration<double>(now - start).count();
+    const double audioSeconds = static_cast<double>(runs * frames) / rate;
+    return 100.0 * seconds / audioSeconds;
+}
+
+static void printRow(const std::string& stage, const char* variant, bool selected, bool ok, double percent) {
+    std::printf("%-26s %c%-8s %-5s %9.4f%%\n", stage.c_str(), selected ? '*' : ' ', variant, ok ? "ok" : "FAIL", percent);
+}
+
+/**
+ * A planar pool block of `channels` x `frames` and the transposes for its
+ * channel count.
+ */
+struct PlanarBuffer {
+    AudioBlockPool pool;
+    AudioBlock block;
+    PlanarKernels kernels;
+
+    PlanarBuffer(int channels, size_t frames) : kernels(selectPlanarKernels(channels)) {
+        pool.init(channels, frames, 1);
+        block = pool.acquire();
+    }
+    void load(const std::vector<float>& interleaved) { kernels.deinterleave(interleaved.data(), block, block.frames); }
+    void store(std::vector<float>& interleaved) const {
+        interleaved.resize(block.frames * block.channels);
+        kernels.interleave(block, interleaved.data(), block.frames);
+    }
+    void copy(const PlanarBuffer& other) {
+        for (int c = 0; c < block.channels; ++c) std::memcpy(block.channel[c], other.block.channel[c], block.frames * sizeof(float));
+    }
+};
+
+/**
+ * Bands spread log-evenly over 31 Hz - 16 kHz, mostly peaks with shelves
+ * at the ends, alternating boost and cut.
+ */
+static std::vector<EqBand> testBands(int count) {
+    std::vector<EqBand> bands;
+    for (int i = 0; i < count; ++i) {
+        EqBand band;
+        band.type = i == 0 ? EqBandType::LowShelf : i == count - 1 ? EqBandType::HighShelf : EqBandType::Peak;
+        band.frequency = static_cast<float>(31.25 * std::pow(512.0, count > 1 ? static_cast<double>(i) / (count - 1) : 0.0));
+        band.gainDb = (i % 2 ? 3.0f : -2.0f);
+        band.q = 1.2f;
+        bands.push_back(band);
+    }
+    return bands;
+}
+
+int main(int argc, char** argv) {
+    int rate = 48000;
+    int bandCount = 10;
+    size_t irTaps = 0;
+    int ms = 200;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--bands") == 0 && i + 1 < argc) {
+            bandCount = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--ir-taps") == 0 && i + 1 < argc) {
+            irTaps = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--ms") == 0 && i + 1 < argc) {
+            ms = std::atoi(argv[++i]);
+        } else {
+            std::fprintf(stderr, "Usage: %s [--rate HZ] [--bands N] [--ir-taps N] [--ms MILLISECONDS]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (rate <= 0 || ms <= 0 || bandCount < 1 || bandCount > ParametricEq::kMaxBands) return 1;
+    if (irTaps > Convolver::kMaxLength) return 1;
+
+    std::printf("simd level: detected %s, selected %s\n", simdLevelName(detectedSimdLevel()), simdLevelName(simdLevel()));
+    std::printf("%d Hz, blocks of %zu frames\n\n", rate, Player::kBlockFrames);
+    std::printf("%-26s %-9s %-5s %10s\n", "stage", "variant", "check", "core");
+
+    const size_t frames = Player::kBlockFrames;
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+    int failures = 0;
+
+    // -----------------------------
+    // ParametricEq
+    // -----------------------------
+    const std::vector<EqBand> bands = testBands(bandCount);
+    std::vector<BiquadCoeffs> coeffs;
+    for (const EqBand& band : bands) coeffs.push_back(ParametricEq::design(band, rate));
+    const int layouts[] = { 2, 6, 8 };
+    for (int channels : layouts) {
+        std::vector<float> samples(frames * channels);
+        for (float& v : samples) v = dist(rng);
+        PlanarBuffer source(channels, frames), work(channels, frames);
+        source.load(samples);
+        std::vector<float> ref, out;
+        const std::string name = "eq " + std::to_string(bandCount) + " bands " + std::to_string(channels) + " ch";
+
+        const EqKernelFn scalar = ParametricEq::selectKernel(channels, SimdLevel::Scalar);
+        alignas(32) double refState[ParametricEq::kMaxBands][2][8] = {};
+        work.copy(source);
+        scalar(work.block, frames, coeffs.data(), bandCount, &refState[0][0][0]);
+        work.store(ref);
+
+        ParametricEq selectedEq;
+        selectedEq.prepare(rate, channels);
+        const char* selected = selectedEq.variant();
+        const char* previous = nullptr;
+        for (SimdLevel level : kLevels) {
+            const char* variant = nullptr;
+            const EqKernelFn k = ParametricEq::selectKernel(channels, level, &variant);
+            if (previous && std::strcmp(previous, variant) == 0) continue;
+            previous = variant;
+
+            alignas(32) double state[ParametricEq::kMaxBands][2][8] = {};
+            work.copy(source);
+            k(work.block, frames, coeffs.data(), bandCount, &state[0][0][0]);
+            work.store(out);
+            const float tolerance = std::strcmp(variant, "avx2") == 0 ? 1e-6f : 0.0f;
+            bool ok = true;
+            for (size_t i = 0; i < out.size() && ok; ++i) ok = std::fabs(out[i] - ref[i]) <= tolerance;
+            failures += ok ? 0 : 1;
+
+            const bool isSelected = std::strcmp(selected, variant) == 0;
+            const double percent = corePercent([&] {
+                work.copy(source);
+                k(work.block, frames, coeffs.data(), bandCount, &state[0][0][0]);
+            }, frames, rate, ms);
+            printRow(name, variant, isSelected, ok, percent);
+            if (isSelected && channels == 2 && bandCount == 10 && rate == 48000 && percent > 1.0) {
+                std::printf("  over the 1%% budget\n");
+                ++failures;
+            }
+        }
+
+        // Whole stage with the selected kernel while the coefficients are
+        // being smoothed: one band's gain changes every block.
+        ParametricEq eq;
+        eq.setBands(bands);
+        eq.prepare(rate, channels);
+        int round = 0;
+        const double percent = corePercent([&] {
+            EqBand band = bands[bandCount / 2];
+            band.gainDb = (round++ % 2) ? 6.0f : -6.0f;
+            eq.setBand(bandCount / 2, band);
+            work.copy(source);
+            eq.process(work.block);
+        }, frames, rate, ms);
+        printRow(name + " ramp", eq.variant(), true, true, percent);
+    }
+
+    // -----------------------------
+    // Limiter
+    // -----------------------------
+    const float* taps = Limiter::interpolatorTaps();
+    for (int channels : layouts) {
+        // Detector over every channel of a block (one channel at a time, as
+        // the limiter runs it)
+        std::vector<float> source((frames + Limiter::kTaps - 1) * channels);
+        for (float& v : source) v = dist(rng);
+        std::vector<float> ref(frames * channels), out(frames * channels);
+        const TruePeakFn scalar = Limiter::selectKernel(SimdLevel::Scalar);
+        const size_t stride = frames + Limiter::kTaps - 1;
+        for (int c = 0; c < channels; ++c) scalar(&source[c * stride], &ref[c * frames], frames, taps);
+
+        Limiter selectedLimiter;
+        selectedLimiter.prepare(rate, channels);
+        const char* selected = selectedLimiter.variant();
+        const std::string name = "limiter detect " + std::to_string(channels) + " ch";
+        const char* previous = nullptr;
+        for (SimdLevel level : kLevels) {
+            const char* variant = nullptr;
+            const TruePeakFn k = Limiter::selectKernel(level, &variant);
+            if (previous && std::strcmp(previous, variant) == 0) continue;
+            previous = variant;
+
+            std::fill(out.begin(), out.end(), 0.0f);
+            for (int c = 0; c < channels; ++c) k(&source[c * stride], &out[c * frames], frames, taps);
+            const float tolerance = std::strcmp(variant, "avx2") == 0 ? 1e-6f : 0.0f;
+            bool ok = true;
+            for (size_t i = 0; i < out.size() && ok; ++i) ok = std::fabs(out[i] - ref[i]) <= tolerance;
+            failures += ok ? 0 : 1;
+
+            const double percent = corePercent([&] {
+                for (int c = 0; c < channels; ++c) k(&source[c * stride], &out[c * frames], frames, taps);
+            }, frames, rate, ms);
+            printRow(name, variant, std::strcmp(selected, variant) == 0, ok, percent);
+        }
+
+        // Whole limiter, 2x boost on noise peaking at full scale
+        std::vector<float> samples(frames * channels);
+        for (float& v : samples) v = 2.0f * dist(rng);
+        PlanarBuffer block(channels, frames), work(channels, frames);
+        block.load(samples);
+        Limiter limiter;
+        limiter.setInputGain(2.0f);
+        limiter.prepare(rate, channels);
+
+        // Peak check on a second of output, past the latency and the gain
+        // smoothing, one channel at a time through the scalar detector
+        const size_t checkBlocks = static_cast<size_t>(rate) / frames + 1;
+        std::vector<float> output, chunk;
+        for (size_t b = 0; b < checkBlocks; ++b) {
+            work.copy(block);
+            limiter.process(work.block);
+            work.store(chunk);
+            output.insert(output.end(), chunk.begin(), chunk.end());
+        }
+        const size_t total = output.size() / channels;
+        const size_t skip = limiter.latency() + static_cast<size_t>(rate) / 20;
+        std::vector<float> lane(total), peaks(total, 0.0f);
+        float truePeak = 0.0f;
+        for (int c = 0; c < channels; ++c) {
+            for (size_t i = 0; i < total; ++i) lane[i] = output[i * channels + c];
+            scalar(lane.data(), peaks.data(), total - (Limiter::kTaps - 1), taps);
+            for (size_t i = skip; i + Limiter::kTaps - 1 < total; ++i) truePeak = std::max(truePeak, peaks[i]);
+        }
+        const float ceiling = std::pow(10.0f, Limiter::kDefaultCeilingDb / 20.0f);
+        const bool ok = truePeak <= ceiling * 1.0001f;
+        failures += ok ? 0 : 1;
+
+        const double percent = corePercent([&] {
+            work.copy(block);
+            limiter.process(work.block);
+        }, frames, rate, ms);
+        printRow("limiter boost " + std::to_string(channels) + " ch", limiter.variant(), true, ok, percent);
+        std::printf("  output true peak %.2f dBTP, gain reduction %.1f dB\n", 20.0 * std::log10(truePeak),
+            limiter.gainReductionDb());
+        if (channels == 2 && rate == 48000 && percent > 1.0) {
+            std::printf("  over the 1%% budget\n");
+            ++failures;
+        }
+    }
+
+    // -----------------------------
+    // Convolver
+    // -----------------------------
+    {
+        // One channel of a 1024 x 6 level per block of 1024 frames
+        const size_t partition = 1024;
+        const size_t count = 6;
+        std::vector<float> window(2 * partition), spectra(count * 2 * partition), filters(count * 2 * partition);
+        for (float& v : window) v = dist(rng);
+        for (float& v : spectra) v = dist(rng);
+        for (float& v : filters) v = dist(rng);
+        std::vector<float> accum(2 * partition), ref(2 * partition), out(2 * partition);
+        auto step = [&](RealFft& fft, SpectrumMacFn mac, std::vector<float>& result) {
+            fft.forward(window.data(), spectra.data(), spectra.data() + partition);
+            std::fill(accum.begin(), accum.end(), 0.0f);
+            for (size_t j = 0; j < count; ++j) {
+                const float* x = &spectra[j * 2 * partition];
+                const float* h = &filters[j * 2 * partition];
+                mac(x, x + partition, h, h + partition, accum.data(), accum.data() + partition, partition);
+            }
+            fft.inverse(accum.data(), accum.data() + partition, result.data());
+        };
+        RealFft scalarFft;
+        scalarFft.init(2 * partition, SimdLevel::Scalar);
+        step(scalarFft, RealFft::selectMac(SimdLevel::Scalar), ref);
+        float peak = 0.0f;
+        for (float v : ref) peak = std::max(peak, std::fabs(v));
+
+        RealFft selectedFft;
+        selectedFft.init(2 * partition);
+        const char* previous = nullptr;
+        for (SimdLevel level : kLevels) {
+            RealFft fft;
+            fft.init(2 * partition, level);
+            const char* variant = fft.variant();
+            if (previous && std::strcmp(previous, variant) == 0) continue;
+            previous = variant;
+            const SpectrumMacFn mac = RealFft::selectMac(level);
+
+            step(fft, mac, out);
+            const float tolerance = std::strcmp(variant, "avx2") == 0 ? 1e-5f * peak : 0.0f;
+            bool ok = true;
+            for (size_t i = 0; i < out.size() && ok; ++i) ok = std::fabs(out[i] - ref[i]) <= tolerance;
+            failures += ok ? 0 : 1;
+
+            const double percent = corePercent([&] { step(fft, mac, out); }, partition, rate, ms);
+            printRow("conv level 1024x6 1 ch", variant, std::strcmp(selectedFft.variant(), variant) == 0, ok, percent);
+        }
+    }
+
+    std::vector<size_t> irLengths = { 4096, 16384, 65536, 262144 };
+    if (irTaps > 0) irLengths = { irTaps };
+    for (size_t taps : irLengths) {
+        const int channels = 2;
+        std::vector<float> ir(taps * channels);
+        for (size_t i = 0; i < ir.size(); ++i) {
+            ir[i] = 0.05f * dist(rng) * static_cast<float>(std::exp(-6.0 * static_cast<double>(i) / ir.size()));
+        }
+        Convolver convolver;
+        convolver.setImpulseResponse(ir.data(), taps, channels, rate);
+        convolver.prepare(rate, channels);
+
+        // Check a window of output frames against a direct convolution
+        const size_t checkFrames = 256;
+        const size_t total = taps + frames + checkFrames;
+        std::vector<float> input(total * channels);
+        for (float& v : input) v = dist(rng);
+        PlanarBuffer whole(channels, total);
+        whole.load(input);
+        for (size_t offset = 0; offset < total; offset += frames) {
+            convolver.process(whole.block.slice(offset, std::min(frames, total - offset)));
+        }
+        std::vector<float> output;
+        whole.store(output);
+        const size_t latency = convolver.latency();
+        double error = 0.0, peak = 0.0;
+        for (size_t f = total - checkFrames; f < total; ++f) {
+            for (int c = 0; c < channels; ++c) {
+                const size_t n = f - latency;
+                double acc = 0.0;
+                for (size_t k = 0; k < taps && k <= n; ++k) acc += static_cast<double>(ir[k * channels + c]) * input[(n - k) * channels + c];
+                error = std::max(error, std::fabs(acc - output[f * channels + c]));
+                peak = std::max(peak, std::fabs(acc));
+            }
+        }
+        const bool ok = error <= 1e-5 * std::max(1.0, peak);
+        failures += ok ? 0 : 1;
+
+        // Cost: wall time of process() (includes waiting for the worker)
+        // and the inline / worker shares
+        std::vector<float> samples(frames * channels);
+        for (float& v : samples) v = dist(rng);
+        PlanarBuffer block(channels, frames);
+        block.load(samples);
+        for (size_t done = 0; done < static_cast<size_t>(rate); done += frames) convolver.process(block.block);
+        const uint64_t inlineBefore = convolver.inlineNanos();
+        const uint64_t workerBefore = convolver.workerNanos();
+        const uint64_t stallsBefore = convolver.stalls();
+        size_t runs = 0;
+        const double wall = corePercent([&] {
+            convolver.process(block.block);
+            ++runs;
+        }, frames, rate, ms);
+        const double audioSeconds = static_cast<double>(runs * frames) / rate;
+        const double inlinePercent = 100.0 * (convolver.inlineNanos() - inlineBefore) * 1e-9 / audioSeconds / channels;
+        const double workerPercent = 100.0 * (convolver.workerNanos() - workerBefore) * 1e-9 / audioSeconds / channels;
+        printRow("conv " + std::to_string(taps) + " taps per ch", convolver.variant(), true, ok, inlinePercent + workerPercent);
+        std::printf("  %s: inline %.4f%%, worker %.4f%%, process() wall %.4f%% per ch, %llu waits\n",
+            convolver.describe().c_str(), inlinePercent, workerPercent, wall / channels,
+            static_cast<unsigned long long>(convolver.stalls() - stallsBefore));
+        if (taps == 65536 && rate == 48000 && inlinePercent + workerPercent > 2.0) {
+            std::printf("  over the 2%% budget\n");
+            ++failures;
+        }
+    }
+
+    // -----------------------------
+    // DspChain
+    // -----------------------------
+    {
+        const int channels = 2;
+        struct Nodes {
+            std::shared_ptr<EqNode> eq = std::make_shared<EqNode>();
+            std::shared_ptr<GainNode> gain = std::make_shared<GainNode>();
+            std::shared_ptr<MatrixNode> matrix = std::make_shared<MatrixNode>();
+            std::shared_ptr<ConvolverNode> convolver = std::make_shared<ConvolverNode>();
+            std::shared_ptr<LimiterNode> limiter = std::make_shared<LimiterNode>();
+            explicit Nodes(const std::vector<EqBand>& bands) {
+                eq->eq().setBands(bands);
+                limiter->limiter().setInputGain(2.0f);
+            }
+            std::vector<DspNode*> all() const { return { eq.get(), gain.get(), matrix.get(), convolver.get(), limiter.get() }; }
+            // Gain and crossfeed change every 8th block
+            void change(int round) {
+                if (round % 8) return;
+                gain->setGainDb((round / 8) % 2 ? -3.0f : 0.0f);
+                const float side = (round / 8) % 3 * 0.1f;
+                matrix->setMatrix(2, { 1.0f - side, side, side, 1.0f - side });
+            }
+        };
+        Nodes chained(bands), direct(bands);
+        DspChain chain;
+        chain.add(chained.eq);
+        chain.add(chained.gain);
+        chain.add(chained.matrix);
+        chain.add(chained.convolver);
+        chain.add(chained.limiter);
+        chain.prepare(rate, channels);
+        for (DspNode* node : direct.all()) node->prepare(rate, channels);
+
+        std::vector<float> samples(frames * channels);
+        for (float& v : samples) v = dist(rng);
+        PlanarBuffer block(channels, frames), a(channels, frames), b(channels, frames);
+        block.load(samples);
+        std::vector<float> outA, outB;
+        bool ok = true;
+        for (int round = 0; round < 64 && ok; ++round) {
+            chained.change(round);
+            direct.change(round);
+            a.copy(block);
+            b.copy(block);
+            chain.process(a.block);
+            for (DspNode* node : direct.all()) node->process(b.block);
+            a.store(outA);
+            b.store(outB);
+            ok = outA == outB;
+        }
+        failures += ok ? 0 : 1;
+
+        chain.prepare(rate, channels);   // costs from here on
+        int round = 0;
+        const double wall = corePercent([&] {
+            chained.change(round++);
+            a.copy(block);
+            chain.process(a.block);
+        }, frames, rate, ms);
+        double nodes = 0.0;
+        for (const DspNodeCost& cost : chain.costs()) {
+            printRow("chain " + cost.name + " 2 ch", "", false, ok, cost.load);
+            nodes += cost.load;
+        }
+        printRow("chain total 2 ch", "", false, ok, wall);
+        std::printf("  chain overhead %.4f%% (process() wall time minus the nodes)\n", wall - nodes);
+
+        // The decode thread's whole stage: decoder block -> planar -> chain ->
+        // interleaved frames
+        std::vector<float> interleaved(samples.size());
+        const double stage = corePercent([&] {
+            chained.change(round++);
+            a.load(samples);
+            chain.process(a.block);
+            a.kernels.interleave(a.block, interleaved.data(), frames);
+        }, frames, rate, ms);
+        printRow("stage 2 ch", a.kernels.variant, false, ok, stage);
+        std::printf("  transposes %.4f%% (stage minus chain)\n", stage - wall);
+    }
+
+    // -----------------------------
+    // Parallel chain
+    // -----------------------------
+    {
+        const int channels = 8;
+        const size_t taps = 65536;
+        const int rounds = 16;
+        std::vector<float> ir(taps * 2);
+        for (size_t i = 0; i < ir.size(); ++i) {
+            ir[i] = 0.05f * dist(rng) * static_cast<float>(std::exp(-6.0 * static_cast<double>(i) / ir.size()));
+        }
+        std::vector<float> samples(frames * rounds * channels);
+        for (float& v : samples) v = dist(rng);
+        PlanarBuffer source(channels, frames * rounds), a(channels, frames);
+        source.load(samples);
+        auto input = [&](int round) {
+            const AudioBlock part = source.block.slice(static_cast<size_t>(round % rounds) * frames, frames);
+            for (int c = 0; c < channels; ++c) std::memcpy(a.block.channel[c], part.channel[c], frames * sizeof(float));
+        };
+        std::printf("  %u hardware threads\n", std::thread::hardware_concurrency());
+
+        std::vector<float> reference, output;
+        double serial = 0.0;
+        for (int workers : { 0, 2, 4, 8 }) {
+            auto eq = std::make_shared<EqNode>();
+            auto convolver = std::make_shared<ConvolverNode>();
+            auto limiter = std::make_shared<LimiterNode>();
+            eq->eq().setBands(bands);
+            convolver->convolver().setImpulseResponse(ir.data(), taps, 2, rate);
+            limiter->limiter().setInputGain(2.0f);
+            DspWorkerPool pool;
+            pool.start(workers);
+            DspChain chain;
+            chain.setWorkers(&pool);
+            chain.add(eq);
+            chain.add(convolver);
+            chain.add(limiter);
+            chain.prepare(rate, channels);
+
+            // Same output as the serial chain, block for block
+            std::vector<float> out;
+            for (int round = 0; round < 4 * rounds; ++round) {
+                input(round);
+                chain.process(a.block);
+                a.store(output);
+                out.insert(out.end(), output.begin(), output.end());
+            }
+            if (workers == 0) reference = out;
+            const bool ok = out == reference;
+            failures += ok ? 0 : 1;
+
+            chain.prepare(rate, channels);   // costs and deadline counts from here on
+            int round = 0;
+            const double wall = corePercent([&] {
+                input(round++);
+                chain.process(a.block);
+            }, frames, rate, ms);
+            double cpu = 0.0;
+            for (const DspNodeCost& cost : chain.costs()) cpu += cost.load + cost.background;
+            if (workers == 0) serial = wall;
+            printRow("parallel 8 ch " + std::to_string(workers) + " workers", "", false, ok, wall);
+            std::printf("  cpu %.4f%%, %.2fx vs serial, %llu of %llu blocks over the deadline, %d pinned, %llu wake-ups\n",
+                cpu, serial / wall, static_cast<unsigned long long>(chain.deadlineMisses()),
+                static_cast<unsigned long long>(chain.blocks()), pool.pinned(),
+                static_cast<unsigned long long>(pool.wakeups()));
+        }
+    }
+
+    // -----------------------------
+    // Governor
+    // -----------------------------
+    {
+        const int channels = 8;
+        const size_t taps = std::max<size_t>(irTaps, 262144);
+        std::vector<float> ir(taps * 2);
+        for (size_t i = 0; i < ir.size(); ++i) {
+            ir[i] = 0.05f * dist(rng) * static_cast<float>(std::exp(-6.0 * static_cast<double>(i) / ir.size()));
+        }
+        std::vector<float> samples(frames * channels);
+        for (float& v : samples) v = dist(rng);
+        PlanarBuffer a(channels, frames);
+        auto eq = std::make_shared<EqNode>();
+        auto convolver = std::make_shared<ConvolverNode>();
+        auto limiter = std::make_shared<LimiterNode>();
+        eq->eq().setBands(bands);
+        convolver->convolver().setImpulseResponse(ir.data(), taps, 2, rate);
+        limiter->limiter().setInputGain(2.0f);
+        DspChain chain;
+        chain.add(eq);
+        chain.add(convolver);
+        chain.add(limiter);
+        chain.prepare(rate, channels);
+
+        double full = 0.0;
+        for (int tier = 0; tier <= DspChain::kMaxQualityTier; ++tier) {
+            for (const auto& node : chain.nodes()) node->setQualityTier(tier);
+            const double wall = corePercent([&] {
+                a.load(samples);
+                chain.process(a.block);
+            }, frames, rate, ms);
+            if (tier == 0) full = wall;
+            printRow("tier " + std::to_string(tier) + " 8 ch", "", false, true, wall);
+            std::printf("  convolving %zu of %zu taps, limiter on %s peaks\n", convolver->convolver().activeLength(),
+                convolver->convolver().length(), limiter->limiter().samplePeak() ? "sample" : "true");
+        }
+
+        // Overloaded: tier 0 takes twice its deadline
+        chain.setGovernor(true);
+        chain.prepare(rate, channels);
+        chain.setDeadline(full / 100.0 / 2.0);
+        for (int round = 0; round < 200; ++round) {
+            a.load(samples);
+            chain.process(a.block);
+        }
+        const int loaded = chain.qualityTier();
+        const uint64_t misses = chain.deadlineMisses();
+        std::string tiers;
+        for (int t = 0; t <= DspChain::kMaxQualityTier; ++t) {
+            tiers += (t == 0 ? "" : "/") + std::to_string(chain.tierBlocks(t));
+        }
+
+        // Headroom again: one tier up per kCalmBlocks
+        chain.setDeadline(100.0);
+        uint64_t rounds = 0;
+        const uint64_t limit = (DspChain::kMaxQualityTier + 1) * DspChain::kCalmBlocks;
+        for (; rounds < limit && chain.qualityTier() > 0; ++rounds) {
+            a.load(samples);
+            chain.process(a.block);
+        }
+        const bool ok = loaded > 0 && chain.qualityTier() == 0;
+        failures += ok ? 0 : 1;
+        printRow("governor 8 ch", "", false, ok, full);
+        std::printf("  overloaded: tier %d after 200 blocks (%llu misses, blocks per tier %s); "
+                    "recovered to tier %d in %llu blocks, %llu changes\n",
+            loaded, static_cast<unsigned long long>(misses), tiers.c_str(), chain.qualityTier(),
+            static_cast<unsigned long long>(rounds), static_cast<unsigned long long>(chain.tierChanges()));
+    }
+
+    if (failures) std::printf("\n%d check(s) FAILED\n", failures);
+    return failures ? 1 : 0;
+}
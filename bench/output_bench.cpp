@@ -0,0 +1,122 @@
+/**
+ * output_bench.cpp
+ *
+ * Memory use and per-period cost of AudioOutput's ring storage modes.
+ *
+ * For each ring format (float32, int16, packed int24) and device format,
+ * walks a ring of 2 s of audio period by period, doing what the PortAudio
+ * callback does (expand the compact ring to float, then render to the device
+ * format, with kernels selected once per stream),
+ * and what write() does on the producer side (quantize float into the
+ * ring). The ring is larger than the caches at high rates, so the numbers
+ * include the memory traffic the compact formats save.
+ *
+ * Usage:
+ *   output_bench [--rate HZ] [--channels N] [--period FRAMES] [--seconds S]
+ */
+
+#include "audio/sample_format.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static size_t nextPowerOfTwo(size_t v) {
+    size_t p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+int main(int argc, char** argv) {
+    int rate = 192000;
+    int channels = 8;
+    size_t period = 1024;
+    double seconds = 5.0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--channels") == 0 && i + 1 < argc) {
+            channels = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--period") == 0 && i + 1 < argc) {
+            period = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = std::atof(argv[++i]);
+        } else {
+            std::fprintf(stderr, "Usage: %s [--rate HZ] [--channels N] [--period FRAMES] [--seconds S]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (rate <= 0 || channels <= 0 || period == 0) return 1;
+
+    // Same sizing as AudioOutput::init(): 2 s rounded up to a power of two.
+    const size_t ringFrames = nextPowerOfTwo(static_cast<size_t>(rate) * 2);
+    const size_t periodSamples = period * channels;
+    const size_t ringSamples = ringFrames * channels;
+
+    std::vector<float> source(ringSamples);
+    for (size_t i = 0; i < ringSamples; ++i) {
+        source[i] = 0.5f * std::sin(static_cast<float>(i / channels) * 0.01f + static_cast<float>(i % channels));
+    }
+
+    const DeviceFormat rings[] = { DeviceFormat::Float32, DeviceFormat::Int16, DeviceFormat::Int24 };
+    const DeviceFormat devices[] = { DeviceFormat::Float32, DeviceFormat::Int32, DeviceFormat::Int24, DeviceFormat::Int16 };
+
+    std::printf("%d Hz, %d ch, ring %zu frames, period %zu frames (%.2f ms)\n\n",
+                rate, channels, ringFrames, period, 1000.0 * period / rate);
+    std::printf("%-8s %10s %10s", "ring", "ring KiB", "write ns");
+    for (DeviceFormat d : devices) std::printf(" %9s", deviceFormatName(d));
+    std::printf("   (callback ns per period by device format)\n");
+
+    using clock = std::chrono::steady_clock;
+    std::vector<float> scratch(periodSamples);
+    std::vector<uint8_t> out(periodSamples * 4);
+    const size_t periods = std::max<size_t>(1, static_cast<size_t>(seconds * rate / period));
+
+    for (DeviceFormat ring : rings) {
+        const size_t bytes = deviceFormatBytes(ring);
+        const SampleKernels ringKernels = selectSampleKernels(ring);
+        std::vector<uint8_t> buffer(ringSamples * bytes + 16);
+
+        // Producer side: fill the whole ring once, timed per period.
+        DitherState writeDither;
+        auto t0 = clock::now();
+        for (size_t f = 0; f + period <= ringFrames; f += period) {
+            const float* src = source.data() + f * channels;
+            uint8_t* dst = buffer.data() + f * channels * bytes;
+            if (ring == DeviceFormat::Float32) {
+                std::memcpy(dst, src, periodSamples * sizeof(float));
+            } else {
+                ringKernels.render(src, dst, periodSamples, 1.0f, &writeDither);
+            }
+        }
+        double writeNs = std::chrono::duration<double, std::nano>(clock::now() - t0).count() / (ringFrames / period);
+        std::printf("%-8s %10zu %10.0f", deviceFormatName(ring), ringSamples * bytes >> 10, writeNs);
+
+        // Consumer side: the callback's expand + device conversion.
+        for (DeviceFormat device : devices) {
+            const RenderKernelFn render = selectSampleKernels(device).render;
+            DitherState dither;
+            size_t pos = 0;
+            auto t1 = clock::now();
+            for (size_t p = 0; p < periods; ++p) {
+                if (pos + period > ringFrames) pos = 0;
+                const uint8_t* src = buffer.data() + pos * channels * bytes;
+                if (ring == DeviceFormat::Float32) {
+                    render(reinterpret_cast<const float*>(src), out.data(), periodSamples, 0.8f, &dither);
+                } else {
+                    ringKernels.expand(src, scratch.data(), periodSamples);
+                    render(scratch.data(), out.data(), periodSamples, 0.8f, &dither);
+                }
+                pos += period;
+            }
+            double ns = std::chrono::duration<double, std::nano>(clock::now() - t1).count() / periods;
+            std::printf(" %9.0f", ns);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
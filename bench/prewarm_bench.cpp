@@ -0,0 +1,104 @@
+/**
+ * prewarm_bench.cpp
+ *
+ * Cold-start benchmark for QueuePrefetcher.
+ *
+ * For each file, measures time-to-first-audio (FFmpegDecoder::open() plus
+ * the first decode() call) in two situations:
+ *   - cold     : the file's pages were dropped from the page cache
+ *   - prewarm  : pages dropped, then QueuePrefetcher::prewarm() issued and
+ *                a short "previous track still playing" gap allowed
+ *
+ * Pages are dropped with posix_fadvise(DONTNEED), which needs no privileges
+ * but only evicts clean pages; run on files that are not being written.
+ *
+ * Usage:
+ *   prewarm_bench [--budget-kb N] [--gap-ms N] <file> [file...]
+ */
+
+#include "decoder/ffmpeg_decoder.h"
+#include "io/queue_prefetcher.h"
+#include "utils/logger.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+static bool dropFromPageCache(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    ::close(fd);
+    return ok;
+}
+
+// open() + first decode(), in milliseconds; negative on failure.
+static double timeToFirstAudio(const std::string& path) {
+    using clock = std::chrono::steady_clock;
+    auto t0 = clock::now();
+    FFmpegDecoder decoder;
+    if (!decoder.open(path)) return -1.0;
+    std::vector<int16_t> buffer;
+    if (decoder.decode(buffer) <= 0) return -1.0;
+    return std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+}
+
+int main(int argc, char** argv) {
+    uint64_t budgetKB = 1024;
+    int gapMs = 200;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--budget-kb") == 0 && i + 1 < argc) {
+            budgetKB = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--gap-ms") == 0 && i + 1 < argc) {
+            gapMs = std::atoi(argv[++i]);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        std::fprintf(stderr, "Usage: %s [--budget-kb N] [--gap-ms N] <file> [file...]\n", argv[0]);
+        return 1;
+    }
+
+    Logger::instance().setLogFile("prewarm_bench.log");
+
+    double coldTotal = 0.0, warmTotal = 0.0;
+    int measured = 0;
+    std::printf("%-50s %10s %10s\n", "file", "cold ms", "prewarm ms");
+    for (const auto& path : files) {
+        if (!dropFromPageCache(path)) {
+            std::fprintf(stderr, "Cannot drop %s from the page cache, skipping\n", path.c_str());
+            continue;
+        }
+        double cold = timeToFirstAudio(path);
+
+        dropFromPageCache(path);
+        QueuePrefetcher::prewarm(path, budgetKB << 10, 64 * 1024);
+        std::this_thread::sleep_for(std::chrono::milliseconds(gapMs));
+        double warm = timeToFirstAudio(path);
+
+        if (cold < 0.0 || warm < 0.0) {
+            std::fprintf(stderr, "Failed to decode %s\n", path.c_str());
+            continue;
+        }
+        std::printf("%-50.50s %10.2f %10.2f\n", path.c_str(), cold, warm);
+        coldTotal += cold;
+        warmTotal += warm;
+        ++measured;
+    }
+
+    if (measured > 0) {
+        std::printf("%-50s %10.2f %10.2f   (budget %llu KiB, gap %d ms)\n", "average",
+                    coldTotal / measured, warmTotal / measured,
+                    static_cast<unsigned long long>(budgetKB), gapMs);
+    }
+    return 0;
+}
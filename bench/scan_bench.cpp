@@ -0,0 +1,148 @@
+/**
+ * scan_bench.cpp
+ *
+ * Library scan benchmark: files/s for each LibraryScanner backend on a cold
+ * and on a warm cache.
+ *
+ * Cold runs drop file data from the page cache with posix_fadvise(DONTNEED).
+ * When run as root, /proc/sys/vm/drop_caches is also written so that dentry
+ * and inode caches are cold too (closer to a first scan after boot).
+ *
+ * Before timing, both backends scan a scratch directory holding a readable
+ * and an unreadable (mode 000) file and must produce the same library: the
+ * unreadable file is left out. Root can read mode-000 files, so the check
+ * then only compares the backends. Exit status 1 on a mismatch.
+ *
+ * Usage:
+ *   scan_bench <music-dir> [--threads N] [--iterations N]
+ */
+
+#include "library/library_scanner.h"
+#include "utils/logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void dropCaches(const std::vector<std::string>& files) {
+    if (::geteuid() == 0) {
+        ::sync();
+        std::ofstream("/proc/sys/vm/drop_caches") << "3\n";
+        return;
+    }
+    for (const auto& path : files) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) continue;
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+}
+
+// Paths `backend` adds to an empty library from `files`, sorted.
+static std::vector<std::string> scannedPaths(LibraryScanner::Backend backend, const std::vector<std::string>& files) {
+    LibraryScanner scanner(backend, 2);
+    TrackLibrary library;
+    scanner.scan(files, library);
+    std::vector<std::string> paths;
+    for (TrackId id = 0; id < library.rowCount(); ++id) {
+        if (library.isLive(id)) paths.push_back(library.path(id));
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+// Both backends on a readable and an unreadable file; false on a mismatch.
+static bool checkBackends() {
+    char dirTemplate[] = "/tmp/scan_bench.XXXXXX";
+    if (!::mkdtemp(dirTemplate)) return true;
+    const std::string dir = dirTemplate;
+    const std::string readable = dir + "/readable.mp3";
+    const std::string unreadable = dir + "/unreadable.mp3";
+    std::ofstream(readable) << "ID3";
+    std::ofstream(unreadable) << "ID3";
+    ::chmod(unreadable.c_str(), 0);
+    const std::vector<std::string> files = { readable, unreadable };
+
+    const bool root = ::geteuid() == 0;
+    std::vector<std::string> expected = { readable };
+    if (root) expected.push_back(unreadable);
+
+    bool ok = true;
+    const LibraryScanner::Backend backends[] = {
+        LibraryScanner::Backend::ThreadPool, LibraryScanner::Backend::IoUring
+    };
+    for (auto backend : backends) {
+        if (LibraryScanner(backend, 1).activeBackend() != backend) continue;
+        std::vector<std::string> paths = scannedPaths(backend, files);
+        bool match = paths == expected;
+        std::printf("%-12s unreadable file check: %zu of 2 files added   %s\n",
+                    LibraryScanner::backendName(backend), paths.size(), match ? "ok" : "MISMATCH");
+        ok = ok && match;
+    }
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    return ok;
+}
+
+static double scanOnce(LibraryScanner& scanner, const std::vector<std::string>& files) {
+    TrackLibrary library;
+    auto t0 = std::chrono::steady_clock::now();
+    scanner.scan(files, library);
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return files.size() / s;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <music-dir> [--threads N] [--iterations N]\n", argv[0]);
+        return 1;
+    }
+    unsigned threads = 0;
+    int iterations = 3;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = std::max(1, std::atoi(argv[++i]));
+        }
+    }
+
+    Logger::instance().setLogFile("scan_bench.log");
+    const bool backendsAgree = checkBackends();
+
+    std::vector<std::string> files = LibraryScanner::listAudioFiles(argv[1]);
+    std::printf("%zu audio files under %s%s\n", files.size(), argv[1],
+                ::geteuid() == 0 ? "" : " (not root: dentry/inode caches stay warm on cold runs)");
+    if (files.empty()) return 1;
+
+    const LibraryScanner::Backend backends[] = {
+        LibraryScanner::Backend::ThreadPool, LibraryScanner::Backend::IoUring
+    };
+    for (auto backend : backends) {
+        LibraryScanner scanner(backend, threads);
+        if (scanner.activeBackend() != backend) {
+            std::printf("%-12s unavailable\n", LibraryScanner::backendName(backend));
+            continue;
+        }
+
+        double cold = 0.0, warm = 0.0;
+        for (int i = 0; i < iterations; ++i) {
+            dropCaches(files);
+            cold += scanOnce(scanner, files);
+            warm += scanOnce(scanner, files);
+        }
+        std::printf("%-12s cold %10.0f files/s   warm %10.0f files/s\n",
+                    LibraryScanner::backendName(backend), cold / iterations, warm / iterations);
+    }
+    return backendsAgree ? 0 : 1;
+}
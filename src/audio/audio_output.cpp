@@ -43,19 +43,37 @@ size_t AudioOutput::nextPowerOfTwo(size_t v) {
     return ++v;
 }
 
+static PaSampleFormat paFormatOf(DeviceFormat format) {
+    switch (format) {
+    case DeviceFormat::Int32: return paInt32;
+    case DeviceFormat::Int24: return paInt24;
+    case DeviceFormat::Int16: return paInt16;
+    default: return paFloat32;
+    }
+}
+
 // -----------------------------
 // Constructor / Destructor
 // -----------------------------
 AudioOutput::AudioOutput()
-    : capacityFrames_(0),
+    : ringFormat_(DeviceFormat::Float32),
+      ringBytes_(sizeof(float)),
+      ringKernels_(selectSampleKernels(DeviceFormat::Float32)),
+      planarKernels_(selectPlanarKernels(0)),
+      capacityFrames_(0),
       channels_(0),
+      outputChannels_(0),
       head_(0),
       tail_(0),
+      flushTo_(kNoFlush),
       stream_(nullptr),
       sampleRate_(0),
       framesPerBuffer_(0),
       dummyMode_(false),
-      volume_(1.0f)
+      volume_(1.0f),
+      preferredFormat_(DeviceFormat::Float32),
+      format_(DeviceFormat::Float32),
+      deviceKernels_(selectSampleKernels(DeviceFormat::Float32))
 {}
 
 AudioOutput::~AudioOutput() {
@@ -65,25 +83,14 @@ AudioOutput::~AudioOutput() {
 
 // -----------------------------
 // init()
-//  - allocate ring buffer sized (in frames).
-//  - open PortAudio (paInitialize) and configure stream parameters.
+//  - open PortAudio (paInitialize), pick the device's channel count.
+//  - allocate ring buffer sized (in frames) and configure stream parameters.
 // -----------------------------
 bool AudioOutput::init(int sampleRate, int channels, unsigned long framesPerBuffer) {
     sampleRate_ = sampleRate;
     channels_ = channels;
     framesPerBuffer_ = framesPerBuffer;
 
-    // Choose ring buffer capacity (in frames). Use a medium buffer to allow some margin.
-    // Example: 2 seconds worth of audio at 44100 = 88200 frames.
-    size_t desiredFrames = static_cast<size_t>(sampleRate) * 2; // 2 seconds
-    capacityFrames_ = nextPowerOfTwo(desiredFrames);
-
-    // allocate interleaved buffer: capacityFrames * channels floats
-    buffer_.assign(capacityFrames_ * channels_, 0.0f);
-
-    head_.store(0);
-    tail_.store(0);
-
     PaError err = Pa_Initialize();
     if (err != paNoError) {
         Logger::instance().log(LogLevel::ERROR, std::string("PortAudio init failed: ") + Pa_GetErrorText(err));
@@ -97,17 +104,27 @@ bool AudioOutput::init(int sampleRate, int channels, unsigned long framesPerBuff
     if (outParams.device == paNoDevice) {
         Logger::instance().log(LogLevel::WARNING, "No default output device. Falling back to DUMMY mode (no sound).");
         dummyMode_ = true;
+        allocateRing();
         return true;
     }
-    outParams.channelCount = channels_;
-    outParams.sampleFormat = paFloat32; // we write float samples
-    
+
     const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(outParams.device);
-    Logger::instance().log(LogLevel::INFO, std::string("Using Audio Device: ") + deviceInfo->name);
+    channels_ = chooseChannels(deviceInfo->maxOutputChannels, channels);
+    outParams.channelCount = channels_;
+    Logger::instance().log(LogLevel::INFO, std::string("Using Audio Device: ") + deviceInfo->name + " (" +
+        std::to_string(channels_) + " of " + std::to_string(deviceInfo->maxOutputChannels) + " channels)");
+    allocateRing();
     outParams.suggestedLatency = deviceInfo->defaultHighOutputLatency;
 
     outParams.hostApiSpecificStreamInfo = nullptr;
 
+    format_ = negotiateFormat(outParams);
+    deviceKernels_ = selectSampleKernels(format_);
+    outParams.sampleFormat = paFormatOf(format_);
+    dither_ = DitherState();
+    Logger::instance().log(LogLevel::INFO, std::string("AudioOutput: device format ") + deviceFormatName(format_) + " (" +
+        deviceKernels_.variant + " kernels)");
+
     // Open stream with static callback lambda wrapper
     err = Pa_OpenStream(
         &stream_,
@@ -115,7 +132,7 @@ bool AudioOutput::init(int sampleRate, int channels, unsigned long framesPerBuff
         &outParams,
         sampleRate_,
         framesPerBuffer_,
-        paClipOff,
+        paClipOff | paDitherOff,    // render() clamps and dithers
         // Callback function
         [](const void* inputBuffer, void* outputBuffer,
            unsigned long framesPerBuffer,
@@ -123,44 +140,7 @@ bool AudioOutput::init(int sampleRate, int channels, unsigned long framesPerBuff
            PaStreamCallbackFlags statusFlags,
            void* userData) -> int
         {
-            // Cast user data to our AudioOutput instance
-            AudioOutput* out = reinterpret_cast<AudioOutput*>(userData);
-            float* outBuf = reinterpret_cast<float*>(outputBuffer);
-
-            // Get indices in frames
-            size_t tail = out->tail_.load(std::memory_order_acquire);
-            size_t head = out->head_.load(std::memory_order_acquire);
-
-            size_t availableFrames = (head - tail) & (out->capacityFrames_ - 1);
-
-            // If not enough frames, we may underflow: output silence for missing frames
-            size_t framesToRead = std::min<size_t>(framesPerBuffer, availableFrames);
-
-            // Read framesToRead frames from ring buffer into outBuf
-            float vol = out->volume_.load(std::memory_order_relaxed);
-            for (size_t f = 0; f < framesToRead; ++f) {
-                size_t idx = ((tail + f) & (out->capacityFrames_ - 1)) * out->channels_;
-                // copy channels_
-                for (int c = 0; c < out->channels_; ++c) {
-                    float sample = out->buffer_[idx + c] * vol;
-                    // Soft-clip / Clamp to [-1.0, 1.0] to allow volume boost without wrapping
-                    if (sample > 1.0f) sample = 1.0f;
-                    else if (sample < -1.0f) sample = -1.0f;
-                    outBuf[f * out->channels_ + c] = sample;
-                }
-            }
-
-            // Fill the rest with silence if underrun
-            if (framesToRead < framesPerBuffer) {
-                size_t start = framesToRead * out->channels_;
-                size_t silenceSamples = (framesPerBuffer - framesToRead) * out->channels_;
-                std::memset(outBuf + start, 0, silenceSamples * sizeof(float));
-            }
-
-            // Advance tail atomically by framesToRead
-            out->tail_.store((tail + framesToRead) & (out->capacityFrames_ - 1), std::memory_order_release);
-
-            // Continue streaming
+            reinterpret_cast<AudioOutput*>(userData)->render(outputBuffer, framesPerBuffer);
             return paContinue;
         },
         this // userData
@@ -175,6 +155,118 @@ bool AudioOutput::init(int sampleRate, int channels, unsigned long framesPerBuff
     return true;
 }
 
+// -----------------------------
+// allocateRing()
+//  - ring buffer of ~2 s for channels_ channels in ringFormat_.
+// -----------------------------
+void AudioOutput::allocateRing() {
+    // Choose ring buffer capacity (in frames). Use a medium buffer to allow some margin.
+    // Example: 2 seconds worth of audio at 44100 = 88200 frames.
+    size_t desiredFrames = static_cast<size_t>(sampleRate_) * 2; // 2 seconds
+    capacityFrames_ = nextPowerOfTwo(desiredFrames);
+
+    // allocate interleaved buffer: capacityFrames * channels samples
+    ringBytes_ = deviceFormatBytes(ringFormat_);
+    ringKernels_ = selectSampleKernels(ringFormat_);
+    buffer_.assign(capacityFrames_ * channels_ * ringBytes_, 0);
+    scratch_.assign(kScratchFrames * channels_, 0.0f);
+    planarKernels_ = selectPlanarKernels(channels_);
+    writeScratch_.assign(ringFormat_ == DeviceFormat::Float32 ? 0 : kScratchFrames * channels_, 0.0f);
+    writeDither_ = DitherState();
+    Logger::instance().log(LogLevel::INFO, std::string("AudioOutput: ring ") + std::to_string(capacityFrames_) + " frames x " +
+        std::to_string(channels_) + " ch " + deviceFormatName(ringFormat_) + " (" + std::to_string(buffer_.size() >> 10) + " KiB, " +
+        ringKernels_.variant + " kernels)");
+
+    head_.store(0);
+    tail_.store(0);
+    flushTo_.store(kNoFlush);
+}
+
+// -----------------------------
+// chooseChannels()
+//  - the override, else the device's own channel count. A device reporting
+//    more than ChannelMixer::kMaxChannels (a sound server, a multi-output
+//    interface) has no fixed speaker layout and gets the source's count.
+// -----------------------------
+int AudioOutput::chooseChannels(int deviceChannels, int sourceChannels) const {
+    int n = deviceChannels >= 1 && deviceChannels <= ChannelMixer::kMaxChannels ? deviceChannels : sourceChannels;
+    if (outputChannels_ > 0) n = outputChannels_;
+    if (deviceChannels >= 1) n = std::min(n, deviceChannels);
+    return std::max(1, std::min(n, ChannelMixer::kMaxChannels));
+}
+
+// -----------------------------
+// negotiateFormat()
+//  - preferred format first, then best resolution first.
+// -----------------------------
+DeviceFormat AudioOutput::negotiateFormat(PaStreamParameters& params) {
+    const DeviceFormat order[] = { preferredFormat_, DeviceFormat::Float32, DeviceFormat::Int32,
+                                   DeviceFormat::Int24, DeviceFormat::Int16 };
+    for (DeviceFormat format : order) {
+        params.sampleFormat = paFormatOf(format);
+        if (Pa_IsFormatSupported(nullptr, &params, sampleRate_) == paFormatIsSupported) {
+            return format;
+        }
+    }
+    // Nothing reported as supported: let Pa_OpenStream decide about float.
+    return DeviceFormat::Float32;
+}
+
+// -----------------------------
+// render() -> PortAudio callback body
+//   - converts up to frameCount frames from the ring to the device format
+//     (at most two contiguous spans), silence for the rest.
+// -----------------------------
+void AudioOutput::render(void* out, unsigned long frameCount) {
+    const size_t mask = capacityFrames_ - 1;
+    const size_t frameBytes = deviceFormatBytes(format_) * channels_;
+    uint8_t* dst = static_cast<uint8_t*>(out);
+
+    // Get indices in frames
+    size_t tail = tail_.load(std::memory_order_acquire);
+    size_t head = head_.load(std::memory_order_acquire);
+
+    // Pending flush from the producer: skip to where it was when flush() ran
+    size_t flushTo = flushTo_.exchange(kNoFlush, std::memory_order_acq_rel);
+    if (flushTo != kNoFlush) tail = flushTo;
+
+    size_t availableFrames = (head - tail) & mask;
+
+    // If not enough frames, we may underflow: output silence for missing frames
+    size_t framesToRead = std::min<size_t>(frameCount, availableFrames);
+
+    float vol = volume_.load(std::memory_order_relaxed);
+    // A compact ring already holds values on the device's integer grid
+    // unless the volume scales them or the device is narrower.
+    bool exact = ringFormat_ != DeviceFormat::Float32 && vol == 1.0f &&
+                 deviceFormatBits(format_) >= deviceFormatBits(ringFormat_);
+    DitherState* dither = exact ? nullptr : &dither_;
+
+    size_t done = 0;
+    while (done < framesToRead) {
+        size_t pos = (tail + done) & mask;
+        size_t span = std::min(framesToRead - done, capacityFrames_ - pos);
+        const uint8_t* src = buffer_.data() + pos * channels_ * ringBytes_;
+        if (ringFormat_ == DeviceFormat::Float32) {
+            deviceKernels_.render(reinterpret_cast<const float*>(src), dst + done * frameBytes,
+                                  span * channels_, vol, dither);
+        } else {
+            span = std::min(span, kScratchFrames);
+            ringKernels_.expand(src, scratch_.data(), span * channels_);
+            deviceKernels_.render(scratch_.data(), dst + done * frameBytes, span * channels_, vol, dither);
+        }
+        done += span;
+    }
+
+    // Fill the rest with silence if underrun (all formats: zero bytes)
+    if (framesToRead < frameCount) {
+        std::memset(dst + framesToRead * frameBytes, 0, (frameCount - framesToRead) * frameBytes);
+    }
+
+    // Advance tail atomically by framesToRead
+    tail_.store((tail + framesToRead) & mask, std::memory_order_release);
+}
+
 // -----------------------------
 // start() / stop()
 // -----------------------------
@@ -228,13 +320,19 @@ size_t AudioOutput::write(const float* frames, size_t frameCount) {
 
     size_t toWrite = std::min(frameCount, freeFrames);
 
-    // Write frames into ring buffer
-    for (size_t f = 0; f < toWrite; ++f) {
-        size_t idx = ((head + f) & (capacityFrames_ - 1)) * channels_;
-        // copy channel samples
-        for (int c = 0; c < channels_; ++c) {
-            buffer_[idx + c] = frames[f * channels_ + c];
+    // Write frames into ring buffer (at most two contiguous spans)
+    size_t done = 0;
+    while (done < toWrite) {
+        size_t pos = (head + done) & (capacityFrames_ - 1);
+        size_t span = std::min(toWrite - done, capacityFrames_ - pos);
+        uint8_t* dst = buffer_.data() + pos * channels_ * ringBytes_;
+        const float* src = frames + done * channels_;
+        if (ringFormat_ == DeviceFormat::Float32) {
+            std::memcpy(dst, src, span * channels_ * sizeof(float));
+        } else {
+            ringKernels_.render(src, dst, span * channels_, 1.0f, &writeDither_);
         }
+        done += span;
     }
 
     // Publish new head index
@@ -243,6 +341,57 @@ size_t AudioOutput::write(const float* frames, size_t frameCount) {
     return toWrite;
 }
 
+size_t AudioOutput::writePlanar(const AudioBlock& block, size_t frameCount) {
+    if (dummyMode_) {
+        return frameCount;
+    }
+    if (!planarKernels_.interleave || block.channels != channels_) {
+        return 0;
+    }
+
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    size_t freeFrames = (tail - head - 1) & (capacityFrames_ - 1);
+    size_t toWrite = std::min(frameCount, freeFrames);
+
+    // Interleave straight into the ring (float), or through the scratch
+    // buffer and the quantizer (int16 / int24)
+    size_t done = 0;
+    while (done < toWrite) {
+        size_t pos = (head + done) & (capacityFrames_ - 1);
+        size_t span = std::min(toWrite - done, capacityFrames_ - pos);
+        uint8_t* dst = buffer_.data() + pos * channels_ * ringBytes_;
+        if (ringFormat_ == DeviceFormat::Float32) {
+            planarKernels_.interleave(block.slice(done, span), reinterpret_cast<float*>(dst), span);
+        } else {
+            for (size_t chunk = 0; chunk < span; chunk += kScratchFrames) {
+                const size_t n = std::min(kScratchFrames, span - chunk);
+                planarKernels_.interleave(block.slice(done + chunk, n), writeScratch_.data(), n);
+                ringKernels_.render(writeScratch_.data(), dst + chunk * channels_ * ringBytes_, n * channels_, 1.0f,
+                                    &writeDither_);
+            }
+        }
+        done += span;
+    }
+
+    head_.store((head + toWrite) & (capacityFrames_ - 1), std::memory_order_release);
+    return toWrite;
+}
+
+void AudioOutput::flush() {
+    if (dummyMode_) {
+        return;
+    }
+    size_t head = head_.load(std::memory_order_acquire);
+    if (!stream_ || Pa_IsStreamActive(stream_) != 1) {
+        // No callback running: the producer may move the tail itself.
+        flushTo_.store(kNoFlush, std::memory_order_relaxed);
+        tail_.store(head, std::memory_order_release);
+        return;
+    }
+    flushTo_.store(head, std::memory_order_release);
+}
+
 size_t AudioOutput::available() const {
     size_t head = head_.load(std::memory_order_acquire);
     size_t tail = tail_.load(std::memory_order_acquire);
@@ -10,9 +10,17 @@
        bool start()
        void stop()
        size_t write(const float* frames, size_t frameCount)  // producer API
+       size_t writePlanar(const AudioBlock& block, size_t frameCount)
        size_t available() const                              // how many frames free
        size_t size() const                                   // how many frames used
+       void flush()                                          // drop unplayed frames (seek)
    - PortAudio callback pulls frames from ring buffer and writes them to device.
+   - init() negotiates the device sample format: the preferred one
+     (setPreferredFormat(), default float32) if the device takes it, else
+     the best of float32, int32, int24, int16.
+   - The stream is opened with the device's own channel count (or
+     setOutputChannels()), not the source's; write() takes frames of
+     channels() samples, so producers mix to it first (ChannelMixer).
 
  Why:
    - Real audio playback requires a callback-driven API to minimize latency.
@@ -20,7 +28,15 @@
 
  Notes:
    - We store audio as interleaved float32 samples (common practice for mixing).
+     setRingFormat() selects a compact ring instead: int16 or packed int24
+     (half or three quarters of the memory; 2 s of 8 channels at 192 kHz is
+     16 MiB as float, 8 MiB as int16). write() quantizes with TPDF dither, the callback
+     expands back to float (SIMD) before the device conversion. Samples are
+     clamped to [-1, 1] on the way in.
    - Producer expected to convert int16_t -> float in producer thread before write().
+   - Audio stays float up to the callback, which converts to the device
+     format once (volume, clamp, dither; sample_format.h). PortAudio's own
+     clipping and dithering are turned off.
 */
 
 #include <vector>
@@ -28,6 +44,10 @@
 #include <cstdint>
 #include <cstddef>   // for size_t
 
+#include "sample_format.h"
+#include "channel_mixer.h"
+#include "planar.h"
+
 // Forward declare PortAudio types to avoid including portaudio.h in header.
 // We will include portaudio.h in the .cpp implementation file.
 struct PaStreamParameters;
@@ -40,10 +60,35 @@ public:
 
     // Initialize audio output
     // sampleRate: e.g., 44100
-    // channels: 1 (mono) or 2 (stereo)
+    // channels: the source's channel count; the stream uses the device's own
+    //   count (channels()), this one only when the device has no fixed layout
+    //   (more than ChannelMixer::kMaxChannels) or there is no device
     // framesPerBuffer: portaudio buffer size (0 = default / system-chosen)
     bool init(int sampleRate, int channels, unsigned long framesPerBuffer = 0);
 
+    // Channel count for the next init() instead of the device's (0 = device),
+    // capped to what the device has.
+    void setOutputChannels(int channels) { outputChannels_ = channels; }
+
+    // Channels per frame of the open stream and of write() (after init()).
+    int channels() const { return channels_; }
+
+    // Device sample format to ask for first on the next init().
+    void setPreferredFormat(DeviceFormat format) { preferredFormat_ = format; }
+
+    // Sample format the stream was opened with (after init()).
+    DeviceFormat deviceFormat() const { return format_; }
+
+    // Ring buffer storage for the next init(): Float32 (default), Int16 or
+    // Int24. Int32 saves nothing over float and is stored as Float32.
+    void setRingFormat(DeviceFormat format) {
+        ringFormat_ = format == DeviceFormat::Int32 ? DeviceFormat::Float32 : format;
+    }
+    DeviceFormat ringFormat() const { return ringFormat_; }
+
+    // Memory held by the ring buffer (after init()).
+    size_t ringBytes() const { return buffer_.size(); }
+
     // Start audio stream (returns true on success)
     bool start();
 
@@ -59,21 +104,55 @@ public:
     // Returns number of frames actually written (may be less if buffer is full).
     size_t write(const float* frames, size_t frameCount);
 
+    // Producer API: the same from a planar block (planar.h) of channels()
+    // planes, interleaved on the way into the ring; the DSP stage's output
+    // goes this way. Returns 0 for a block with another channel count.
+    size_t writePlanar(const AudioBlock& block, size_t frameCount);
+
     // Query how many frames currently available to write (free capacity)
     size_t available() const;
 
     // Query how many frames currently available to read (used)
     size_t size() const;
 
+    // Producer API: discard the frames written so far that have not been
+    // played (used after a seek). A running callback applies this at its next
+    // period; frames written after flush() are kept.
+    void flush();
+
 private:
-    // Internal: power-of-two ring buffer for interleaved float samples.
-    // The ring buffer size is in *frames* (not samples). Internally we store
-    // frames * channels floats.
-    std::vector<float> buffer_;        // contiguous storage
+    // Ring buffer for channels_ at sampleRate_ (init()).
+    void allocateRing();
+
+    // Channel count to open for a device with `deviceChannels` outputs.
+    int chooseChannels(int deviceChannels, int sourceChannels) const;
+
+    // Callback body: fill `frameCount` device frames at `out` from the ring.
+    void render(void* out, unsigned long frameCount);
+
+    // First format from the preference order that the device accepts.
+    DeviceFormat negotiateFormat(PaStreamParameters& params);
+
+private:
+    // Internal: power-of-two ring buffer for interleaved samples in
+    // ringFormat_. The ring buffer size is in *frames* (not samples).
+    // Internally we store frames * channels samples of ringBytes_ bytes.
+    std::vector<uint8_t> buffer_;      // contiguous storage
+    DeviceFormat ringFormat_;          // sample format of buffer_
+    size_t ringBytes_;                 // bytes per ring sample
+    SampleKernels ringKernels_;        // ring <-> float, selected in init()
+    std::vector<float> scratch_;       // callback: expanded ring samples
+    DitherState writeDither_;          // producer: ring quantization
+    PlanarKernels planarKernels_;      // producer: writePlanar() interleave
+    std::vector<float> writeScratch_;  // producer: interleaved chunk (int rings)
     size_t capacityFrames_;            // capacity in frames (power of two)
-    int channels_;                     // channels (1 or 2)
+    int channels_;                     // channels per frame (device)
+    int outputChannels_;               // setOutputChannels() (0 = device)
     std::atomic<size_t> head_;         // write index in frames
     std::atomic<size_t> tail_;         // read index in frames
+    std::atomic<size_t> flushTo_;      // pending flush: new tail index (kNoFlush = none)
+    static constexpr size_t kNoFlush = SIZE_MAX;
+    static constexpr size_t kScratchFrames = 1024;   // expansion chunk (callback)
 
     // PortAudio stream handle (implementation includes portaudio.h)
     void* stream_;
@@ -82,6 +161,11 @@ private:
     bool dummyMode_;
     std::atomic<float> volume_;
 
+    DeviceFormat preferredFormat_;     // asked for first by init()
+    DeviceFormat format_;              // negotiated device format
+    SampleKernels deviceKernels_;      // float -> device, selected in init()
+    DitherState dither_;               // callback-only
+
     // Internal helper to ensure capacity is power-of-two
     static size_t nextPowerOfTwo(size_t v);
 };
@@ -0,0 +1,582 @@
+/*
+ channel_mixer.cpp
+
+ Standard mixing matrices and the per-channel-pair kernels. See
+ channel_mixer.h.
+
+ Kernel layout (SSE2, 4 frames per step; AVX2 is the same with 8 frames,
+ frames 0-3 in the low lane and 4-7 in the high lane):
+   - in: 1 channel is loaded as is; 2 channels are split with one shuffle;
+     3..8 channels are read as rows of 4 channels per frame and transposed,
+     the last row of 5..8 channels starting at channel n - 4 (overlapping
+     the previous one) so no load crosses into the next frame.
+   - each output channel is a sum of matrix coefficient * input channel
+     vectors, in input channel order (the scalar variant sums in the same
+     order).
+   - out: the mirror image of the input side.
+   - With 3 channels a 4-wide row reaches one sample into the next frame,
+     so those kernels stop a frame early and leave the rest to the scalar
+     loop. The stores go in frame order, so the extra lane written is always
+     overwritten by the next frame.
+*/
+
+#include "channel_mixer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define CM_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+#include <immintrin.h>
+#define CM_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace {
+
+constexpr int kMax = ChannelMixer::kMaxChannels;
+constexpr float kMinus3dB = 0.70710678f;
+
+// -----------------------------
+// Scalar (reference, tails, other targets)
+// -----------------------------
+template <int I, int O>
+void mixScalar(const float* in, float* out, size_t frames, const float* m) {
+    for (size_t f = 0; f < frames; ++f) {
+        const float* x = in + f * I;
+        float* y = out + f * O;
+        for (int o = 0; o < O; ++o) {
+            float acc = m[o * I] * x[0];
+            for (int i = 1; i < I; ++i) acc += m[o * I + i] * x[i];
+            y[o] = acc;
+        }
+    }
+}
+
+// Row offset of the 4-channel group starting at `base` in an n-channel frame.
+constexpr int groupOffset(int base, int n) {
+    return (base + 4 <= n || n < 4) ? base : n - 4;
+}
+
+#if defined(CM_USE_SSE2)
+// -----------------------------
+// SSE2 (4 frames per step)
+// -----------------------------
+inline void transpose4(__m128& a, __m128& b, __m128& c, __m128& d) {
+    __m128 t0 = _mm_unpacklo_ps(a, b);
+    __m128 t1 = _mm_unpacklo_ps(c, d);
+    __m128 t2 = _mm_unpackhi_ps(a, b);
+    __m128 t3 = _mm_unpackhi_ps(c, d);
+    a = _mm_movelh_ps(t0, t1);
+    b = _mm_movehl_ps(t1, t0);
+    c = _mm_movelh_ps(t2, t3);
+    d = _mm_movehl_ps(t3, t2);
+}
+
+template <int C>
+inline void loadFrames4(const float* p, __m128* x) {
+    if (C == 1) {
+        x[0] = _mm_loadu_ps(p);
+    } else if (C == 2) {
+        __m128 a = _mm_loadu_ps(p);
+        __m128 b = _mm_loadu_ps(p + 4);
+        x[0] = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        x[1] = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    } else {
+        for (int base = 0; base < C; base += 4) {
+            const int off = groupOffset(base, C);
+            __m128 r0 = _mm_loadu_ps(p + off);
+            __m128 r1 = _mm_loadu_ps(p + C + off);
+            __m128 r2 = _mm_loadu_ps(p + 2 * C + off);
+            __m128 r3 = _mm_loadu_ps(p + 3 * C + off);
+            transpose4(r0, r1, r2, r3);
+            x[off] = r0;
+            x[off + 1] = r1;
+            x[off + 2] = r2;
+            x[off + 3] = r3;
+        }
+    }
+}
+
+template <int C>
+inline void storeFrames4(float* p, __m128* y) {
+    if (C == 1) {
+        _mm_storeu_ps(p, y[0]);
+    } else if (C == 2) {
+        _mm_storeu_ps(p, _mm_unpacklo_ps(y[0], y[1]));
+        _mm_storeu_ps(p + 4, _mm_unpackhi_ps(y[0], y[1]));
+    } else {
+        for (int base = 0; base < C; base += 4) {
+            const int off = groupOffset(base, C);
+            __m128 r0 = y[off], r1 = y[off + 1], r2 = y[off + 2], r3 = y[off + 3];
+            transpose4(r0, r1, r2, r3);
+            _mm_storeu_ps(p + off, r0);
+            _mm_storeu_ps(p + C + off, r1);
+            _mm_storeu_ps(p + 2 * C + off, r2);
+            _mm_storeu_ps(p + 3 * C + off, r3);
+        }
+    }
+}
+
+template <int I, int O>
+void mixSse2(const float* in, float* out, size_t frames, const float* m) {
+    constexpr size_t slack = (I == 3 || O == 3) ? 1 : 0;
+    __m128 coef[O][I];
+    for (int o = 0; o < O; ++o)
+        for (int i = 0; i < I; ++i) coef[o][i] = _mm_set1_ps(m[o * I + i]);
+    __m128 x[I < 4 ? 4 : I];
+    __m128 y[O < 4 ? 4 : O];
+    for (__m128& v : y) v = _mm_setzero_ps();
+
+    size_t f = 0;
+    for (; f + 4 + slack <= frames; f += 4) {
+        loadFrames4<I>(in + f * I, x);
+        for (int o = 0; o < O; ++o) {
+            __m128 acc = _mm_mul_ps(coef[o][0], x[0]);
+            for (int i = 1; i < I; ++i) acc = _mm_add_ps(acc, _mm_mul_ps(coef[o][i], x[i]));
+            y[o] = acc;
+        }
+        storeFrames4<O>(out + f * O, y);
+    }
+    mixScalar<I, O>(in + f * I, out + f * O, frames - f, m);
+}
+#endif // CM_USE_SSE2
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+// -----------------------------
+// AVX2 (8 frames per step: frames 0-3 low lane, 4-7 high lane)
+// -----------------------------
+CM_TARGET_AVX2 inline void transpose4x2(__m256& a, __m256& b, __m256& c, __m256& d) {
+    __m256 t0 = _mm256_unpacklo_ps(a, b);
+    __m256 t1 = _mm256_unpacklo_ps(c, d);
+    __m256 t2 = _mm256_unpackhi_ps(a, b);
+    __m256 t3 = _mm256_unpackhi_ps(c, d);
+    a = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+    b = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+    c = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    d = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+// Row of frame k in the low lane, frame k + 4 in the high lane.
+CM_TARGET_AVX2 inline __m256 loadRowPair(const float* p, size_t stride) {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + 4 * stride), 1);
+}
+
+template <int C>
+CM_TARGET_AVX2 inline void loadFrames8(const float* p, __m256* x) {
+    if (C == 1) {
+        x[0] = _mm256_loadu_ps(p);
+    } else if (C == 2) {
+        __m256 a = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + 8), 1);
+        __m256 b = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 4)), _mm_loadu_ps(p + 12), 1);
+        x[0] = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        x[1] = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    } else {
+        for (int base = 0; base < C; base += 4) {
+            const int off = groupOffset(base, C);
+            __m256 r0 = loadRowPair(p + off, C);
+            __m256 r1 = loadRowPair(p + C + off, C);
+            __m256 r2 = loadRowPair(p + 2 * C + off, C);
+            __m256 r3 = loadRowPair(p + 3 * C + off, C);
+            transpose4x2(r0, r1, r2, r3);
+            x[off] = r0;
+            x[off + 1] = r1;
+            x[off + 2] = r2;
+            x[off + 3] = r3;
+        }
+    }
+}
+
+template <int C>
+CM_TARGET_AVX2 inline void storeFrames8(float* p, __m256* y) {
+    if (C == 1) {
+        _mm256_storeu_ps(p, y[0]);
+    } else if (C == 2) {
+        __m256 lo = _mm256_unpacklo_ps(y[0], y[1]);   // frames 0,1 | 4,5
+        __m256 hi = _mm256_unpackhi_ps(y[0], y[1]);   // frames 2,3 | 6,7
+        _mm256_storeu_ps(p, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(p + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    } else {
+        for (int base = 0; base < C; base += 4) {
+            const int off = groupOffset(base, C);
+            __m256 r[4] = { y[off], y[off + 1], y[off + 2], y[off + 3] };
+            transpose4x2(r[0], r[1], r[2], r[3]);
+            // Frames 0-3, then 4-7 (frame order, see the 3-channel note).
+            for (int k = 0; k < 4; ++k) _mm_storeu_ps(p + k * C + off, _mm256_castps256_ps128(r[k]));
+            for (int k = 0; k < 4; ++k) _mm_storeu_ps(p + (k + 4) * C + off, _mm256_extractf128_ps(r[k], 1));
+        }
+    }
+}
+
+template <int I, int O>
+CM_TARGET_AVX2 void mixAvx2(const float* in, float* out, size_t frames, const float* m) {
+    constexpr size_t slack = (I == 3 || O == 3) ? 1 : 0;
+    __m256 coef[O][I];
+    for (int o = 0; o < O; ++o)
+        for (int i = 0; i < I; ++i) coef[o][i] = _mm256_set1_ps(m[o * I + i]);
+    __m256 x[I < 4 ? 4 : I];
+    __m256 y[O < 4 ? 4 : O];
+    for (__m256& v : y) v = _mm256_setzero_ps();
+
+    size_t f = 0;
+    for (; f + 8 + slack <= frames; f += 8) {
+        loadFrames8<I>(in + f * I, x);
+        for (int o = 0; o < O; ++o) {
+            __m256 acc = _mm256_mul_ps(coef[o][0], x[0]);
+            for (int i = 1; i < I; ++i) acc = _mm256_fmadd_ps(coef[o][i], x[i], acc);
+            y[o] = acc;
+        }
+        storeFrames8<O>(out + f * O, y);
+    }
+#if defined(CM_USE_SSE2)
+    mixSse2<I, O>(in + f * I, out + f * O, frames - f, m);
+#else
+    mixScalar<I, O>(in + f * I, out + f * O, frames - f, m);
+#endif
+}
+#endif // MUSIC_PLAYER_X86_DISPATCH
+
+// -----------------------------
+// Planar kernels: any channel pair, frames in the vector lanes (no
+// transposes), every input plane loaded once per group of frames
+// -----------------------------
+void mixPlanarScalarRange(const AudioBlock& in, const AudioBlock& out, size_t from, size_t frames, const float* m) {
+    const int ic = in.channels;
+    for (int o = 0; o < out.channels; ++o) {
+        const float* row = m + o * ic;
+        float* y = out.channel[o];
+        for (size_t f = from; f < frames; ++f) {
+            float acc = row[0] * in.channel[0][f];
+            for (int i = 1; i < ic; ++i) acc += row[i] * in.channel[i][f];
+            y[f] = acc;
+        }
+    }
+}
+
+void mixPlanarScalar(const AudioBlock& in, const AudioBlock& out, size_t frames, const float* m) {
+    mixPlanarScalarRange(in, out, 0, frames, m);
+}
+
+#if defined(CM_USE_SSE2)
+void mixPlanarSse2(const AudioBlock& in, const AudioBlock& out, size_t frames, const float* m) {
+    const int ic = in.channels;
+    size_t f = 0;
+    for (; f + 4 <= frames; f += 4) {
+        __m128 x[kMax];
+        for (int i = 0; i < ic; ++i) x[i] = _mm_loadu_ps(in.channel[i] + f);
+        for (int o = 0; o < out.channels; ++o) {
+            const float* row = m + o * ic;
+            __m128 acc = _mm_mul_ps(_mm_set1_ps(row[0]), x[0]);
+            for (int i = 1; i < ic; ++i) acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(row[i]), x[i]));
+            _mm_storeu_ps(out.channel[o] + f, acc);
+        }
+    }
+    mixPlanarScalarRange(in, out, f, frames, m);
+}
+#endif
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+CM_TARGET_AVX2 void mixPlanarAvx2(const AudioBlock& in, const AudioBlock& out, size_t frames, const float* m) {
+    const int ic = in.channels;
+    size_t f = 0;
+    for (; f + 8 <= frames; f += 8) {
+        __m256 x[kMax];
+        for (int i = 0; i < ic; ++i) x[i] = _mm256_loadu_ps(in.channel[i] + f);
+        for (int o = 0; o < out.channels; ++o) {
+            const float* row = m + o * ic;
+            __m256 acc = _mm256_mul_ps(_mm256_set1_ps(row[0]), x[0]);
+            for (int i = 1; i < ic; ++i) acc = _mm256_fmadd_ps(_mm256_set1_ps(row[i]), x[i], acc);
+            _mm256_storeu_ps(out.channel[o] + f, acc);
+        }
+    }
+#if defined(CM_USE_SSE2)
+    if (f < frames) mixPlanarSse2(in.slice(f, frames - f), out.slice(f, frames - f), frames - f, m);
+#else
+    mixPlanarScalarRange(in, out, f, frames, m);
+#endif
+}
+#endif
+
+// -----------------------------
+// Kernel table: [level][in - 1][out - 1]
+// -----------------------------
+struct KernelTable {
+    MixKernelFn scalar[kMax][kMax] = {};
+    MixKernelFn sse2[kMax][kMax] = {};
+    MixKernelFn avx2[kMax][kMax] = {};
+};
+
+template <int I, int O>
+void addKernels(KernelTable& t) {
+    t.scalar[I - 1][O - 1] = &mixScalar<I, O>;
+#if defined(CM_USE_SSE2)
+    t.sse2[I - 1][O - 1] = &mixSse2<I, O>;
+#endif
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+    t.avx2[I - 1][O - 1] = &mixAvx2<I, O>;
+#endif
+    if constexpr (O < kMax) {
+        addKernels<I, O + 1>(t);
+    } else if constexpr (I < kMax) {
+        addKernels<I + 1, 1>(t);
+    }
+}
+
+const KernelTable& kernelTable() {
+    static const KernelTable table = [] {
+        KernelTable t;
+        addKernels<1, 1>(t);
+        return t;
+    }();
+    return table;
+}
+
+// -----------------------------
+// Standard matrix
+// -----------------------------
+struct Route {
+    Speaker speaker;
+    float gain;
+};
+
+// Where a source speaker goes when the output does not have it: the first
+// group whose speakers all exist is used.
+std::vector<std::vector<Route>> fallbacks(Speaker s) {
+    const float k = kMinus3dB;
+    switch (s) {
+    case Speaker::FL: return { { { Speaker::FC, k } } };
+    case Speaker::FR: return { { { Speaker::FC, k } } };
+    case Speaker::FC: return { { { Speaker::FL, k }, { Speaker::FR, k } } };
+    case Speaker::SL: return { { { Speaker::BL, k } }, { { Speaker::FL, k } }, { { Speaker::FC, k } } };
+    case Speaker::SR: return { { { Speaker::BR, k } }, { { Speaker::FR, k } }, { { Speaker::FC, k } } };
+    case Speaker::BL: return { { { Speaker::SL, k } }, { { Speaker::FL, k } }, { { Speaker::FC, k } } };
+    case Speaker::BR: return { { { Speaker::SR, k } }, { { Speaker::FR, k } }, { { Speaker::FC, k } } };
+    case Speaker::BC: return { { { Speaker::BL, k }, { Speaker::BR, k } },
+                               { { Speaker::SL, k }, { Speaker::SR, k } },
+                               { { Speaker::FL, 0.5f }, { Speaker::FR, 0.5f } },
+                               { { Speaker::FC, k } } };
+    default: return {};   // LFE: dropped
+    }
+}
+
+std::vector<float> standardMatrix(int inChannels, int outChannels) {
+    const std::vector<Speaker> src = speakerLayout(inChannels);
+    const std::vector<Speaker> dst = speakerLayout(outChannels);
+    auto indexOf = [&](Speaker s) {
+        for (int o = 0; o < outChannels; ++o) {
+            if (dst[o] == s) return o;
+        }
+        return -1;
+    };
+
+    std::vector<float> m(static_cast<size_t>(outChannels) * inChannels, 0.0f);
+    for (int i = 0; i < inChannels; ++i) {
+        const int same = indexOf(src[i]);
+        if (same >= 0) {
+            m[same * inChannels + i] = 1.0f;
+            continue;
+        }
+        // Mono is the same signal on both fronts, not a centre speaker.
+        std::vector<std::vector<Route>> options = fallbacks(src[i]);
+        if (inChannels == 1) options = { { { Speaker::FL, 1.0f }, { Speaker::FR, 1.0f } } };
+        for (const std::vector<Route>& group : options) {
+            bool complete = true;
+            for (const Route& r : group) complete = complete && indexOf(r.speaker) >= 0;
+            if (!complete) continue;
+            for (const Route& r : group) m[indexOf(r.speaker) * inChannels + i] += r.gain;
+            break;
+        }
+    }
+
+    // Scale down so that no output can exceed full scale.
+    float maxRow = 0.0f;
+    for (int o = 0; o < outChannels; ++o) {
+        float sum = 0.0f;
+        for (int i = 0; i < inChannels; ++i) sum += std::fabs(m[o * inChannels + i]);
+        if (sum > maxRow) maxRow = sum;
+    }
+    if (maxRow > 1.0f) {
+        for (float& c : m) c /= maxRow;
+    }
+    return m;
+}
+
+} // namespace
+
+// -----------------------------
+// Layouts
+// -----------------------------
+std::vector<Speaker> speakerLayout(int channels) {
+    using S = Speaker;
+    switch (channels) {
+    case 1: return { S::FC };
+    case 2: return { S::FL, S::FR };
+    case 3: return { S::FL, S::FR, S::FC };
+    case 4: return { S::FL, S::FR, S::BL, S::BR };
+    case 5: return { S::FL, S::FR, S::FC, S::BL, S::BR };
+    case 6: return { S::FL, S::FR, S::FC, S::LFE, S::BL, S::BR };
+    case 7: return { S::FL, S::FR, S::FC, S::LFE, S::BC, S::SL, S::SR };
+    case 8: return { S::FL, S::FR, S::FC, S::LFE, S::BL, S::BR, S::SL, S::SR };
+    default: return {};
+    }
+}
+
+const char* speakerName(Speaker speaker) {
+    switch (speaker) {
+    case Speaker::FL: return "FL";
+    case Speaker::FR: return "FR";
+    case Speaker::FC: return "FC";
+    case Speaker::LFE: return "LFE";
+    case Speaker::BL: return "BL";
+    case Speaker::BR: return "BR";
+    case Speaker::SL: return "SL";
+    case Speaker::SR: return "SR";
+    default: return "BC";
+    }
+}
+
+bool parseMixMatrix(const std::string& text, int& inChannels, int& outChannels, std::vector<float>& matrix) {
+    std::vector<float> values;
+    int rows = 0;
+    int columns = -1;
+    size_t pos = 0;
+    while (pos <= text.size()) {
+        size_t end = text.find(';', pos);
+        if (end == std::string::npos) end = text.size();
+        const std::string row = text.substr(pos, end - pos);
+        int count = 0;
+        const char* p = row.c_str();
+        while (*p) {
+            char* next = nullptr;
+            float v = std::strtof(p, &next);
+            if (next == p) return false;
+            values.push_back(v);
+            ++count;
+            p = next;
+            while (*p == ' ') ++p;
+            if (*p == ',') ++p;
+            else if (*p) return false;
+        }
+        if (count == 0 || (columns >= 0 && count != columns)) return false;
+        columns = count;
+        ++rows;
+        pos = end + 1;
+    }
+    if (rows < 1 || rows > ChannelMixer::kMaxChannels || columns > ChannelMixer::kMaxChannels) return false;
+    inChannels = columns;
+    outChannels = rows;
+    matrix = std::move(values);
+    return true;
+}
+
+// -----------------------------
+// ChannelMixer
+// -----------------------------
+ChannelMixer::ChannelMixer()
+    : inChannels_(0),
+      outChannels_(0),
+      identity_(true),
+      kernel_(nullptr),
+      variant_("scalar"),
+      planarKernel_(nullptr),
+      planarVariant_("scalar")
+{
+    configure(2, 2);
+}
+
+PlanarMixKernelFn ChannelMixer::selectPlanarKernel(SimdLevel level, const char** variant) {
+    if (level > detectedSimdLevel()) level = detectedSimdLevel();
+    const char* name = "scalar";
+    PlanarMixKernelFn fn = &mixPlanarScalar;
+#if defined(CM_USE_SSE2)
+    if (level >= SimdLevel::SSE2) {
+        fn = &mixPlanarSse2;
+        name = "sse2";
+    }
+#endif
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+    if (level >= SimdLevel::AVX2) {
+        fn = &mixPlanarAvx2;
+        name = "avx2";
+    }
+#endif
+    if (variant) *variant = name;
+    return fn;
+}
+
+MixKernelFn ChannelMixer::selectKernel(int inChannels, int outChannels, SimdLevel level, const char** variant) {
+    if (inChannels < 1 || inChannels > kMax || outChannels < 1 || outChannels > kMax) return nullptr;
+    if (level > detectedSimdLevel()) level = detectedSimdLevel();
+    const KernelTable& t = kernelTable();
+    const int i = inChannels - 1;
+    const int o = outChannels - 1;
+    const char* name = "scalar";
+    MixKernelFn fn = t.scalar[i][o];
+    if (level >= SimdLevel::AVX2 && t.avx2[i][o]) {
+        fn = t.avx2[i][o];
+        name = "avx2";
+    } else if (level >= SimdLevel::SSE2 && t.sse2[i][o]) {
+        fn = t.sse2[i][o];
+        name = "sse2";
+    }
+    if (variant) *variant = name;
+    return fn;
+}
+
+bool ChannelMixer::configure(int inChannels, int outChannels) {
+    if (inChannels < 1 || inChannels > kMax || outChannels < 1 || outChannels > kMax) return false;
+    return setMatrix(inChannels, outChannels, standardMatrix(inChannels, outChannels));
+}
+
+bool ChannelMixer::configure(int inChannels, int outChannels, const std::vector<float>& matrix) {
+    if (matrix.size() != static_cast<size_t>(inChannels) * static_cast<size_t>(outChannels)) return false;
+    return setMatrix(inChannels, outChannels, matrix);
+}
+
+bool ChannelMixer::setMatrix(int inChannels, int outChannels, std::vector<float> matrix) {
+    const char* variant = nullptr;
+    MixKernelFn kernel = selectKernel(inChannels, outChannels, simdLevel(), &variant);
+    if (!kernel) return false;
+    planarKernel_ = selectPlanarKernel(simdLevel(), &planarVariant_);
+    inChannels_ = inChannels;
+    outChannels_ = outChannels;
+    matrix_ = std::move(matrix);
+    kernel_ = kernel;
+    variant_ = variant;
+    identity_ = inChannels == outChannels;
+    for (int o = 0; o < outChannels && identity_; ++o) {
+        for (int i = 0; i < inChannels; ++i) {
+            if (matrix_[o * inChannels + i] != (i == o ? 1.0f : 0.0f)) {
+                identity_ = false;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+std::string ChannelMixer::describe() const {
+    const std::vector<Speaker> src = speakerLayout(inChannels_);
+    const std::vector<Speaker> dst = speakerLayout(outChannels_);
+    std::string text;
+    for (int o = 0; o < outChannels_; ++o) {
+        if (o) text += "; ";
+        text += speakerName(dst[o]);
+        text += " =";
+        bool any = false;
+        for (int i = 0; i < inChannels_; ++i) {
+            const float c = matrix_[o * inChannels_ + i];
+            if (c == 0.0f) continue;
+            char term[32];
+            std::snprintf(term, sizeof(term), "%s %.3g*%s", any ? " +" : "", c, speakerName(src[i]));
+            text += term;
+            any = true;
+        }
+        if (!any) text += " 0";
+    }
+    return text;
+}
@@ -0,0 +1,115 @@
+#pragma once
+/*
+ channel_mixer.h
+
+ Purpose:
+   - Map interleaved float audio from the source's channel count to the
+     output device's (5.1/7.1 -> stereo, mono -> stereo, stereo -> 5.1, or a
+     custom matrix) in the producer thread, before AudioOutput::write().
+   - Every (in, out) pair of 1..8 channels has its own kernel with the
+     channel counts as template parameters: the frames are transposed to
+     per-channel vectors (4 frames per SSE2 register, 8 per AVX2 register),
+     multiplied by the matrix and transposed back. configure() picks the
+     kernel once per stream, following simdLevel() (cpu_features.h).
+   - Planar blocks (planar.h, the DSP stage's layout) need no transposes:
+     one kernel per variant handles every pair, with frames in the vector
+     lanes.
+
+ Notes:
+   - Streams carry no channel mask here, so an n-channel stream is taken to
+     be in the default WAVE/FLAC/FFmpeg order for n (see speakerLayout()).
+   - The standard matrix routes each source speaker to the same output
+     speaker if there is one, otherwise folds it in at -3 dB (centre to
+     left/right, sides to backs or fronts, ...). LFE is dropped unless the
+     output has one. Mono is copied to both fronts. If a row would sum past
+     1 (a downmix), the whole matrix is scaled down so no output can clip.
+   - process() requires `in` and `out` not to overlap.
+*/
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "planar.h"
+#include "../utils/cpu_features.h"
+
+enum class Speaker {
+    FL, FR, FC, LFE, BL, BR, SL, SR, BC
+};
+
+// Mix `frames` interleaved frames: out[f][o] = sum_i matrix[o][i] * in[f][i].
+using MixKernelFn = void (*)(const float* in, float* out, size_t frames, const float* matrix);
+
+// Mix `frames` frames of planar blocks: out.channel[o][f] =
+// sum_i matrix[o][i] * in.channel[i][f], channel counts from the blocks.
+using PlanarMixKernelFn = void (*)(const AudioBlock& in, const AudioBlock& out, size_t frames, const float* matrix);
+
+class ChannelMixer {
+public:
+    static constexpr int kMaxChannels = 8;
+
+    ChannelMixer();
+
+    // Standard matrix between the default layouts for the two counts.
+    bool configure(int inChannels, int outChannels);
+
+    // Custom matrix, row-major outChannels x inChannels, used as given.
+    bool configure(int inChannels, int outChannels, const std::vector<float>& matrix);
+
+    int inChannels() const { return inChannels_; }
+    int outChannels() const { return outChannels_; }
+    const std::vector<float>& matrix() const { return matrix_; }
+
+    // Same channel count and an identity matrix: callers can skip process().
+    bool isIdentity() const { return identity_; }
+
+    // Kernel variant in use ("scalar", "sse2", "avx2").
+    const char* variant() const { return variant_; }
+
+    // Mix `frames` frames of inChannels() samples at `in` into
+    // outChannels() samples per frame at `out`.
+    void process(const float* in, float* out, size_t frames) const {
+        kernel_(in, out, frames, matrix_.data());
+    }
+
+    // Planar variant: `in` has inChannels() planes, `out` outChannels().
+    void process(const AudioBlock& in, const AudioBlock& out, size_t frames) const {
+        planarKernel_(in, out, frames, matrix_.data());
+    }
+    const char* planarVariant() const { return planarVariant_; }
+
+    // Matrix as text, one "out <- in*coef" list per output speaker (logging).
+    std::string describe() const;
+
+    // Kernel for one channel pair, widest variant at or below `level`
+    // (capped to the host); nullptr for counts outside 1..kMaxChannels.
+    static MixKernelFn selectKernel(int inChannels, int outChannels, SimdLevel level,
+                                    const char** variant = nullptr);
+
+    // Planar kernel, widest variant at or below `level` (capped to the host).
+    static PlanarMixKernelFn selectPlanarKernel(SimdLevel level, const char** variant = nullptr);
+
+private:
+    bool setMatrix(int inChannels, int outChannels, std::vector<float> matrix);
+
+    int inChannels_;
+    int outChannels_;
+    std::vector<float> matrix_;   // outChannels_ x inChannels_, row-major
+    bool identity_;
+    MixKernelFn kernel_;
+    const char* variant_;
+    PlanarMixKernelFn planarKernel_;
+    const char* planarVariant_;
+};
+
+// Speaker order assumed for an n-channel stream (1..8):
+//   1 FC | 2 FL FR | 3 FL FR FC | 4 FL FR BL BR | 5 FL FR FC BL BR
+//   6 FL FR FC LFE BL BR | 7 FL FR FC LFE BC SL SR | 8 FL FR FC LFE BL BR SL SR
+std::vector<Speaker> speakerLayout(int channels);
+
+// "FL", "FR", "FC", "LFE", "BL", "BR", "SL", "SR", "BC".
+const char* speakerName(Speaker speaker);
+
+// Parse "a,b,c;d,e,f" (rows separated by ';') into a row-major matrix;
+// false on a syntax error or ragged rows.
+bool parseMixMatrix(const std::string& text, int& inChannels, int& outChannels, std::vector<float>& matrix);
@@ -0,0 +1,283 @@
+/*
+ planar.cpp
+
+ AudioBlockPool and the interleave / deinterleave kernels. See planar.h.
+
+ Register layouts (f = frame, c = channel):
+   - stereo, SSE2: two loads hold f0..f3 as L R pairs; shuffles pick the
+     even and odd lanes. AVX2 does the same on 8 frames, with the 128-bit
+     halves put back in frame order by a 64-bit permute.
+   - 4 channels: four frames are a 4x4 matrix of one register per frame,
+     transposed with _MM_TRANSPOSE4_PS.
+   - 8 channels: SSE2 transposes the two 4x4 halves of four frames. An AVX2
+     8x8 transpose (unpack, shuffle, 128-bit permute) measured slower than
+     that, so AVX2 hosts use the SSE2 variant too.
+*/
+
+#include "planar.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define PL_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+#include <immintrin.h>
+#define PL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+void AudioBlock::clear() const {
+    for (int c = 0; c < channels; ++c) std::memset(channel[c], 0, frames * sizeof(float));
+}
+
+// -----------------------------
+// AudioBlockPool
+// -----------------------------
+
+AudioBlockPool::AudioBlockPool()
+    : base_(nullptr),
+      stride_(0),
+      channels_(0),
+      frames_(0) {}
+
+void AudioBlockPool::init(int channels, size_t frames, int count) {
+    channels_ = std::max(0, std::min(channels, AudioBlock::kMaxChannels));
+    frames_ = frames;
+    stride_ = (frames + 15) & ~static_cast<size_t>(15);
+    const size_t blockFloats = stride_ * static_cast<size_t>(channels_);
+    storage_.assign(blockFloats * static_cast<size_t>(std::max(count, 0)) + 16, 0.0f);
+    const uintptr_t address = reinterpret_cast<uintptr_t>(storage_.data());
+    base_ = storage_.data() + ((64 - (address & 63)) & 63) / sizeof(float);
+    free_.clear();
+    free_.reserve(static_cast<size_t>(std::max(count, 0)));
+    for (int b = count - 1; b >= 0; --b) free_.push_back(base_ + static_cast<size_t>(b) * blockFloats);
+}
+
+AudioBlock AudioBlockPool::acquire() {
+    AudioBlock block;
+    if (free_.empty() || channels_ == 0) return block;
+    float* first = free_.back();
+    free_.pop_back();
+    for (int c = 0; c < channels_; ++c) block.channel[c] = first + static_cast<size_t>(c) * stride_;
+    block.channels = channels_;
+    block.frames = frames_;
+    return block;
+}
+
+void AudioBlockPool::release(const AudioBlock& block) {
+    if (block.channels > 0) free_.push_back(block.channel[0]);
+}
+
+// -----------------------------
+// Kernels
+// -----------------------------
+
+namespace {
+
+template <int C>
+void deinterleaveScalar(const float* in, const AudioBlock& out, size_t frames) {
+    if (C == 1) {
+        std::memcpy(out.channel[0], in, frames * sizeof(float));
+        return;
+    }
+    for (size_t f = 0; f < frames; ++f) {
+        for (int c = 0; c < C; ++c) out.channel[c][f] = in[f * C + c];
+    }
+}
+
+template <int C>
+void interleaveScalar(const AudioBlock& in, float* out, size_t frames) {
+    if (C == 1) {
+        std::memcpy(out, in.channel[0], frames * sizeof(float));
+        return;
+    }
+    for (size_t f = 0; f < frames; ++f) {
+        for (int c = 0; c < C; ++c) out[f * C + c] = in.channel[c][f];
+    }
+}
+
+// Finish frames [from, frames) with the scalar loop
+template <int C>
+inline void deinterleaveTail(const float* in, const AudioBlock& out, size_t from, size_t frames) {
+    for (size_t f = from; f < frames; ++f) {
+        for (int c = 0; c < C; ++c) out.channel[c][f] = in[f * C + c];
+    }
+}
+
+template <int C>
+inline void interleaveTail(const AudioBlock& in, float* out, size_t from, size_t frames) {
+    for (size_t f = from; f < frames; ++f) {
+        for (int c = 0; c < C; ++c) out[f * C + c] = in.channel[c][f];
+    }
+}
+
+#ifdef PL_USE_SSE2
+void deinterleave2Sse2(const float* in, const AudioBlock& out, size_t frames) {
+    float* l = out.channel[0];
+    float* r = out.channel[1];
+    size_t f = 0;
+    for (; f + 4 <= frames; f += 4) {
+        const __m128 a = _mm_loadu_ps(in + f * 2);
+        const __m128 b = _mm_loadu_ps(in + f * 2 + 4);
+        _mm_storeu_ps(l + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(r + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    deinterleaveTail<2>(in, out, f, frames);
+}
+
+void interleave2Sse2(const AudioBlock& in, float* out, size_t frames) {
+    const float* l = in.channel[0];
+    const float* r = in.channel[1];
+    size_t f = 0;
+    for (; f + 4 <= frames; f += 4) {
+        const __m128 a = _mm_loadu_ps(l + f);
+        const __m128 b = _mm_loadu_ps(r + f);
+        _mm_storeu_ps(out + f * 2, _mm_unpacklo_ps(a, b));
+        _mm_storeu_ps(out + f * 2 + 4, _mm_unpackhi_ps(a, b));
+    }
+    interleaveTail<2>(in, out, f, frames);
+}
+
+void deinterleave4Sse2(const float* in, const AudioBlock& out, size_t frames) {
+    size_t f = 0;
+    for (; f + 4 <= frames; f += 4) {
+        __m128 r0 = _mm_loadu_ps(in + f * 4);
+        __m128 r1 = _mm_loadu_ps(in + f * 4 + 4);
+        __m128 r2 = _mm_loadu_ps(in + f * 4 + 8);
+        __m128 r3 = _mm_loadu_ps(in + f * 4 + 12);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(out.channel[0] + f, r0);
+        _mm_storeu_ps(out.channel[1] + f, r1);
+        _mm_storeu_ps(out.channel[2] + f, r2);
+        _mm_storeu_ps(out.channel[3] + f, r3);
+    }
+    deinterleaveTail<4>(in, out, f, frames);
+}
+
+void interleave4Sse2(const AudioBlock& in, float* out, size_t frames) {
+    size_t f = 0;
+    for (; f + 4 <= frames; f += 4) {
+        __m128 r0 = _mm_loadu_ps(in.channel[0] + f);
+        __m128 r1 = _mm_loadu_ps(in.channel[1] + f);
+        __m128 r2 = _mm_loadu_ps(in.channel[2] + f);
+        __m128 r3 = _mm_loadu_ps(in.channel[3] + f);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(out + f * 4, r0);
+        _mm_storeu_ps(out + f * 4 + 4, r1);
+        _mm_storeu_ps(out + f * 4 + 8, r2);
+        _mm_storeu_ps(out + f * 4 + 12, r3);
+    }
+    interleaveTail<4>(in, out, f, frames);
+}
+
+void deinterleave8Sse2(const float* in, const AudioBlock& out, size_t frames) {
+    size_t f = 0;
+    for (; f + 4 <= frames; f += 4) {
+        for (int half = 0; half < 2; ++half) {
+            __m128 r0 = _mm_loadu_ps(in + f * 8 + half * 4);
+            __m128 r1 = _mm_loadu_ps(in + f * 8 + 8 + half * 4);
+            __m128 r2 = _mm_loadu_ps(in + f * 8 + 16 + half * 4);
+            __m128 r3 = _mm_loadu_ps(in + f * 8 + 24 + half * 4);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(out.channel[half * 4] + f, r0);
+            _mm_storeu_ps(out.channel[half * 4 + 1] + f, r1);
+            _mm_storeu_ps(out.channel[half * 4 + 2] + f, r2);
+            _mm_storeu_ps(out.channel[half * 4 + 3] + f, r3);
+        }
+    }
+    deinterleaveTail<8>(in, out, f, frames);
+}
+
+void interleave8Sse2(const AudioBlock& in, float* out, size_t frames) {
+    size_t f = 0;
+    for (; f + 4 <= frames; f += 4) {
+        for (int half = 0; half < 2; ++half) {
+            __m128 r0 = _mm_loadu_ps(in.channel[half * 4] + f);
+            __m128 r1 = _mm_loadu_ps(in.channel[half * 4 + 1] + f);
+            __m128 r2 = _mm_loadu_ps(in.channel[half * 4 + 2] + f);
+            __m128 r3 = _mm_loadu_ps(in.channel[half * 4 + 3] + f);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(out + f * 8 + half * 4, r0);
+            _mm_storeu_ps(out + f * 8 + 8 + half * 4, r1);
+            _mm_storeu_ps(out + f * 8 + 16 + half * 4, r2);
+            _mm_storeu_ps(out + f * 8 + 24 + half * 4, r3);
+        }
+    }
+    interleaveTail<8>(in, out, f, frames);
+}
+#endif
+
+#ifdef MUSIC_PLAYER_X86_DISPATCH
+PL_TARGET_AVX2 void deinterleave2Avx2(const float* in, const AudioBlock& out, size_t frames) {
+    float* l = out.channel[0];
+    float* r = out.channel[1];
+    size_t f = 0;
+    for (; f + 8 <= frames; f += 8) {
+        const __m256 a = _mm256_loadu_ps(in + f * 2);
+        const __m256 b = _mm256_loadu_ps(in + f * 2 + 8);
+        // [L0 L1 L4 L5 | L2 L3 L6 L7] -> frame order
+        const __m256 even = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m256 odd = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm256_storeu_ps(l + f, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(even), _MM_SHUFFLE(3, 1, 2, 0))));
+        _mm256_storeu_ps(r + f, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(odd), _MM_SHUFFLE(3, 1, 2, 0))));
+    }
+    deinterleaveTail<2>(in, out, f, frames);
+}
+
+PL_TARGET_AVX2 void interleave2Avx2(const AudioBlock& in, float* out, size_t frames) {
+    const float* l = in.channel[0];
+    const float* r = in.channel[1];
+    size_t f = 0;
+    for (; f + 8 <= frames; f += 8) {
+        const __m256 a = _mm256_loadu_ps(l + f);
+        const __m256 b = _mm256_loadu_ps(r + f);
+        const __m256 lo = _mm256_unpacklo_ps(a, b);   // f0 f1 | f4 f5
+        const __m256 hi = _mm256_unpackhi_ps(a, b);   // f2 f3 | f6 f7
+        _mm256_storeu_ps(out + f * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(out + f * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    interleaveTail<2>(in, out, f, frames);
+}
+#endif
+
+template <int C>
+PlanarKernels scalarKernels() {
+    return { deinterleaveScalar<C>, interleaveScalar<C>, "scalar" };
+}
+
+} // namespace
+
+PlanarKernels selectPlanarKernels(int channels, SimdLevel level) {
+    if (level > detectedSimdLevel()) level = detectedSimdLevel();
+#ifdef MUSIC_PLAYER_X86_DISPATCH
+    if (level >= SimdLevel::AVX2) {
+        if (channels == 2) return { deinterleave2Avx2, interleave2Avx2, "avx2" };
+    }
+#endif
+#ifdef PL_USE_SSE2
+    if (level >= SimdLevel::SSE2) {
+        if (channels == 2) return { deinterleave2Sse2, interleave2Sse2, "sse2" };
+        if (channels == 4) return { deinterleave4Sse2, interleave4Sse2, "sse2" };
+        if (channels == 8) return { deinterleave8Sse2, interleave8Sse2, "sse2" };
+    }
+#endif
+    switch (channels) {
+    case 1: return scalarKernels<1>();
+    case 2: return scalarKernels<2>();
+    case 3: return scalarKernels<3>();
+    case 4: return scalarKernels<4>();
+    case 5: return scalarKernels<5>();
+    case 6: return scalarKernels<6>();
+    case 7: return scalarKernels<7>();
+    case 8: return scalarKernels<8>();
+    default: return { nullptr, nullptr, "scalar" };
+    }
+}
+
+PlanarKernels selectPlanarKernels(int channels) {
+    return selectPlanarKernels(channels, simdLevel());
+}
@@ -0,0 +1,93 @@
+#pragma once
+/*
+ planar.h
+
+ Purpose:
+   - The planar (one array per channel) float layout the DSP stage works in,
+     and the transposes between it and the interleaved layout of decoders
+     and the output ring.
+   - AudioBlock is a view: one sample pointer per channel plus a frame
+     count. AudioBlockPool owns the memory behind blocks: planes of a fixed
+     number of frames, 64-byte aligned, carved from one allocation made when
+     a stream is set up.
+   - Interleaving happens at the edges only: the decode thread deinterleaves
+     the decoder's block once, and AudioOutput::writePlanar() interleaves
+     straight into the ring.
+
+ How:
+   - The transposes are specialized per channel count: stereo has SSE2 and
+     AVX2 variants, 4 and 8 channels SSE2 (unpack / 4x4 register
+     transposes), the other counts a scalar loop the compiler unrolls.
+     selectPlanarKernels() resolves the pair once per stream through
+     simdLevel() (cpu_features.h). All variants only move samples, so their
+     output is identical.
+
+ Notes:
+   - Planes of a pool block are padded to a multiple of 16 floats, so every
+     plane starts on a 64-byte boundary.
+   - A pool is used by one thread (the decode thread); acquire() and
+     release() neither lock nor allocate.
+*/
+
+#include <cstddef>
+#include <vector>
+
+#include "../utils/cpu_features.h"
+
+struct AudioBlock {
+    static constexpr int kMaxChannels = 8;
+
+    float* channel[kMaxChannels] = {};
+    int channels = 0;
+    size_t frames = 0;
+
+    // The frames [offset, offset + count) of this block.
+    AudioBlock slice(size_t offset, size_t count) const {
+        AudioBlock part = *this;
+        for (int c = 0; c < channels; ++c) part.channel[c] = channel[c] + offset;
+        part.frames = count;
+        return part;
+    }
+
+    // Zero the block's samples.
+    void clear() const;
+};
+
+class AudioBlockPool {
+public:
+    AudioBlockPool();
+
+    // `count` blocks of `channels` planes of `frames` samples; all
+    // previously acquired blocks become invalid.
+    void init(int channels, size_t frames, int count);
+
+    // A free block (frames() frames, zeroed at init()), or a block with no
+    // channels if all are in use.
+    AudioBlock acquire();
+    void release(const AudioBlock& block);
+
+    int channels() const { return channels_; }
+    size_t frames() const { return frames_; }
+
+private:
+    std::vector<float> storage_;
+    std::vector<float*> free_;      // first plane of each free block
+    float* base_;                   // storage_ rounded up to 64 bytes
+    size_t stride_;                 // floats per plane (padded)
+    int channels_;
+    size_t frames_;
+};
+
+// Interleaved <-> planar for one channel count (the block's).
+using DeinterleaveFn = void (*)(const float* in, const AudioBlock& out, size_t frames);
+using InterleaveFn = void (*)(const AudioBlock& in, float* out, size_t frames);
+struct PlanarKernels {
+    DeinterleaveFn deinterleave;
+    InterleaveFn interleave;
+    const char* variant;   // "scalar", "sse2", "avx2"
+};
+
+// Widest variant at or below `level` (capped to the host) for `channels`
+// (1..AudioBlock::kMaxChannels); null kernels for other counts.
+PlanarKernels selectPlanarKernels(int channels, SimdLevel level);
+PlanarKernels selectPlanarKernels(int channels);
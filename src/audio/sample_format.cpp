@@ -0,0 +1,537 @@
+/*
+ sample_format.cpp
+
+ Float -> device format conversion for the PortAudio callback.
+
+ Each sample: x = clamp(src * gain, -1, 1) * fullScale (+ dither), rounded
+ to nearest and clamped to the integer range. The SSE2 path runs the four
+ dither lanes in one register; the scalar path (tails, other targets) steps
+ the same lanes, so both produce identical output.
+
+ The AVX2 and AVX-512 variants are compiled with target attributes into the
+ baseline build and only reached through selectSampleKernels() on hosts
+ that have them. They handle whole 8/16-sample groups and hand the rest to
+ the SSE2 variant. Without dither their output is bit-identical to the
+ scalar variant; with dither only the noise sequence differs.
+*/
+
+#include "sample_format.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SF_USE_SSE2 1
+#include <emmintrin.h>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#endif
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+#include <immintrin.h>
+#define SF_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define SF_TARGET_AVX512 __attribute__((target("avx2,fma,avx512f,avx512bw")))
+#endif
+
+namespace {
+
+constexpr float kDitherScale = 1.0f / 65536.0f;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool kLittleEndian = false;
+#else
+constexpr bool kLittleEndian = true;
+#endif
+
+inline uint32_t xorshift(uint32_t& s) {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+// Triangular noise in (-1, 1): difference of the two 16-bit halves.
+inline float tpdf(uint32_t r) {
+    return static_cast<float>(static_cast<int32_t>(r & 0xFFFF) - static_cast<int32_t>(r >> 16)) * kDitherScale;
+}
+
+inline float clampUnit(float v) {
+    return v > 1.0f ? 1.0f : (v < -1.0f ? -1.0f : v);
+}
+
+// Scaled, dithered and clamped integer sample (scalar path).
+inline int32_t quantize(float v, float fullScale, float lo, float hi, float noise) {
+    float x = clampUnit(v) * fullScale + noise;
+    x = x > hi ? hi : (x < lo ? lo : x);
+    return static_cast<int32_t>(std::lrint(x));
+}
+
+inline int32_t load24(const uint8_t* p) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    uint32_t u = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8);
+#else
+    uint32_t u = (uint32_t(p[2]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[0]) << 8);
+#endif
+    return static_cast<int32_t>(u) >> 8;
+}
+
+inline void store24(uint8_t* p, int32_t v) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    p[0] = static_cast<uint8_t>(v >> 16);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v);
+#else
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+#endif
+}
+
+struct Range {
+    float fullScale;
+    float lo;
+    float hi;
+    bool dither;
+};
+
+constexpr size_t bytesOf(DeviceFormat format) {
+    return format == DeviceFormat::Int16 ? 2 : (format == DeviceFormat::Int24 ? 3 : 4);
+}
+
+constexpr Range rangeOf(DeviceFormat format) {
+    switch (format) {
+    case DeviceFormat::Int16: return { 32768.0f, -32768.0f, 32767.0f, true };
+    case DeviceFormat::Int24: return { 8388608.0f, -8388608.0f, 8388607.0f, true };
+    // 2147483520 is the largest float below 2^31.
+    case DeviceFormat::Int32: return { 2147483648.0f, -2147483648.0f, 2147483520.0f, false };
+    default: return { 1.0f, -1.0f, 1.0f, false };
+    }
+}
+
+#if defined(SF_USE_SSE2)
+#ifdef __SSSE3__
+// Low three bytes of each int32 lane, packed into bytes 0..11.
+const __m128i kPack24 = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+#endif
+
+inline __m128i xorshift4(__m128i& s) {
+    s = _mm_xor_si128(s, _mm_slli_epi32(s, 13));
+    s = _mm_xor_si128(s, _mm_srli_epi32(s, 17));
+    s = _mm_xor_si128(s, _mm_slli_epi32(s, 5));
+    return s;
+}
+
+inline __m128 tpdf4(__m128i r) {
+    __m128i lo = _mm_and_si128(r, _mm_set1_epi32(0xFFFF));
+    __m128i hi = _mm_srli_epi32(r, 16);
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(lo, hi)), _mm_set1_ps(kDitherScale));
+}
+#endif
+
+} // namespace
+
+int deviceFormatBits(DeviceFormat format) {
+    switch (format) {
+    case DeviceFormat::Int16: return 16;
+    case DeviceFormat::Int32: return 32;
+    default: return 24;
+    }
+}
+
+size_t deviceFormatBytes(DeviceFormat format) {
+    return bytesOf(format);
+}
+
+const char* deviceFormatName(DeviceFormat format) {
+    switch (format) {
+    case DeviceFormat::Int32: return "int32";
+    case DeviceFormat::Int24: return "int24";
+    case DeviceFormat::Int16: return "int16";
+    default: return "float32";
+    }
+}
+
+bool parseDeviceFormat(const char* name, DeviceFormat& format) {
+    const DeviceFormat all[] = { DeviceFormat::Float32, DeviceFormat::Int32, DeviceFormat::Int24, DeviceFormat::Int16 };
+    for (DeviceFormat f : all) {
+        if (std::strcmp(name, deviceFormatName(f)) == 0) {
+            format = f;
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+// Float -> device format, specialized per format so the per-sample format
+// tests below fold away. Simd = false is the scalar variant.
+template <DeviceFormat F, bool Simd>
+void renderKernel(const float* src, void* dst, size_t samples, float gain, DitherState* dither) {
+    constexpr DeviceFormat format = F;
+    const Range r = rangeOf(format);
+    const bool useDither = r.dither && dither;
+    DitherState unused;
+    DitherState& state = dither ? *dither : unused;
+    size_t i = 0;
+
+#if defined(SF_USE_SSE2)
+    if (Simd) {
+        const __m128 vgain = _mm_set1_ps(gain);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 minusOne = _mm_set1_ps(-1.0f);
+        const __m128 scale = _mm_set1_ps(r.fullScale);
+        const __m128 lo = _mm_set1_ps(r.lo);
+        const __m128 hi = _mm_set1_ps(r.hi);
+        __m128i lanes4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state.s));
+
+        for (; i + 4 <= samples; i += 4) {
+            __m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), vgain);
+            v = _mm_max_ps(_mm_min_ps(v, one), minusOne);
+            if (format == DeviceFormat::Float32) {
+                _mm_storeu_ps(static_cast<float*>(dst) + i, v);
+                continue;
+            }
+            v = _mm_mul_ps(v, scale);
+            if (useDither) v = _mm_add_ps(v, tpdf4(xorshift4(lanes4)));
+            __m128i q = _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(v, hi), lo));
+
+            if (format == DeviceFormat::Int32) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(static_cast<int32_t*>(dst) + i), q);
+            } else if (format == DeviceFormat::Int16) {
+                // Values are in range already; the saturating pack just narrows.
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(static_cast<int16_t*>(dst) + i), _mm_packs_epi32(q, q));
+            } else {
+                uint8_t* p = static_cast<uint8_t*>(dst) + i * 3;
+                if (kLittleEndian && i * 3 + 16 <= samples * 3) {
+                    // Overlapping stores: the bytes past these 12 belong to later
+                    // samples and are overwritten by the next iteration or the tail.
+#ifdef __SSSE3__
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_shuffle_epi8(q, kPack24));
+#else
+                    alignas(16) int32_t lanes[4];
+                    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), q);
+                    for (int k = 0; k < 4; ++k) std::memcpy(p + k * 3, &lanes[k], 4);
+#endif
+                } else {
+                    alignas(16) int32_t lanes[4];
+                    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), q);
+                    for (int k = 0; k < 4; ++k) store24(p + k * 3, lanes[k]);
+                }
+            }
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state.s), lanes4);
+    }
+#endif
+
+    for (; i < samples; ++i) {
+        float v = src[i] * gain;
+        if (format == DeviceFormat::Float32) {
+            static_cast<float*>(dst)[i] = clampUnit(v);
+            continue;
+        }
+        float noise = useDither ? tpdf(xorshift(state.s[i & 3])) : 0.0f;
+        int32_t q = quantize(v, r.fullScale, r.lo, r.hi, noise);
+        switch (format) {
+        case DeviceFormat::Int32: static_cast<int32_t*>(dst)[i] = q; break;
+        case DeviceFormat::Int16: static_cast<int16_t*>(dst)[i] = static_cast<int16_t>(q); break;
+        default: store24(static_cast<uint8_t*>(dst) + i * 3, q); break;
+        }
+    }
+}
+
+template <DeviceFormat F, bool Simd>
+void expandKernel(const void* src, float* dst, size_t samples) {
+    size_t i = 0;
+    switch (F) {
+    case DeviceFormat::Float32:
+        std::memcpy(dst, src, samples * sizeof(float));
+        return;
+    case DeviceFormat::Int32: {
+        const int32_t* s = static_cast<const int32_t*>(src);
+        for (; i < samples; ++i) dst[i] = static_cast<float>(s[i]) * (1.0f / 2147483648.0f);
+        return;
+    }
+    case DeviceFormat::Int16: {
+        const int16_t* s = static_cast<const int16_t*>(src);
+#if defined(SF_USE_SSE2)
+        const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+        for (; Simd && i + 8 <= samples; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            // Sign-extend by placing each int16 in the top half of an int32.
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+            _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+        }
+#endif
+        for (; i < samples; ++i) dst[i] = static_cast<float>(s[i]) * (1.0f / 32768.0f);
+        return;
+    }
+    case DeviceFormat::Int24: {
+        const uint8_t* s = static_cast<const uint8_t*>(src);
+#if defined(SF_USE_SSE2)
+        // 4 samples per 12 bytes, each moved to the top 24 bits of a lane.
+        // The wide loads read up to 4 bytes past the group, so stop early.
+        const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+        for (; Simd && kLittleEndian && i * 3 + 16 <= samples * 3; i += 4) {
+#ifdef __SSSE3__
+            const __m128i unpack = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+            __m128i w = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i * 3)), unpack);
+#else
+            // Gather with movd rather than via memory (avoids a store-forwarding stall).
+            int32_t l[4];
+            for (int k = 0; k < 4; ++k) std::memcpy(&l[k], s + (i + k) * 3, 4);
+            __m128i lo = _mm_unpacklo_epi32(_mm_cvtsi32_si128(l[0]), _mm_cvtsi32_si128(l[1]));
+            __m128i hi = _mm_unpacklo_epi32(_mm_cvtsi32_si128(l[2]), _mm_cvtsi32_si128(l[3]));
+            __m128i w = _mm_slli_epi32(_mm_unpacklo_epi64(lo, hi), 8);
+#endif
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(w), scale));
+        }
+#endif
+        for (; i < samples; ++i) dst[i] = static_cast<float>(load24(s + i * 3)) * (1.0f / 8388608.0f);
+        return;
+    }
+    }
+}
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+// -----------------------------
+// AVX2 variants (8 samples per step)
+// -----------------------------
+SF_TARGET_AVX2 inline __m256i xorshift8(__m256i& s) {
+    s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 13));
+    s = _mm256_xor_si256(s, _mm256_srli_epi32(s, 17));
+    s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 5));
+    return s;
+}
+
+SF_TARGET_AVX2 inline __m256 tpdf8(__m256i r) {
+    __m256i lo = _mm256_and_si256(r, _mm256_set1_epi32(0xFFFF));
+    __m256i hi = _mm256_srli_epi32(r, 16);
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(lo, hi)), _mm256_set1_ps(kDitherScale));
+}
+
+template <DeviceFormat F>
+SF_TARGET_AVX2 void renderKernelAvx2(const float* src, void* dst, size_t samples, float gain, DitherState* dither) {
+    const Range r = rangeOf(F);
+    const bool useDither = r.dither && dither;
+    DitherState unused;
+    DitherState& state = dither ? *dither : unused;
+    const __m256 vgain = _mm256_set1_ps(gain);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 minusOne = _mm256_set1_ps(-1.0f);
+    const __m256 scale = _mm256_set1_ps(r.fullScale);
+    const __m256 lo = _mm256_set1_ps(r.lo);
+    const __m256 hi = _mm256_set1_ps(r.hi);
+    // Int24: low three bytes of each lane, then the six used dwords moved together.
+    const __m256i pack24 = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i join24 = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    __m256i lanes8 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state.s));
+    size_t i = 0;
+
+    for (; i + 8 <= samples; i += 8) {
+        __m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + i), vgain);
+        v = _mm256_max_ps(_mm256_min_ps(v, one), minusOne);
+        if (F == DeviceFormat::Float32) {
+            _mm256_storeu_ps(static_cast<float*>(dst) + i, v);
+            continue;
+        }
+        v = useDither ? _mm256_fmadd_ps(v, scale, tpdf8(xorshift8(lanes8))) : _mm256_mul_ps(v, scale);
+        __m256i q = _mm256_cvtps_epi32(_mm256_max_ps(_mm256_min_ps(v, hi), lo));
+
+        if (F == DeviceFormat::Int32) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(static_cast<int32_t*>(dst) + i), q);
+        } else if (F == DeviceFormat::Int16) {
+            __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(static_cast<int16_t*>(dst) + i), packed);
+        } else {
+            uint8_t* p = static_cast<uint8_t*>(dst) + i * 3;
+            q = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(q, pack24), join24);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(q));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(p + 16), _mm256_extracti128_si256(q, 1));
+        }
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(state.s), lanes8);
+    renderKernel<F, true>(src + i, static_cast<uint8_t*>(dst) + i * bytesOf(F), samples - i, gain, dither);
+}
+
+template <DeviceFormat F>
+SF_TARGET_AVX2 void expandKernelAvx2(const void* src, float* dst, size_t samples) {
+    if (F == DeviceFormat::Float32) {
+        std::memcpy(dst, src, samples * sizeof(float));
+        return;
+    }
+    const uint8_t* s = static_cast<const uint8_t*>(src);
+    size_t i = 0;
+    if (F == DeviceFormat::Int16) {
+        const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+        for (; i + 16 <= samples; i += 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i * 2));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i * 2 + 16));
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a)), scale));
+            _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b)), scale));
+        }
+    } else {
+        const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+        // Int24: 24 bytes loaded exactly (16 + 8), split 12 per lane, each
+        // sample moved to the top 24 bits of its dword.
+        const __m256i split24 = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+        const __m256i unpack24 = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                                  -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+        for (; i + 8 <= samples; i += 8) {
+            __m256i w;
+            if (F == DeviceFormat::Int32) {
+                w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i * 4));
+            } else {
+                const uint8_t* p = s + i * 3;
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                __m128i b = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 16));
+                w = _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1);
+                w = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(w, split24), unpack24);
+            }
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(w), scale));
+        }
+    }
+    expandKernel<F, true>(s + i * bytesOf(F), dst + i, samples - i);
+}
+
+// -----------------------------
+// AVX-512 variants (16 samples per step; F + BW)
+// -----------------------------
+// GCC 12's AVX-512 headers trip -Wmaybe-uninitialized on their own
+// _mm512_undefined_*() placeholders (GCC PR105593).
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+SF_TARGET_AVX512 inline __m512i xorshift16(__m512i& s) {
+    s = _mm512_xor_si512(s, _mm512_slli_epi32(s, 13));
+    s = _mm512_xor_si512(s, _mm512_srli_epi32(s, 17));
+    s = _mm512_xor_si512(s, _mm512_slli_epi32(s, 5));
+    return s;
+}
+
+SF_TARGET_AVX512 inline __m512 tpdf16(__m512i r) {
+    __m512i lo = _mm512_and_si512(r, _mm512_set1_epi32(0xFFFF));
+    __m512i hi = _mm512_srli_epi32(r, 16);
+    return _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_sub_epi32(lo, hi)), _mm512_set1_ps(kDitherScale));
+}
+
+// Int24: 12 used bytes per 128-bit lane <-> 48 contiguous bytes.
+SF_TARGET_AVX512 inline __m512i bytes24PerLane(bool pack) {
+    const __m128i packLane = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m128i unpackLane = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    return _mm512_broadcast_i32x4(pack ? packLane : unpackLane);
+}
+
+template <DeviceFormat F>
+SF_TARGET_AVX512 void renderKernelAvx512(const float* src, void* dst, size_t samples, float gain, DitherState* dither) {
+    const Range r = rangeOf(F);
+    const bool useDither = r.dither && dither;
+    DitherState unused;
+    DitherState& state = dither ? *dither : unused;
+    const __m512 vgain = _mm512_set1_ps(gain);
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 minusOne = _mm512_set1_ps(-1.0f);
+    const __m512 scale = _mm512_set1_ps(r.fullScale);
+    const __m512 lo = _mm512_set1_ps(r.lo);
+    const __m512 hi = _mm512_set1_ps(r.hi);
+    const __m512i pack24 = bytes24PerLane(true);
+    const __m512i join24 = _mm512_setr_epi32(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 3, 7, 11, 15);
+    __m512i lanes16 = _mm512_loadu_si512(state.s);
+    size_t i = 0;
+
+    for (; i + 16 <= samples; i += 16) {
+        __m512 v = _mm512_mul_ps(_mm512_loadu_ps(src + i), vgain);
+        v = _mm512_max_ps(_mm512_min_ps(v, one), minusOne);
+        if (F == DeviceFormat::Float32) {
+            _mm512_storeu_ps(static_cast<float*>(dst) + i, v);
+            continue;
+        }
+        v = useDither ? _mm512_fmadd_ps(v, scale, tpdf16(xorshift16(lanes16))) : _mm512_mul_ps(v, scale);
+        __m512i q = _mm512_cvtps_epi32(_mm512_max_ps(_mm512_min_ps(v, hi), lo));
+
+        if (F == DeviceFormat::Int32) {
+            _mm512_storeu_si512(static_cast<int32_t*>(dst) + i, q);
+        } else if (F == DeviceFormat::Int16) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(static_cast<int16_t*>(dst) + i), _mm512_cvtsepi32_epi16(q));
+        } else {
+            q = _mm512_permutexvar_epi32(join24, _mm512_shuffle_epi8(q, pack24));
+            _mm512_mask_storeu_epi32(static_cast<uint8_t*>(dst) + i * 3, 0x0FFF, q);
+        }
+    }
+    _mm512_storeu_si512(state.s, lanes16);
+    renderKernel<F, true>(src + i, static_cast<uint8_t*>(dst) + i * bytesOf(F), samples - i, gain, dither);
+}
+
+template <DeviceFormat F>
+SF_TARGET_AVX512 void expandKernelAvx512(const void* src, float* dst, size_t samples) {
+    if (F == DeviceFormat::Float32) {
+        std::memcpy(dst, src, samples * sizeof(float));
+        return;
+    }
+    const uint8_t* s = static_cast<const uint8_t*>(src);
+    const __m512 scale = _mm512_set1_ps(F == DeviceFormat::Int16 ? 1.0f / 32768.0f : 1.0f / 2147483648.0f);
+    const __m512i split24 = _mm512_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0, 6, 7, 8, 0, 9, 10, 11, 0);
+    const __m512i unpack24 = bytes24PerLane(false);
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        __m512i w;
+        if (F == DeviceFormat::Int16) {
+            w = _mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i * 2)));
+        } else if (F == DeviceFormat::Int32) {
+            w = _mm512_loadu_si512(s + i * 4);
+        } else {
+            // Masked load of exactly 48 bytes.
+            w = _mm512_maskz_loadu_epi32(0x0FFF, s + i * 3);
+            w = _mm512_shuffle_epi8(_mm512_permutexvar_epi32(split24, w), unpack24);
+        }
+        _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_cvtepi32_ps(w), scale));
+    }
+    expandKernel<F, true>(s + i * bytesOf(F), dst + i, samples - i);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif // MUSIC_PLAYER_X86_DISPATCH
+
+template <DeviceFormat F>
+SampleKernels kernelsFor(SimdLevel level) {
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+    if (level >= SimdLevel::AVX512) return SampleKernels{ &renderKernelAvx512<F>, &expandKernelAvx512<F>, "avx512" };
+    if (level >= SimdLevel::AVX2) return SampleKernels{ &renderKernelAvx2<F>, &expandKernelAvx2<F>, "avx2" };
+#endif
+#if defined(SF_USE_SSE2)
+    if (level >= SimdLevel::SSE2) return SampleKernels{ &renderKernel<F, true>, &expandKernel<F, true>, "sse2" };
+#endif
+    (void)level;
+    return SampleKernels{ &renderKernel<F, false>, &expandKernel<F, false>, "scalar" };
+}
+
+} // namespace
+
+SampleKernels selectSampleKernels(DeviceFormat format, SimdLevel level) {
+    if (level > detectedSimdLevel()) level = detectedSimdLevel();
+    switch (format) {
+    case DeviceFormat::Int32: return kernelsFor<DeviceFormat::Int32>(level);
+    case DeviceFormat::Int24: return kernelsFor<DeviceFormat::Int24>(level);
+    case DeviceFormat::Int16: return kernelsFor<DeviceFormat::Int16>(level);
+    default: return kernelsFor<DeviceFormat::Float32>(level);
+    }
+}
+
+SampleKernels selectSampleKernels(DeviceFormat format) {
+    return selectSampleKernels(format, simdLevel());
+}
+
+void renderToDevice(const float* src, void* dst, size_t samples, DeviceFormat format, float gain, DitherState* dither) {
+    selectSampleKernels(format).render(src, dst, samples, gain, dither);
+}
+
+void expandToFloat(const void* src, float* dst, size_t samples, DeviceFormat format) {
+    selectSampleKernels(format).expand(src, dst, samples);
+}
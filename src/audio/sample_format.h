@@ -0,0 +1,83 @@
+#pragma once
+/*
+ sample_format.h
+
+ Purpose:
+   - Device sample formats AudioOutput can open a stream with, and the one
+     conversion from the engine's float samples to them.
+   - renderToDevice() is the only place where audio leaves float: volume,
+     clamping, dither and packing happen in a single vectorized pass in the
+     PortAudio callback, once per sample.
+   - The same formats serve as compact ring storage in AudioOutput (int16,
+     packed int24); expandToFloat() is the way back.
+   - Both are templates per format; selectSampleKernels() returns the pair
+     for one format so AudioOutput resolves it once per stream instead of
+     branching on the format in the callback.
+   - Each format has scalar, SSE2, AVX2 and AVX-512 variants; selection
+     follows simdLevel() (cpu_features.h), so one binary uses the widest
+     unit the host has.
+
+ Notes:
+   - Int16 and Int24 get TPDF dither of +-1 LSB (difference of two uniform
+     variables from a per-stream xorshift generator); Int32 and Float32 are
+     exact enough to need none.
+   - Int24 is packed 3-byte samples in host byte order (paInt24).
+   - Float32 output is clamped to [-1, 1] like the integer formats, so a
+     volume boost never reaches the device as out-of-range floats.
+*/
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../utils/cpu_features.h"
+
+enum class DeviceFormat {
+    Float32,
+    Int32,
+    Int24,
+    Int16
+};
+
+// Bytes per sample of `format` as PortAudio lays it out.
+size_t deviceFormatBytes(DeviceFormat format);
+
+// "float32", "int32", "int24", "int16".
+const char* deviceFormatName(DeviceFormat format);
+
+// Parse a name accepted by deviceFormatName(); false if unknown.
+bool parseDeviceFormat(const char* name, DeviceFormat& format);
+
+// Dither generator state: xorshift32 lanes, one per SIMD lane (the SSE2
+// and scalar variants step the first four, AVX2 eight, AVX-512 all 16).
+struct DitherState {
+    uint32_t s[16] = { 0x9E3779B9u, 0x243F6A88u, 0xB7E15162u, 0x6A09E667u,
+                       0xBB67AE85u, 0x3C6EF372u, 0xA54FF53Au, 0x510E527Fu,
+                       0x9B05688Cu, 0x1F83D9ABu, 0x5BE0CD19u, 0x428A2F98u,
+                       0x71374491u, 0xB5C0FBCFu, 0xE9B5DBA5u, 0x3956C25Bu };
+};
+
+// Convert `samples` interleaved floats to `format` at `dst`, scaling by
+// `gain` and clamping to full scale. dither == nullptr skips the dither
+// (when the input is already on the target's integer grid).
+void renderToDevice(const float* src, void* dst, size_t samples, DeviceFormat format, float gain, DitherState* dither);
+
+// Expand `samples` samples of `format` at `src` to float in [-1, 1).
+void expandToFloat(const void* src, float* dst, size_t samples, DeviceFormat format);
+
+// renderToDevice() / expandToFloat() specialized for one format. Callers on
+// a hot path (the PortAudio callback) select them once per stream.
+using RenderKernelFn = void (*)(const float* src, void* dst, size_t samples, float gain, DitherState* dither);
+using ExpandKernelFn = void (*)(const void* src, float* dst, size_t samples);
+struct SampleKernels {
+    RenderKernelFn render;
+    ExpandKernelFn expand;
+    const char* variant;   // "scalar", "sse2", "avx2", "avx512"
+};
+SampleKernels selectSampleKernels(DeviceFormat format);
+
+// Widest variant at or below `level` (capped to what the host supports),
+// e.g. to compare variants against each other.
+SampleKernels selectSampleKernels(DeviceFormat format, SimdLevel level);
+
+// Significant bits of `format` (24 for Float32: the mantissa).
+int deviceFormatBits(DeviceFormat format);
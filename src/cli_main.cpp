@@ -0,0 +1,190 @@
+/**
+ * cli_main.cpp
+ *
+ * Headless command-line player: plays the files given as arguments in order.
+ * Needs no GUI libraries, so it is what Makefile.simple builds; compiled with
+ * -DMUSIC_PLAYER_NO_FFMPEG it plays WAV/AIFF through the native PcmDecoder
+ * with PortAudio as the only dependency.
+ *
+ * Usage:
+ *   music_player_cli [--volume 0..2] [--speed 0.5..2] [--pcm-cache MB]
+ *                    [--block-cache MB] [--loop A B]
+ *                    [--output-format float32|int32|int24|int16]
+ *                    [--ring-format float32|int16|int24] [--output-channels N]
+ *                    [--mix-matrix "a,b,...;c,d,..."] [--eq BANDS] [--eq-preamp DB]
+ *                    [--limiter-ceiling DBTP] [--no-limiter]
+ *                    [--ir FILE] [--ir-mix WET] [--dsp-workers N] [--dsp-governor]
+ *                    file1.wav [file2.aiff ...]
+ *
+ * --pcm-cache enables the decoded-PCM disk cache (PcmCache) with the given
+ * budget, so files played again are not decoded again.
+ * --block-cache sets the in-memory block cache budget (PcmBlockCache, default
+ * 64 MiB, 0 = off). --loop repeats seconds [A, B) of each file until Ctrl+C;
+ * after the first pass the loop is served from the block cache.
+ * --output-format picks the device sample format to try first (default
+ * float32); the output falls back to what the device supports.
+ * --ring-format stores the output ring buffer as int16 or packed int24
+ * instead of float to save memory.
+ * --output-channels opens the device with N channels instead of its own
+ * count. --mix-matrix replaces the standard down/upmix for sources whose
+ * channel count matches its columns on an output matching its rows (rows
+ * separated by ';', e.g. "1,0,0.7;0,1,0.7" for 3 -> 2).
+ * --eq sets the parametric EQ bands as type:freq[:gain[:q]] separated by ','
+ * (e.g. "lowshelf:100:4,peak:3000:-2:1.4,highpass:30"); --eq-preamp adds a
+ * gain in dB in front of them.
+ * --volume above 1 is a boost applied by the true-peak limiter;
+ * --limiter-ceiling sets its ceiling (default -1 dBTP), --no-limiter turns the
+ * limiting off (boosted peaks then clip at full scale).
+ * --ir convolves the output with an impulse response file (room correction
+ * filter or reverb, resampled if needed); --ir-mix sets the share of the
+ * convolved signal (0..1, default 1).
+ * --dsp-workers runs the per-channel DSP work (EQ, convolution) on N worker
+ * threads besides the decode thread (default 0).
+ * --dsp-governor lets the DSP stage lower its quality (shorter convolution
+ * tail, sample-peak limiting) while it cannot keep up; app.log records every
+ * step.
+ */
+
+#include "player/player.h"
+#include "io/pcm_cache.h"
+#include "io/pcm_block_cache.h"
+#include "utils/logger.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main(int argc, char** argv) {
+    float volume = 1.0f;
+    float speed = 1.0f;
+    uint64_t pcmCacheMB = 0;
+    uint64_t blockCacheMB = 64;
+    double loopStart = 0.0;
+    double loopEnd = 0.0;
+    DeviceFormat outputFormat = DeviceFormat::Float32;
+    DeviceFormat ringFormat = DeviceFormat::Float32;
+    int outputChannels = 0;
+    int mixIn = 0;
+    int mixOut = 0;
+    std::vector<float> mixMatrix;
+    std::vector<EqBand> eqBands;
+    float eqPreamp = 0.0f;
+    float limiterCeiling = Limiter::kDefaultCeilingDb;
+    bool limiterEnabled = true;
+    std::string irPath;
+    float irMix = 1.0f;
+    int dspWorkers = 0;
+    bool dspGovernor = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--volume") == 0 && i + 1 < argc) {
+            volume = static_cast<float>(std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = static_cast<float>(std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--pcm-cache") == 0 && i + 1 < argc) {
+            pcmCacheMB = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--block-cache") == 0 && i + 1 < argc) {
+            blockCacheMB = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--loop") == 0 && i + 2 < argc) {
+            loopStart = std::atof(argv[++i]);
+            loopEnd = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--output-format") == 0 && i + 1 < argc) {
+            if (!parseDeviceFormat(argv[++i], outputFormat)) {
+                std::fprintf(stderr, "Unknown output format %s\n", argv[i]);
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--ring-format") == 0 && i + 1 < argc) {
+            if (!parseDeviceFormat(argv[++i], ringFormat)) {
+                std::fprintf(stderr, "Unknown ring format %s\n", argv[i]);
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--output-channels") == 0 && i + 1 < argc) {
+            outputChannels = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--mix-matrix") == 0 && i + 1 < argc) {
+            if (!parseMixMatrix(argv[++i], mixIn, mixOut, mixMatrix)) {
+                std::fprintf(stderr, "Invalid mix matrix %s\n", argv[i]);
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--eq") == 0 && i + 1 < argc) {
+            if (!parseEqBands(argv[++i], eqBands)) {
+                std::fprintf(stderr, "Invalid EQ bands %s\n", argv[i]);
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--eq-preamp") == 0 && i + 1 < argc) {
+            eqPreamp = static_cast<float>(std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--limiter-ceiling") == 0 && i + 1 < argc) {
+            limiterCeiling = static_cast<float>(std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--no-limiter") == 0) {
+            limiterEnabled = false;
+        } else if (std::strcmp(argv[i], "--ir") == 0 && i + 1 < argc) {
+            irPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--ir-mix") == 0 && i + 1 < argc) {
+            irMix = static_cast<float>(std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--dsp-workers") == 0 && i + 1 < argc) {
+            dspWorkers = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--dsp-governor") == 0) {
+            dspGovernor = true;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        std::fprintf(stderr, "Usage: %s [--volume 0..2] [--speed 0.5..2] [--pcm-cache MB] [--block-cache MB] [--loop A B] [--output-format FMT] [--ring-format FMT] [--output-channels N] [--mix-matrix M] [--eq BANDS] [--eq-preamp DB] [--limiter-ceiling DBTP] [--no-limiter] [--ir FILE] [--ir-mix WET] [--dsp-workers N] [--dsp-governor] file...\n", argv[0]);
+        return 1;
+    }
+
+    Logger::instance().setLogFile("app.log");
+
+    std::unique_ptr<PcmCache> pcmCache;
+    if (pcmCacheMB > 0) {
+        pcmCache.reset(new PcmCache(PcmCache::defaultDirectory(), pcmCacheMB << 20));
+    }
+
+    PcmBlockCache blockCache(blockCacheMB << 20);
+
+    Player player;
+    player.setPcmCache(pcmCache.get());
+    player.setBlockCache(&blockCache);
+    player.setOutputFormat(outputFormat);
+    player.setRingFormat(ringFormat);
+    player.setOutputChannels(outputChannels);
+    player.setMixMatrix(mixIn, mixOut, mixMatrix);
+    player.equalizer().setBands(eqBands);
+    player.equalizer().setPreamp(eqPreamp);
+    player.limiter().setCeiling(limiterCeiling);
+    player.limiter().setEnabled(limiterEnabled);
+    player.setImpulseResponse(irPath);
+    player.convolver().setMix(irMix);
+    player.setDspWorkers(dspWorkers);
+    player.setDspGovernor(dspGovernor);
+    int played = 0;
+    for (const auto& file : files) {
+        if (!player.load(file)) {
+            std::fprintf(stderr, "Cannot play %s (see app.log)\n", file.c_str());
+            continue;
+        }
+        player.setSpeed(speed);
+        player.setVolume(volume);
+        if (loopEnd > loopStart && !player.setLoop(loopStart, loopEnd)) {
+            std::fprintf(stderr, "Invalid loop %.2f-%.2f s\n", loopStart, loopEnd);
+        }
+        if (!player.play()) {
+            std::fprintf(stderr, "Cannot start audio output for %s\n", file.c_str());
+            continue;
+        }
+        std::printf("Playing %s (%.1f s)\n", file.c_str(), player.getDuration());
+        std::fflush(stdout);
+
+        while (!player.isFinished()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        player.stop();   // drains the ring buffer
+        ++played;
+    }
+    return played > 0 ? 0 : 1;
+}
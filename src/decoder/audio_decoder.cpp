@@ -0,0 +1,105 @@
+/**
+ * audio_decoder.cpp
+ *
+ * Decoder selection and the fixed-block decodeFrames() adapter.
+ * See audio_decoder.h.
+ */
+
+#include "audio_decoder.h"
+#include "pcm_decoder.h"
+#include "flac_decoder.h"
+#ifndef MUSIC_PLAYER_NO_FFMPEG
+#include "ffmpeg_decoder.h"
+#endif
+#include "pcm_convert.h"
+#include "../io/staging_cache.h"
+#include "../utils/logger.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+std::string AudioDecoder::resolveSource(const std::string& filepath) const {
+    return staging_ ? staging_->resolve(filepath) : filepath;
+}
+
+int AudioDecoder::decodeFloat(std::vector<float>& out_buffer) {
+    scratch_.clear();
+    int n = decode(scratch_);
+    if (n > 0) {
+        size_t start = out_buffer.size();
+        out_buffer.resize(start + static_cast<size_t>(n));
+        convertS16ToFloat(scratch_.data(), out_buffer.data() + start, static_cast<size_t>(n));
+    }
+    return n;
+}
+
+size_t AudioDecoder::decodeFrames(float* dst, size_t frames) {
+    const size_t channels = static_cast<size_t>(std::max(getChannels(), 0));
+    frames_position_ = -1;
+    if (channels == 0) {
+        return 0;
+    }
+
+    size_t done = 0;
+    while (done < frames) {
+        if (pending_.size() - pending_pos_ < channels) {
+            pending_.clear();
+            pending_pos_ = 0;
+            if (decodeFloat(pending_) <= 0) {
+                pending_.clear();
+                break;
+            }
+            int64_t position = getDecodePosition();
+            if (position >= 0) pending_position_ = position;
+        }
+        if (done == 0) frames_position_ = pending_position_;
+
+        size_t take = std::min(frames - done, (pending_.size() - pending_pos_) / channels);
+        std::memcpy(dst + done * channels, pending_.data() + pending_pos_, take * channels * sizeof(float));
+        pending_pos_ += take * channels;
+        done += take;
+        if (pending_position_ >= 0) pending_position_ += static_cast<int64_t>(take);
+    }
+    return done;
+}
+
+static std::string lowerExtension(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) {
+        return std::string();
+    }
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return ext;
+}
+
+std::unique_ptr<AudioDecoder> AudioDecoder::openFile(const std::string& filepath, StagingCache* staging,
+                                                    DecodeWorkload workload, int threads) {
+    std::string ext = lowerExtension(filepath);
+    std::unique_ptr<AudioDecoder> native;
+    if (ext == "wav" || ext == "wave" || ext == "aif" || ext == "aiff" || ext == "aifc") {
+        native.reset(new PcmDecoder());
+    } else if (ext == "flac") {
+        native.reset(new FlacDecoder());
+    }
+    if (native) {
+        native->setStagingCache(staging);
+        native->setWorkload(workload, threads);
+        if (native->open(filepath)) {
+            return native;
+        }
+    }
+
+#ifndef MUSIC_PLAYER_NO_FFMPEG
+    std::unique_ptr<AudioDecoder> ffmpeg(new FFmpegDecoder());
+    ffmpeg->setStagingCache(staging);
+    ffmpeg->setWorkload(workload, threads);
+    if (ffmpeg->open(filepath)) {
+        return ffmpeg;
+    }
+#else
+    Logger::instance().log(LogLevel::ERROR, "AudioDecoder: built without FFmpeg; only WAV/AIFF/FLAC are supported: " + filepath);
+#endif
+    return nullptr;
+}
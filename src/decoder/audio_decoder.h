@@ -0,0 +1,134 @@
+#pragma once
+/**
+ * audio_decoder.h
+ *
+ * Decoder interface used by Player, plus the factory that picks an
+ * implementation for a file.
+ *
+ * Implementations:
+ *   - PcmDecoder    (pcm_decoder.h):    native WAV/AIFF reader, no dependencies
+ *   - FlacDecoder   (flac_decoder.h):   native FLAC decoder, no dependencies
+ *   - FFmpegDecoder (ffmpeg_decoder.h): everything else
+ *
+ * Contract (same as the original FFmpegDecoder API):
+ *   - decode(...) appends interleaved signed 16-bit samples to the vector and
+ *     returns the number of samples appended (not frames). 0 means EOF.
+ *   - getSampleRate()/getChannels() describe the decoded output after open().
+ *   - decodeFloat(...) is the same in float ([-1, 1)) at the source's full
+ *     resolution (24-bit FLAC/WAV, float codecs); decoders without a native
+ *     float path expand their int16 output.
+ *   - decodeFrames(...) is the fixed-block alternative to decode(): it fills
+ *     exactly the requested number of float frames and keeps the rest of the
+ *     decoder's batch for the next call. Use one or the other per decoder.
+ *
+ * Decoders that can parallelise internally size that from a DecodeWorkload
+ * hint set before open(): playback keeps cores free for the rest of the
+ * process, offline jobs (analysis, transcoding) go for throughput.
+ *
+ * Builds without FFmpeg (-DMUSIC_PLAYER_NO_FFMPEG, used by Makefile.simple)
+ * only contain the native decoders; openFile() then fails for other formats.
+ */
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+class StagingCache;  // io/staging_cache.h
+
+enum class DecodeWorkload {
+    Playback,   // real time: low latency, few threads
+    Offline     // analysis / transcoding: maximum throughput
+};
+
+class AudioDecoder {
+public:
+    virtual ~AudioDecoder() = default;
+
+    // Open the media file. Returns true on success.
+    virtual bool open(const std::string& filepath) = 0;
+
+    // Append interleaved int16 samples; returns samples appended (0 = EOF).
+    virtual int decode(std::vector<int16_t>& out_buffer) = 0;
+
+    // Append interleaved float samples at full resolution; returns samples
+    // appended (0 = EOF). The default expands decode().
+    virtual int decodeFloat(std::vector<float>& out_buffer);
+
+    // Close and free resources.
+    virtual void close() = 0;
+
+    // Output parameters (after open)
+    virtual int getSampleRate() const = 0;
+    virtual int getChannels() const = 0;
+
+    // Duration in seconds (0 if unknown).
+    virtual double getDuration() const = 0;
+
+    // Short implementation name for logs and benchmarks ("pcm", "flac", "ffmpeg").
+    virtual const char* name() const = 0;
+
+    // Bits per sample of the source (32 or 64 for codecs that decode to
+    // float, 16 if unknown).
+    virtual int getSourceBits() const { return 16; }
+
+    // Reposition so that the next decode() starts at `seconds`.
+    // Returns false if the decoder cannot seek or the position is invalid.
+    virtual bool seek(double seconds) { (void)seconds; return false; }
+
+    // Frame index, counted from the start of the stream, of the first sample
+    // appended by the most recent decode(); -1 if unknown.
+    virtual int64_t getDecodePosition() const { return -1; }
+
+    // Write exactly `frames` interleaved float frames ([-1, 1)) to `dst`,
+    // calling decodeFloat() as often as needed. Frames left over from a batch are
+    // returned by the next call. Returns `frames`, or fewer at EOF.
+    size_t decodeFrames(float* dst, size_t frames);
+
+    // Frame index of the first frame of the latest decodeFrames() block
+    // (-1 if unknown).
+    int64_t getFramesPosition() const { return frames_position_; }
+
+    // Attach a staging cache consulted by open() (may be nullptr; not owned).
+    // If it holds a complete local copy of the file, that copy is opened.
+    void setStagingCache(StagingCache* cache) { staging_ = cache; }
+
+    // Threading hint consulted by open(). `threads` > 0 overrides the
+    // decoder's choice for the workload; 0 keeps the automatic default.
+    void setWorkload(DecodeWorkload workload, int threads = 0) {
+        workload_ = workload;
+        threads_ = threads;
+    }
+
+    // Create and open the best decoder for `filepath`: PcmDecoder for
+    // WAV/AIFF and FlacDecoder for FLAC files they can read, FFmpegDecoder
+    // otherwise (including variants the native decoders reject, e.g. ADPCM
+    // WAV or 32-bit FLAC).
+    // `workload`/`threads` are passed to setWorkload().
+    // Returns nullptr if no decoder could open the file.
+    static std::unique_ptr<AudioDecoder> openFile(const std::string& filepath, StagingCache* staging = nullptr,
+                                                  DecodeWorkload workload = DecodeWorkload::Playback, int threads = 0);
+
+protected:
+    // Path open() should read: the staged local copy if available.
+    std::string resolveSource(const std::string& filepath) const;
+
+    // Forget frames buffered by decodeFrames(). seek() and close()
+    // implementations call this first.
+    void discardBufferedFrames() {
+        pending_.clear();
+        pending_pos_ = 0;
+        pending_position_ = -1;
+    }
+
+    StagingCache* staging_ = nullptr;
+    DecodeWorkload workload_ = DecodeWorkload::Playback;
+    int threads_ = 0;
+
+private:
+    std::vector<float> pending_;     // decodeFloat() batch being handed out by decodeFrames()
+    std::vector<int16_t> scratch_;   // decode() output for the default decodeFloat()
+    size_t pending_pos_ = 0;         // next sample in pending_
+    int64_t pending_position_ = -1;  // frame index of pending_[pending_pos_]
+    int64_t frames_position_ = -1;   // see getFramesPosition()
+};
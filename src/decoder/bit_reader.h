@@ -0,0 +1,134 @@
+#pragma once
+/**
+ * bit_reader.h
+ *
+ * MSB-first bit reader over a byte range with a 64-bit cache, shared by the
+ * FLAC frame decoder and the PCM block codec.
+ *
+ * The cache holds `bits_` valid bits, left-aligned. Bulk refills load 8
+ * bytes at once; bits below the valid region may already hold the next
+ * bytes, which later refills OR in again unchanged.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size)
+        : begin_(data), p_(data), end_(data + size), cache_(0), bits_(0), overrun_(false) {}
+
+    bool overrun() const { return overrun_; }
+
+    uint32_t read(int n) {
+        if (n == 0) return 0;
+        if (bits_ < n) {
+            refill();
+            if (bits_ < n) {
+                overrun_ = true;
+                cache_ = 0;
+                bits_ = 0;
+                return 0;
+            }
+        }
+        uint32_t v = static_cast<uint32_t>(cache_ >> (64 - n));
+        cache_ <<= n;
+        bits_ -= n;
+        return v;
+    }
+
+    int32_t readSigned(int n) {
+        if (n == 0) return 0;
+        uint32_t v = read(n);
+        return static_cast<int32_t>(v << (32 - n)) >> (32 - n);
+    }
+
+    // Number of 0 bits before the next 1 bit (the 1 is consumed).
+    uint32_t readUnary() {
+        uint32_t q = 0;
+        while (true) {
+            if (bits_ == 0) {
+                refill();
+                if (bits_ == 0) {
+                    overrun_ = true;
+                    return q;
+                }
+            }
+            uint64_t visible = cache_ & (~0ULL << (64 - bits_));
+            if (visible) {
+                int z = __builtin_clzll(visible);
+                cache_ <<= z;
+                cache_ <<= 1;
+                bits_ -= z + 1;
+                return q + static_cast<uint32_t>(z);
+            }
+            q += static_cast<uint32_t>(bits_);
+            cache_ = 0;
+            bits_ = 0;
+        }
+    }
+
+    // Decode `n` Rice codes with parameter `k` as folded (unsigned) values.
+    bool readRice(uint32_t* dst, size_t n, int k) {
+        for (size_t j = 0; j < n; ++j) {
+            // Fast path: unary run, stop bit and k low bits all in the cache.
+            if (bits_ < 32 + k) refill();
+            uint64_t visible = bits_ ? cache_ & (~0ULL << (64 - bits_)) : 0;
+            if (visible) {
+                int z = __builtin_clzll(visible);
+                if (z + 1 + k <= bits_) {
+                    uint64_t rest = (cache_ << z) << 1;
+                    uint32_t low = k ? static_cast<uint32_t>(rest >> (64 - k)) : 0;
+                    cache_ = k ? rest << k : rest;
+                    bits_ -= z + 1 + k;
+                    dst[j] = (static_cast<uint32_t>(z) << k) | low;
+                    continue;
+                }
+            }
+            uint64_t u = (static_cast<uint64_t>(readUnary()) << k) | read(k);
+            if (u > 0xFFFFFFFFULL || overrun_) return false;
+            dst[j] = static_cast<uint32_t>(u);
+        }
+        return !overrun_;
+    }
+
+    void alignToByte() {
+        int n = bits_ & 7;
+        cache_ <<= n;
+        bits_ -= n;
+    }
+
+    // Byte offset of the read position (after alignToByte()).
+    size_t bytePosition() const {
+        return static_cast<size_t>(p_ - begin_) - static_cast<size_t>(bits_ / 8);
+    }
+
+private:
+    void refill() {
+        if (end_ - p_ >= 8) {
+            int take = (64 - bits_) >> 3;
+            if (take == 0) return;
+            uint64_t v;
+            std::memcpy(&v, p_, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            v = __builtin_bswap64(v);
+#endif
+            cache_ |= v >> bits_;
+            p_ += take;
+            bits_ += take * 8;
+        } else {
+            while (bits_ <= 56 && p_ < end_) {
+                cache_ |= static_cast<uint64_t>(*p_++) << (56 - bits_);
+                bits_ += 8;
+            }
+        }
+    }
+
+    const uint8_t* begin_;
+    const uint8_t* p_;
+    const uint8_t* end_;
+    uint64_t cache_;
+    int bits_;
+    bool overrun_;
+};
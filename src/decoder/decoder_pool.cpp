@@ -0,0 +1,213 @@
+/**
+ * decoder_pool.cpp
+ *
+ * See decoder_pool.h.
+ */
+
+#include "decoder_pool.h"
+
+#include <cstring>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libswresample/swresample.h>
+}
+
+DecoderPool& DecoderPool::instance() {
+    static DecoderPool pool;
+    return pool;
+}
+
+DecoderPool::~DecoderPool() {
+    clear();
+}
+
+// -----------------------------
+// Packets and frames
+// -----------------------------
+AVPacket* DecoderPool::acquirePacket() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!packets_.empty()) {
+            AVPacket* packet = packets_.back();
+            packets_.pop_back();
+            return packet;
+        }
+    }
+    return av_packet_alloc();
+}
+
+AVFrame* DecoderPool::acquireFrame() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!frames_.empty()) {
+            AVFrame* frame = frames_.back();
+            frames_.pop_back();
+            return frame;
+        }
+    }
+    return av_frame_alloc();
+}
+
+void DecoderPool::releasePacket(AVPacket* packet) {
+    if (!packet) return;
+    av_packet_unref(packet);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (packets_.size() < kMaxIdleFrames) {
+            packets_.push_back(packet);
+            return;
+        }
+    }
+    av_packet_free(&packet);
+}
+
+void DecoderPool::releaseFrame(AVFrame* frame) {
+    if (!frame) return;
+    av_frame_unref(frame);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (frames_.size() < kMaxIdleFrames) {
+            frames_.push_back(frame);
+            return;
+        }
+    }
+    av_frame_free(&frame);
+}
+
+// -----------------------------
+// Resamplers
+// -----------------------------
+SwrContext* DecoderPool::acquireResampler(const ResamplerKey& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = resamplers_.begin(); it != resamplers_.end(); ++it) {
+        if (it->key == key) {
+            SwrContext* swr = it->swr;
+            resamplers_.erase(it);
+            ++stats_.resamplerReused;
+            return swr;
+        }
+    }
+    ++stats_.resamplerCreated;
+    return nullptr;
+}
+
+void DecoderPool::releaseResampler(const ResamplerKey& key, SwrContext* swr) {
+    if (!swr) return;
+    // Buffered samples would leak into the next track.
+    if (swr_get_delay(swr, key.outRate) != 0) {
+        swr_free(&swr);
+        return;
+    }
+    SwrContext* evicted = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (resamplers_.size() >= kMaxIdleResamplers) {
+            evicted = resamplers_.front().swr;
+            resamplers_.pop_front();
+        }
+        resamplers_.push_back({ key, swr });
+    }
+    if (evicted) {
+        swr_free(&evicted);
+    }
+}
+
+// -----------------------------
+// Codec contexts
+// -----------------------------
+static bool sameParameters(const AVCodecParameters* a, const AVCodecParameters* b) {
+    return a->codec_id == b->codec_id && a->codec_tag == b->codec_tag && a->format == b->format &&
+           a->sample_rate == b->sample_rate && a->channels == b->channels && a->channel_layout == b->channel_layout &&
+           a->bits_per_coded_sample == b->bits_per_coded_sample && a->block_align == b->block_align &&
+           a->frame_size == b->frame_size && a->initial_padding == b->initial_padding &&
+           a->extradata_size == b->extradata_size &&
+           (a->extradata_size == 0 || std::memcmp(a->extradata, b->extradata, a->extradata_size) == 0);
+}
+
+AVCodecContext* DecoderPool::acquireCodec(const AVCodecParameters* params, const CodecKey& key) {
+    AVCodecContext* ctx = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = codecs_.begin(); it != codecs_.end(); ++it) {
+            if (it->key == key && sameParameters(it->params, params)) {
+                ctx = it->ctx;
+                avcodec_parameters_free(&it->params);
+                codecs_.erase(it);
+                ++stats_.codecReused;
+                break;
+            }
+        }
+        if (!ctx) {
+            ++stats_.codecCreated;
+            return nullptr;
+        }
+    }
+    avcodec_flush_buffers(ctx);
+    // Fields avcodec_parameters_to_context() would copy that sameParameters()
+    // does not compare (decoding does not depend on them). bits_per_raw_sample
+    // is left alone: the decoder sets it while opening.
+    ctx->bit_rate = params->bit_rate;
+    ctx->profile = params->profile;
+    ctx->level = params->level;
+    ctx->seek_preroll = params->seek_preroll;
+    ctx->trailing_padding = params->trailing_padding;
+    return ctx;
+}
+
+void DecoderPool::releaseCodec(AVCodecContext* ctx, const AVCodecParameters* params, const CodecKey& key) {
+    if (!ctx) return;
+    IdleCodec idle{ ctx, nullptr, key };
+    if (!params || !avcodec_is_open(ctx) || !(idle.params = avcodec_parameters_alloc()) ||
+        avcodec_parameters_copy(idle.params, params) < 0) {
+        freeCodec(idle);
+        return;
+    }
+    IdleCodec evicted{ nullptr, nullptr, CodecKey() };
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (codecs_.size() >= kMaxIdleCodecs) {
+            evicted = codecs_.front();
+            codecs_.pop_front();
+        }
+        codecs_.push_back(idle);
+    }
+    freeCodec(evicted);
+}
+
+void DecoderPool::freeCodec(IdleCodec& idle) {
+    if (idle.ctx) {
+        avcodec_free_context(&idle.ctx);
+    }
+    if (idle.params) {
+        avcodec_parameters_free(&idle.params);
+    }
+}
+
+// -----------------------------
+// Housekeeping
+// -----------------------------
+void DecoderPool::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (AVPacket* packet : packets_) {
+        av_packet_free(&packet);
+    }
+    packets_.clear();
+    for (AVFrame* frame : frames_) {
+        av_frame_free(&frame);
+    }
+    frames_.clear();
+    for (IdleResampler& idle : resamplers_) {
+        swr_free(&idle.swr);
+    }
+    resamplers_.clear();
+    for (IdleCodec& idle : codecs_) {
+        freeCodec(idle);
+    }
+    codecs_.clear();
+}
+
+DecoderPool::Stats DecoderPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
@@ -0,0 +1,129 @@
+#pragma once
+/**
+ * decoder_pool.h
+ *
+ * Process-wide recycling of FFmpeg objects between FFmpegDecoder instances.
+ *
+ * Opening a track used to allocate a fresh AVCodecContext, SwrContext,
+ * AVPacket and AVFrame and free them again in cleanup(). For playlists of
+ * same-format files most of that work is identical from track to track, so
+ * FFmpegDecoder (unless setUsePool(false)) takes and returns them here:
+ *
+ *   - AVPacket / AVFrame: unreferenced and kept on free lists.
+ *   - SwrContext: keyed by (input layout/format/rate, output layout/format/
+ *     rate). Only contexts with no buffered samples are kept, so a reused
+ *     one starts clean without swr_init().
+ *   - AVCodecContext: an opened context is reused for a stream whose codec
+ *     parameters (codec, format, rate, layout, extradata, ...) are identical
+ *     and that asks for the same threading (CodecKey: the thread count and
+ *     type requested at open, so a slice-threaded playback decoder never
+ *     gets a frame-threaded offline context). It is reset with
+ *     avcodec_flush_buffers() - the same reset a seek performs - and gets
+ *     the new stream's informational fields (bit rate, profile, ...).
+ *     Anything else gets a new context.
+ *
+ * Idle objects are bounded (oldest dropped first); all methods are thread
+ * safe so SegmentDecoder workers can share the pool.
+ */
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// Forward declarations only (see ffmpeg_decoder.h).
+extern "C" {
+    struct AVCodecContext;
+    struct AVCodecParameters;
+    struct SwrContext;
+    struct AVPacket;
+    struct AVFrame;
+}
+
+struct ResamplerKey {
+    uint64_t inLayout = 0;
+    int inFormat = 0;
+    int inRate = 0;
+    uint64_t outLayout = 0;
+    int outFormat = 0;
+    int outRate = 0;
+
+    bool operator==(const ResamplerKey& o) const {
+        return inLayout == o.inLayout && inFormat == o.inFormat && inRate == o.inRate &&
+               outLayout == o.outLayout && outFormat == o.outFormat && outRate == o.outRate;
+    }
+};
+
+// Threading an AVCodecContext was opened with, as requested (thread_count
+// and thread_type before avcodec_open2(); threadType 0 when single-threaded).
+struct CodecKey {
+    int threadCount = 1;
+    int threadType = 0;
+
+    bool operator==(const CodecKey& o) const {
+        return threadCount == o.threadCount && threadType == o.threadType;
+    }
+};
+
+class DecoderPool {
+public:
+    static DecoderPool& instance();
+
+    // Fresh objects if none are idle; nullptr only on allocation failure.
+    AVPacket* acquirePacket();
+    AVFrame* acquireFrame();
+    void releasePacket(AVPacket* packet);
+    void releaseFrame(AVFrame* frame);
+
+    // An initialised resampler for `key`, or nullptr (caller allocates).
+    SwrContext* acquireResampler(const ResamplerKey& key);
+    void releaseResampler(const ResamplerKey& key, SwrContext* swr);
+
+    // An opened, flushed codec context matching `params` and `key`, or
+    // nullptr (caller allocates and opens).
+    AVCodecContext* acquireCodec(const AVCodecParameters* params, const CodecKey& key);
+    // Keep an opened context for reuse; `params` describes the stream it was
+    // opened for, `key` the threading requested. Unopened contexts are freed.
+    void releaseCodec(AVCodecContext* ctx, const AVCodecParameters* params, const CodecKey& key);
+
+    // Free all idle objects.
+    void clear();
+
+    struct Stats {
+        uint64_t codecReused = 0;
+        uint64_t codecCreated = 0;
+        uint64_t resamplerReused = 0;
+        uint64_t resamplerCreated = 0;
+    };
+    Stats stats() const;
+
+    static constexpr size_t kMaxIdleFrames = 8;      // per list (packets, frames)
+    static constexpr size_t kMaxIdleResamplers = 4;
+    static constexpr size_t kMaxIdleCodecs = 4;
+
+private:
+    DecoderPool() = default;
+    ~DecoderPool();
+    DecoderPool(const DecoderPool&) = delete;
+    DecoderPool& operator=(const DecoderPool&) = delete;
+
+    struct IdleResampler {
+        ResamplerKey key;
+        SwrContext* swr;
+    };
+    struct IdleCodec {
+        AVCodecContext* ctx;
+        AVCodecParameters* params;   // owned copy
+        CodecKey key;
+    };
+
+    void freeCodec(IdleCodec& idle);
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<AVPacket*> packets_;
+    std::vector<AVFrame*> frames_;
+    std::deque<IdleResampler> resamplers_;   // oldest first
+    std::deque<IdleCodec> codecs_;           // oldest first
+    Stats stats_;
+};
@@ -6,8 +6,13 @@
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <thread>
 
 #include "ffmpeg_decoder.h"
+#include "decoder_pool.h"
+#include "pcm_convert.h"
+#include "../io/staging_cache.h"
+#include "../io/mapped_file.h"
 #include "../utils/logger.h"
 
 extern "C" {
@@ -17,8 +22,19 @@ extern "C" {
 #include <libavutil/opt.h>
 #include <libavutil/channel_layout.h>
 #include <libavutil/samplefmt.h>
+#include <libavformat/avio.h>
 }
 
+// avio buffer size for the mmap-backed context. Each refill is a memcpy from
+// the mapping, so a moderate size keeps the copy cache-resident.
+static constexpr int kMappedIOBufferSize = 64 * 1024;
+
+// Playback only threads a codec when one core may struggle: more than
+// stereo 192 kHz worth of samples per second.
+static constexpr int kHeavyStreamRate = 2 * 192000;
+static constexpr int kPlaybackCodecThreads = 2;
+static constexpr int kMaxOfflineCodecThreads = 16;
+
 static std::string ffmpegErrStr(int errnum) {
     char buf[256];
     av_strerror(errnum, buf, sizeof(buf));
@@ -34,9 +50,15 @@ FFmpegDecoder::FFmpegDecoder()
       audio_stream_index_(-1),
       out_sample_rate_(0),
       out_channels_(0),
-      out_sample_fmt_(AV_SAMPLE_FMT_S16),
+      out_sample_fmt_(AV_SAMPLE_FMT_FLT),
       out_channel_layout_(0),
-      eof_(false)
+      eof_(false),
+      resync_(false),
+      next_position_(0),
+      decode_position_(-1),
+      use_mapped_io_(true),
+      avio_ctx_(nullptr),
+      use_pool_(true)
 {
 }
 
@@ -47,7 +69,15 @@ FFmpegDecoder::~FFmpegDecoder() {
 bool FFmpegDecoder::open(const std::string& filepath) {
     cleanup();
 
-    int ret = avformat_open_input(&fmt_ctx_, filepath.c_str(), nullptr, nullptr);
+    std::string source = resolveSource(filepath);
+
+    // Mapping a file on a network mount would turn page faults into
+    // synchronous round trips; let avformat's buffered reads handle those.
+    if (use_mapped_io_ && !StagingCache::isSlowPath(source)) {
+        initMappedIO(source);
+    }
+
+    int ret = avformat_open_input(&fmt_ctx_, source.c_str(), nullptr, nullptr);
     if (ret < 0) {
         Logger::instance().log(LogLevel::ERROR, std::string("FFmpegDecoder: avformat_open_input failed: ") + ffmpegErrStr(ret));
         cleanup();
@@ -68,7 +98,8 @@ bool FFmpegDecoder::open(const std::string& filepath) {
         return false;
     }
 
-    AVCodecParameters* codecpar = fmt_ctx_->streams[audio_stream_index_]->codecpar;
+    AVStream* stream = fmt_ctx_->streams[audio_stream_index_];
+    AVCodecParameters* codecpar = stream->codecpar;
     const AVCodec* codec = avcodec_find_decoder(codecpar->codec_id);
     if (!codec) {
         Logger::instance().log(LogLevel::ERROR, "FFmpegDecoder: Unsupported codec");
@@ -76,25 +107,44 @@ bool FFmpegDecoder::open(const std::string& filepath) {
         return false;
     }
 
-    codec_ctx_ = avcodec_alloc_context3(codec);
-    if (!codec_ctx_) {
-        Logger::instance().log(LogLevel::ERROR, "FFmpegDecoder: avcodec_alloc_context3 failed");
-        cleanup();
-        return false;
+    int threadType = 0;
+    int threads = chooseCodecThreads(codec, codecpar, &threadType);
+    codec_key_.threadCount = threads;
+    codec_key_.threadType = threads > 1 ? threadType : 0;
+    if (use_pool_) {
+        codec_ctx_ = DecoderPool::instance().acquireCodec(codecpar, codec_key_);
+        if (codec_ctx_) {
+            codec_ctx_->pkt_timebase = stream->time_base;
+        }
     }
 
-    ret = avcodec_parameters_to_context(codec_ctx_, codecpar);
-    if (ret < 0) {
-        Logger::instance().log(LogLevel::ERROR, std::string("FFmpegDecoder: avcodec_parameters_to_context failed: ") + ffmpegErrStr(ret));
-        cleanup();
-        return false;
-    }
+    if (!codec_ctx_) {
+        codec_ctx_ = avcodec_alloc_context3(codec);
+        if (!codec_ctx_) {
+            Logger::instance().log(LogLevel::ERROR, "FFmpegDecoder: avcodec_alloc_context3 failed");
+            cleanup();
+            return false;
+        }
 
-    ret = avcodec_open2(codec_ctx_, codec, nullptr);
-    if (ret < 0) {
-        Logger::instance().log(LogLevel::ERROR, std::string("FFmpegDecoder: avcodec_open2 failed: ") + ffmpegErrStr(ret));
-        cleanup();
-        return false;
+        ret = avcodec_parameters_to_context(codec_ctx_, codecpar);
+        if (ret < 0) {
+            Logger::instance().log(LogLevel::ERROR, std::string("FFmpegDecoder: avcodec_parameters_to_context failed: ") + ffmpegErrStr(ret));
+            cleanup();
+            return false;
+        }
+        codec_ctx_->pkt_timebase = stream->time_base;
+
+        codec_ctx_->thread_count = threads;
+        if (threads > 1) {
+            codec_ctx_->thread_type = threadType;
+        }
+
+        ret = avcodec_open2(codec_ctx_, codec, nullptr);
+        if (ret < 0) {
+            Logger::instance().log(LogLevel::ERROR, std::string("FFmpegDecoder: avcodec_open2 failed: ") + ffmpegErrStr(ret));
+            cleanup();
+            return false;
+        }
     }
 
     out_sample_rate_ = codec_ctx_->sample_rate > 0 ? codec_ctx_->sample_rate : 44100;
@@ -106,8 +156,8 @@ bool FFmpegDecoder::open(const std::string& filepath) {
         out_channel_layout_ = codec_ctx_->channel_layout;
     }
 
-    packet_ = av_packet_alloc();
-    frame_ = av_frame_alloc();
+    packet_ = use_pool_ ? DecoderPool::instance().acquirePacket() : av_packet_alloc();
+    frame_ = use_pool_ ? DecoderPool::instance().acquireFrame() : av_frame_alloc();
     if (!packet_ || !frame_) {
         Logger::instance().log(LogLevel::ERROR, "FFmpegDecoder: packet/frame allocation failed");
         cleanup();
@@ -121,12 +171,102 @@ bool FFmpegDecoder::open(const std::string& filepath) {
     }
 
     eof_ = false;
+    resync_ = false;
+    next_position_ = 0;
+    decode_position_ = -1;
 
-    std::string msg = std::string("FFmpegDecoder: Opened successfully. SR=") + std::to_string(out_sample_rate_) + std::string(" CH=") + std::to_string(out_channels_);
+    std::string msg = std::string("FFmpegDecoder: Opened successfully. SR=") + std::to_string(out_sample_rate_) + std::string(" CH=") + std::to_string(out_channels_) +
+        " codec=" + codec->name + " threads=" + std::to_string(getCodecThreads());
     Logger::instance().log(LogLevel::INFO, msg);
     return true;
 }
 
+// -----------------------------
+// Codec threading
+// -----------------------------
+
+// Codecs whose per-packet work is too small for threading to pay for its
+// synchronisation. FFmpeg numbers PCM from 0x10000 and ADPCM from 0x11000.
+static bool isCheapCodec(AVCodecID id) {
+    return id >= AV_CODEC_ID_PCM_S16LE && id < AV_CODEC_ID_AMR_NB;
+}
+
+int FFmpegDecoder::chooseCodecThreads(const AVCodec* codec, const AVCodecParameters* params, int* threadType) const {
+    const bool frameThreads = (codec->capabilities & AV_CODEC_CAP_FRAME_THREADS) != 0;
+    const bool sliceThreads = (codec->capabilities & AV_CODEC_CAP_SLICE_THREADS) != 0;
+
+    int threads = 1;
+    if (threads_ > 0) {
+        threads = threads_;
+    } else if ((frameThreads || sliceThreads) && !isCheapCodec(codec->id)) {
+        if (workload_ == DecodeWorkload::Offline) {
+            unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+            threads = static_cast<int>(std::min<unsigned>(cores, kMaxOfflineCodecThreads));
+        } else if (params->sample_rate * std::max(1, params->channels) > kHeavyStreamRate) {
+            threads = kPlaybackCodecThreads;
+        }
+    }
+
+    // Frame threading adds one packet of delay per thread; playback
+    // prefers slice threading when the codec has it.
+    bool preferSlice = workload_ == DecodeWorkload::Playback ? sliceThreads : !frameThreads;
+    *threadType = preferSlice ? FF_THREAD_SLICE : FF_THREAD_FRAME;
+    return threads;
+}
+
+int FFmpegDecoder::getCodecThreads() const {
+    if (!codec_ctx_ || codec_ctx_->thread_count < 1 || !codec_ctx_->active_thread_type) {
+        return 1;
+    }
+    return codec_ctx_->thread_count;
+}
+
+// -----------------------------
+// mmap-backed AVIOContext callbacks
+// -----------------------------
+static int mappedRead(void* opaque, uint8_t* buf, int buf_size) {
+    MappedFile* file = static_cast<MappedFile*>(opaque);
+    size_t n = file->read(buf, static_cast<size_t>(buf_size));
+    return n > 0 ? static_cast<int>(n) : AVERROR_EOF;
+}
+
+static int64_t mappedSeek(void* opaque, int64_t offset, int whence) {
+    MappedFile* file = static_cast<MappedFile*>(opaque);
+    if (whence & AVSEEK_SIZE) {
+        return static_cast<int64_t>(file->size());
+    }
+    int64_t pos = file->seek(offset, whence & ~AVSEEK_FORCE);
+    return pos >= 0 ? pos : AVERROR(EINVAL);
+}
+
+bool FFmpegDecoder::initMappedIO(const std::string& path) {
+    std::unique_ptr<MappedFile> file(new MappedFile());
+    if (!file->open(path)) {
+        return false;
+    }
+
+    unsigned char* buffer = static_cast<unsigned char*>(av_malloc(kMappedIOBufferSize));
+    if (!buffer) {
+        return false;
+    }
+    avio_ctx_ = avio_alloc_context(buffer, kMappedIOBufferSize, 0, file.get(), &mappedRead, nullptr, &mappedSeek);
+    if (!avio_ctx_) {
+        av_free(buffer);
+        return false;
+    }
+
+    fmt_ctx_ = avformat_alloc_context();
+    if (!fmt_ctx_) {
+        av_freep(&avio_ctx_->buffer);
+        avio_context_free(&avio_ctx_);
+        return false;
+    }
+    fmt_ctx_->pb = avio_ctx_;
+    fmt_ctx_->flags |= AVFMT_FLAG_CUSTOM_IO;
+    mapped_ = std::move(file);
+    return true;
+}
+
 bool FFmpegDecoder::initResampler() {
     uint64_t in_ch_layout = codec_ctx_->channel_layout;
     if (in_ch_layout == 0) {
@@ -135,6 +275,19 @@ bool FFmpegDecoder::initResampler() {
 
     uint64_t out_ch_layout = in_ch_layout;
 
+    swr_key_.inLayout = in_ch_layout;
+    swr_key_.inFormat = codec_ctx_->sample_fmt;
+    swr_key_.inRate = codec_ctx_->sample_rate;
+    swr_key_.outLayout = out_ch_layout;
+    swr_key_.outFormat = out_sample_fmt_;
+    swr_key_.outRate = out_sample_rate_;
+    if (use_pool_) {
+        swr_ctx_ = DecoderPool::instance().acquireResampler(swr_key_);
+        if (swr_ctx_) {
+            return true;
+        }
+    }
+
     swr_ctx_ = swr_alloc_set_opts(
         nullptr,
         out_ch_layout,
@@ -161,7 +314,47 @@ bool FFmpegDecoder::initResampler() {
     return true;
 }
 
+// Append `count` resampler output samples (float) to the caller's buffer.
+static void appendSamples(std::vector<float>& out, const float* src, int count) {
+    out.insert(out.end(), src, src + count);
+}
+
+static void appendSamples(std::vector<int16_t>& out, const float* src, int count) {
+    size_t start = out.size();
+    out.resize(start + static_cast<size_t>(count));
+    convertFloatToS16(src, out.data() + start, static_cast<size_t>(count));
+}
+
 int FFmpegDecoder::decode(std::vector<int16_t>& out_buffer) {
+    return decodeSamples(out_buffer);
+}
+
+int FFmpegDecoder::decodeFloat(std::vector<float>& out_buffer) {
+    return decodeSamples(out_buffer);
+}
+
+int FFmpegDecoder::getSourceBits() const {
+    if (!codec_ctx_) return 16;
+    // Lossy codecs (MP3, AAC, Vorbis, Opus) decode to float with
+    // bits_per_raw_sample 0; their output is not 16-bit either.
+    switch (codec_ctx_->sample_fmt) {
+    case AV_SAMPLE_FMT_FLT:
+    case AV_SAMPLE_FMT_FLTP:
+        return 32;
+    case AV_SAMPLE_FMT_DBL:
+    case AV_SAMPLE_FMT_DBLP:
+        return 64;
+    default:
+        break;
+    }
+    if (codec_ctx_->bits_per_raw_sample > 16) {
+        return codec_ctx_->bits_per_raw_sample;
+    }
+    return 16;
+}
+
+template <typename Sample>
+int FFmpegDecoder::decodeSamples(std::vector<Sample>& out_buffer) {
     if (!fmt_ctx_ || !codec_ctx_ || !swr_ctx_ || !packet_ || !frame_) {
         return 0;
     }
@@ -181,6 +374,19 @@ int FFmpegDecoder::decode(std::vector<int16_t>& out_buffer) {
             }
             // Logger::instance().log(LogLevel::INFO, "FFmpegDecoder: avcodec_receive_frame got frame");
 
+            if (resync_) {
+                next_position_ = -1;
+                if (frame_->best_effort_timestamp != AV_NOPTS_VALUE) {
+                    const AVStream* stream = fmt_ctx_->streams[audio_stream_index_];
+                    int64_t start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+                    next_position_ = av_rescale_q(frame_->best_effort_timestamp - start, stream->time_base, AVRational{ 1, out_sample_rate_ });
+                }
+                resync_ = false;
+            }
+            if (totalSamplesAppended == 0) {
+                decode_position_ = next_position_;
+            }
+
             int max_out_samples = av_rescale_rnd(
                 swr_get_delay(swr_ctx_, codec_ctx_->sample_rate) + frame_->nb_samples,
                 out_sample_rate_, codec_ctx_->sample_rate, AV_ROUND_UP);
@@ -218,10 +424,11 @@ int FFmpegDecoder::decode(std::vector<int16_t>& out_buffer) {
             }
 
             int totalConvertedSamples = out_samples * out_channels_;
-            int16_t* samples16 = reinterpret_cast<int16_t*>(converted[0]);
-
-            out_buffer.insert(out_buffer.end(), samples16, samples16 + totalConvertedSamples);
+            appendSamples(out_buffer, reinterpret_cast<const float*>(converted[0]), totalConvertedSamples);
             totalSamplesAppended += totalConvertedSamples;
+            if (next_position_ >= 0) {
+                next_position_ += out_samples;
+            }
 
             av_freep(&converted[0]);
             av_freep(&converted);
@@ -261,11 +468,63 @@ int FFmpegDecoder::decode(std::vector<int16_t>& out_buffer) {
     }
 }
 
+bool FFmpegDecoder::seek(double seconds) {
+    discardBufferedFrames();
+    if (!fmt_ctx_ || !codec_ctx_ || !swr_ctx_ || seconds < 0.0) {
+        return false;
+    }
+    const AVStream* stream = fmt_ctx_->streams[audio_stream_index_];
+    int64_t start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    int64_t target = start + av_rescale_q(static_cast<int64_t>(seconds * AV_TIME_BASE), AVRational{ 1, AV_TIME_BASE }, stream->time_base);
+
+    int ret = av_seek_frame(fmt_ctx_, audio_stream_index_, target, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+        Logger::instance().log(LogLevel::ERROR, std::string("FFmpegDecoder: av_seek_frame failed: ") + ffmpegErrStr(ret));
+        return false;
+    }
+    avcodec_flush_buffers(codec_ctx_);
+    // Drop samples buffered by the resampler before the seek.
+    ret = swr_init(swr_ctx_);
+    if (ret < 0) {
+        Logger::instance().log(LogLevel::ERROR, std::string("FFmpegDecoder: swr_init failed: ") + ffmpegErrStr(ret));
+        return false;
+    }
+    eof_ = false;
+    resync_ = true;
+    next_position_ = -1;
+    return true;
+}
+
+double FFmpegDecoder::getDuration() const {
+    if (!fmt_ctx_ || fmt_ctx_->duration == AV_NOPTS_VALUE || fmt_ctx_->duration <= 0) {
+        return 0.0;
+    }
+    return static_cast<double>(fmt_ctx_->duration) / AV_TIME_BASE;
+}
+
 void FFmpegDecoder::close() {
+    discardBufferedFrames();
     cleanup();
 }
 
 void FFmpegDecoder::cleanup() {
+    if (use_pool_) {
+        // Hand everything reusable to the pool; the codec context needs the
+        // stream parameters it was opened with, so release it before fmt_ctx_.
+        DecoderPool& pool = DecoderPool::instance();
+        pool.releaseResampler(swr_key_, swr_ctx_);
+        pool.releaseFrame(frame_);
+        pool.releasePacket(packet_);
+        const AVCodecParameters* params = nullptr;
+        if (fmt_ctx_ && audio_stream_index_ >= 0 && audio_stream_index_ < static_cast<int>(fmt_ctx_->nb_streams)) {
+            params = fmt_ctx_->streams[audio_stream_index_]->codecpar;
+        }
+        pool.releaseCodec(codec_ctx_, params, codec_key_);
+        swr_ctx_ = nullptr;
+        frame_ = nullptr;
+        packet_ = nullptr;
+        codec_ctx_ = nullptr;
+    }
     if (swr_ctx_) {
         swr_free(&swr_ctx_);
         swr_ctx_ = nullptr;
@@ -286,5 +545,12 @@ void FFmpegDecoder::cleanup() {
         avformat_close_input(&fmt_ctx_);
         fmt_ctx_ = nullptr;
     }
+    // avformat does not free a caller-supplied AVIOContext (AVFMT_FLAG_CUSTOM_IO).
+    if (avio_ctx_) {
+        av_freep(&avio_ctx_->buffer);
+        avio_context_free(&avio_ctx_);
+        avio_ctx_ = nullptr;
+    }
+    mapped_.reset();
 }
 
@@ -4,33 +4,54 @@
 /**
  * ffmpeg_decoder.h
  *
- * FFmpeg-based decoder that exposes a simple C++ API used by Player.
+ * FFmpeg-based AudioDecoder (audio_decoder.h) used by Player for every format
+ * the native PcmDecoder does not handle.
  *
  * Public methods:
  *   - bool open(const std::string& filepath)
  *   - int decode(std::vector<int16_t>& out_buffer)
+ *   - int decodeFloat(std::vector<float>& out_buffer)
  *   - void close()
  *   - int getSampleRate() const
  *   - int getChannels() const
+ *   - double getDuration() const
+ *   - bool seek(double seconds)
+ *   - int64_t getDecodePosition() const
  *
  * Behavior:
  *   - Decoded and resampled audio is returned as interleaved signed 16-bit PCM
- *     samples in host endianness (int16_t).
+ *     samples in host endianness (int16_t) by decode(), or as float at the
+ *     codec's full resolution by decodeFloat().
  *   - decode(...) appends samples to the provided vector and returns number of
  *     samples appended (not frames). If 0 is returned, that indicates EOF or
  *     no samples available.
  *
  * Implementation notes (in .cpp):
  *   - Uses libavformat/libavcodec to demux and decode packets.
- *   - Uses libswresample (swr_convert) to convert to AV_SAMPLE_FMT_S16 interleaved,
- *     and to the desired sample rate / channel layout.
+ *   - Local files are demuxed through a custom AVIOContext that reads from an
+ *     mmap of the file (MappedFile) instead of avformat's own read() calls.
+ *   - Uses libswresample (swr_convert) to convert to AV_SAMPLE_FMT_FLT interleaved,
+ *     and to the desired sample rate / channel layout; decode() narrows the
+ *     float output to int16 (pcm_convert.h).
  *   - The output sample rate and channels are chosen to be the codec's native
  *     values by default (but you can change that part in code if you want a
  *     fixed output).
+ *   - Codec threading (thread_count / thread_type) follows the DecodeWorkload
+ *     set with setWorkload(): off for cheap codecs (PCM, ADPCM) and codecs
+ *     without threading support; for playback, slice threading (no added
+ *     latency) and at most two threads, only for high-rate multichannel
+ *     streams; for offline jobs, frame threading on every core.
+ *   - Codec contexts, resamplers, packets and frames are taken from and
+ *     returned to DecoderPool (decoder_pool.h), so opening the next track of
+ *     the same format skips most of the setup.
  */
 
+#include "audio_decoder.h"
+#include "decoder_pool.h"
+
 #include <string>
 #include <vector>
+#include <memory>
 #include <cstdint>
 
 // Forward declarations only; concrete FFmpeg headers stay in the .cpp so their
@@ -41,32 +62,87 @@ extern "C" {
     struct SwrContext;
     struct AVPacket;
     struct AVFrame;
+    struct AVIOContext;
+    struct AVCodec;
+    struct AVCodecParameters;
     // enum AVSampleFormat : int; // Removed to avoid forward declaration issues
 }
 
-class FFmpegDecoder {
+class MappedFile;    // io/mapped_file.h
+
+class FFmpegDecoder : public AudioDecoder {
 public:
     FFmpegDecoder();
-    ~FFmpegDecoder();
+    ~FFmpegDecoder() override;
 
     // Open the media file. Returns true on success.
-    bool open(const std::string& filepath);
+    // If a staging cache is attached and holds a complete local copy of
+    // `filepath`, the local copy is opened instead.
+    bool open(const std::string& filepath) override;
+
+    // Serve demuxer reads from an mmap of local files (default: on).
+    // Takes effect on the next open().
+    void setUseMappedIO(bool enable) { use_mapped_io_ = enable; }
+    bool isUsingMappedIO() const { return avio_ctx_ != nullptr; }
+
+    // Recycle FFmpeg objects through DecoderPool (default: on).
+    // Takes effect on the next open().
+    void setUsePool(bool enable) { use_pool_ = enable; }
 
     // Decode some audio and append interleaved int16 samples to out_buffer.
     // Returns number of int16 samples appended. 0 -> EOF or no more data.
-    int decode(std::vector<int16_t>& out_buffer);
+    int decode(std::vector<int16_t>& out_buffer) override;
+
+    // Same as decode(), without narrowing the resampler's float output.
+    int decodeFloat(std::vector<float>& out_buffer) override;
 
     // Close and free resources.
-    void close();
+    void close() override;
 
     // Output parameters (after open)
-    int getSampleRate() const { return out_sample_rate_; }
-    int getChannels() const { return out_channels_; }
+    int getSampleRate() const override { return out_sample_rate_; }
+    int getChannels() const override { return out_channels_; }
+
+    // Container duration in seconds (0 if unknown).
+    double getDuration() const override;
+
+    const char* name() const override { return "ffmpeg"; }
+
+    // 32/64 for codecs that decode to float/double (MP3, AAC, Vorbis, Opus,
+    // ...), else the codec's bits_per_raw_sample when above 16 (24-bit
+    // ALAC/WavPack, ...).
+    int getSourceBits() const override;
+
+    // Codec threads in use after open() (1 = single-threaded).
+    int getCodecThreads() const;
+
+    // Seek to the last seekable point at or before `seconds` (container
+    // dependent; use getDecodePosition() to find where decoding resumed).
+    bool seek(double seconds) override;
+
+    // Output frame index, counted from the start of the stream, of the first
+    // sample appended by the most recent decode(). After a seek it comes from
+    // the decoded frame's timestamp; -1 if the stream has no timestamps.
+    int64_t getDecodePosition() const override { return decode_position_; }
 
 private:
+    // Body of decode() / decodeFloat(): decode packets until some samples
+    // come out of the resampler and append them to out_buffer.
+    template <typename Sample>
+    int decodeSamples(std::vector<Sample>& out_buffer);
+
+    // Codec thread_count (and *threadType when > 1) for a stream, from
+    // workload_, threads_ and the codec's capabilities.
+    int chooseCodecThreads(const AVCodec* codec, const AVCodecParameters* params, int* threadType) const;
+
     // Initialize (allocate) resampler based on codecCtx_.
     bool initResampler();
 
+    // Map `path` and attach a custom AVIOContext to a fresh fmt_ctx_.
+    // Returns false if the file cannot be mapped (caller falls back to
+    // avformat's own I/O).
+    bool initMappedIO(const std::string& path);
+
     // Internal cleanup helper
     void cleanup();
 
@@ -82,10 +158,22 @@ private:
     // Output format parameters (we resample to these)
     int out_sample_rate_;        // e.g., 44100
     int out_channels_;           // e.g., 2
-    int out_sample_fmt_;         // AV_SAMPLE_FMT_S16 (stored as int to avoid header dependency)
+    int out_sample_fmt_;         // AV_SAMPLE_FMT_FLT (stored as int to avoid header dependency)
     uint64_t out_channel_layout_;   // channel layout mask
 
     bool eof_;                   // end-of-file reached flag
+
+    bool resync_;                // take next_position_ from the next frame's timestamp
+    int64_t next_position_;      // output frame index of the next converted sample (-1 = unknown)
+    int64_t decode_position_;    // see getDecodePosition()
+
+    bool use_mapped_io_;                 // prefer mmap-backed I/O for local files
+    std::unique_ptr<MappedFile> mapped_; // mapping behind avio_ctx_
+    AVIOContext* avio_ctx_;              // custom I/O context (nullptr = avformat I/O)
+
+    bool use_pool_;              // recycle objects through DecoderPool
+    ResamplerKey swr_key_;       // DecoderPool key of swr_ctx_
+    CodecKey codec_key_;         // DecoderPool key of codec_ctx_ (threading requested at open)
 };
 
 #endif // FFMPEG_DECODER_H
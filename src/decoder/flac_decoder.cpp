@@ -0,0 +1,331 @@
+/**
+ * flac_decoder.cpp
+ *
+ * Metadata parsing, sequential/parallel decode and sample-exact seeking for
+ * FlacDecoder. Frame-level work lives in flac_frame.cpp.
+ */
+
+#include "flac_decoder.h"
+#include "../utils/logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+static uint32_t be24(const uint8_t* p) { return (static_cast<uint32_t>(p[0]) << 16) | (p[1] << 8) | p[2]; }
+static uint32_t be32(const uint8_t* p) { return (be24(p) << 8) | p[3]; }
+static uint64_t be64(const uint8_t* p) { return (static_cast<uint64_t>(be32(p)) << 32) | be32(p + 4); }
+
+// Smallest byte range decodeAll() hands to one worker.
+static constexpr size_t kMinParallelRange = 256 * 1024;
+
+FlacDecoder::FlacDecoder()
+    : first_frame_(0),
+      next_offset_(0),
+      skip_(0),
+      decode_position_(-1),
+      interleave_(selectFlacInterleave(0))
+{}
+
+FlacDecoder::~FlacDecoder() {
+    close();
+}
+
+bool FlacDecoder::open(const std::string& filepath) {
+    close();
+
+    std::string source = resolveSource(filepath);
+    if (!file_.open(source)) {
+        Logger::instance().log(LogLevel::ERROR, "FlacDecoder: cannot map " + source);
+        return false;
+    }
+    if (!parseMetadata()) {
+        Logger::instance().log(LogLevel::INFO, "FlacDecoder: not a supported FLAC stream: " + source);
+        close();
+        return false;
+    }
+
+    frame_.reserve(info_.channels, info_.maxBlockSize);
+    interleave_ = selectFlacInterleave(info_.channels);
+    next_offset_ = first_frame_;
+    file_.seek(static_cast<int64_t>(first_frame_), SEEK_SET);
+
+    Logger::instance().log(LogLevel::INFO, "FlacDecoder: Opened successfully. SR=" + std::to_string(info_.sampleRate) +
+        " CH=" + std::to_string(info_.channels) + " bps=" + std::to_string(info_.bitsPerSample) +
+        " seekpoints=" + std::to_string(seek_table_.size()));
+    return true;
+}
+
+bool FlacDecoder::parseMetadata() {
+    const uint8_t* d = file_.data();
+    const size_t size = file_.size();
+    size_t pos = 0;
+
+    // Skip an ID3v2 tag (syncsafe size, optional footer).
+    if (size >= 10 && std::memcmp(d, "ID3", 3) == 0) {
+        size_t tag = (static_cast<size_t>(d[6] & 0x7F) << 21) | ((d[7] & 0x7F) << 14) | ((d[8] & 0x7F) << 7) | (d[9] & 0x7F);
+        pos = 10 + tag + ((d[5] & 0x10) ? 10 : 0);
+    }
+    if (pos + 4 > size || std::memcmp(d + pos, "fLaC", 4) != 0) return false;
+    pos += 4;
+
+    bool haveInfo = false;
+    bool last = false;
+    while (!last && pos + 4 <= size) {
+        last = (d[pos] & 0x80) != 0;
+        uint32_t type = d[pos] & 0x7F;
+        uint32_t length = be24(d + pos + 1);
+        const uint8_t* body = d + pos + 4;
+        if (pos + 4 + length > size) return false;
+
+        if (type == 0 && length >= 34) {
+            info_.minBlockSize = (body[0] << 8) | body[1];
+            info_.maxBlockSize = (body[2] << 8) | body[3];
+            info_.minFrameSize = be24(body + 4);
+            info_.maxFrameSize = be24(body + 7);
+            info_.sampleRate = (static_cast<uint32_t>(body[10]) << 12) | (body[11] << 4) | (body[12] >> 4);
+            info_.channels = ((body[12] >> 1) & 7) + 1;
+            info_.bitsPerSample = (((body[12] & 1) << 4) | (body[13] >> 4)) + 1;
+            info_.totalSamples = (static_cast<uint64_t>(body[13] & 0x0F) << 32) | be32(body + 14);
+            haveInfo = true;
+        } else if (type == 3) {
+            for (uint32_t i = 0; i + 18 <= length; i += 18) {
+                uint64_t sample = be64(body + i);
+                if (sample == ~0ULL) continue;   // placeholder
+                seek_table_.push_back({ sample, be64(body + i + 8) });
+            }
+        }
+        pos += 4 + length;
+    }
+
+    first_frame_ = pos;
+    return haveInfo && last && info_.sampleRate > 0 && info_.maxBlockSize >= 16 &&
+           info_.bitsPerSample >= 4 && info_.bitsPerSample <= 24 && first_frame_ < size;
+}
+
+size_t FlacDecoder::decodeFrameAt(size_t offset) {
+    return decodeFlacFrame(file_.data() + offset, file_.size() - offset, info_, header_, frame_);
+}
+
+// -----------------------------
+// decode()
+// -----------------------------
+int FlacDecoder::decode(std::vector<int16_t>& out_buffer) {
+    size_t offset = 0;
+    size_t frames = nextFrame(offset);
+    if (frames == 0) return 0;
+    size_t start = out_buffer.size();
+    out_buffer.resize(start + frames * info_.channels);
+    interleave_.toS16(frame_, info_.channels, info_.bitsPerSample, offset, frames, out_buffer.data() + start);
+    return static_cast<int>(frames * info_.channels);
+}
+
+int FlacDecoder::decodeFloat(std::vector<float>& out_buffer) {
+    size_t offset = 0;
+    size_t frames = nextFrame(offset);
+    if (frames == 0) return 0;
+    size_t start = out_buffer.size();
+    out_buffer.resize(start + frames * info_.channels);
+    interleave_.toFloat(frame_, info_.channels, info_.bitsPerSample, offset, frames, out_buffer.data() + start);
+    return static_cast<int>(frames * info_.channels);
+}
+
+size_t FlacDecoder::nextFrame(size_t& offset) {
+    const size_t size = file_.size();
+    while (file_.isOpen() && next_offset_ < size) {
+        size_t len = decodeFrameAt(next_offset_);
+        if (len == 0) {
+            // Corrupt frame or trailing garbage: resync on the next header.
+            size_t next = findFlacFrame(file_.data(), size, next_offset_ + 1, info_, header_);
+            if (next < size) {
+                Logger::instance().log(LogLevel::WARNING, "FlacDecoder: skipped corrupt data at byte " + std::to_string(next_offset_));
+            }
+            next_offset_ = next;
+            continue;
+        }
+
+        // Keep the mapping's readahead window in step with decoding.
+        if (file_.tell() != next_offset_) file_.seek(static_cast<int64_t>(next_offset_), SEEK_SET);
+        size_t consumed = len;
+        file_.consume(consumed);
+        next_offset_ += len;
+
+        if (skip_ >= header_.blockSize) {
+            skip_ -= header_.blockSize;
+            continue;
+        }
+        size_t frames = header_.blockSize - skip_;
+        offset = skip_;
+        decode_position_ = static_cast<int64_t>(header_.firstSample + skip_);
+        skip_ = 0;
+        return frames;
+    }
+    return 0;
+}
+
+double FlacDecoder::getDuration() const {
+    return info_.sampleRate ? static_cast<double>(info_.totalSamples) / info_.sampleRate : 0.0;
+}
+
+void FlacDecoder::close() {
+    discardBufferedFrames();
+    file_.close();
+    info_ = FlacStreamInfo();
+    seek_table_.clear();
+    first_frame_ = 0;
+    next_offset_ = 0;
+    skip_ = 0;
+    decode_position_ = -1;
+}
+
+// -----------------------------
+// Seeking
+// -----------------------------
+bool FlacDecoder::seek(double seconds) {
+    if (!file_.isOpen() || seconds < 0.0) return false;
+    return seekToSample(static_cast<uint64_t>(std::llround(seconds * info_.sampleRate)));
+}
+
+bool FlacDecoder::seekToSample(uint64_t target) {
+    discardBufferedFrames();
+    if (!file_.isOpen()) return false;
+    const uint8_t* d = file_.data();
+    const size_t size = file_.size();
+    if (info_.totalSamples && target >= info_.totalSamples) {
+        if (target > info_.totalSamples) return false;
+        next_offset_ = size;
+        skip_ = 0;
+        return true;
+    }
+
+    // 1. Closest preceding SEEKTABLE point that lands on a real frame.
+    size_t lo = first_frame_;
+    for (const SeekPoint& point : seek_table_) {
+        if (point.sample > target) break;
+        size_t offset = first_frame_ + static_cast<size_t>(point.offset);
+        FlacFrameHeader h;
+        if (offset < size && parseFlacFrameHeader(d + offset, size - offset, info_, h) && h.firstSample <= target) {
+            lo = offset;
+        }
+    }
+
+    // 2. Bisect the remaining byte range on frame-header sample numbers.
+    //    Candidates are confirmed by a full decode (CRC-16) so a false sync
+    //    inside frame data cannot move `lo` past the target.
+    const size_t window = std::max<size_t>(info_.maxFrameSize ? info_.maxFrameSize * 2 : 0, 64 * 1024);
+    size_t hi = size;
+    while (hi - lo > window) {
+        size_t mid = lo + (hi - lo) / 2;
+        FlacFrameHeader h;
+        size_t offset = findFlacFrame(d, hi, mid, info_, h);
+        if (offset >= hi) {
+            hi = mid;
+        } else if (h.firstSample <= target && decodeFrameAt(offset) != 0) {
+            lo = offset;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // 3. Walk forward to the frame containing the target.
+    size_t offset = lo;
+    while (offset < size) {
+        size_t len = decodeFrameAt(offset);
+        if (len == 0) {
+            offset = findFlacFrame(d, size, offset + 1, info_, header_);
+            continue;
+        }
+        if (header_.firstSample + header_.blockSize > target) {
+            if (header_.firstSample > target) return false;   // gap in the stream
+            next_offset_ = offset;
+            skip_ = static_cast<size_t>(target - header_.firstSample);
+            file_.seek(static_cast<int64_t>(offset), SEEK_SET);
+            return true;
+        }
+        offset += len;
+    }
+    return false;
+}
+
+// -----------------------------
+// decodeAll(): frame-parallel offline decode
+// -----------------------------
+bool FlacDecoder::decodeAll(std::vector<int16_t>& out, unsigned threads) {
+    if (!file_.isOpen()) return false;
+    const uint8_t* d = file_.data();
+    const size_t size = file_.size();
+    const uint32_t channels = info_.channels;
+    const FlacInterleaveS16Fn interleave = selectFlacInterleave(channels).toS16;
+    out.clear();
+
+    if (info_.totalSamples == 0) {
+        // Unknown length: output positions are not known up front.
+        FlacFrameBuffer buffer;
+        buffer.reserve(channels, info_.maxBlockSize);
+        FlacFrameHeader h;
+        size_t offset = first_frame_;
+        while (offset < size) {
+            size_t len = decodeFlacFrame(d + offset, size - offset, info_, h, buffer);
+            if (len == 0) {
+                offset = findFlacFrame(d, size, offset + 1, info_, h);
+                continue;
+            }
+            size_t start = out.size();
+            out.resize(start + static_cast<size_t>(h.blockSize) * channels);
+            interleave(buffer, channels, info_.bitsPerSample, 0, h.blockSize, out.data() + start);
+            offset += len;
+        }
+        return !out.empty();
+    }
+
+    out.assign(static_cast<size_t>(info_.totalSamples) * channels, 0);
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t bytes = size - first_frame_;
+    const unsigned workers = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, bytes / kMinParallelRange)));
+
+    std::atomic<uint64_t> written(0);
+    auto worker = [&](unsigned w) {
+        size_t begin = first_frame_ + bytes * w / workers;
+        size_t end = first_frame_ + bytes * (w + 1) / workers;
+        FlacFrameBuffer buffer;
+        buffer.reserve(channels, info_.maxBlockSize);
+        FlacFrameHeader h;
+        uint64_t local = 0;
+
+        size_t offset = w == 0 ? begin : findFlacFrame(d, size, begin, info_, h);
+        while (offset < end) {
+            size_t len = decodeFlacFrame(d + offset, size - offset, info_, h, buffer);
+            if (len == 0) {
+                offset = findFlacFrame(d, size, offset + 1, info_, h);
+                continue;
+            }
+            uint64_t frames = std::min<uint64_t>(h.blockSize, info_.totalSamples > h.firstSample ? info_.totalSamples - h.firstSample : 0);
+            if (frames) {
+                interleave(buffer, channels, info_.bitsPerSample, 0, static_cast<size_t>(frames),
+                           out.data() + h.firstSample * channels);
+                local += frames;
+            }
+            offset += len;
+        }
+        written += local;
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned w = 1; w < workers; ++w) {
+        pool.emplace_back(worker, w);
+    }
+    worker(0);
+    for (auto& th : pool) {
+        th.join();
+    }
+
+    if (written.load() != info_.totalSamples) {
+        Logger::instance().log(LogLevel::WARNING, "FlacDecoder: decodeAll recovered " + std::to_string(written.load()) +
+            " of " + std::to_string(info_.totalSamples) + " samples");
+        return false;
+    }
+    return true;
+}
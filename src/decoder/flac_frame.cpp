@@ -0,0 +1,599 @@
+/*
+ flac_frame.cpp
+
+ FLAC frame decoding. See flac_frame.h for the structure and hot paths.
+ Bitstream reference: RFC 9639 (Free Lossless Audio Codec).
+*/
+
+#include "flac_frame.h"
+#include "bit_reader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define FLAC_USE_SSE2 1
+#include <emmintrin.h>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define FLAC_USE_NEON 1
+#include <arm_neon.h>
+#endif
+
+// -----------------------------
+// CRC-8 (poly 0x07) / CRC-16 (poly 0x8005), MSB first
+// -----------------------------
+struct FlacCrcTables {
+    uint8_t crc8[256];
+    uint16_t crc16[256];
+
+    FlacCrcTables() {
+        for (int i = 0; i < 256; ++i) {
+            uint8_t c8 = static_cast<uint8_t>(i);
+            uint16_t c16 = static_cast<uint16_t>(i << 8);
+            for (int b = 0; b < 8; ++b) {
+                c8 = static_cast<uint8_t>((c8 & 0x80) ? (c8 << 1) ^ 0x07 : (c8 << 1));
+                c16 = static_cast<uint16_t>((c16 & 0x8000) ? (c16 << 1) ^ 0x8005 : (c16 << 1));
+            }
+            crc8[i] = c8;
+            crc16[i] = c16;
+        }
+    }
+};
+
+static const FlacCrcTables& crcTables() {
+    static const FlacCrcTables tables;
+    return tables;
+}
+
+static uint8_t crc8(const uint8_t* data, size_t n) {
+    const FlacCrcTables& t = crcTables();
+    uint8_t crc = 0;
+    for (size_t i = 0; i < n; ++i) crc = t.crc8[crc ^ data[i]];
+    return crc;
+}
+
+static uint16_t crc16(const uint8_t* data, size_t n) {
+    const FlacCrcTables& t = crcTables();
+    uint16_t crc = 0;
+    for (size_t i = 0; i < n; ++i) {
+        crc = static_cast<uint16_t>((crc << 8) ^ t.crc16[(crc >> 8) ^ data[i]]);
+    }
+    return crc;
+}
+
+// -----------------------------
+// SIMD helpers
+// -----------------------------
+// Unfold Rice values in place: u -> (u >> 1) ^ -(u & 1).
+static void unfoldResiduals(int32_t* data, size_t n) {
+    size_t i = 0;
+#if defined(FLAC_USE_SSE2)
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+        __m128i u = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i sign = _mm_sub_epi32(zero, _mm_and_si128(u, one));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(_mm_srli_epi32(u, 1), sign));
+    }
+#elif defined(FLAC_USE_NEON)
+    const uint32x4_t one = vdupq_n_u32(1);
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t u = vld1q_u32(reinterpret_cast<const uint32_t*>(data + i));
+        int32x4_t sign = vnegq_s32(vreinterpretq_s32_u32(vandq_u32(u, one)));
+        vst1q_s32(data + i, veorq_s32(vreinterpretq_s32_u32(vshrq_n_u32(u, 1)), sign));
+    }
+#endif
+    for (; i < n; ++i) {
+        uint32_t u = static_cast<uint32_t>(data[i]);
+        data[i] = static_cast<int32_t>((u >> 1) ^ (0u - (u & 1)));
+    }
+}
+
+#if defined(FLAC_USE_SSE2)
+static inline __m128i mullo32(__m128i a, __m128i b) {
+#ifdef __SSE4_1__
+    return _mm_mullo_epi32(a, b);
+#else
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+#endif
+
+// -----------------------------
+// Prediction
+// -----------------------------
+static void restoreFixed(int32_t* s, size_t n, uint32_t order) {
+    switch (order) {
+        case 0:
+            break;
+        case 1:
+            for (size_t i = 1; i < n; ++i) s[i] += s[i - 1];
+            break;
+        case 2:
+            for (size_t i = 2; i < n; ++i) s[i] += 2 * s[i - 1] - s[i - 2];
+            break;
+        case 3:
+            for (size_t i = 3; i < n; ++i) s[i] += 3 * (s[i - 1] - s[i - 2]) + s[i - 3];
+            break;
+        case 4:
+            for (size_t i = 4; i < n; ++i) s[i] += 4 * (s[i - 1] + s[i - 3]) - 6 * s[i - 2] - s[i - 4];
+            break;
+    }
+}
+
+// 32-bit LPC, four outputs per step.
+//   p[i+m] = sum_j c[j] * s[i+m-1-j],  m = 0..3
+// For tap j, lanes m <= j read samples that are final before the step;
+// they are accumulated as one 4-lane multiply-add per tap with lanes m > j
+// masked to zero. The masked terms (c[j] * s[i..i+2]) are added serially.
+static void restoreLpc32(int32_t* s, size_t n, const int32_t* c, uint32_t order, int shift) {
+    size_t i = order;
+#if defined(FLAC_USE_SSE2) || defined(FLAC_USE_NEON)
+    alignas(16) int32_t taps[32][4];
+    for (uint32_t j = 0; j < order; ++j) {
+        for (uint32_t m = 0; m < 4; ++m) taps[j][m] = m <= j ? c[j] : 0;
+    }
+    for (; i + 4 <= n; i += 4) {
+        alignas(16) int32_t v[4];
+#if defined(FLAC_USE_SSE2)
+        __m128i acc = _mm_setzero_si128();
+        for (uint32_t j = 0; j < order; ++j) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i - 1 - j));
+            acc = _mm_add_epi32(acc, mullo32(_mm_load_si128(reinterpret_cast<const __m128i*>(taps[j])), x));
+        }
+        _mm_store_si128(reinterpret_cast<__m128i*>(v), acc);
+#else
+        int32x4_t acc = vdupq_n_s32(0);
+        for (uint32_t j = 0; j < order; ++j) {
+            acc = vmlaq_s32(acc, vld1q_s32(taps[j]), vld1q_s32(s + i - 1 - j));
+        }
+        vst1q_s32(v, acc);
+#endif
+        int32_t c0 = c[0];
+        int32_t c1 = order > 1 ? c[1] : 0;
+        int32_t c2 = order > 2 ? c[2] : 0;
+        s[i]     += v[0] >> shift;
+        s[i + 1] += (v[1] + c0 * s[i]) >> shift;
+        s[i + 2] += (v[2] + c0 * s[i + 1] + c1 * s[i]) >> shift;
+        s[i + 3] += (v[3] + c0 * s[i + 2] + c1 * s[i + 1] + c2 * s[i]) >> shift;
+    }
+#endif
+    for (; i < n; ++i) {
+        int32_t sum = 0;
+        for (uint32_t j = 0; j < order; ++j) sum += c[j] * s[i - 1 - j];
+        s[i] += sum >> shift;
+    }
+}
+
+static void restoreLpc64(int32_t* s, size_t n, const int32_t* c, uint32_t order, int shift) {
+    for (size_t i = order; i < n; ++i) {
+        int64_t sum = 0;
+        for (uint32_t j = 0; j < order; ++j) sum += static_cast<int64_t>(c[j]) * s[i - 1 - j];
+        s[i] += static_cast<int32_t>(sum >> shift);
+    }
+}
+
+static int floorLog2(uint32_t v) {
+    return v ? 31 - __builtin_clz(v) : 0;
+}
+
+// -----------------------------
+// Subframes
+// -----------------------------
+static bool decodeResidual(BitReader& br, int32_t* out, uint32_t blockSize, uint32_t order) {
+    uint32_t method = br.read(2);
+    if (method > 1) return false;
+    const int paramBits = method == 0 ? 4 : 5;
+    const uint32_t escape = method == 0 ? 15 : 31;
+
+    uint32_t partitionOrder = br.read(4);
+    uint32_t perPartition = blockSize >> partitionOrder;
+    if ((perPartition << partitionOrder) != blockSize || perPartition < order) return false;
+
+    size_t i = order;
+    for (uint32_t p = 0; p < (1u << partitionOrder); ++p) {
+        uint32_t n = perPartition - (p == 0 ? order : 0);
+        uint32_t k = br.read(paramBits);
+        if (k == escape) {
+            int bits = static_cast<int>(br.read(5));
+            for (uint32_t j = 0; j < n; ++j) out[i + j] = br.readSigned(bits);
+        } else {
+            if (!br.readRice(reinterpret_cast<uint32_t*>(out + i), n, static_cast<int>(k))) return false;
+            unfoldResiduals(out + i, n);
+        }
+        i += n;
+    }
+    return !br.overrun();
+}
+
+static bool decodeSubframe(BitReader& br, int32_t* out, uint32_t blockSize, uint32_t bps) {
+    if (br.read(1) != 0) return false;
+    uint32_t type = br.read(6);
+    uint32_t wasted = 0;
+    if (br.read(1)) {
+        wasted = br.readUnary() + 1;
+        if (wasted >= bps) return false;
+        bps -= wasted;
+    }
+    const int width = static_cast<int>(bps);
+
+    if (type == 0) {
+        std::fill(out, out + blockSize, br.readSigned(width));
+    } else if (type == 1) {
+        for (uint32_t i = 0; i < blockSize; ++i) out[i] = br.readSigned(width);
+    } else if (type >= 8 && type <= 12) {
+        uint32_t order = type - 8;
+        if (order > blockSize) return false;
+        for (uint32_t i = 0; i < order; ++i) out[i] = br.readSigned(width);
+        if (!decodeResidual(br, out, blockSize, order)) return false;
+        restoreFixed(out, blockSize, order);
+    } else if (type >= 32) {
+        uint32_t order = type - 31;
+        if (order > blockSize) return false;
+        for (uint32_t i = 0; i < order; ++i) out[i] = br.readSigned(width);
+        uint32_t precision = br.read(4) + 1;
+        if (precision == 16) return false;
+        int shift = br.readSigned(5);
+        if (shift < 0) return false;
+        int32_t coefs[32];
+        for (uint32_t i = 0; i < order; ++i) coefs[i] = br.readSigned(static_cast<int>(precision));
+        if (!decodeResidual(br, out, blockSize, order)) return false;
+        if (bps + precision + static_cast<uint32_t>(floorLog2(order)) <= 32) {
+            restoreLpc32(out, blockSize, coefs, order, shift);
+        } else {
+            restoreLpc64(out, blockSize, coefs, order, shift);
+        }
+    } else {
+        return false;   // reserved
+    }
+
+    if (wasted) {
+        for (uint32_t i = 0; i < blockSize; ++i) {
+            out[i] = static_cast<int32_t>(static_cast<uint32_t>(out[i]) << wasted);
+        }
+    }
+    return !br.overrun();
+}
+
+// -----------------------------
+// FlacFrameBuffer
+// -----------------------------
+void FlacFrameBuffer::reserve(uint32_t channels, uint32_t maxBlockSize) {
+    stride_ = (static_cast<size_t>(maxBlockSize) + 3) & ~static_cast<size_t>(3);
+    samples_.assign(stride_ * channels, 0);
+}
+
+// -----------------------------
+// Frame header
+// -----------------------------
+bool parseFlacFrameHeader(const uint8_t* d, size_t size, const FlacStreamInfo& info, FlacFrameHeader& h) {
+    if (size < 6 || d[0] != 0xFF || (d[1] & 0xFE) != 0xF8) return false;
+    const bool variable = (d[1] & 1) != 0;
+    const uint32_t bsCode = d[2] >> 4;
+    const uint32_t srCode = d[2] & 0x0F;
+    const uint32_t chCode = d[3] >> 4;
+    const uint32_t ssCode = (d[3] >> 1) & 7;
+    if ((d[3] & 1) || bsCode == 0 || srCode == 15 || chCode > 10 || ssCode == 3) return false;
+
+    // Frame or sample number, UTF-8 style coding (up to 7 bytes).
+    size_t pos = 4;
+    uint8_t lead = d[pos++];
+    int extra;
+    uint64_t number;
+    if (!(lead & 0x80))              { number = lead;        extra = 0; }
+    else if ((lead & 0xE0) == 0xC0)  { number = lead & 0x1F; extra = 1; }
+    else if ((lead & 0xF0) == 0xE0)  { number = lead & 0x0F; extra = 2; }
+    else if ((lead & 0xF8) == 0xF0)  { number = lead & 0x07; extra = 3; }
+    else if ((lead & 0xFC) == 0xF8)  { number = lead & 0x03; extra = 4; }
+    else if ((lead & 0xFE) == 0xFC)  { number = lead & 0x01; extra = 5; }
+    else if (lead == 0xFE)           { number = 0;           extra = 6; }
+    else return false;
+    if (pos + extra > size) return false;
+    for (int i = 0; i < extra; ++i) {
+        uint8_t b = d[pos++];
+        if ((b & 0xC0) != 0x80) return false;
+        number = (number << 6) | (b & 0x3F);
+    }
+
+    uint32_t blockSize;
+    if (bsCode == 1)      blockSize = 192;
+    else if (bsCode <= 5) blockSize = 576u << (bsCode - 2);
+    else if (bsCode == 6) { if (pos + 1 > size) return false; blockSize = d[pos] + 1u; pos += 1; }
+    else if (bsCode == 7) { if (pos + 2 > size) return false; blockSize = ((d[pos] << 8) | d[pos + 1]) + 1u; pos += 2; }
+    else                  blockSize = 256u << (bsCode - 8);
+
+    static const uint32_t rates[] = { 0, 88200, 176400, 192000, 8000, 16000, 22050, 24000,
+                                      32000, 44100, 48000, 96000 };
+    uint32_t sampleRate;
+    if (srCode == 0)       sampleRate = info.sampleRate;
+    else if (srCode < 12)  sampleRate = rates[srCode];
+    else if (srCode == 12) { if (pos + 1 > size) return false; sampleRate = d[pos] * 1000u; pos += 1; }
+    else                   { if (pos + 2 > size) return false;
+                             sampleRate = ((d[pos] << 8) | d[pos + 1]) * (srCode == 14 ? 10u : 1u); pos += 2; }
+
+    static const uint32_t depths[] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+    uint32_t bps = ssCode == 0 ? info.bitsPerSample : depths[ssCode];
+
+    if (pos + 1 > size || crc8(d, pos) != d[pos]) return false;
+    pos += 1;
+
+    uint32_t channels = chCode < 8 ? chCode + 1 : 2;
+    if (channels != info.channels || bps != info.bitsPerSample || sampleRate != info.sampleRate ||
+        (info.maxBlockSize && blockSize > info.maxBlockSize)) {
+        return false;
+    }
+
+    h.blockSize = blockSize;
+    h.sampleRate = sampleRate;
+    h.channels = channels;
+    h.channelAssignment = chCode;
+    h.bitsPerSample = bps;
+    h.firstSample = variable ? number : number * info.maxBlockSize;
+    h.headerBytes = pos;
+    return true;
+}
+
+size_t findFlacFrame(const uint8_t* data, size_t size, size_t offset, const FlacStreamInfo& info, FlacFrameHeader& header) {
+    while (offset + 1 < size) {
+        const void* hit = std::memchr(data + offset, 0xFF, size - offset - 1);
+        if (!hit) break;
+        offset = static_cast<size_t>(static_cast<const uint8_t*>(hit) - data);
+        if ((data[offset + 1] & 0xFE) == 0xF8 &&
+            parseFlacFrameHeader(data + offset, size - offset, info, header)) {
+            return offset;
+        }
+        ++offset;
+    }
+    return size;
+}
+
+// -----------------------------
+// Frame decode
+// -----------------------------
+size_t decodeFlacFrame(const uint8_t* data, size_t size, const FlacStreamInfo& info,
+                       FlacFrameHeader& h, FlacFrameBuffer& out) {
+    if (!parseFlacFrameHeader(data, size, info, h)) return 0;
+
+    BitReader br(data + h.headerBytes, size - h.headerBytes);
+    for (uint32_t c = 0; c < h.channels; ++c) {
+        // The side channel carries one extra bit.
+        uint32_t bps = h.bitsPerSample;
+        if ((h.channelAssignment == 8 && c == 1) || (h.channelAssignment == 9 && c == 0) ||
+            (h.channelAssignment == 10 && c == 1)) {
+            ++bps;
+        }
+        if (!decodeSubframe(br, out.channel(c), h.blockSize, bps)) return 0;
+    }
+    br.alignToByte();
+    size_t end = h.headerBytes + br.bytePosition();
+    if (end + 2 > size || br.overrun()) return 0;
+    uint16_t expected = static_cast<uint16_t>((data[end] << 8) | data[end + 1]);
+    if (crc16(data, end) != expected) return 0;
+
+    // Inter-channel decorrelation.
+    if (h.channelAssignment >= 8) {
+        int32_t* a = out.channel(0);
+        int32_t* b = out.channel(1);
+        const uint32_t n = h.blockSize;
+        switch (h.channelAssignment) {
+            case 8:   // left, side
+                for (uint32_t i = 0; i < n; ++i) b[i] = a[i] - b[i];
+                break;
+            case 9:   // side, right
+                for (uint32_t i = 0; i < n; ++i) a[i] += b[i];
+                break;
+            case 10:  // mid, side
+                for (uint32_t i = 0; i < n; ++i) {
+                    int32_t mid = static_cast<int32_t>(static_cast<uint32_t>(a[i]) << 1) | (b[i] & 1);
+                    int32_t side = b[i];
+                    a[i] = (mid + side) >> 1;
+                    b[i] = (mid - side) >> 1;
+                }
+                break;
+        }
+    }
+    return end + 2;
+}
+
+// -----------------------------
+// Interleave kernels
+// -----------------------------
+// Specialized on the channel count (N = 0: count known at run time only).
+// With N fixed the per-frame channel loop unrolls and writes are
+// sequential. On SSE2, 4 frames at a time are transposed in registers:
+// 4x4 blocks for each group of four channels, unpacks for a remaining pair
+// (stereo, 5.1) or a single channel (mono). NEON interleaves stereo with
+// vst2.
+namespace {
+
+#if defined(FLAC_USE_SSE2)
+// Frames i..i+3 of N channels (N = 1, or 4k + {0, 2}) as float.
+template <uint32_t N>
+inline void interleave4Float(const int32_t* const* src, size_t i, __m128 scale, float* dst) {
+    auto load = [&](uint32_t c) {
+        return _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src[c] + i))), scale);
+    };
+    if (N == 1) {
+        _mm_storeu_ps(dst + i, load(0));
+        return;
+    }
+    uint32_t c = 0;
+    for (; c + 4 <= N; c += 4) {
+        __m128 r0 = load(c), r1 = load(c + 1), r2 = load(c + 2), r3 = load(c + 3);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(dst + (i + 0) * N + c, r0);
+        _mm_storeu_ps(dst + (i + 1) * N + c, r1);
+        _mm_storeu_ps(dst + (i + 2) * N + c, r2);
+        _mm_storeu_ps(dst + (i + 3) * N + c, r3);
+    }
+    if (N - c == 2) {
+        __m128 a = load(c), b = load(c + 1);
+        __m128 lo = _mm_unpacklo_ps(a, b);   // frames i, i+1
+        __m128 hi = _mm_unpackhi_ps(a, b);   // frames i+2, i+3
+        if (N == 2) {
+            _mm_storeu_ps(dst + 2 * i, lo);
+            _mm_storeu_ps(dst + 2 * i + 4, hi);
+        } else {
+            _mm_storel_pi(reinterpret_cast<__m64*>(dst + (i + 0) * N + c), lo);
+            _mm_storeh_pi(reinterpret_cast<__m64*>(dst + (i + 1) * N + c), lo);
+            _mm_storel_pi(reinterpret_cast<__m64*>(dst + (i + 2) * N + c), hi);
+            _mm_storeh_pi(reinterpret_cast<__m64*>(dst + (i + 3) * N + c), hi);
+        }
+    }
+}
+
+// Same for int16: shift to 16 bits, transpose as int32, then narrow.
+template <uint32_t N>
+inline void interleave4S16(const int32_t* const* src, size_t i, __m128i down, __m128i up, int16_t* dst) {
+    auto load = [&](uint32_t c) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[c] + i));
+        return _mm_sll_epi32(_mm_sra_epi32(v, down), up);
+    };
+    if (N == 1) {
+        __m128i v = load(0);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(v, v));
+        return;
+    }
+    uint32_t c = 0;
+    for (; c + 4 <= N; c += 4) {
+        __m128i r0 = load(c), r1 = load(c + 1), r2 = load(c + 2), r3 = load(c + 3);
+        __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+        __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+        __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+        __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+        __m128i f01 = _mm_packs_epi32(_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1));
+        __m128i f23 = _mm_packs_epi32(_mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + (i + 0) * N + c), f01);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + (i + 1) * N + c), _mm_srli_si128(f01, 8));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + (i + 2) * N + c), f23);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + (i + 3) * N + c), _mm_srli_si128(f23, 8));
+    }
+    if (N - c == 2) {
+        __m128i a = load(c), b = load(c + 1);
+        __m128i p = _mm_packs_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));   // 4 frames of 2
+        if (N == 2) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i), p);
+        } else {
+            for (uint32_t k = 0; k < 4; ++k) {
+                int32_t pair = _mm_cvtsi128_si32(p);
+                std::memcpy(dst + (i + k) * N + c, &pair, sizeof(pair));
+                p = _mm_srli_si128(p, 4);
+            }
+        }
+    }
+}
+#endif
+
+template <uint32_t N>
+void interleaveS16(const FlacFrameBuffer& in, uint32_t channels, uint32_t bitsPerSample,
+                   size_t offset, size_t frames, int16_t* dst) {
+    const int down = bitsPerSample > 16 ? static_cast<int>(bitsPerSample - 16) : 0;
+    const int up = bitsPerSample < 16 ? static_cast<int>(16 - bitsPerSample) : 0;
+    if (N == 0) {
+        for (uint32_t c = 0; c < channels; ++c) {
+            const int32_t* src = in.channel(c) + offset;
+            int16_t* out = dst + c;
+            for (size_t i = 0; i < frames; ++i) {
+                out[i * channels] = static_cast<int16_t>((src[i] >> down) * (1 << up));
+            }
+        }
+        return;
+    }
+
+    constexpr uint32_t kCh = N ? N : 1;
+    const int32_t* src[kCh];
+    for (uint32_t c = 0; c < kCh; ++c) src[c] = in.channel(c) + offset;
+    size_t i = 0;
+#if defined(FLAC_USE_SSE2)
+    const __m128i sd = _mm_cvtsi32_si128(down);
+    const __m128i su = _mm_cvtsi32_si128(up);
+    for (; i + 4 <= frames; i += 4) interleave4S16<kCh>(src, i, sd, su, dst);
+#elif defined(FLAC_USE_NEON)
+    if (N == 2) {
+        const int32x4_t shift = vdupq_n_s32(up - down);   // one of them is 0
+        for (; i + 4 <= frames; i += 4) {
+            int16x4x2_t v;
+            v.val[0] = vmovn_s32(vshlq_s32(vld1q_s32(src[0] + i), shift));
+            v.val[1] = vmovn_s32(vshlq_s32(vld1q_s32(src[kCh - 1] + i), shift));
+            vst2_s16(dst + 2 * i, v);
+        }
+    }
+#endif
+    for (; i < frames; ++i) {
+        for (uint32_t c = 0; c < kCh; ++c) {
+            dst[i * kCh + c] = static_cast<int16_t>((src[c][i] >> down) * (1 << up));
+        }
+    }
+}
+
+template <uint32_t N>
+void interleaveFloat(const FlacFrameBuffer& in, uint32_t channels, uint32_t bitsPerSample,
+                     size_t offset, size_t frames, float* dst) {
+    const float scale = 1.0f / static_cast<float>(1u << (bitsPerSample - 1));
+    if (N == 0) {
+        for (uint32_t c = 0; c < channels; ++c) {
+            const int32_t* src = in.channel(c) + offset;
+            float* out = dst + c;
+            for (size_t i = 0; i < frames; ++i) {
+                out[i * channels] = static_cast<float>(src[i]) * scale;
+            }
+        }
+        return;
+    }
+
+    constexpr uint32_t kCh = N ? N : 1;
+    const int32_t* src[kCh];
+    for (uint32_t c = 0; c < kCh; ++c) src[c] = in.channel(c) + offset;
+    size_t i = 0;
+#if defined(FLAC_USE_SSE2)
+    const __m128 vscale = _mm_set1_ps(scale);
+    for (; i + 4 <= frames; i += 4) interleave4Float<kCh>(src, i, vscale, dst);
+#elif defined(FLAC_USE_NEON)
+    if (N == 2) {
+        for (; i + 4 <= frames; i += 4) {
+            float32x4x2_t v;
+            v.val[0] = vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(src[0] + i)), scale);
+            v.val[1] = vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(src[kCh - 1] + i)), scale);
+            vst2q_f32(dst + 2 * i, v);
+        }
+    }
+#endif
+    for (; i < frames; ++i) {
+        for (uint32_t c = 0; c < kCh; ++c) {
+            dst[i * kCh + c] = static_cast<float>(src[c][i]) * scale;
+        }
+    }
+}
+
+template <uint32_t N>
+constexpr FlacInterleaveKernels kernelsFor() {
+    return FlacInterleaveKernels{ &interleaveS16<N>, &interleaveFloat<N> };
+}
+
+} // namespace
+
+FlacInterleaveKernels selectFlacInterleave(uint32_t channels) {
+    switch (channels) {
+        case 1: return kernelsFor<1>();
+        case 2: return kernelsFor<2>();
+        case 6: return kernelsFor<6>();
+        case 8: return kernelsFor<8>();
+        default: return kernelsFor<0>();
+    }
+}
+
+void interleaveFlacToS16(const FlacFrameBuffer& in, uint32_t channels, uint32_t bitsPerSample,
+                         size_t offset, size_t frames, int16_t* dst) {
+    selectFlacInterleave(channels).toS16(in, channels, bitsPerSample, offset, frames, dst);
+}
+
+void interleaveFlacToFloat(const FlacFrameBuffer& in, uint32_t channels, uint32_t bitsPerSample,
+                           size_t offset, size_t frames, float* dst) {
+    selectFlacInterleave(channels).toFloat(in, channels, bitsPerSample, offset, frames, dst);
+}
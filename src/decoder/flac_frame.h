@@ -0,0 +1,104 @@
+#pragma once
+/*
+ flac_frame.h
+
+ Purpose:
+   - Stateless FLAC frame decoding used by FlacDecoder: frame header parsing,
+     sync search, and full frame decode (subframes, residuals, prediction,
+     inter-channel decorrelation, CRC-16 check) into planar int32 samples.
+   - Because every FLAC frame is self-contained, these functions can be run
+     on different frames from different threads (frame-level parallelism).
+
+ Hot paths:
+   - Rice residuals: 64-bit bit cache with count-leading-zeros for the
+     unary part; sign unfolding (zigzag) runs as a separate SSE2/NEON pass
+     over each partition.
+   - LPC restoration: 32-bit accumulation (when bps + precision + log2(order)
+     fits, which libFLAC encoders guarantee for <=24-bit input) computes four
+     outputs per step: the taps that only touch already-final samples are
+     evaluated as a 4-lane SIMD multiply-add, the remaining triangle is
+     resolved serially. Wider streams use a scalar 64-bit path.
+   - Interleaving: kernels specialized per channel count (mono, stereo, 5.1,
+     7.1) transpose 4 frames at a time in SIMD registers; FlacDecoder picks
+     them once per stream (selectFlacInterleave()).
+
+ Limits:
+   - Up to 24 bits per sample (side channels then need 25 bits, which keeps
+     every sample in int32). FlacDecoder rejects wider streams.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct FlacStreamInfo {
+    uint32_t minBlockSize = 0;
+    uint32_t maxBlockSize = 0;
+    uint32_t minFrameSize = 0;   // 0 = unknown
+    uint32_t maxFrameSize = 0;   // 0 = unknown
+    uint32_t sampleRate = 0;
+    uint32_t channels = 0;
+    uint32_t bitsPerSample = 0;
+    uint64_t totalSamples = 0;   // per channel; 0 = unknown
+};
+
+struct FlacFrameHeader {
+    uint32_t blockSize = 0;
+    uint32_t sampleRate = 0;
+    uint32_t channels = 0;
+    uint32_t channelAssignment = 0;  // 0-7 independent, 8 L/S, 9 S/R, 10 M/S
+    uint32_t bitsPerSample = 0;
+    uint64_t firstSample = 0;        // index of the frame's first sample
+    size_t headerBytes = 0;
+};
+
+// Planar decode target: one block of int32 samples per channel.
+class FlacFrameBuffer {
+public:
+    void reserve(uint32_t channels, uint32_t maxBlockSize);
+    int32_t* channel(uint32_t c) { return samples_.data() + c * stride_; }
+    const int32_t* channel(uint32_t c) const { return samples_.data() + c * stride_; }
+
+private:
+    std::vector<int32_t> samples_;
+    size_t stride_ = 0;
+};
+
+// Parse the frame header at `data`. Rejects bad sync/reserved bits, CRC-8
+// mismatches, and headers that disagree with STREAMINFO (rate, channels,
+// bit depth, block size), which makes it usable for sync search.
+bool parseFlacFrameHeader(const uint8_t* data, size_t size, const FlacStreamInfo& info, FlacFrameHeader& header);
+
+// First offset >= `offset` holding a valid frame header, or `size` if none.
+size_t findFlacFrame(const uint8_t* data, size_t size, size_t offset, const FlacStreamInfo& info, FlacFrameHeader& header);
+
+// Decode the frame starting at `data` into `out` (reserved for the stream).
+// Returns the frame length in bytes, or 0 if the frame is corrupt or
+// truncated (including CRC-16 mismatch).
+size_t decodeFlacFrame(const uint8_t* data, size_t size, const FlacStreamInfo& info,
+                       FlacFrameHeader& header, FlacFrameBuffer& out);
+
+// Interleave kernels for one channel count, chosen once per stream with
+// selectFlacInterleave(). Both take the same arguments as the functions
+// below; `channels` must match the count they were selected for.
+using FlacInterleaveS16Fn = void (*)(const FlacFrameBuffer& in, uint32_t channels, uint32_t bitsPerSample,
+                                     size_t offset, size_t frames, int16_t* dst);
+using FlacInterleaveFloatFn = void (*)(const FlacFrameBuffer& in, uint32_t channels, uint32_t bitsPerSample,
+                                       size_t offset, size_t frames, float* dst);
+struct FlacInterleaveKernels {
+    FlacInterleaveS16Fn toS16;
+    FlacInterleaveFloatFn toFloat;
+};
+
+// Kernels specialized for mono, stereo, 5.1 and 7.1 (unrolled channel loop,
+// SIMD interleave for stereo); a generic pair for other counts.
+FlacInterleaveKernels selectFlacInterleave(uint32_t channels);
+
+// Interleave `frames` samples starting at `offset` of a decoded frame into
+// int16 (top 16 bits for deeper streams). Selects the kernel on every call.
+void interleaveFlacToS16(const FlacFrameBuffer& in, uint32_t channels, uint32_t bitsPerSample,
+                         size_t offset, size_t frames, int16_t* dst);
+
+// Same, into float in [-1, 1) at the stream's full resolution.
+void interleaveFlacToFloat(const FlacFrameBuffer& in, uint32_t channels, uint32_t bitsPerSample,
+                           size_t offset, size_t frames, float* dst);
@@ -0,0 +1,322 @@
+/**
+ * pcm_block_codec.cpp
+ *
+ * Block layout (all multi-bit fields MSB first):
+ *   byte 0        high nibble: kPcmBlockVersion
+ *                 low nibble flags: bit 0 = verbatim, bit 1 = right channel
+ *                 coded as side
+ *   byte 1..ch    predictor order per channel (0..2)          [not verbatim]
+ *   byte ch+1..2ch  wasted low bits per channel, shifted out before
+ *                 prediction                                   [not verbatim]
+ *   bitstream     per channel: per 256-sample partition a 5-bit Rice
+ *                 parameter followed by the Rice-coded folded residuals
+ *
+ * The first `order` samples of a channel are coded as residuals of the
+ * order-0 predictor (the samples themselves), so there is no warm-up field.
+ * Verbatim blocks carry the samples as little-endian int32 after byte 0.
+ */
+
+#include "pcm_block_codec.h"
+#include "bit_reader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+constexpr size_t kPartition = 256;
+constexpr int kRiceParamBits = 5;
+constexpr int kMaxRiceParam = 30;   // residuals are at most 30 bits folded
+
+constexpr uint8_t kFlagVerbatim = 0x01;
+constexpr uint8_t kFlagSide = 0x02;
+constexpr uint8_t kFlagMask = 0x0F;
+
+// Largest magnitude of a channel after side coding (R - L).
+constexpr int64_t kMaxPlanar = 2LL * kPcmBlockMaxSample;
+
+inline uint32_t fold(int32_t v) {
+    return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+}
+
+inline int32_t unfold(uint32_t u) {
+    return static_cast<int32_t>(u >> 1) ^ -static_cast<int32_t>(u & 1);
+}
+
+// -----------------------------
+// BitWriter: MSB-first counterpart of BitReader
+// -----------------------------
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out), acc_(0), bits_(0) {}
+
+    // Append the low `n` (<= 32) bits of `v`.
+    void put(uint32_t v, int n) {
+        if (n == 0) return;
+        acc_ = (acc_ << n) | (v & (0xFFFFFFFFu >> (32 - n)));
+        bits_ += n;
+        while (bits_ >= 8) {
+            bits_ -= 8;
+            out_.push_back(static_cast<uint8_t>(acc_ >> bits_));
+        }
+    }
+
+    void putRice(uint32_t u, int k) {
+        uint32_t q = u >> k;
+        while (q >= 32) {
+            put(0, 32);
+            q -= 32;
+        }
+        put(1, static_cast<int>(q) + 1);
+        put(u, k);
+    }
+
+    void flush() {
+        if (bits_ > 0) out_.push_back(static_cast<uint8_t>(acc_ << (8 - bits_)));
+        bits_ = 0;
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint64_t acc_;
+    int bits_;
+};
+
+// Residual of the fixed predictor of `order` at index i (i >= order).
+inline int32_t residualAt(const int32_t* x, size_t i, int order) {
+    switch (order) {
+    case 1: return x[i] - x[i - 1];
+    case 2: return x[i] - 2 * x[i - 1] + x[i - 2];
+    default: return x[i];
+    }
+}
+
+// Pick the predictor order with the smallest sum of absolute residuals.
+int chooseOrder(const int32_t* x, size_t n) {
+    uint64_t cost[3] = {0, 0, 0};
+    for (size_t i = 2; i < n; ++i) {
+        int32_t d1 = x[i] - x[i - 1];
+        int32_t d2 = d1 - (x[i - 1] - x[i - 2]);
+        cost[0] += static_cast<uint32_t>(std::abs(x[i]));
+        cost[1] += static_cast<uint32_t>(std::abs(d1));
+        cost[2] += static_cast<uint32_t>(std::abs(d2));
+    }
+    int best = 0;
+    for (int o = 1; o < 3; ++o) {
+        if (cost[o] < cost[best]) best = o;
+    }
+    return best;
+}
+
+// Bits needed to Rice code `u[0..n)` with parameter k.
+uint64_t riceBits(const uint32_t* u, size_t n, int k) {
+    uint64_t bits = static_cast<uint64_t>(n) * static_cast<uint64_t>(k + 1);
+    for (size_t i = 0; i < n; ++i) bits += u[i] >> k;
+    return bits;
+}
+
+// Best Rice parameter for a partition: start from log2 of the mean and
+// check the neighbours exactly.
+int chooseRiceParam(const uint32_t* u, size_t n) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) sum += u[i];
+    uint64_t mean = n ? sum / n : 0;
+    int k = 0;
+    while (k < kMaxRiceParam && (1ULL << (k + 1)) <= mean) ++k;
+
+    int best = k;
+    uint64_t bestBits = riceBits(u, n, k);
+    for (int c : {k - 1, k + 1}) {
+        if (c < 0 || c > kMaxRiceParam) continue;
+        uint64_t b = riceBits(u, n, c);
+        if (b < bestBits) {
+            bestBits = b;
+            best = c;
+        }
+    }
+    return best;
+}
+
+// Low bits that are zero in every sample of x[0..n).
+int wastedBits(const int32_t* x, size_t n) {
+    uint32_t any = 0;
+    for (size_t i = 0; i < n; ++i) any |= static_cast<uint32_t>(x[i]);
+    if (any == 0) return 0;
+    int shift = 0;
+    while (!(any & 1u)) {
+        any >>= 1;
+        ++shift;
+    }
+    return shift;
+}
+
+void storeVerbatim(const int32_t* pcm, size_t samples, std::vector<uint8_t>& out) {
+    out.assign(1 + samples * 4, 0);
+    out[0] = static_cast<uint8_t>(kPcmBlockVersion << 4) | kFlagVerbatim;
+    for (size_t i = 0; i < samples; ++i) {
+        uint32_t v = static_cast<uint32_t>(pcm[i]);
+        for (int b = 0; b < 4; ++b) out[1 + 4 * i + b] = static_cast<uint8_t>(v >> (8 * b));
+    }
+}
+
+} // namespace
+
+// -----------------------------
+// Quantization
+// -----------------------------
+void quantizePcmBlock(const float* src, int32_t* dst, size_t samples) {
+    const float limit = static_cast<float>(kPcmBlockMaxSample);
+    for (size_t i = 0; i < samples; ++i) {
+        float v = src[i] * kPcmBlockScale;
+        if (!(v > -limit)) v = (v == v) ? -limit : 0.0f;   // NaN -> silence
+        if (v > limit) v = limit;
+        dst[i] = static_cast<int32_t>(std::lrint(v));
+    }
+}
+
+void dequantizePcmBlock(const int32_t* src, float* dst, size_t samples) {
+    const float inv = 1.0f / kPcmBlockScale;
+    for (size_t i = 0; i < samples; ++i) dst[i] = static_cast<float>(src[i]) * inv;
+}
+
+// -----------------------------
+// Encoder
+// -----------------------------
+bool compressPcmBlock(const int32_t* pcm, size_t frames, int channels, std::vector<uint8_t>& out) {
+    if (channels < 1 || channels > kPcmBlockMaxChannels) return false;
+
+    // Deinterleave; samples within +-2^26 leave the side channel and the
+    // order-2 residuals well inside int32.
+    std::vector<int32_t> planar(frames * channels);
+    for (int c = 0; c < channels; ++c) {
+        int32_t* dst = planar.data() + static_cast<size_t>(c) * frames;
+        for (size_t i = 0; i < frames; ++i) {
+            int32_t v = pcm[i * channels + c];
+            if (v < -kPcmBlockMaxSample || v > kPcmBlockMaxSample) return false;
+            dst[i] = v;
+        }
+    }
+
+    uint8_t flags = 0;
+    if (channels == 2 && frames > 2) {
+        // Side coding pays off when the channels are correlated.
+        const int32_t* l = planar.data();
+        const int32_t* r = l + frames;
+        uint64_t right = 0, side = 0;
+        for (size_t i = 1; i < frames; ++i) {
+            right += static_cast<uint32_t>(std::abs(r[i] - r[i - 1]));
+            side += static_cast<uint32_t>(std::abs((r[i] - l[i]) - (r[i - 1] - l[i - 1])));
+        }
+        if (side < right) {
+            flags |= kFlagSide;
+            int32_t* rs = planar.data() + frames;
+            for (size_t i = 0; i < frames; ++i) rs[i] -= l[i];
+        }
+    }
+
+    out.clear();
+    out.reserve(frames * channels * 2);
+    out.push_back(static_cast<uint8_t>(kPcmBlockVersion << 4) | flags);
+    std::vector<int> orders(channels);
+    std::vector<int> shifts(channels);
+    for (int c = 0; c < channels; ++c) {
+        int32_t* x = planar.data() + static_cast<size_t>(c) * frames;
+        shifts[c] = wastedBits(x, frames);
+        if (shifts[c] > 0) {
+            for (size_t i = 0; i < frames; ++i) x[i] >>= shifts[c];
+        }
+        orders[c] = chooseOrder(x, frames);
+        out.push_back(static_cast<uint8_t>(orders[c]));
+    }
+    for (int c = 0; c < channels; ++c) out.push_back(static_cast<uint8_t>(shifts[c]));
+
+    BitWriter bw(out);
+    std::vector<uint32_t> folded(frames);
+    for (int c = 0; c < channels; ++c) {
+        const int32_t* x = planar.data() + static_cast<size_t>(c) * frames;
+        size_t order = static_cast<size_t>(orders[c]);
+        for (size_t i = 0; i < frames; ++i) {
+            folded[i] = fold(i < order ? x[i] : residualAt(x, i, orders[c]));
+        }
+        for (size_t p = 0; p < frames; p += kPartition) {
+            size_t n = std::min(kPartition, frames - p);
+            int k = chooseRiceParam(folded.data() + p, n);
+            bw.put(static_cast<uint32_t>(k), kRiceParamBits);
+            for (size_t i = 0; i < n; ++i) bw.putRice(folded[p + i], k);
+        }
+    }
+    bw.flush();
+
+    if (out.size() >= 1 + frames * channels * 4) storeVerbatim(pcm, frames * channels, out);
+    return true;
+}
+
+// -----------------------------
+// Decoder
+// -----------------------------
+bool decompressPcmBlock(const uint8_t* data, size_t size, size_t frames, int channels, int32_t* pcm) {
+    if (channels < 1 || channels > kPcmBlockMaxChannels || size < 1) return false;
+    if ((data[0] >> 4) != kPcmBlockVersion) return false;
+    const size_t samples = frames * channels;
+    const uint8_t flags = data[0] & kFlagMask;
+
+    if (flags & kFlagVerbatim) {
+        if (size != 1 + samples * 4) return false;
+        for (size_t i = 0; i < samples; ++i) {
+            const uint8_t* b = data + 1 + 4 * i;
+            int32_t v = static_cast<int32_t>(static_cast<uint32_t>(b[0]) | (static_cast<uint32_t>(b[1]) << 8) |
+                                             (static_cast<uint32_t>(b[2]) << 16) | (static_cast<uint32_t>(b[3]) << 24));
+            if (v < -kPcmBlockMaxSample || v > kPcmBlockMaxSample) return false;
+            pcm[i] = v;
+        }
+        return true;
+    }
+    const size_t header = 1 + 2 * static_cast<size_t>(channels);
+    if (size < header) return false;
+
+    BitReader br(data + header, size - header);
+    std::vector<uint32_t> folded(frames);
+    std::vector<int32_t> planar(samples);
+    for (int c = 0; c < channels; ++c) {
+        int order = data[1 + c];
+        int shift = data[1 + channels + c];
+        if (order > 2 || shift > 27) return false;
+        for (size_t p = 0; p < frames; p += kPartition) {
+            size_t n = std::min(kPartition, frames - p);
+            int k = static_cast<int>(br.read(kRiceParamBits));
+            if (k > kMaxRiceParam || !br.readRice(folded.data() + p, n, k)) return false;
+        }
+
+        // Rebuild in 64 bits so corrupt residuals cannot overflow.
+        const int64_t limit = kMaxPlanar >> shift;
+        int32_t* x = planar.data() + static_cast<size_t>(c) * frames;
+        int64_t x1 = 0, x2 = 0;
+        for (size_t i = 0; i < frames; ++i) {
+            int64_t r = unfold(folded[i]);
+            int64_t v;
+            if (i < static_cast<size_t>(order) || order == 0) v = r;
+            else if (order == 1) v = r + x1;
+            else v = r + 2 * x1 - x2;
+            if (v < -limit || v > limit) return false;
+            x2 = x1;
+            x1 = v;
+            x[i] = static_cast<int32_t>(v);
+        }
+        if (shift > 0) {
+            for (size_t i = 0; i < frames; ++i) x[i] = static_cast<int32_t>(static_cast<uint32_t>(x[i]) << shift);
+        }
+    }
+
+    const int32_t* side = (flags & kFlagSide) ? planar.data() : nullptr;
+    for (int c = 0; c < channels; ++c) {
+        const int32_t* x = planar.data() + static_cast<size_t>(c) * frames;
+        for (size_t i = 0; i < frames; ++i) {
+            int32_t v = x[i];
+            if (side && c == 1) v += side[i];
+            if (v < -kPcmBlockMaxSample || v > kPcmBlockMaxSample) return false;
+            pcm[i * channels + c] = v;
+        }
+    }
+    return true;
+}
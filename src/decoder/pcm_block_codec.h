@@ -0,0 +1,56 @@
+#pragma once
+/**
+ * pcm_block_codec.h
+ *
+ * Fast lossless compression of short interleaved PCM blocks, used by
+ * PcmBlockCache to keep decoded audio in RAM.
+ *
+ * Samples are 24-bit integers with headroom: the engine's float output is
+ * quantized at 2^-23 of full scale (quantizePcmBlock()) into int32 values of
+ * up to +-2^26, so peaks up to +18 dBFS from lossy decoders survive. 16- and
+ * 24-bit sources map onto this grid exactly.
+ *
+ * Per block and channel, low bits that are zero in every sample (the 8
+ * padding bits of a 16-bit source) are shifted out, and the cheapest fixed
+ * polynomial predictor (order 0..2, as in FLAC's FIXED subframes) is chosen;
+ * stereo blocks may code the right channel as the side signal R - L.
+ * Residuals are zig-zag mapped and Rice coded in partitions of 256 samples
+ * with a per-partition parameter. Blocks that do not compress (noise) are
+ * stored verbatim.
+ *
+ * Typical music compresses to 60-75 % of its 16- or 24-bit size; decoding
+ * is a few nanoseconds per sample, far below the cost of decoding MP3/AAC
+ * again.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Largest channel count compressPcmBlock() accepts.
+static constexpr int kPcmBlockMaxChannels = 8;
+
+// Block format version, stored in every block; bump on layout changes.
+// Version 1 held int16 samples.
+static constexpr int kPcmBlockVersion = 2;
+
+// Quantization step: 1.0f (full scale) is 2^23.
+static constexpr float kPcmBlockScale = 8388608.0f;
+// Largest sample magnitude (+18 dBFS); quantizePcmBlock() saturates here.
+static constexpr int32_t kPcmBlockMaxSample = 1 << 26;
+
+// Float [-1, 1) -> block samples (scaled by 2^23, rounded, saturated).
+void quantizePcmBlock(const float* src, int32_t* dst, size_t samples);
+
+// Block samples -> float (divided by 2^23).
+void dequantizePcmBlock(const int32_t* src, float* dst, size_t samples);
+
+// Compress `frames` interleaved frames of `channels` channels into `out`
+// (replacing its contents). Samples must be within +-kPcmBlockMaxSample.
+// Returns false for unsupported channel counts.
+bool compressPcmBlock(const int32_t* pcm, size_t frames, int channels, std::vector<uint8_t>& out);
+
+// Decode a block produced by compressPcmBlock() with the same `frames` and
+// `channels` into `pcm` (frames * channels samples). Returns false if the
+// data is corrupt or from another format version.
+bool decompressPcmBlock(const uint8_t* data, size_t size, size_t frames, int channels, int32_t* pcm);
@@ -0,0 +1,512 @@
+/*
+ pcm_convert.cpp
+
+ Raw PCM -> interleaved int16 conversion kernels. See pcm_convert.h.
+
+ Layout:
+   - simdConvert() handles the bulk of each buffer with SSE2/SSSE3 or NEON
+     and returns how many samples it consumed.
+   - The scalar loop in convertPcmToS16() finishes the remainder and is the
+     whole implementation on other targets (and on big-endian hosts).
+   - The S16LE / S24LE -> float kernels come in per-level variants behind
+     selectPcmToFloat(); the AVX2/AVX-512 ones are compiled with target
+     attributes and only called on hosts that report them.
+*/
+
+#include "pcm_convert.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define PCM_HOST_LITTLE_ENDIAN 0
+#else
+#define PCM_HOST_LITTLE_ENDIAN 1
+#endif
+
+#if PCM_HOST_LITTLE_ENDIAN && (defined(__SSE2__) || defined(_M_X64))
+#define PCM_USE_SSE2 1
+#include <emmintrin.h>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#elif PCM_HOST_LITTLE_ENDIAN && defined(__ARM_NEON) && defined(__aarch64__)
+#define PCM_USE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+#include <immintrin.h>
+#define PCM_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define PCM_TARGET_AVX512 __attribute__((target("avx2,fma,avx512f,avx512bw")))
+#endif
+
+size_t pcmBytesPerSample(PcmEncoding encoding) {
+    switch (encoding) {
+        case PcmEncoding::U8:
+        case PcmEncoding::S8:    return 1;
+        case PcmEncoding::S16LE:
+        case PcmEncoding::S16BE: return 2;
+        case PcmEncoding::S24LE:
+        case PcmEncoding::S24BE: return 3;
+        case PcmEncoding::S32LE:
+        case PcmEncoding::S32BE:
+        case PcmEncoding::F32LE:
+        case PcmEncoding::F32BE: return 4;
+    }
+    return 0;
+}
+
+// -----------------------------
+// Scalar helpers
+// -----------------------------
+static inline int16_t s16FromBytes(uint8_t lo, uint8_t hi) {
+    return static_cast<int16_t>(static_cast<uint16_t>(lo | (hi << 8)));
+}
+
+static inline int16_t s16FromFloat(float f) {
+    float s = f * 32768.0f;
+    if (!(s > -32768.0f)) return -32768;   // also catches NaN
+    if (s >= 32767.0f) return 32767;
+    return static_cast<int16_t>(std::lrintf(s));
+}
+
+static inline float floatFromBytes(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3) {
+    uint32_t bits = static_cast<uint32_t>(b0) | (static_cast<uint32_t>(b1) << 8) |
+                    (static_cast<uint32_t>(b2) << 16) | (static_cast<uint32_t>(b3) << 24);
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// -----------------------------
+// SIMD bulk conversion
+// -----------------------------
+#if defined(PCM_USE_SSE2)
+
+static inline __m128i bswap16x8(__m128i v) {
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static inline __m128i bswap32x4(__m128i v) {
+    v = bswap16x8(v);
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+}
+
+static inline __m128i floatToS16x8(__m128 a, __m128 b) {
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    // max(v, lo) returns lo for NaN lanes.
+    a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(a, scale), lo), hi);
+    b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(b, scale), lo), hi);
+    return _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+}
+
+static size_t simdConvert(const uint8_t* src, PcmEncoding encoding, int16_t* dst, size_t samples) {
+    size_t i = 0;
+    switch (encoding) {
+        case PcmEncoding::U8:
+        case PcmEncoding::S8: {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i bias = _mm_set1_epi8(encoding == PcmEncoding::U8 ? static_cast<char>(0x80) : 0);
+            for (; i + 16 <= samples; i += 16) {
+                __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), bias);
+                // Interleaving zero below each byte yields byte << 8.
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(zero, v));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(zero, v));
+            }
+            break;
+        }
+        case PcmEncoding::S16BE:
+            for (; i + 8 <= samples; i += 8) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), bswap16x8(v));
+            }
+            break;
+#ifdef __SSSE3__
+        case PcmEncoding::S24LE:
+        case PcmEncoding::S24BE: {
+            // Top two bytes of four packed 3-byte samples -> four int16.
+            const __m128i mask = encoding == PcmEncoding::S24LE
+                ? _mm_setr_epi8(1, 2, 4, 5, 7, 8, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1)
+                : _mm_setr_epi8(1, 0, 4, 3, 7, 6, 10, 9, -1, -1, -1, -1, -1, -1, -1, -1);
+            // Each step loads 16 bytes at +0 and +12; keep 28 bytes in bounds.
+            for (; i + 10 <= samples; i += 8) {
+                const uint8_t* p = src + i * 3;
+                __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), mask);
+                __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), mask);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi64(a, b));
+            }
+            break;
+        }
+#endif
+        case PcmEncoding::S32LE:
+        case PcmEncoding::S32BE: {
+            const bool swap = encoding == PcmEncoding::S32BE;
+            for (; i + 8 <= samples; i += 8) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 16));
+                if (swap) {
+                    a = bswap32x4(a);
+                    b = bswap32x4(b);
+                }
+                __m128i v = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+            }
+            break;
+        }
+        case PcmEncoding::F32LE:
+        case PcmEncoding::F32BE: {
+            const bool swap = encoding == PcmEncoding::F32BE;
+            for (; i + 8 <= samples; i += 8) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 16));
+                if (swap) {
+                    a = bswap32x4(a);
+                    b = bswap32x4(b);
+                }
+                __m128i v = floatToS16x8(_mm_castsi128_ps(a), _mm_castsi128_ps(b));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return i;
+}
+
+#elif defined(PCM_USE_NEON)
+
+// Interleave two byte planes (low, high) into sixteen int16.
+static inline void storeZip(int16_t* dst, uint8x16_t lo, uint8x16_t hi) {
+    vst1q_s16(dst, vreinterpretq_s16_u8(vzip1q_u8(lo, hi)));
+    vst1q_s16(dst + 8, vreinterpretq_s16_u8(vzip2q_u8(lo, hi)));
+}
+
+static inline int16x4_t floatToS16x4(float32x4_t v) {
+    return vqmovn_s32(vcvtnq_s32_f32(vmulq_n_f32(v, 32768.0f)));
+}
+
+static size_t simdConvert(const uint8_t* src, PcmEncoding encoding, int16_t* dst, size_t samples) {
+    size_t i = 0;
+    switch (encoding) {
+        case PcmEncoding::U8:
+        case PcmEncoding::S8: {
+            const uint8x16_t zero = vdupq_n_u8(0);
+            const uint8x16_t bias = vdupq_n_u8(encoding == PcmEncoding::U8 ? 0x80 : 0);
+            for (; i + 16 <= samples; i += 16) {
+                storeZip(dst + i, zero, veorq_u8(vld1q_u8(src + i), bias));
+            }
+            break;
+        }
+        case PcmEncoding::S16BE:
+            for (; i + 8 <= samples; i += 8) {
+                vst1q_s16(dst + i, vreinterpretq_s16_u8(vrev16q_u8(vld1q_u8(src + i * 2))));
+            }
+            break;
+        case PcmEncoding::S24LE:
+        case PcmEncoding::S24BE:
+            for (; i + 16 <= samples; i += 16) {
+                uint8x16x3_t v = vld3q_u8(src + i * 3);
+                if (encoding == PcmEncoding::S24LE) storeZip(dst + i, v.val[1], v.val[2]);
+                else                                storeZip(dst + i, v.val[1], v.val[0]);
+            }
+            break;
+        case PcmEncoding::S32LE:
+        case PcmEncoding::S32BE:
+            for (; i + 16 <= samples; i += 16) {
+                uint8x16x4_t v = vld4q_u8(src + i * 4);
+                if (encoding == PcmEncoding::S32LE) storeZip(dst + i, v.val[2], v.val[3]);
+                else                                storeZip(dst + i, v.val[1], v.val[0]);
+            }
+            break;
+        case PcmEncoding::F32LE:
+        case PcmEncoding::F32BE: {
+            const bool swap = encoding == PcmEncoding::F32BE;
+            for (; i + 8 <= samples; i += 8) {
+                uint8x16_t a = vld1q_u8(src + i * 4);
+                uint8x16_t b = vld1q_u8(src + i * 4 + 16);
+                if (swap) {
+                    a = vrev32q_u8(a);
+                    b = vrev32q_u8(b);
+                }
+                vst1q_s16(dst + i, vcombine_s16(floatToS16x4(vreinterpretq_f32_u8(a)),
+                                                floatToS16x4(vreinterpretq_f32_u8(b))));
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return i;
+}
+
+#else
+
+static size_t simdConvert(const uint8_t*, PcmEncoding, int16_t*, size_t) {
+    return 0;
+}
+
+#endif
+
+// -----------------------------
+// convertPcmToS16()
+// -----------------------------
+void convertPcmToS16(const uint8_t* src, PcmEncoding encoding, int16_t* dst, size_t samples) {
+#if PCM_HOST_LITTLE_ENDIAN
+    if (encoding == PcmEncoding::S16LE) {
+        std::memcpy(dst, src, samples * sizeof(int16_t));
+        return;
+    }
+#endif
+    size_t i = simdConvert(src, encoding, dst, samples);
+    const size_t width = pcmBytesPerSample(encoding);
+    const uint8_t* p = src + i * width;
+
+    switch (encoding) {
+        case PcmEncoding::U8:
+            for (; i < samples; ++i, ++p) dst[i] = static_cast<int16_t>((p[0] - 128) * 256);
+            break;
+        case PcmEncoding::S8:
+            for (; i < samples; ++i, ++p) dst[i] = static_cast<int16_t>(static_cast<int8_t>(p[0]) * 256);
+            break;
+        case PcmEncoding::S16LE:
+            for (; i < samples; ++i, p += 2) dst[i] = s16FromBytes(p[0], p[1]);
+            break;
+        case PcmEncoding::S16BE:
+            for (; i < samples; ++i, p += 2) dst[i] = s16FromBytes(p[1], p[0]);
+            break;
+        case PcmEncoding::S24LE:
+            for (; i < samples; ++i, p += 3) dst[i] = s16FromBytes(p[1], p[2]);
+            break;
+        case PcmEncoding::S24BE:
+            for (; i < samples; ++i, p += 3) dst[i] = s16FromBytes(p[1], p[0]);
+            break;
+        case PcmEncoding::S32LE:
+            for (; i < samples; ++i, p += 4) dst[i] = s16FromBytes(p[2], p[3]);
+            break;
+        case PcmEncoding::S32BE:
+            for (; i < samples; ++i, p += 4) dst[i] = s16FromBytes(p[1], p[0]);
+            break;
+        case PcmEncoding::F32LE:
+            for (; i < samples; ++i, p += 4) dst[i] = s16FromFloat(floatFromBytes(p[0], p[1], p[2], p[3]));
+            break;
+        case PcmEncoding::F32BE:
+            for (; i < samples; ++i, p += 4) dst[i] = s16FromFloat(floatFromBytes(p[3], p[2], p[1], p[0]));
+            break;
+    }
+}
+
+// -----------------------------
+// S16LE / S24LE -> float variants
+// -----------------------------
+// Each variant does whole vectors and passes the rest to the next narrower
+// one; all produce identical output (exact int -> float, power-of-two scale).
+static inline int32_t s32FromBytes(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3) {
+    return static_cast<int32_t>(static_cast<uint32_t>(b0) | (static_cast<uint32_t>(b1) << 8) |
+                                (static_cast<uint32_t>(b2) << 16) | (static_cast<uint32_t>(b3) << 24));
+}
+
+static void s16ToFloatBase(const uint8_t* src, float* dst, size_t samples) {
+    const float scale = 1.0f / 32768.0f;
+    size_t i = 0;
+#if defined(PCM_USE_NEON)
+    for (; i + 8 <= samples; i += 8) {
+        int16x8_t v = vreinterpretq_s16_u8(vld1q_u8(src + i * 2));
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+    }
+#endif
+    for (; i < samples; ++i) dst[i] = s16FromBytes(src[i * 2], src[i * 2 + 1]) * scale;
+}
+
+static void s24ToFloatBase(const uint8_t* src, float* dst, size_t samples) {
+    // Placed in the top of an int32 and scaled by 2^-31.
+    const float scale = 1.0f / 2147483648.0f;
+    const uint8_t* p = src;
+    for (size_t i = 0; i < samples; ++i, p += 3) dst[i] = s32FromBytes(0, p[0], p[1], p[2]) * scale;
+}
+
+#if defined(PCM_USE_SSE2)
+static void s16ToFloatSse2(const uint8_t* src, float* dst, size_t samples) {
+    const __m128 vscale = _mm_set1_ps(1.0f / 32768.0f);
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        // Sign-extend by placing each int16 in the top half of an int32.
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+    }
+    s16ToFloatBase(src + i * 2, dst + i, samples - i);
+}
+
+static void s24ToFloatSse2(const uint8_t* src, float* dst, size_t samples) {
+    const __m128 vscale = _mm_set1_ps(1.0f / 2147483648.0f);
+    size_t i = 0;
+    // 4-byte reads per sample: the last one ends a byte past the group.
+    for (; i * 3 + 13 <= samples * 3; i += 4) {
+        const uint8_t* p = src + i * 3;
+        int32_t l[4];
+        for (int k = 0; k < 4; ++k) std::memcpy(&l[k], p + k * 3, 4);
+        __m128i lo = _mm_unpacklo_epi32(_mm_cvtsi32_si128(l[0]), _mm_cvtsi32_si128(l[1]));
+        __m128i hi = _mm_unpacklo_epi32(_mm_cvtsi32_si128(l[2]), _mm_cvtsi32_si128(l[3]));
+        __m128i w = _mm_slli_epi32(_mm_unpacklo_epi64(lo, hi), 8);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(w), vscale));
+    }
+    s24ToFloatBase(src + i * 3, dst + i, samples - i);
+}
+#endif
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+PCM_TARGET_AVX2 static void s16ToFloatAvx2(const uint8_t* src, float* dst, size_t samples) {
+    const __m256 vscale = _mm256_set1_ps(1.0f / 32768.0f);
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2 + 16));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a)), vscale));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b)), vscale));
+    }
+    s16ToFloatSse2(src + i * 2, dst + i, samples - i);
+}
+
+PCM_TARGET_AVX2 static void s24ToFloatAvx2(const uint8_t* src, float* dst, size_t samples) {
+    const __m256 vscale = _mm256_set1_ps(1.0f / 2147483648.0f);
+    // 24 bytes loaded exactly (16 + 8), 12 per lane, each sample moved to
+    // the top 24 bits of its dword.
+    const __m256i split = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+    const __m256i unpack = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        const uint8_t* p = src + i * 3;
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i b = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + 16));
+        __m256i w = _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1);
+        w = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(w, split), unpack);
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(w), vscale));
+    }
+    s24ToFloatSse2(src + i * 3, dst + i, samples - i);
+}
+
+// GCC 12's AVX-512 headers trip -Wmaybe-uninitialized on their own
+// _mm512_undefined_*() placeholders (GCC PR105593).
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+PCM_TARGET_AVX512 static void s16ToFloatAvx512(const uint8_t* src, float* dst, size_t samples) {
+    const __m512 vscale = _mm512_set1_ps(1.0f / 32768.0f);
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        __m512i w = _mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 2)));
+        _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_cvtepi32_ps(w), vscale));
+    }
+    s16ToFloatAvx2(src + i * 2, dst + i, samples - i);
+}
+
+PCM_TARGET_AVX512 static void s24ToFloatAvx512(const uint8_t* src, float* dst, size_t samples) {
+    const __m512 vscale = _mm512_set1_ps(1.0f / 2147483648.0f);
+    const __m512i split = _mm512_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0, 6, 7, 8, 0, 9, 10, 11, 0);
+    const __m512i unpack = _mm512_broadcast_i32x4(_mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11));
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        // Masked load of exactly 48 bytes.
+        __m512i w = _mm512_maskz_loadu_epi32(0x0FFF, src + i * 3);
+        w = _mm512_shuffle_epi8(_mm512_permutexvar_epi32(split, w), unpack);
+        _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_cvtepi32_ps(w), vscale));
+    }
+    s24ToFloatAvx2(src + i * 3, dst + i, samples - i);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif // MUSIC_PLAYER_X86_DISPATCH
+
+PcmToFloatKernel selectPcmToFloat(PcmEncoding encoding, SimdLevel level) {
+    if (encoding != PcmEncoding::S16LE && encoding != PcmEncoding::S24LE) return { nullptr, nullptr };
+    const bool s16 = encoding == PcmEncoding::S16LE;
+    if (level > detectedSimdLevel()) level = detectedSimdLevel();
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+    if (level >= SimdLevel::AVX512) return { s16 ? s16ToFloatAvx512 : s24ToFloatAvx512, "avx512" };
+    if (level >= SimdLevel::AVX2) return { s16 ? s16ToFloatAvx2 : s24ToFloatAvx2, "avx2" };
+#endif
+#if defined(PCM_USE_SSE2)
+    if (level >= SimdLevel::SSE2) return { s16 ? s16ToFloatSse2 : s24ToFloatSse2, "sse2" };
+#endif
+#if defined(PCM_USE_NEON)
+    if (s16) return { s16ToFloatBase, "neon" };
+#endif
+    return { s16 ? s16ToFloatBase : s24ToFloatBase, "scalar" };
+}
+
+// -----------------------------
+// convertS16ToFloat()
+// -----------------------------
+void convertS16ToFloat(const int16_t* src, float* dst, size_t samples) {
+#if PCM_HOST_LITTLE_ENDIAN
+    selectPcmToFloat(PcmEncoding::S16LE, simdLevel()).convert(reinterpret_cast<const uint8_t*>(src), dst, samples);
+#else
+    for (size_t i = 0; i < samples; ++i) dst[i] = static_cast<float>(src[i]) * (1.0f / 32768.0f);
+#endif
+}
+
+// -----------------------------
+// convertPcmToFloat()
+// -----------------------------
+void convertPcmToFloat(const uint8_t* src, PcmEncoding encoding, float* dst, size_t samples) {
+    const size_t width = pcmBytesPerSample(encoding);
+    const uint8_t* p = src;
+    // Integer formats are placed in the top of an int32 and scaled by 2^-31.
+    const float scale = 1.0f / 2147483648.0f;
+    switch (encoding) {
+        case PcmEncoding::S16LE:
+        case PcmEncoding::S24LE:
+            // Byte-addressed kernels: any alignment, any host byte order.
+            selectPcmToFloat(encoding, simdLevel()).convert(src, dst, samples);
+            return;
+        case PcmEncoding::U8:
+        case PcmEncoding::S8:
+        case PcmEncoding::S16BE: {
+            // No extra resolution: go through int16.
+            int16_t tmp[256];
+            for (size_t i = 0; i < samples; i += 256) {
+                size_t n = samples - i < 256 ? samples - i : 256;
+                convertPcmToS16(src + i * width, encoding, tmp, n);
+                convertS16ToFloat(tmp, dst + i, n);
+            }
+            return;
+        }
+        case PcmEncoding::S24BE:
+            for (size_t i = 0; i < samples; ++i, p += 3) dst[i] = s32FromBytes(0, p[2], p[1], p[0]) * scale;
+            return;
+        case PcmEncoding::S32LE:
+            for (size_t i = 0; i < samples; ++i, p += 4) dst[i] = s32FromBytes(p[0], p[1], p[2], p[3]) * scale;
+            return;
+        case PcmEncoding::S32BE:
+            for (size_t i = 0; i < samples; ++i, p += 4) dst[i] = s32FromBytes(p[3], p[2], p[1], p[0]) * scale;
+            return;
+        case PcmEncoding::F32LE:
+            for (size_t i = 0; i < samples; ++i, p += 4) dst[i] = floatFromBytes(p[0], p[1], p[2], p[3]);
+            return;
+        case PcmEncoding::F32BE:
+            for (size_t i = 0; i < samples; ++i, p += 4) dst[i] = floatFromBytes(p[3], p[2], p[1], p[0]);
+            return;
+    }
+}
+
+// -----------------------------
+// convertFloatToS16()
+// -----------------------------
+void convertFloatToS16(const float* src, int16_t* dst, size_t samples) {
+#if PCM_HOST_LITTLE_ENDIAN
+    convertPcmToS16(reinterpret_cast<const uint8_t*>(src), PcmEncoding::F32LE, dst, samples);
+#else
+    for (size_t i = 0; i < samples; ++i) dst[i] = s16FromFloat(src[i]);
+#endif
+}
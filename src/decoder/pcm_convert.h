@@ -0,0 +1,68 @@
+#pragma once
+/*
+ pcm_convert.h
+
+ Purpose:
+   - Convert raw PCM sample storage (as found in WAV/AIFF data chunks) to the
+     engine's interleaved int16 format in one pass.
+   - Convert the same sources to normalized float at full resolution for the
+     float (hi-res) path, and move between engine int16 and float.
+   - SSE2 (x86-64 baseline) and NEON paths process 8-16 samples per step;
+     a scalar loop handles tails and other targets. 24-bit input uses SSSE3
+     byte shuffles when the compiler targets SSSE3, scalar otherwise.
+   - The 16- and 24-bit little-endian -> float kernels (the bulk of the
+     float path) also have AVX2 and AVX-512 variants, picked at run time by
+     simdLevel() (cpu_features.h).
+
+ Notes:
+   - Source pointers may be unaligned (mmap + arbitrary chunk offsets).
+   - Integer inputs wider than 16 bits are truncated to their top 16 bits;
+     float input is scaled by 32768, rounded and saturated.
+*/
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../utils/cpu_features.h"
+
+enum class PcmEncoding {
+    U8,      // unsigned 8-bit (WAV)
+    S8,      // signed 8-bit (AIFF)
+    S16LE,
+    S16BE,
+    S24LE,   // packed 3-byte
+    S24BE,
+    S32LE,
+    S32BE,
+    F32LE,
+    F32BE
+};
+
+// Bytes one sample of `encoding` occupies.
+size_t pcmBytesPerSample(PcmEncoding encoding);
+
+// Convert `samples` samples from `src` to `dst`.
+void convertPcmToS16(const uint8_t* src, PcmEncoding encoding, int16_t* dst, size_t samples);
+
+// Convert `samples` samples from `src` to float in [-1, 1) without
+// dropping bits (24-bit and 32-bit integers keep their full precision up to
+// float's 24-bit mantissa).
+void convertPcmToFloat(const uint8_t* src, PcmEncoding encoding, float* dst, size_t samples);
+
+// Engine int16 -> float in [-1, 1) (x / 32768), e.g. for decodeFrames().
+void convertS16ToFloat(const int16_t* src, float* dst, size_t samples);
+
+// Host float -> int16 (scaled by 32768, rounded, saturated).
+void convertFloatToS16(const float* src, int16_t* dst, size_t samples);
+
+// One variant of a dispatched PCM -> float kernel.
+using PcmToFloatFn = void (*)(const uint8_t* src, float* dst, size_t samples);
+struct PcmToFloatKernel {
+    PcmToFloatFn convert;
+    const char* variant;   // "scalar"/"neon", "sse2", "avx2", "avx512"
+};
+
+// Widest S16LE / S24LE -> float variant at or below `level` (capped to the
+// host); {nullptr, nullptr} for encodings without dispatched variants.
+// convertPcmToFloat() and convertS16ToFloat() use simdLevel().
+PcmToFloatKernel selectPcmToFloat(PcmEncoding encoding, SimdLevel level);
@@ -0,0 +1,298 @@
+/**
+ * pcm_decoder.cpp
+ *
+ * RIFF/AIFF chunk parsing and mmap-backed decode for PcmDecoder.
+ */
+
+#include "pcm_decoder.h"
+#include "../utils/logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+static uint16_t le16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+static uint32_t le32(const uint8_t* p) { return le16(p) | (static_cast<uint32_t>(le16(p + 2)) << 16); }
+static uint64_t le64(const uint8_t* p) { return le32(p) | (static_cast<uint64_t>(le32(p + 4)) << 32); }
+static uint16_t be16(const uint8_t* p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+static uint32_t be32(const uint8_t* p) { return (static_cast<uint32_t>(be16(p)) << 16) | be16(p + 2); }
+
+// IEEE 754 80-bit extended (AIFF COMM sample rate).
+static double extended80(const uint8_t* p) {
+    int exponent = static_cast<int>(be16(p) & 0x7FFF);
+    uint64_t mantissa = (static_cast<uint64_t>(be32(p + 2)) << 32) | be32(p + 6);
+    if (exponent == 0 && mantissa == 0) return 0.0;
+    double v = std::ldexp(static_cast<double>(mantissa), exponent - 16383 - 63);
+    return (p[0] & 0x80) ? -v : v;
+}
+
+PcmDecoder::PcmDecoder()
+    : encoding_(PcmEncoding::S16LE),
+      sample_rate_(0),
+      channels_(0),
+      frame_bytes_(0),
+      data_offset_(0),
+      total_frames_(0),
+      next_frame_(0),
+      decode_position_(-1)
+{}
+
+PcmDecoder::~PcmDecoder() {
+    close();
+}
+
+bool PcmDecoder::open(const std::string& filepath) {
+    close();
+
+    std::string source = resolveSource(filepath);
+    if (!file_.open(source)) {
+        Logger::instance().log(LogLevel::ERROR, "PcmDecoder: cannot map " + source);
+        return false;
+    }
+
+    const uint8_t* d = file_.data();
+    bool ok = false;
+    if (file_.size() >= 12 && (std::memcmp(d, "RIFF", 4) == 0 || std::memcmp(d, "RF64", 4) == 0) &&
+        std::memcmp(d + 8, "WAVE", 4) == 0) {
+        ok = parseWav();
+    } else if (file_.size() >= 12 && std::memcmp(d, "FORM", 4) == 0 &&
+               (std::memcmp(d + 8, "AIFF", 4) == 0 || std::memcmp(d + 8, "AIFC", 4) == 0)) {
+        ok = parseAiff();
+    }
+
+    if (!ok || sample_rate_ <= 0 || channels_ <= 0 || total_frames_ == 0) {
+        Logger::instance().log(LogLevel::INFO, "PcmDecoder: not a supported PCM file: " + source);
+        close();
+        return false;
+    }
+
+    // Start the readahead window at the sample data rather than the header.
+    file_.seek(static_cast<int64_t>(data_offset_), SEEK_SET);
+
+    Logger::instance().log(LogLevel::INFO, "PcmDecoder: Opened successfully. SR=" + std::to_string(sample_rate_) +
+        " CH=" + std::to_string(channels_) + " bytes/sample=" + std::to_string(pcmBytesPerSample(encoding_)));
+    return true;
+}
+
+// Clamp the data chunk to the file and derive the frame count. Truncated
+// files and streaming writers that leave the size at 0 or 0xFFFFFFFF are
+// common, so the file end wins over the header.
+static uint64_t framesInRange(uint64_t offset, uint64_t declared, uint64_t fileSize, size_t frameBytes) {
+    if (offset >= fileSize || frameBytes == 0) return 0;
+    uint64_t available = fileSize - offset;
+    uint64_t bytes = (declared == 0 || declared > available) ? available : declared;
+    return bytes / frameBytes;
+}
+
+// -----------------------------
+// WAV / RF64
+// -----------------------------
+bool PcmDecoder::parseWav() {
+    const uint8_t* d = file_.data();
+    const uint64_t size = file_.size();
+
+    uint64_t ds64DataSize = 0;
+    bool haveFormat = false;
+    uint64_t pos = 12;
+    while (pos + 8 <= size) {
+        const uint8_t* c = d + pos;
+        uint64_t chunkSize = le32(c + 4);
+
+        if (std::memcmp(c, "ds64", 4) == 0 && chunkSize >= 24 && pos + 8 + 24 <= size) {
+            ds64DataSize = le64(c + 16);
+        } else if (std::memcmp(c, "fmt ", 4) == 0) {
+            if (chunkSize < 16 || pos + 8 + 16 > size) return false;
+            uint16_t tag = le16(c + 8);
+            channels_ = le16(c + 10);
+            sample_rate_ = static_cast<int>(le32(c + 12));
+            uint16_t blockAlign = le16(c + 20);
+            uint16_t bits = le16(c + 22);
+            // WAVE_FORMAT_EXTENSIBLE: the real tag is the first two bytes of
+            // the SubFormat GUID.
+            if (tag == 0xFFFE && chunkSize >= 40 && pos + 8 + 40 <= size) {
+                tag = le16(c + 32);
+            }
+            if (channels_ <= 0 || blockAlign == 0 || blockAlign % channels_ != 0) return false;
+
+            // Container width decides the layout; e.g. 20-bit samples are
+            // left-justified in 3 bytes.
+            size_t width = blockAlign / channels_;
+            if (tag == 1) {
+                switch (width) {
+                    case 1: encoding_ = PcmEncoding::U8; break;
+                    case 2: encoding_ = PcmEncoding::S16LE; break;
+                    case 3: encoding_ = PcmEncoding::S24LE; break;
+                    case 4: encoding_ = PcmEncoding::S32LE; break;
+                    default: return false;
+                }
+            } else if (tag == 3 && bits == 32 && width == 4) {
+                encoding_ = PcmEncoding::F32LE;
+            } else {
+                return false;
+            }
+            frame_bytes_ = blockAlign;
+            haveFormat = true;
+        } else if (std::memcmp(c, "data", 4) == 0) {
+            if (!haveFormat) return false;
+            if (chunkSize == 0xFFFFFFFFULL && ds64DataSize) chunkSize = ds64DataSize;
+            data_offset_ = pos + 8;
+            total_frames_ = framesInRange(data_offset_, chunkSize, size, frame_bytes_);
+            return true;
+        }
+        pos += 8 + chunkSize + (chunkSize & 1);
+    }
+    return false;
+}
+
+// -----------------------------
+// AIFF / AIFF-C
+// -----------------------------
+bool PcmDecoder::parseAiff() {
+    const uint8_t* d = file_.data();
+    const uint64_t size = file_.size();
+    const bool aifc = std::memcmp(d + 8, "AIFC", 4) == 0;
+
+    uint64_t commFrames = 0;
+    bool haveFormat = false;
+    uint64_t pos = 12;
+    while (pos + 8 <= size) {
+        const uint8_t* c = d + pos;
+        uint64_t chunkSize = be32(c + 4);
+
+        if (std::memcmp(c, "COMM", 4) == 0) {
+            if (chunkSize < 18 || pos + 8 + 18 > size) return false;
+            channels_ = be16(c + 8);
+            commFrames = be32(c + 10);
+            int bits = be16(c + 14);
+            double rate = extended80(c + 16);
+            if (rate <= 0.0 || rate > 1e7 || bits <= 0 || bits > 32) return false;
+            sample_rate_ = static_cast<int>(rate + 0.5);
+
+            size_t width = static_cast<size_t>(bits + 7) / 8;
+            char compression[4] = { 'N', 'O', 'N', 'E' };
+            if (aifc) {
+                if (chunkSize < 22 || pos + 8 + 22 > size) return false;
+                std::memcpy(compression, c + 26, 4);
+            }
+            static const PcmEncoding bigEndian[] = { PcmEncoding::S8, PcmEncoding::S16BE, PcmEncoding::S24BE, PcmEncoding::S32BE };
+            if (std::memcmp(compression, "NONE", 4) == 0 || std::memcmp(compression, "twos", 4) == 0) {
+                encoding_ = bigEndian[width - 1];
+            } else if (std::memcmp(compression, "sowt", 4) == 0 && width >= 2) {
+                static const PcmEncoding littleEndian[] = { PcmEncoding::S16LE, PcmEncoding::S24LE, PcmEncoding::S32LE };
+                encoding_ = littleEndian[width - 2];
+            } else if (std::memcmp(compression, "raw ", 4) == 0 && width == 1) {
+                encoding_ = PcmEncoding::U8;
+            } else if (std::memcmp(compression, "in24", 4) == 0) {
+                encoding_ = PcmEncoding::S24BE;
+                width = 3;
+            } else if (std::memcmp(compression, "in32", 4) == 0) {
+                encoding_ = PcmEncoding::S32BE;
+                width = 4;
+            } else if (std::memcmp(compression, "fl32", 4) == 0 || std::memcmp(compression, "FL32", 4) == 0) {
+                encoding_ = PcmEncoding::F32BE;
+                width = 4;
+            } else {
+                return false;
+            }
+            if (channels_ <= 0) return false;
+            frame_bytes_ = width * static_cast<size_t>(channels_);
+            haveFormat = true;
+        } else if (std::memcmp(c, "SSND", 4) == 0) {
+            if (chunkSize < 8 || pos + 16 > size) return false;
+            uint32_t offset = be32(c + 8);
+            data_offset_ = pos + 16 + offset;
+            uint64_t dataBytes = chunkSize - 8 >= offset ? chunkSize - 8 - offset : 0;
+            if (haveFormat) {
+                total_frames_ = framesInRange(data_offset_, dataBytes, size, frame_bytes_);
+                if (commFrames) total_frames_ = std::min<uint64_t>(total_frames_, commFrames);
+                return true;
+            }
+            // COMM after SSND is legal; keep scanning and fix up below.
+            total_frames_ = dataBytes;
+        }
+        pos += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    if (haveFormat && data_offset_ != 0) {
+        total_frames_ = framesInRange(data_offset_, total_frames_, size, frame_bytes_);
+        if (commFrames) total_frames_ = std::min<uint64_t>(total_frames_, commFrames);
+        return true;
+    }
+    return false;
+}
+
+// -----------------------------
+// decode()
+// -----------------------------
+int PcmDecoder::decode(std::vector<int16_t>& out_buffer) {
+    if (!file_.isOpen() || next_frame_ >= total_frames_) {
+        return 0;
+    }
+
+    size_t frames = static_cast<size_t>(std::min<uint64_t>(kFramesPerDecode, total_frames_ - next_frame_));
+    size_t samples = frames * static_cast<size_t>(channels_);
+
+    // Reading through the cursor keeps the mapping's WILLNEED window ahead
+    // of playback. open() left the cursor at data_offset_.
+    size_t bytes = frames * frame_bytes_;
+    const uint8_t* src = file_.consume(bytes);
+
+    size_t start = out_buffer.size();
+    out_buffer.resize(start + samples);
+    convertPcmToS16(src, encoding_, out_buffer.data() + start, samples);
+
+    decode_position_ = static_cast<int64_t>(next_frame_);
+    next_frame_ += frames;
+    return static_cast<int>(samples);
+}
+
+int PcmDecoder::decodeFloat(std::vector<float>& out_buffer) {
+    if (!file_.isOpen() || next_frame_ >= total_frames_) {
+        return 0;
+    }
+
+    size_t frames = static_cast<size_t>(std::min<uint64_t>(kFramesPerDecode, total_frames_ - next_frame_));
+    size_t samples = frames * static_cast<size_t>(channels_);
+    size_t bytes = frames * frame_bytes_;
+    const uint8_t* src = file_.consume(bytes);
+
+    size_t start = out_buffer.size();
+    out_buffer.resize(start + samples);
+    convertPcmToFloat(src, encoding_, out_buffer.data() + start, samples);
+
+    decode_position_ = static_cast<int64_t>(next_frame_);
+    next_frame_ += frames;
+    return static_cast<int>(samples);
+}
+
+bool PcmDecoder::seek(double seconds) {
+    discardBufferedFrames();
+    if (!file_.isOpen() || seconds < 0.0) {
+        return false;
+    }
+    uint64_t frame = static_cast<uint64_t>(std::llround(seconds * sample_rate_));
+    if (frame > total_frames_) {
+        return false;
+    }
+    next_frame_ = frame;
+    file_.seek(static_cast<int64_t>(data_offset_ + next_frame_ * frame_bytes_), SEEK_SET);
+    return true;
+}
+
+double PcmDecoder::getDuration() const {
+    return sample_rate_ > 0 ? static_cast<double>(total_frames_) / sample_rate_ : 0.0;
+}
+
+void PcmDecoder::close() {
+    discardBufferedFrames();
+    file_.close();
+    encoding_ = PcmEncoding::S16LE;
+    sample_rate_ = 0;
+    channels_ = 0;
+    frame_bytes_ = 0;
+    data_offset_ = 0;
+    total_frames_ = 0;
+    next_frame_ = 0;
+    decode_position_ = -1;
+}
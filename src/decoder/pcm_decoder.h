@@ -0,0 +1,60 @@
+#pragma once
+/**
+ * pcm_decoder.h
+ *
+ * Native decoder for uncompressed WAV and AIFF files.
+ *
+ * Avoids the FFmpeg probe / codec / resampler setup for files that only
+ * need a byte-format conversion: the file is memory-mapped (MappedFile),
+ * the RIFF or AIFF chunk list is parsed to find the sample format and the
+ * data range, and decode() converts straight from the mapping to int16
+ * (decodeFloat(): to float at full resolution; pcm_convert.h).
+ *
+ * Supported:
+ *   - WAV / RF64 / WAVE_FORMAT_EXTENSIBLE: 8/16/24/32-bit int, 32-bit float
+ *   - AIFF and AIFF-C (NONE, twos, sowt, in24, in32, fl32, raw)
+ *
+ * open() fails for anything else (ADPCM, A-law, 64-bit float, ...) so that
+ * AudioDecoder::openFile() can fall back to FFmpegDecoder.
+ */
+
+#include "audio_decoder.h"
+#include "pcm_convert.h"
+#include "../io/mapped_file.h"
+
+class PcmDecoder : public AudioDecoder {
+public:
+    PcmDecoder();
+    ~PcmDecoder() override;
+
+    bool open(const std::string& filepath) override;
+    int decode(std::vector<int16_t>& out_buffer) override;
+    int decodeFloat(std::vector<float>& out_buffer) override;
+    void close() override;
+
+    int getSampleRate() const override { return sample_rate_; }
+    int getChannels() const override { return channels_; }
+    double getDuration() const override;
+    const char* name() const override { return "pcm"; }
+    bool seek(double seconds) override;
+    int64_t getDecodePosition() const override { return decode_position_; }
+    int getSourceBits() const override { return static_cast<int>(pcmBytesPerSample(encoding_) * 8); }
+
+    // Frames converted per decode() call (~93 ms at 44.1 kHz).
+    static constexpr size_t kFramesPerDecode = 4096;
+
+private:
+    bool parseWav();
+    bool parseAiff();
+
+private:
+    MappedFile file_;
+    PcmEncoding encoding_;
+    int sample_rate_;
+    int channels_;
+    size_t frame_bytes_;     // bytes per interleaved frame in the file
+    uint64_t data_offset_;   // first sample byte
+    uint64_t total_frames_;
+    uint64_t next_frame_;    // decode position
+    int64_t decode_position_;  // first frame of the last decode() (-1 before)
+};
@@ -0,0 +1,252 @@
+/**
+ * segment_decoder.cpp
+ *
+ * Segment-parallel decode with overlap-and-trim stitching. See
+ * segment_decoder.h.
+ */
+
+#include "segment_decoder.h"
+#include "ffmpeg_decoder.h"
+#include "../utils/logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <thread>
+
+// Frames compared when aligning a segment with the output before it.
+static constexpr int64_t kAlignFrames = 1024;
+// Accepted mean absolute difference per sample over the compared frames.
+// Lossless codecs match exactly; lossy ones match once the pre-roll has
+// settled the decoder state.
+static constexpr int64_t kAlignTolerance = 1;
+// Mean absolute frame-to-frame change per sample the compared output must
+// show: a wrong lag of one frame costs about that much per sample, so a
+// quieter (or silent) window would accept any lag.
+static constexpr int64_t kMinAlignActivity = 4 * kAlignTolerance;
+// Longest window compared: quiet windows grow from kAlignFrames up to this
+// (~0.7 s at 44.1 kHz) before the file falls back to a sequential decode.
+static constexpr int64_t kMaxAlignFrames = 32768;
+
+static constexpr int64_t kUntilEof = std::numeric_limits<int64_t>::max();
+
+SegmentDecoder::SegmentDecoder(unsigned threads)
+    : threads_(threads ? threads : std::max(1u, std::thread::hardware_concurrency())),
+      overlap_seconds_(1.0),
+      min_segment_seconds_(30.0),
+      staging_(nullptr),
+      sample_rate_(0),
+      channels_(0),
+      segments_used_(0)
+{}
+
+bool SegmentDecoder::decodeFile(const std::string& filepath, std::vector<int16_t>& out) {
+    out.clear();
+    sample_rate_ = 0;
+    channels_ = 0;
+    segments_used_ = 0;
+
+    FFmpegDecoder probe;
+    probe.setStagingCache(staging_);
+    if (!probe.open(filepath)) {
+        return false;
+    }
+    sample_rate_ = probe.getSampleRate();
+    channels_ = probe.getChannels();
+    const double duration = probe.getDuration();
+    probe.close();
+
+    unsigned segments = 1;
+    if (duration > 0.0 && min_segment_seconds_ > 0.0) {
+        segments = static_cast<unsigned>(std::min<double>(threads_, std::floor(duration / min_segment_seconds_)));
+    }
+    if (segments < 2) {
+        return decodeSequential(filepath, out);
+    }
+
+    const int64_t total = static_cast<int64_t>(std::llround(duration * sample_rate_));
+    std::vector<Segment> parts(segments);
+    for (unsigned i = 0; i < segments; ++i) {
+        parts[i].start = total * i / segments;
+        parts[i].end = i + 1 < segments ? total * (i + 1) / segments : kUntilEof;
+    }
+
+    std::atomic<unsigned> next(0);
+    auto worker = [&]() {
+        for (unsigned i = next++; i < segments; i = next++) {
+            decodeSegment(filepath, parts[i]);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < std::min(threads_, segments); ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& th : pool) {
+        th.join();
+    }
+
+    out.reserve(static_cast<size_t>(total + kMaxAlignLag) * channels_);
+    for (unsigned i = 0; i < segments; ++i) {
+        if (!parts[i].ok || !stitch(parts[i], out)) {
+            Logger::instance().log(LogLevel::WARNING, "SegmentDecoder: segment " + std::to_string(i) +
+                " could not be aligned, decoding sequentially: " + filepath);
+            return decodeSequential(filepath, out);
+        }
+        std::vector<int16_t>().swap(parts[i].pcm);
+    }
+    segments_used_ = segments;
+    return !out.empty();
+}
+
+bool SegmentDecoder::decodeSequential(const std::string& filepath, std::vector<int16_t>& out) {
+    out.clear();
+    FFmpegDecoder decoder;
+    decoder.setStagingCache(staging_);
+    decoder.setWorkload(DecodeWorkload::Offline);
+    if (!decoder.open(filepath)) {
+        return false;
+    }
+    sample_rate_ = decoder.getSampleRate();
+    channels_ = decoder.getChannels();
+    while (decoder.decode(out) > 0) {
+    }
+    segments_used_ = 1;
+    return !out.empty();
+}
+
+// -----------------------------
+// Per-segment decode (worker threads)
+// -----------------------------
+void SegmentDecoder::decodeSegment(const std::string& filepath, Segment& segment) const {
+    FFmpegDecoder decoder;
+    decoder.setStagingCache(staging_);
+    // Parallelism comes from the segments; codec threads would only contend.
+    decoder.setWorkload(DecodeWorkload::Offline, 1);
+    if (!decoder.open(filepath)) {
+        return;
+    }
+    const int64_t channels = channels_;
+
+    // Keep enough ahead of `start` for stitch() to search every lag, and
+    // decode `overlap` more before that to let the codec settle.
+    int64_t keepFrom = 0;
+    if (segment.start > 0) {
+        keepFrom = std::max<int64_t>(0, segment.start - kMaxAlignFrames - kMaxAlignLag);
+        int64_t preroll = static_cast<int64_t>(overlap_seconds_ * sample_rate_);
+        double seekTo = static_cast<double>(std::max<int64_t>(0, keepFrom - preroll)) / sample_rate_;
+        if (!decoder.seek(seekTo)) {
+            return;
+        }
+    }
+    const int64_t stopAt = segment.end == kUntilEof ? kUntilEof : segment.end + kMaxAlignLag;
+
+    std::vector<int16_t> chunk;
+    while (true) {
+        chunk.clear();
+        int n = decoder.decode(chunk);
+        if (n <= 0) {
+            break;
+        }
+        int64_t position = decoder.getDecodePosition();
+        if (position < 0) {
+            return;   // no timestamps: cannot place the samples
+        }
+        int64_t frames = n / channels;
+        if (segment.pcm.empty()) {
+            if (position + frames <= keepFrom) {
+                continue;   // still in the pre-roll
+            }
+            if (position > keepFrom) {
+                return;     // seek landed past the samples we need
+            }
+            segment.firstPosition = keepFrom;
+            segment.pcm.assign(chunk.begin() + (keepFrom - position) * channels, chunk.end());
+        } else {
+            segment.pcm.insert(segment.pcm.end(), chunk.begin(), chunk.end());
+        }
+        if (position + frames >= stopAt) {
+            break;
+        }
+    }
+    segment.ok = !segment.pcm.empty();
+}
+
+// -----------------------------
+// Stitching
+// -----------------------------
+bool SegmentDecoder::stitch(Segment& segment, std::vector<int16_t>& out) const {
+    const int64_t channels = channels_;
+    const int64_t have = static_cast<int64_t>(out.size()) / channels;
+    const int64_t available = static_cast<int64_t>(segment.pcm.size()) / channels;
+    if (have != segment.start) {
+        return false;   // the previous segment ended early
+    }
+
+    // Offset of this decoder's positions from the true ones: compare the
+    // last `compare` frames of `out` with the segment at each lag. The window
+    // doubles while it is too quiet to tell lags apart (a gap between tracks);
+    // still quiet at kMaxAlignFrames, the segment cannot be placed.
+    int64_t lag = 0;
+    int64_t compare = std::min(kAlignFrames, have);
+    auto activity = [&](int64_t frames) {
+        const int16_t* x = out.data() + (have - frames) * channels;
+        int64_t sum = 0;
+        for (int64_t i = channels; i < frames * channels; ++i) {
+            sum += std::abs(static_cast<int>(x[i]) - static_cast<int>(x[i - channels]));
+        }
+        return sum;
+    };
+    while (compare > 0 && activity(compare) < kMinAlignActivity * compare * channels) {
+        const int64_t longer = std::min(std::min(2 * compare, kMaxAlignFrames), have);
+        if (longer == compare) {
+            Logger::instance().log(LogLevel::INFO, "SegmentDecoder: output before frame " +
+                std::to_string(segment.start) + " is too quiet to align a segment");
+            return false;
+        }
+        compare = longer;
+    }
+    if (compare > 0) {
+        const int16_t* ref = out.data() + (have - compare) * channels;
+        const int64_t tolerance = kAlignTolerance * compare * channels;
+        auto mismatch = [&](int64_t l, int64_t limit) {
+            int64_t from = have - compare + l - segment.firstPosition;
+            if (from < 0 || from + compare > available) {
+                return kUntilEof;
+            }
+            const int16_t* cand = segment.pcm.data() + from * channels;
+            int64_t sum = 0;
+            for (int64_t i = 0; i < compare * channels && sum <= limit; ++i) {
+                sum += std::abs(static_cast<int>(ref[i]) - static_cast<int>(cand[i]));
+            }
+            return sum;
+        };
+
+        int64_t best = mismatch(0, tolerance);
+        for (int64_t step = 1; step <= kMaxAlignLag && best > tolerance; ++step) {
+            for (int64_t l : { step, -step }) {
+                int64_t m = mismatch(l, best);
+                if (m < best) {
+                    best = m;
+                    lag = l;
+                }
+            }
+        }
+        if (best > tolerance) {
+            return false;
+        }
+        if (lag != 0) {
+            Logger::instance().log(LogLevel::INFO, "SegmentDecoder: corrected seek timestamp by " + std::to_string(lag) + " frames");
+        }
+    }
+
+    int64_t from = segment.start + lag - segment.firstPosition;
+    int64_t to = segment.end == kUntilEof ? available : segment.end + lag - segment.firstPosition;
+    if (from < 0 || to > available || to < from) {
+        return false;
+    }
+    out.insert(out.end(), segment.pcm.begin() + from * channels, segment.pcm.begin() + to * channels);
+    return true;
+}
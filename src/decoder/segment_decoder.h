@@ -0,0 +1,89 @@
+#pragma once
+/**
+ * segment_decoder.h
+ *
+ * Segment-parallel decode of a single file for offline jobs (analysis,
+ * transcoding, cache fills).
+ *
+ * One FFmpegDecoder per file leaves cores idle on long tracks. SegmentDecoder
+ * splits a seekable file into N time segments and decodes each with its own
+ * FFmpegDecoder on a worker pool:
+ *
+ *   - Every segment after the first seeks `overlap` seconds ahead of its
+ *     start, so the codec has settled (MP3 bit reservoir, MDCT overlap, AAC
+ *     pre-roll) before the samples that are kept.
+ *   - Segments are stitched in order. Before a segment is appended, the tail
+ *     of its pre-roll is matched against the tail of the output so far; the
+ *     best lag within +/- kMaxAlignLag frames corrects containers whose
+ *     post-seek timestamps are approximate. The overlap is then trimmed, so
+ *     the result equals a single sequential decode. A quiet or silent tail
+ *     would match any lag, so the compared window grows until it has
+ *     enough signal; if it never does, the segment is not stitched.
+ *   - Files that are short, not seekable, have no timestamps, or whose
+ *     segments cannot be aligned are decoded sequentially instead.
+ *
+ * Output is interleaved int16, as from AudioDecoder::decode(). All segments
+ * are held in memory until stitched, so peak memory is about twice the
+ * decoded size.
+ */
+
+#include "audio_decoder.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class StagingCache;  // io/staging_cache.h
+
+class SegmentDecoder {
+public:
+    // threads: worker count (0 = hardware concurrency). The file is split
+    // into as many segments, but none shorter than setMinSegment().
+    explicit SegmentDecoder(unsigned threads = 0);
+
+    // Pre-roll decoded and discarded before each segment (default 1 s).
+    void setOverlap(double seconds) { overlap_seconds_ = seconds; }
+    // Shortest segment worth a decoder of its own (default 30 s).
+    void setMinSegment(double seconds) { min_segment_seconds_ = seconds; }
+    // Passed to every FFmpegDecoder (may be nullptr; not owned).
+    void setStagingCache(StagingCache* cache) { staging_ = cache; }
+
+    // Decode the whole of `filepath` into `out`. Returns false if the file
+    // cannot be decoded at all.
+    bool decodeFile(const std::string& filepath, std::vector<int16_t>& out);
+
+    // Output format and the number of segments used by the last decodeFile()
+    // (1 = sequential decode).
+    int getSampleRate() const { return sample_rate_; }
+    int getChannels() const { return channels_; }
+    unsigned getSegmentsUsed() const { return segments_used_; }
+
+    // Largest timestamp error corrected when stitching (frames; four MP3
+    // frames).
+    static constexpr int64_t kMaxAlignLag = 4608;
+
+private:
+    struct Segment {
+        int64_t start = 0;           // first output frame this segment supplies
+        int64_t end = 0;             // one past its last frame (INT64_MAX = EOF)
+        int64_t firstPosition = -1;  // decoder position of pcm[0]
+        std::vector<int16_t> pcm;    // pre-roll + segment + alignment slack
+        bool ok = false;
+    };
+
+    bool decodeSequential(const std::string& filepath, std::vector<int16_t>& out);
+    void decodeSegment(const std::string& filepath, Segment& segment) const;
+    // Append `segment` to `out`, correcting its timestamp offset; false if
+    // no lag makes the pre-roll match the output so far.
+    bool stitch(Segment& segment, std::vector<int16_t>& out) const;
+
+private:
+    unsigned threads_;
+    double overlap_seconds_;
+    double min_segment_seconds_;
+    StagingCache* staging_;
+
+    int sample_rate_;
+    int channels_;
+    unsigned segments_used_;
+};
@@ -0,0 +1,455 @@
+/*
+ convolver.cpp
+
+ Partitioning, the worker hand-off and the block loop. See convolver.h.
+
+ One level (partition P, first tap O, filters H_j = FFT of taps
+ O + jP .. O + (j+1)P - 1 padded to 2P):
+   - Every P input frames: X = FFT(previous block | this block) goes into the
+     delay line; Y = sum_j X[now - j] H_j; the last P samples of IFFT(Y) are
+     the level's output for the block, due O frames after the block's start.
+   - The head (O = 0) runs at once, so its output belongs to the same block.
+     A worker level (O = 2P) is handed its block when the block is complete
+     and its output is read during the block after next: the job posted at
+     the end of block t is waited for at the end of block t + 1.
+   - Each level double-buffers its input and output: the processing thread
+     collects into input[side] and reads output[side] while the job works on
+     the other pair.
+   - All of this is per channel (Level::Lane): a job is one level of one
+     channel, and a channel's head blocks do not wait for the others.
+*/
+
+#include "convolver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "../utils/thread_clock.h"
+
+namespace {
+
+// Band-limited resampling of an interleaved response (windowed sinc, 32
+// zero crossings each side, Blackman-Harris window). The gain is scaled by
+// the rate change so the frequency response stays the same.
+std::vector<float> resampleResponse(const std::vector<float>& in, size_t frames, int channels, double ratio) {
+    const double pi = 3.14159265358979323846;
+    const double cutoff = std::min(1.0, ratio);
+    const double halfWidth = 32.0 / cutoff;   // input samples each side
+    const size_t outFrames = std::min(Convolver::kMaxLength, static_cast<size_t>(std::ceil(frames * ratio)));
+    const size_t ch = static_cast<size_t>(channels);
+    std::vector<float> out(outFrames * ch, 0.0f);
+    std::vector<double> acc(ch);
+    for (size_t n = 0; n < outFrames; ++n) {
+        const double t = n / ratio;
+        const double first = std::max(0.0, std::ceil(t - halfWidth));
+        const double last = std::min(static_cast<double>(frames) - 1.0, std::floor(t + halfWidth));
+        std::fill(acc.begin(), acc.end(), 0.0);
+        for (double k = first; k <= last; k += 1.0) {
+            const double d = t - k;
+            const double x = cutoff * d;
+            const double sinc = std::fabs(x) < 1e-12 ? 1.0 : std::sin(pi * x) / (pi * x);
+            const double phase = pi * (d / halfWidth + 1.0);   // 0 .. 2 pi over the window
+            const double window = 0.35875 - 0.48829 * std::cos(phase) + 0.14128 * std::cos(2.0 * phase)
+                - 0.01168 * std::cos(3.0 * phase);
+            const float* frame = &in[static_cast<size_t>(k) * ch];
+            for (size_t c = 0; c < ch; ++c) acc[c] += frame[c] * sinc * window;
+        }
+        for (size_t c = 0; c < ch; ++c) out[n * ch + c] = static_cast<float>(acc[c] * cutoff / ratio);
+    }
+    return out;
+}
+
+} // namespace
+
+Convolver::Convolver()
+    : irFrames_(0),
+      irChannels_(0),
+      irRate_(0),
+      sampleRate_(0),
+      channels_(0),
+      length_(0),
+      tailLimit_(0),
+      variant_("scalar"),
+      fifoFill_(),
+      clock_(),
+      appliedMix_(),
+      blockMix_(1.0f),
+      mix_(1.0f),
+      stalls_(0),
+      inlineNanos_(0),
+      workerNanos_(0),
+      stop_(false)
+{}
+
+Convolver::~Convolver() {
+    stopWorker();
+}
+
+bool Convolver::setImpulseResponse(const float* samples, size_t frames, int channels, int sampleRate) {
+    clearImpulseResponse();
+    if (!samples || frames == 0 || frames > kMaxLength || channels < 1 || channels > kMaxChannels || sampleRate <= 0) {
+        return false;
+    }
+    ir_.assign(samples, samples + frames * static_cast<size_t>(channels));
+    irFrames_ = frames;
+    irChannels_ = channels;
+    irRate_ = sampleRate;
+    return true;
+}
+
+void Convolver::clearImpulseResponse() {
+    ir_.clear();
+    irFrames_ = 0;
+    irChannels_ = 0;
+    irRate_ = 0;
+}
+
+void Convolver::setMix(float wet) {
+    mix_.store(std::min(1.0f, std::max(0.0f, wet)), std::memory_order_relaxed);
+}
+
+// -----------------------------
+// Set-up
+// -----------------------------
+bool Convolver::prepare(int sampleRate, int channels) {
+    stopWorker();
+    levels_.clear();
+    length_ = 0;
+    tailLimit_ = 0;
+    if (channels < 1 || channels > kMaxChannels || sampleRate <= 0) return false;
+    sampleRate_ = sampleRate;
+    channels_ = channels;
+    if (irFrames_ == 0) return true;
+
+    // Response at the stream's rate
+    std::vector<float> resampled;
+    const std::vector<float>* response = &ir_;
+    size_t frames = irFrames_;
+    if (irRate_ != sampleRate) {
+        resampled = resampleResponse(ir_, irFrames_, irChannels_, static_cast<double>(sampleRate) / irRate_);
+        response = &resampled;
+        frames = resampled.size() / static_cast<size_t>(irChannels_);
+    }
+    length_ = frames;
+
+    const size_t ch = static_cast<size_t>(channels);
+    const size_t irCh = static_cast<size_t>(irChannels_);
+    size_t partition = kHeadFrames;
+    for (size_t index = 0; ; ++index, partition *= 4) {
+        const size_t offset = index == 0 ? 0 : 2 * partition;
+        if (offset >= frames) break;
+        const bool last = partition >= kMaxPartition;
+        const size_t end = last ? frames : std::min(frames, 8 * partition);   // next level's offset
+
+        std::unique_ptr<Level> level(new Level());
+        level->partition = partition;
+        level->offset = offset;
+        level->count = (end - offset + partition - 1) / partition;
+        level->used = level->count;
+        level->work.fft.init(2 * partition);
+        level->mac = RealFft::selectMac(simdLevel());
+        const size_t spectrum = 2 * partition;   // re P | im P
+        level->filters.assign(irCh * level->count * spectrum, 0.0f);
+        level->spectra.assign(ch * level->count * spectrum, 0.0f);
+        level->history.assign(ch * 2 * partition, 0.0f);
+        for (int s = 0; s < 2; ++s) {
+            level->input[s].assign(ch * partition, 0.0f);
+            level->output[s].assign(ch * partition, 0.0f);
+        }
+        level->work.accum.assign(spectrum, 0.0f);
+        level->work.time.assign(2 * partition, 0.0f);
+
+        // Filter spectra, with the inverse transform's 1/P folded in
+        const float scale = 1.0f / static_cast<float>(partition);
+        for (size_t c = 0; c < irCh; ++c) {
+            for (size_t j = 0; j < level->count; ++j) {
+                std::vector<float>& time = level->work.time;
+                std::fill(time.begin(), time.end(), 0.0f);
+                const size_t first = offset + j * partition;
+                const size_t taps = std::min(partition, end - std::min(end, first));
+                for (size_t k = 0; k < taps; ++k) time[k] = (*response)[(first + k) * irCh + c];
+                float* h = &level->filters[(c * level->count + j) * spectrum];
+                level->work.fft.forward(time.data(), h, h + partition);
+                for (size_t k = 0; k < spectrum; ++k) h[k] *= scale;
+            }
+        }
+        levels_.push_back(std::move(level));
+        if (last) break;
+    }
+
+    variant_ = levels_[0]->work.fft.variant();
+    inFifo_.assign(kHeadFrames * ch, 0.0f);
+    outFifo_.assign(kHeadFrames * ch, 0.0f);
+    wet_.assign(kHeadFrames * ch, 0.0f);
+    headScratch_.assign(ch, levels_[0]->work);
+    reset();
+
+    if (levels_.size() > 1) {
+        worker_ = std::thread(&Convolver::workerLoop, this);
+    }
+    return true;
+}
+
+std::string Convolver::describe() const {
+    std::string text;
+    for (const auto& level : levels_) {
+        if (!text.empty()) text += ' ';
+        text += std::to_string(level->partition) + "x" + std::to_string(level->count);
+    }
+    return text;
+}
+
+void Convolver::setTailLimit(size_t taps) {
+    if (taps == tailLimit_) return;
+    tailLimit_ = taps;
+    for (size_t i = 1; i < levels_.size(); ++i) {
+        Level& level = *levels_[i];
+        if (taps == 0) {
+            level.used = level.count;
+        } else if (taps <= level.offset) {
+            level.used = 0;
+        } else {
+            level.used = std::min(level.count, (taps - level.offset + level.partition - 1) / level.partition);
+        }
+    }
+}
+
+size_t Convolver::activeLength() const {
+    size_t taps = 0;
+    for (const auto& level : levels_) {
+        if (level->used > 0) taps = level->offset + level->used * level->partition;
+    }
+    return std::min(length_, taps);
+}
+
+// -----------------------------
+// Worker
+// -----------------------------
+void Convolver::stopWorker() {
+    if (!worker_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    jobCv_.notify_all();
+    worker_.join();
+    stop_ = false;
+}
+
+void Convolver::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        if (stop_) return;
+        // Earliest deadline first
+        Level* next = nullptr;
+        Lane* job = nullptr;
+        size_t channel = 0;
+        for (size_t i = 1; i < levels_.size(); ++i) {
+            Level* level = levels_[i].get();
+            for (size_t c = 0; c < static_cast<size_t>(channels_); ++c) {
+                Lane& lane = level->lanes[c];
+                if (lane.queued && (!job || lane.deadline < job->deadline)) {
+                    next = level;
+                    job = &lane;
+                    channel = c;
+                }
+            }
+        }
+        if (!job) {
+            jobCv_.wait(lock);
+            continue;
+        }
+        job->queued = false;
+        const int side = job->jobSide;
+        const size_t used = job->jobUsed;
+        lock.unlock();
+
+        const uint64_t start = threadCpuNanos();
+        const size_t offset = channel * next->partition;
+        convolve(*next, channel, next->input[side].data() + offset, next->output[side].data() + offset, used,
+                 next->work);
+        workerNanos_.fetch_add(threadCpuNanos() - start, std::memory_order_relaxed);
+
+        lock.lock();
+        job->busy = false;
+        doneCv_.notify_all();
+    }
+}
+
+void Convolver::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    doneCv_.wait(lock, [this] {
+        for (const auto& level : levels_) {
+            for (const Lane& lane : level->lanes) {
+                if (lane.busy) return false;
+            }
+        }
+        return true;
+    });
+}
+
+// -----------------------------
+// Processing
+// -----------------------------
+void Convolver::reset() {
+    waitIdle();
+    for (auto& level : levels_) {
+        std::fill(level->spectra.begin(), level->spectra.end(), 0.0f);
+        std::fill(level->history.begin(), level->history.end(), 0.0f);
+        for (int s = 0; s < 2; ++s) {
+            std::fill(level->input[s].begin(), level->input[s].end(), 0.0f);
+            std::fill(level->output[s].begin(), level->output[s].end(), 0.0f);
+        }
+        for (Lane& lane : level->lanes) lane = Lane();
+    }
+    std::fill(inFifo_.begin(), inFifo_.end(), 0.0f);
+    std::fill(outFifo_.begin(), outFifo_.end(), 0.0f);
+    blockMix_ = mix_.load(std::memory_order_relaxed);
+    for (int c = 0; c < kMaxChannels; ++c) {
+        fifoFill_[c] = 0;
+        clock_[c] = 0;
+        appliedMix_[c] = blockMix_;
+    }
+}
+
+// One level step of one channel: `input` and `output` hold P frames; the
+// first `used` partitions are summed.
+void Convolver::convolve(Level& level, size_t channel, const float* input, float* output, size_t used,
+                         Scratch& scratch) {
+    const size_t partition = level.partition;
+    const size_t spectrum = 2 * partition;
+    const size_t count = level.count;
+    const size_t irCh = static_cast<size_t>(irChannels_);
+    Lane& lane = level.lanes[channel];
+    lane.slot = (lane.slot + 1) % count;
+    float* yr = scratch.accum.data();
+    float* yi = yr + partition;
+
+    float* history = &level.history[channel * 2 * partition];
+    std::memmove(history, history + partition, partition * sizeof(float));
+    std::memcpy(history + partition, input, partition * sizeof(float));
+
+    float* spectra = &level.spectra[channel * count * spectrum];
+    float* x = spectra + lane.slot * spectrum;
+    scratch.fft.forward(history, x, x + partition);
+
+    std::fill(scratch.accum.begin(), scratch.accum.end(), 0.0f);
+    const float* filters = &level.filters[(channel % irCh) * count * spectrum];
+    for (size_t j = 0; j < used; ++j) {
+        const float* xj = spectra + ((lane.slot + count - j) % count) * spectrum;
+        const float* h = filters + j * spectrum;
+        level.mac(xj, xj + partition, h, h + partition, yr, yi, partition);
+    }
+    scratch.fft.inverse(yr, yi, scratch.time.data());
+    std::memcpy(output, scratch.time.data() + partition, partition * sizeof(float));
+}
+
+void Convolver::process(const AudioBlock& block) {
+    beginBlock();
+    processChannels(block, 0);
+}
+
+void Convolver::beginBlock() {
+    blockMix_ = mix_.load(std::memory_order_relaxed);
+}
+
+void Convolver::processChannels(const AudioBlock& part, int first) {
+    if (levels_.empty() || first < 0 || part.channels < 1 || first + part.channels > channels_) return;
+    for (int i = 0; i < part.channels; ++i) {
+        const size_t c = static_cast<size_t>(first + i);
+        float* data = part.channel[i];
+        size_t done = 0;
+        while (done < part.frames) {
+            const size_t n = std::min(part.frames - done, kHeadFrames - fifoFill_[c]);
+            float* in = &inFifo_[c * kHeadFrames + fifoFill_[c]];
+            const float* out = &outFifo_[c * kHeadFrames + fifoFill_[c]];
+            for (size_t f = 0; f < n; ++f) {
+                const float sample = data[done + f];
+                data[done + f] = out[f];
+                in[f] = sample;
+            }
+            fifoFill_[c] += n;
+            done += n;
+            if (fifoFill_[c] == kHeadFrames) {
+                processBlock(c);
+                fifoFill_[c] = 0;
+            }
+        }
+    }
+}
+
+// Restart a cut-off level of one channel from silence (no job running).
+void Convolver::clearLane(Level& level, size_t channel) {
+    const size_t partition = level.partition;
+    const size_t spectra = level.count * 2 * partition;
+    std::fill_n(&level.spectra[channel * spectra], spectra, 0.0f);
+    std::fill_n(&level.history[channel * 2 * partition], 2 * partition, 0.0f);
+}
+
+// One head block of one channel: inFifo_ -> outFifo_.
+void Convolver::processBlock(size_t channel) {
+    const uint64_t start = threadCpuNanos();
+    const size_t frames = kHeadFrames;
+    const float* dry = &inFifo_[channel * frames];
+    float* wet = &wet_[channel * frames];
+
+    // Head, inline
+    convolve(*levels_[0], channel, dry, wet, levels_[0]->count, headScratch_[channel]);
+
+    // Worker levels: add their ready output, collect their input, hand
+    // over complete blocks
+    for (size_t i = 1; i < levels_.size(); ++i) {
+        Level& level = *levels_[i];
+        Lane& lane = level.lanes[channel];
+        const size_t partition = level.partition;
+        const float* r = &level.output[lane.side][channel * partition + lane.fill];
+        for (size_t f = 0; f < frames; ++f) wet[f] += r[f];
+        std::memcpy(&level.input[lane.side][channel * partition + lane.fill], dry, frames * sizeof(float));
+        lane.fill += frames;
+        if (lane.fill < partition) continue;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (lane.busy) {
+            // The previous block's result is needed from the next frame on
+            stalls_.fetch_add(1, std::memory_order_relaxed);
+            doneCv_.wait(lock, [&lane] { return !lane.busy; });
+        }
+        if (level.used == 0) {
+            // Cut off by the tail limit: silence where this job's result
+            // would have been read
+            lock.unlock();
+            std::fill_n(&level.output[lane.side][channel * partition], partition, 0.0f);
+            lane.stale = true;
+        } else {
+            if (lane.stale) {
+                lock.unlock();
+                clearLane(level, channel);
+                lane.stale = false;
+                lock.lock();
+            }
+            lane.busy = true;
+            lane.queued = true;
+            lane.jobSide = lane.side;
+            lane.jobUsed = level.used;
+            lane.deadline = clock_[channel] + frames + partition;
+            lock.unlock();
+            jobCv_.notify_one();
+        }
+        lane.side ^= 1;
+        lane.fill = 0;
+    }
+
+    // Dry/wet mix, ramped over the block
+    const float target = blockMix_;
+    const float applied = appliedMix_[channel];
+    const float step = (target - applied) / static_cast<float>(frames);
+    float* out = &outFifo_[channel * frames];
+    for (size_t f = 0; f < frames; ++f) {
+        const float m = target == applied ? target : applied + step * static_cast<float>(f + 1);
+        out[f] = dry[f] * (1.0f - m) + wet[f] * m;
+    }
+    appliedMix_[channel] = target;
+    clock_[channel] += frames;
+    inlineNanos_.fetch_add(threadCpuNanos() - start, std::memory_order_relaxed);
+}
@@ -0,0 +1,217 @@
+#pragma once
+/*
+ convolver.h
+
+ Purpose:
+   - Fast convolution with long impulse responses (room correction filters,
+     reverbs; up to kMaxLength taps per channel) as a processor of the
+     player's DSP stage, in the decode thread after the EQ.
+
+ How:
+   - Non-uniformly partitioned overlap-save: the impulse response is cut
+     into levels of growing partition size, each a uniformly partitioned
+     FFT convolution (real FFT, fft.h) with a frequency-domain delay line:
+         head   kHeadFrames (256) x 8 partitions   taps 0 .. 2k
+         level  1024 x 6                           taps 2k .. 8k
+         level  4096 x 6                           taps 8k .. 32k
+         level  16384 x as many as needed          taps 32k ..
+     (levels past the impulse response's end are left out).
+   - The head runs inline in process(); every larger level runs on one
+     worker thread. A level of partition P starts 2P taps into the response,
+     so a job started when a P-frame input block of a channel is complete
+     has P frames of processing time before its result is due; the worker
+     takes the job (level and channel) that is due first. If a result is not
+     ready in time, process() waits for it (stalls() counts these) -- the
+     output never depends on timing.
+   - Channels advance independently (own FIFO position, frame clock and
+     per-level progress), so DspChain can convolve disjoint channel groups
+     of a block on different threads: beginBlock() takes the mix once for
+     the block, processChannels() convolves a group; process() does both.
+   - The audio is delayed by latency() = kHeadFrames frames (input is
+     collected in head-sized blocks).
+   - setTailLimit() (DspChain's governor, through ConvolverNode) drops the
+     partitions past a tap count from the sums; a level left with none
+     posts no jobs and contributes silence, and restarts from empty delay
+     lines when the limit is lifted. The head always runs in full.
+
+ Threads:
+   - setImpulseResponse() and prepare() are called while nothing is
+     processing (Player::load()); setMix() may be called from any thread.
+   - reset(), process() and beginBlock() belong to the processing thread;
+     processChannels() to the processing thread or DspChain's workers,
+     concurrently only for disjoint channels.
+
+ Notes:
+   - A response with one channel is used for every channel; otherwise
+     output channel c uses response channel c % responseChannels.
+   - A response recorded at another sample rate is resampled (windowed
+     sinc) in prepare().
+   - Without a response process() does nothing and there is no latency.
+*/
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fft.h"
+#include "../audio/planar.h"
+
+class Convolver {
+public:
+    static constexpr size_t kHeadFrames = 256;       // head partition, latency
+    static constexpr size_t kMaxPartition = 16384;   // largest worker partition
+    static constexpr size_t kMaxLength = 1 << 20;    // taps per channel (~22 s at 48 kHz)
+    static constexpr int kMaxChannels = 8;
+
+    Convolver();
+    ~Convolver();
+
+    Convolver(const Convolver&) = delete;
+    Convolver& operator=(const Convolver&) = delete;
+
+    // ---- set-up (not while processing) ----
+    // Interleaved response of `frames` x `channels` recorded at `sampleRate`;
+    // used from the next prepare(). False (and no response) if it is empty,
+    // longer than kMaxLength or has more than kMaxChannels channels.
+    bool setImpulseResponse(const float* samples, size_t frames, int channels, int sampleRate);
+    void clearImpulseResponse();
+    bool hasImpulseResponse() const { return irFrames_ > 0; }
+
+    // Partition the response for a stream (resampled to `sampleRate` if
+    // needed) and start the worker; false for a channel count outside
+    // 1..kMaxChannels. Without a response it only records the format.
+    bool prepare(int sampleRate, int channels);
+
+    // ---- control side (any thread) ----
+    // Share of the convolved signal in the output (0 = dry, 1 = wet only,
+    // the default for room correction). Smoothed over one head block.
+    void setMix(float wet);
+    float mix() const { return mix_.load(std::memory_order_relaxed); }
+
+    // ---- processing side ----
+    // Forget the audio in the delay lines (e.g. after a seek); waits for the
+    // worker's current job.
+    void reset();
+
+    // Convolve a block of the prepared channel count in place (other blocks
+    // pass through); the output lags the input by latency() frames.
+    void process(const AudioBlock& block);
+
+    // Channel split: the mix for the next block, then channels
+    // [first, first + part.channels) of it.
+    void beginBlock();
+    void processChannels(const AudioBlock& part, int first);
+
+    // Convolve with the first `taps` taps of the response only (rounded up
+    // to whole partitions, at least the head's; 0 = all). Reset by prepare().
+    void setTailLimit(size_t taps);
+    size_t tailLimit() const { return tailLimit_; }
+    // Taps in use under the limit
+    size_t activeLength() const;
+
+    bool active() const { return !levels_.empty(); }
+    size_t latency() const { return active() ? kHeadFrames : 0; }
+
+    // Frames after the last input until the output has died away.
+    size_t tailFrames() const { return active() ? kHeadFrames + length_ - 1 : 0; }
+
+    // Prepared response length in taps, and its partitioning ("256x8 1024x6 ...")
+    size_t length() const { return length_; }
+    std::string describe() const;
+
+    // FFT variant in use ("scalar", "sse2", "avx2").
+    const char* variant() const { return variant_; }
+
+    // Times process() had to wait for the worker (frequent while processing
+    // runs ahead of real time), and the CPU time spent convolving inline and
+    // on the worker (nanoseconds).
+    uint64_t stalls() const { return stalls_.load(std::memory_order_relaxed); }
+    uint64_t inlineNanos() const { return inlineNanos_.load(std::memory_order_relaxed); }
+    uint64_t workerNanos() const { return workerNanos_.load(std::memory_order_relaxed); }
+
+private:
+    // A level's progress in one channel
+    struct alignas(64) Lane {
+        size_t slot = 0;               // delay line position of the newest spectrum
+        size_t fill = 0;               // frames collected in input[side]
+        int side = 0;                  // buffers the processing thread uses
+        // worker hand-off (mutex_)
+        bool busy = false;             // job queued or running
+        bool queued = false;           // job not yet picked up
+        int jobSide = 0;               // buffers of the job
+        size_t jobUsed = 0;            // partitions summed by the job
+        uint64_t deadline = 0;         // channel's frame clock at which the result is due
+        bool stale = false;            // level was cut off: history and spectra are old
+    };
+
+    // Transform and buffers for one thread's convolve() calls (RealFft
+    // works in its own scratch)
+    struct Scratch {
+        RealFft fft;
+        std::vector<float> accum;      // re P | im P
+        std::vector<float> time;       // 2P
+    };
+
+    // One uniformly partitioned convolution (see the table above)
+    struct Level {
+        size_t partition = 0;          // P: frames per block, FFT size 2P
+        size_t offset = 0;             // first tap covered
+        size_t count = 0;              // partitions
+        size_t used = 0;               // partitions summed under the tail limit
+        SpectrumMacFn mac = nullptr;
+        std::vector<float> filters;    // [response channel][count][re P | im P], scaled 1/P
+        std::vector<float> spectra;    // delay line: [channel][count][re P | im P]
+        std::vector<float> history;    // [channel][2P]: previous block | current block
+        std::vector<float> input[2];   // [channel][P]: collected / being convolved
+        std::vector<float> output[2];  // [channel][P]: being read / being computed
+        Scratch work;                  // set-up and the worker (the head: headScratch_)
+        Lane lanes[kMaxChannels];
+    };
+
+    void stopWorker();
+    void workerLoop();
+    void waitIdle();
+    void convolve(Level& level, size_t channel, const float* input, float* output, size_t used, Scratch& scratch);
+    void processBlock(size_t channel);
+    void clearLane(Level& level, size_t channel);
+
+    // response (set-up)
+    std::vector<float> ir_;
+    size_t irFrames_;
+    int irChannels_;
+    int irRate_;
+
+    // prepared stream
+    int sampleRate_;
+    int channels_;
+    size_t length_;
+    size_t tailLimit_;              // taps, 0 = none
+    const char* variant_;
+    std::vector<std::unique_ptr<Level>> levels_;   // [0] = head (inline)
+    std::vector<float> inFifo_;     // [channel][kHeadFrames]; the head's input
+    std::vector<float> outFifo_;    // [channel][kHeadFrames]
+    std::vector<float> wet_;        // [channel][kHeadFrames]
+    std::vector<Scratch> headScratch_;   // [channel]
+    size_t fifoFill_[kMaxChannels];
+    uint64_t clock_[kMaxChannels];  // frames through processBlock()
+    float appliedMix_[kMaxChannels];
+    float blockMix_;                // mix_ as of beginBlock()
+
+    std::atomic<float> mix_;
+    std::atomic<uint64_t> stalls_;
+    std::atomic<uint64_t> inlineNanos_;
+    std::atomic<uint64_t> workerNanos_;
+
+    // worker
+    std::mutex mutex_;
+    std::condition_variable jobCv_;    // processing thread -> worker
+    std::condition_variable doneCv_;   // worker -> processing thread
+    bool stop_;
+    std::thread worker_;
+};
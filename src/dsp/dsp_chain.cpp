@@ -0,0 +1,309 @@
+/*
+ dsp_chain.cpp
+
+ Node list hand-off between the control and processing sides, block
+ splitting and per-node cost accounting. See dsp_chain.h.
+*/
+
+#include "dsp_chain.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "dsp_workers.h"
+#include "../utils/thread_clock.h"
+
+namespace {
+
+// Weight of the newest block in load() (~8 blocks, ~170 ms at 48 kHz)
+constexpr double kLoadSmoothing = 0.125;
+
+uint64_t steadyNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
+
+DspChain::DspChain()
+    : version_(0),
+      sampleRate_(0),
+      channels_(0),
+      adopted_(0),
+      workers_(nullptr),
+      deadline_(1.0),
+      blocks_(0),
+      misses_(0),
+      governor_(false),
+      load_(0.0),
+      tier_(0),
+      tierChanges_(0),
+      tierBlocks_(),
+      sinceChange_(0),
+      calm_(0) {}
+
+// -----------------------------
+// Control side
+// -----------------------------
+
+bool DspChain::prepare(int sampleRate, int channels) {
+    sampleRate_ = sampleRate;
+    channels_ = channels;
+    bool ok = true;
+    for (Entry& entry : entries_) {
+        entry.ready = entry.node->prepare(sampleRate, channels);
+        ok = ok && entry.ready;
+        entry.node->setQualityTier(0);
+        entry.node->nanos_.store(0, std::memory_order_relaxed);
+        entry.node->frames_.store(0, std::memory_order_relaxed);
+        entry.node->backgroundStart_ = entry.node->backgroundNanos();
+    }
+    blocks_.store(0, std::memory_order_relaxed);
+    misses_.store(0, std::memory_order_relaxed);
+    load_.store(0.0, std::memory_order_relaxed);
+    tier_.store(0, std::memory_order_relaxed);
+    tierChanges_.store(0, std::memory_order_relaxed);
+    for (auto& count : tierBlocks_) count.store(0, std::memory_order_relaxed);
+    sinceChange_ = 0;
+    calm_ = 0;
+    publish();
+    // Nothing processes now: take the list over for the processing side
+    // (so latency() is right before the first block) and drop removed nodes.
+    current();
+    retired_.clear();
+    return ok;
+}
+
+bool DspChain::insert(size_t index, std::shared_ptr<DspNode> node) {
+    collect();
+    if (!node || entries_.size() >= static_cast<size_t>(kMaxNodes) || indexOf(node.get()) >= 0) return false;
+    Entry entry;
+    entry.node = std::move(node);
+    if (sampleRate_ > 0) {
+        entry.ready = entry.node->prepare(sampleRate_, channels_);
+        entry.node->backgroundStart_ = entry.node->backgroundNanos();
+    }
+    entries_.insert(entries_.begin() + static_cast<std::ptrdiff_t>(std::min(index, entries_.size())), std::move(entry));
+    publish();
+    return true;
+}
+
+bool DspChain::remove(const DspNode* node) {
+    collect();
+    const int index = indexOf(node);
+    if (index < 0) return false;
+    std::shared_ptr<DspNode> removed = std::move(entries_[index].node);
+    entries_.erase(entries_.begin() + index);
+    publish();
+    retired_.emplace_back(version_, std::move(removed));
+    return true;
+}
+
+std::vector<std::shared_ptr<DspNode>> DspChain::nodes() const {
+    std::vector<std::shared_ptr<DspNode>> result;
+    for (const Entry& entry : entries_) result.push_back(entry.node);
+    return result;
+}
+
+int DspChain::indexOf(const DspNode* node) const {
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (entries_[i].node.get() == node) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+std::vector<DspNodeCost> DspChain::costs() const {
+    std::vector<DspNodeCost> result;
+    for (const Entry& entry : entries_) {
+        const DspNode& node = *entry.node;
+        DspNodeCost cost;
+        cost.name = node.name();
+        cost.frames = node.frames_.load(std::memory_order_relaxed);
+        if (cost.frames > 0 && sampleRate_ > 0) {
+            const double audioNanos = static_cast<double>(cost.frames) * 1e9 / sampleRate_;
+            cost.load = 100.0 * static_cast<double>(node.nanos_.load(std::memory_order_relaxed)) / audioNanos;
+            cost.background = 100.0 * static_cast<double>(node.backgroundNanos() - node.backgroundStart_) / audioNanos;
+        }
+        result.push_back(cost);
+    }
+    return result;
+}
+
+void DspChain::setWorkers(DspWorkerPool* pool) {
+    workers_ = pool;
+}
+
+void DspChain::setDeadline(double share) {
+    deadline_.store(std::max(0.01, share), std::memory_order_relaxed);
+}
+
+void DspChain::setGovernor(bool enabled) {
+    governor_.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t DspChain::tierBlocks(int tier) const {
+    if (tier < 0 || tier > kMaxQualityTier) return 0;
+    return tierBlocks_[tier].load(std::memory_order_relaxed);
+}
+
+void DspChain::publish() {
+    NodeList list;
+    for (const Entry& entry : entries_) {
+        if (entry.ready) list.nodes[list.count++] = entry.node.get();
+    }
+    list.version = ++version_;
+    list_.publish(list);
+}
+
+// Release removed nodes the processing side no longer runs
+void DspChain::collect() {
+    const uint64_t adopted = adopted_.load(std::memory_order_acquire);
+    retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+        [adopted](const std::pair<uint64_t, std::shared_ptr<DspNode>>& r) { return r.first <= adopted; }),
+        retired_.end());
+}
+
+// -----------------------------
+// Processing side
+// -----------------------------
+
+const DspChain::NodeList& DspChain::current() {
+    if (list_.read()) {
+        adopted_.store(list_.current().version, std::memory_order_release);
+    }
+    return list_.current();
+}
+
+void DspChain::reset() {
+    const NodeList& list = current();
+    for (int i = 0; i < list.count; ++i) list.nodes[i]->reset();
+}
+
+void DspChain::process(const AudioBlock& block) {
+    const NodeList& list = current();
+    if (list.count == 0) return;
+    const bool fork = workers_ && workers_->workers() > 0 && block.channels > 1;
+    const double budget = deadline_.load(std::memory_order_relaxed) * 1e9 / std::max(1, sampleRate_);   // ns per frame
+    const bool governed = governor_.load(std::memory_order_relaxed);
+    if (!governed && tier_.load(std::memory_order_relaxed) != 0) {
+        // Governor switched off: back to full quality
+        tier_.store(0, std::memory_order_relaxed);
+        tierChanges_.fetch_add(1, std::memory_order_relaxed);
+        for (int i = 0; i < list.count; ++i) list.nodes[i]->setQualityTier(0);
+    }
+    if (governed) {
+        // Every call, so nodes added since pick the tier up too
+        for (int i = 0; i < list.count; ++i) list.nodes[i]->setQualityTier(tier_.load(std::memory_order_relaxed));
+    }
+    for (size_t done = 0; done < block.frames; done += kBlockFrames) {
+        const size_t n = std::min(block.frames - done, kBlockFrames);
+        const AudioBlock part = block.slice(done, n);
+        const int tier = tier_.load(std::memory_order_relaxed);
+        const uint64_t blockStart = steadyNanos();
+        uint64_t start = threadCpuNanos();
+        for (int i = 0; i < list.count; ) {
+            DspNode* node = list.nodes[i];
+            int end = i + 1;
+            if (fork && node->channelsIndependent()) {
+                while (end < list.count && list.nodes[end]->channelsIndependent()) ++end;
+                runForked(list.nodes + i, end - i, part);
+                start = threadCpuNanos();
+            } else {
+                node->process(part);
+                const uint64_t now = threadCpuNanos();
+                node->nanos_.fetch_add(now - start, std::memory_order_relaxed);
+                start = now;
+            }
+            for (; i < end; ++i) list.nodes[i]->frames_.fetch_add(n, std::memory_order_relaxed);
+        }
+        const uint64_t wall = steadyNanos() - blockStart;
+        const double load = static_cast<double>(wall) / (budget * static_cast<double>(n));
+        blocks_.fetch_add(1, std::memory_order_relaxed);
+        if (load > 1.0) misses_.fetch_add(1, std::memory_order_relaxed);
+        tierBlocks_[tier].fetch_add(1, std::memory_order_relaxed);
+        if (govern(load, governed)) {
+            const int next = tier_.load(std::memory_order_relaxed);
+            for (int i = 0; i < list.count; ++i) list.nodes[i]->setQualityTier(next);
+        }
+    }
+}
+
+// Smooth the block's load and step the tier: down on pressure once the last
+// step has had kSettleBlocks to show, up after kCalmBlocks of calm. True if
+// the tier changed.
+bool DspChain::govern(double load, bool governed) {
+    const double previous = load_.load(std::memory_order_relaxed);
+    const double smoothed = blocks_.load(std::memory_order_relaxed) == 1 ? load
+        : previous + (load - previous) * kLoadSmoothing;
+    load_.store(smoothed, std::memory_order_relaxed);
+    if (!governed) return false;
+
+    const int tier = tier_.load(std::memory_order_relaxed);
+    const bool pressure = load > 1.0 || smoothed > kDownLoad;
+    ++sinceChange_;
+    calm_ = smoothed < kUpLoad ? calm_ + 1 : 0;
+    int next = tier;
+    if (pressure && sinceChange_ >= kSettleBlocks && tier < kMaxQualityTier) {
+        next = tier + 1;
+    } else if (calm_ >= kCalmBlocks && tier > 0) {
+        next = tier - 1;
+    } else {
+        return false;
+    }
+    tier_.store(next, std::memory_order_relaxed);
+    tierChanges_.fetch_add(1, std::memory_order_relaxed);
+    sinceChange_ = 0;
+    calm_ = 0;
+    return true;
+}
+
+// Costs: beginBlock() and every group's share go to the node; the
+// processing thread's wait for the workers goes to none.
+void DspChain::runForked(DspNode* const* nodes, int count, const AudioBlock& block) {
+    uint64_t start = threadCpuNanos();
+    for (int i = 0; i < count; ++i) {
+        nodes[i]->beginBlock(block.frames);
+        const uint64_t now = threadCpuNanos();
+        nodes[i]->nanos_.fetch_add(now - start, std::memory_order_relaxed);
+        start = now;
+    }
+    Fork fork;
+    fork.nodes = nodes;
+    fork.count = count;
+    fork.block = block;
+    fork.groups = std::min(block.channels, workers_->workers() + 1);
+    workers_->run(fork.groups, &DspChain::runGroup, &fork);
+}
+
+// One channel group of a fork, on a worker or the processing thread
+void DspChain::runGroup(void* context, int group) {
+    const Fork& fork = *static_cast<const Fork*>(context);
+    const int first = group * fork.block.channels / fork.groups;
+    const int end = (group + 1) * fork.block.channels / fork.groups;
+    AudioBlock part;
+    part.channels = end - first;
+    part.frames = fork.block.frames;
+    for (int c = 0; c < part.channels; ++c) part.channel[c] = fork.block.channel[first + c];
+    uint64_t start = threadCpuNanos();
+    for (int i = 0; i < fork.count; ++i) {
+        DspNode* node = fork.nodes[i];
+        node->processChannels(part, first);
+        const uint64_t now = threadCpuNanos();
+        node->nanos_.fetch_add(now - start, std::memory_order_relaxed);
+        start = now;
+    }
+}
+
+size_t DspChain::latency() {
+    const NodeList& list = current();
+    size_t total = 0;
+    for (int i = 0; i < list.count; ++i) total += list.nodes[i]->latency();
+    return total;
+}
+
+size_t DspChain::tailFrames() {
+    const NodeList& list = current();
+    size_t total = 0;
+    for (int i = 0; i < list.count; ++i) total += list.nodes[i]->tailFrames();
+    return total;
+}
@@ -0,0 +1,250 @@
+#pragma once
+/*
+ dsp_chain.h
+
+ Purpose:
+   - The player's DSP stage as a chain of processor nodes (EQ, convolver,
+     gain, matrix, limiter, ...; dsp_nodes.h) run in order on the decode
+     thread's blocks, with nodes added and removed while it plays, and the
+     CPU time of every node.
+
+ How:
+   - A node processes planar blocks (planar.h) of the prepared channel
+     count in place, at most kBlockFrames frames at a time (process() cuts
+     larger blocks). Parameters are the node's business: the nodes here take them
+     through atomics or TripleBuffer snapshots and smooth them per sample.
+   - The control side keeps the node list and publishes a copy of it (plain
+     pointers) through a TripleBuffer; process() picks up the newest copy
+     at the start of a call. A removed node is kept alive until the
+     processing side reports (adopted_) that it runs a list without it, and
+     is released on the control side -- the processing side never locks,
+     allocates or frees.
+   - Each node's time in process() is measured with the thread's CPU clock
+     (thread_clock.h) and reported by costs() as a share of one core at
+     real time.
+   - With a worker pool (setWorkers(), dsp_workers.h) a run of consecutive
+     nodes whose channels are independent (EQ, convolver, gain) is forked:
+     each node's beginBlock() runs on the processing thread, then the
+     channels are cut into contiguous groups (one per worker plus one for
+     the processing thread) that run the whole run of nodes through
+     processChannels() in parallel. The chain joins before a node that
+     mixes channels (matrix, limiter). The output is the same as serial.
+   - Every block's wall time in process() is compared with its deadline
+     (its duration times setDeadline()'s share); blocks() and
+     deadlineMisses() count them.
+   - Governor (setGovernor()): the same wall time, as a share of the
+     deadline, is smoothed over blocks (load()); under pressure -- a missed
+     deadline or the smoothed load above kDownLoad -- the chain steps every
+     node one quality tier down (setQualityTier(), cheaper and slightly
+     worse: a shorter convolution tail, sample- instead of true-peak
+     limiting), at most once per kSettleBlocks so the last step shows in the
+     load first. It steps back up one tier after kCalmBlocks in a row under
+     kUpLoad; the gap between the two thresholds keeps it from flapping.
+     qualityTier(), tierChanges() and tierBlocks() report what it did.
+
+ Threads:
+   - Control side (one thread, e.g. the UI): insert(), add(), remove(),
+     nodes(), costs(), setDeadline(), setGovernor(), and the block, load
+     and tier counters;
+     prepare() and setWorkers() too, but only while nothing processes.
+   - Processing side (the decode thread): reset(), process(), latency(),
+     tailFrames(); the control thread may call them while nothing
+     processes (e.g. right after prepare()).
+
+ Notes:
+   - A node added to a prepared chain is prepared right away, before the
+     processing side can see it. A node whose prepare() fails (e.g. a
+     channel count it cannot handle) stays in the list but is left out of
+     processing until the next prepare().
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../audio/planar.h"
+#include "../utils/triple_buffer.h"
+
+class DspChain;
+class DspWorkerPool;
+
+class DspNode {
+public:
+    virtual ~DspNode() = default;
+
+    // Short name for logs and the cost report ("eq", "limiter", ...)
+    virtual const char* name() const = 0;
+
+    // Set up for a stream; called while the node does not process.
+    virtual bool prepare(int sampleRate, int channels) = 0;
+
+    // Forget the audio held in filters and delay lines (e.g. after a seek).
+    virtual void reset() {}
+
+    // A block of at most DspChain::kBlockFrames frames, in place.
+    virtual void process(const AudioBlock& block) = 0;
+
+    // Frames the output lags the input, and frames of output after the last
+    // input until it has died away.
+    virtual size_t latency() const { return 0; }
+    virtual size_t tailFrames() const { return latency(); }
+
+    // CPU time spent for the node off the processing thread (worker
+    // threads), nanoseconds since prepare().
+    virtual uint64_t backgroundNanos() const { return 0; }
+
+    // Channel split: a node whose channels do not interact returns true and
+    // implements the two calls below; the chain then calls beginBlock() once
+    // per block on the processing thread and processChannels() for disjoint
+    // channel groups of the block, concurrently. process() must give the
+    // same result as beginBlock() followed by processChannels(block, 0).
+    virtual bool channelsIndependent() const { return false; }
+    virtual void beginBlock(size_t frames) { (void)frames; }
+    // `part` holds channels [first, first + part.channels) of the block.
+    virtual void processChannels(const AudioBlock& part, int first) { (void)part; (void)first; }
+
+    // Quality tier from the governor: 0 = full quality, every step up
+    // (to DspChain::kMaxQualityTier) may trade quality for CPU time. Called
+    // on the processing thread between blocks, also with an unchanged tier.
+    virtual void setQualityTier(int tier) { (void)tier; }
+
+private:
+    friend class DspChain;
+    std::atomic<uint64_t> nanos_{0};    // in process(), written by the processing side (and workers)
+    std::atomic<uint64_t> frames_{0};
+    uint64_t backgroundStart_ = 0;      // backgroundNanos() at prepare()
+};
+
+// Cost of one node since the chain was prepared
+struct DspNodeCost {
+    std::string name;
+    double load = 0.0;         // % of one core at real time, in process() (all threads)
+    double background = 0.0;   // % of one core on worker threads
+    uint64_t frames = 0;       // frames processed
+};
+
+class DspChain {
+public:
+    static constexpr int kMaxNodes = 16;
+    static constexpr size_t kBlockFrames = 1024;
+
+    // Governor (see above); loads are shares of the block deadline
+    static constexpr int kMaxQualityTier = 3;
+    static constexpr double kDownLoad = 0.75;
+    static constexpr double kUpLoad = 0.4;
+    static constexpr uint64_t kSettleBlocks = 16;
+    static constexpr uint64_t kCalmBlocks = 256;    // ~5 s at 48 kHz
+
+    DspChain();
+
+    DspChain(const DspChain&) = delete;
+    DspChain& operator=(const DspChain&) = delete;
+
+    // ---- control side ----
+    // Prepare every node for a stream and reset the costs (not while
+    // processing); false if a node could not be prepared.
+    bool prepare(int sampleRate, int channels);
+
+    // Put `node` at `index` (clamped to the end). False if the chain is full
+    // or the node is already in it.
+    bool insert(size_t index, std::shared_ptr<DspNode> node);
+    bool add(std::shared_ptr<DspNode> node) { return insert(kMaxNodes, std::move(node)); }
+
+    // Take `node` out; the chain lets go of it once processing has moved on.
+    bool remove(const DspNode* node);
+
+    std::vector<std::shared_ptr<DspNode>> nodes() const;
+    int indexOf(const DspNode* node) const;
+
+    std::vector<DspNodeCost> costs() const;
+
+    // Fork channel-independent nodes over `pool` (not owned; nullptr = all
+    // on the processing thread). Not while processing.
+    void setWorkers(DspWorkerPool* pool);
+
+    // Share of a block's duration process() may take before the block
+    // counts as a deadline miss (default 1; e.g. 0.5 leaves the other half
+    // to decoding and output).
+    void setDeadline(double share);
+
+    // Blocks processed and deadline misses since prepare().
+    uint64_t blocks() const { return blocks_.load(std::memory_order_relaxed); }
+    uint64_t deadlineMisses() const { return misses_.load(std::memory_order_relaxed); }
+
+    // Step quality tiers with the load (default off); switched off, the
+    // nodes go back to tier 0 with the next block.
+    void setGovernor(bool enabled);
+    bool governor() const { return governor_.load(std::memory_order_relaxed); }
+
+    // Smoothed wall time per block as a share of its deadline (1 = all of
+    // it), the tier in use, tier changes and blocks processed at `tier`
+    // since prepare().
+    double load() const { return load_.load(std::memory_order_relaxed); }
+    int qualityTier() const { return tier_.load(std::memory_order_relaxed); }
+    uint64_t tierChanges() const { return tierChanges_.load(std::memory_order_relaxed); }
+    uint64_t tierBlocks(int tier) const;
+
+    // ---- processing side ----
+    void reset();
+    void process(const AudioBlock& block);
+
+    // Sums over the nodes being processed.
+    size_t latency();
+    size_t tailFrames();
+
+private:
+    struct Entry {
+        std::shared_ptr<DspNode> node;
+        bool ready = false;               // prepared for the current stream
+    };
+
+    // What the processing side runs
+    struct NodeList {
+        DspNode* nodes[kMaxNodes] = {};
+        int count = 0;
+        uint64_t version = 0;
+    };
+
+    // A run of channel-independent nodes over one block, for the workers
+    struct Fork {
+        DspNode* const* nodes;
+        int count;
+        AudioBlock block;
+        int groups;
+    };
+
+    void publish();
+    void collect();
+    const NodeList& current();
+    void runForked(DspNode* const* nodes, int count, const AudioBlock& block);
+    static void runGroup(void* context, int group);
+    bool govern(double load, bool governed);
+
+    // control side
+    std::vector<Entry> entries_;
+    std::vector<std::pair<uint64_t, std::shared_ptr<DspNode>>> retired_;   // removed in list version
+    uint64_t version_;
+    int sampleRate_;
+    int channels_;
+
+    TripleBuffer<NodeList> list_;
+    std::atomic<uint64_t> adopted_;       // list version the processing side runs
+
+    DspWorkerPool* workers_;
+    std::atomic<double> deadline_;        // share of a block's duration
+    std::atomic<uint64_t> blocks_;
+    std::atomic<uint64_t> misses_;
+
+    // governor (written by the processing side)
+    std::atomic<bool> governor_;
+    std::atomic<double> load_;
+    std::atomic<int> tier_;
+    std::atomic<uint64_t> tierChanges_;
+    std::atomic<uint64_t> tierBlocks_[kMaxQualityTier + 1];
+    uint64_t sinceChange_;                // blocks since the last tier change
+    uint64_t calm_;                       // blocks in a row under kUpLoad
+};
@@ -0,0 +1,165 @@
+/*
+ dsp_nodes.cpp
+
+ GainNode and MatrixNode. See dsp_nodes.h.
+*/
+
+#include "dsp_nodes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// -----------------------------
+// GainNode
+// -----------------------------
+
+GainNode::GainNode()
+    : gainDb_(0.0f),
+      channels_(0),
+      gain_(1.0f),
+      gainStep_(1.0f),
+      ramp_(),
+      rampFrames_(0) {}
+
+void GainNode::setGainDb(float gainDb) {
+    gainDb_.store(std::max(-120.0f, std::min(24.0f, gainDb)), std::memory_order_relaxed);
+}
+
+bool GainNode::prepare(int sampleRate, int channels) {
+    if (channels < 1 || sampleRate <= 0) return false;
+    channels_ = channels;
+    gainStep_ = static_cast<float>(1.0 - std::exp(-1.0 / (0.005 * sampleRate)));   // 5 ms
+    reset();
+    return true;
+}
+
+void GainNode::reset() {
+    gain_ = std::pow(10.0f, gainDb_.load(std::memory_order_relaxed) / 20.0f);
+}
+
+void GainNode::process(const AudioBlock& block) {
+    beginBlock(block.frames);
+    processChannels(block, 0);
+}
+
+// Ramp per frame until settled; the rest of the block is a plain multiply
+void GainNode::beginBlock(size_t frames) {
+    const float db = gainDb_.load(std::memory_order_relaxed);
+    const float target = db == 0.0f ? 1.0f : std::pow(10.0f, db / 20.0f);
+    frames = std::min(frames, DspChain::kBlockFrames);
+    size_t f = 0;
+    for (; f < frames && gain_ != target; ++f) {
+        gain_ += (target - gain_) * gainStep_;
+        if (std::fabs(target - gain_) < 1e-6f) gain_ = target;
+        ramp_[f] = gain_;
+    }
+    rampFrames_ = f;
+}
+
+void GainNode::processChannels(const AudioBlock& part, int first) {
+    const int channels = std::min(part.channels, channels_ - first);
+    const size_t ramp = std::min(rampFrames_, part.frames);
+    const float gain = gain_;
+    for (int c = 0; c < channels; ++c) {
+        float* p = part.channel[c];
+        for (size_t f = 0; f < ramp; ++f) p[f] *= ramp_[f];
+        if (gain == 1.0f) continue;
+        for (size_t f = ramp; f < part.frames; ++f) p[f] *= gain;
+    }
+}
+
+// -----------------------------
+// MatrixNode
+// -----------------------------
+
+MatrixNode::MatrixNode()
+    : channels_(0),
+      rampFrames_(1),
+      rampLeft_(0),
+      identity_(true),
+      kernel_(nullptr),
+      current_(),
+      target_(),
+      step_(),
+      scratch_() {}
+
+void MatrixNode::setMatrix(int channels, const std::vector<float>& matrix) {
+    Settings settings;
+    const size_t size = static_cast<size_t>(channels) * static_cast<size_t>(channels);
+    if (channels >= 1 && channels <= kMaxChannels && matrix.size() == size) {
+        std::copy(matrix.begin(), matrix.end(), settings.matrix);
+        settings.channels = channels;
+    }
+    settings_.publish(settings);
+}
+
+bool MatrixNode::prepare(int sampleRate, int channels) {
+    if (channels < 1 || channels > kMaxChannels || sampleRate <= 0) return false;
+    kernel_ = ChannelMixer::selectPlanarKernel(simdLevel());
+    channels_ = channels;
+    rampFrames_ = std::max<size_t>(1, static_cast<size_t>(sampleRate) / 100);   // 10 ms
+    pool_.init(channels, DspChain::kBlockFrames, 1);
+    scratch_ = pool_.acquire();
+    settings_.read();
+    applySettings(settings_.current(), false);
+    return true;
+}
+
+void MatrixNode::reset() {
+    // A jump is inaudible after a seek: finish a running crossfade now
+    if (rampLeft_ > 0) {
+        std::copy(target_, target_ + kMaxChannels * kMaxChannels, current_);
+        rampLeft_ = 0;
+    }
+}
+
+// New target matrix: the identity unless the settings fit the stream
+void MatrixNode::applySettings(const Settings& settings, bool ramp) {
+    const size_t n = static_cast<size_t>(channels_);
+    identity_ = true;
+    for (size_t o = 0; o < n; ++o) {
+        for (size_t i = 0; i < n; ++i) {
+            const float value = settings.channels == channels_ ? settings.matrix[o * n + i] : (o == i ? 1.0f : 0.0f);
+            target_[o * n + i] = value;
+            identity_ = identity_ && value == (o == i ? 1.0f : 0.0f);
+        }
+    }
+    if (!ramp) {
+        std::copy(target_, target_ + n * n, current_);
+        rampLeft_ = 0;
+        return;
+    }
+    for (size_t k = 0; k < n * n; ++k) step_[k] = (target_[k] - current_[k]) / static_cast<float>(rampFrames_);
+    rampLeft_ = rampFrames_;
+}
+
+void MatrixNode::process(const AudioBlock& block) {
+    if (settings_.read()) applySettings(settings_.current(), true);
+    if (block.channels != channels_) return;
+    const size_t n = static_cast<size_t>(channels_);
+    const size_t frames = block.frames;
+
+    // Crossfade: coefficients move one step per frame
+    size_t f = 0;
+    for (; f < frames && rampLeft_ > 0; ++f) {
+        float in[kMaxChannels];
+        for (size_t i = 0; i < n; ++i) in[i] = block.channel[i][f];
+        if (--rampLeft_ == 0) {
+            std::copy(target_, target_ + n * n, current_);
+        } else {
+            for (size_t k = 0; k < n * n; ++k) current_[k] += step_[k];
+        }
+        for (size_t o = 0; o < n; ++o) {
+            float sum = 0.0f;
+            for (size_t i = 0; i < n; ++i) sum += current_[o * n + i] * in[i];
+            block.channel[o][f] = sum;
+        }
+    }
+    if (f == frames || identity_) return;
+
+    // Settled: the mixer kernel into scratch, then back in place
+    const size_t rest = frames - f;
+    kernel_(block.slice(f, rest), scratch_, rest, target_);
+    for (size_t c = 0; c < n; ++c) std::memcpy(block.channel[c] + f, scratch_.channel[c], rest * sizeof(float));
+}
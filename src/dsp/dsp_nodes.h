@@ -0,0 +1,162 @@
+#pragma once
+/*
+ dsp_nodes.h
+
+ Purpose:
+   - The processor nodes of the player's DspChain (dsp_chain.h): adapters
+     that own the stage's processors (ParametricEq, Convolver, Limiter) and
+     two small nodes of their own, a smoothed gain and a smoothed square
+     channel matrix (crossfeed, width, channel swaps, ...).
+
+ Threads:
+   - The setters of GainNode and MatrixNode, like the processors' own, may
+     be called from one control thread at any time; the change is picked up
+     by the next process() and smoothed per sample, so it does not click.
+   - Everything else follows DspNode (prepare() while not processing,
+     reset() and process() on the processing thread).
+   - GainNode, EqNode and ConvolverNode are channel-independent: DspChain
+     may run their processChannels() for disjoint channel groups on its
+     workers.
+
+ Notes:
+   - Quality tiers (DspChain's governor): ConvolverNode keeps a quarter of
+     the response per tier (tier 1: 1/4, 2: 1/16, 3: 1/64; the late,
+     quiet part of a reverb or room response goes first), LimiterNode
+     detects sample peaks from tier 2 on. The others ignore the tier.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "dsp_chain.h"
+#include "parametric_eq.h"
+#include "convolver.h"
+#include "limiter.h"
+#include "../audio/channel_mixer.h"
+#include "../utils/triple_buffer.h"
+
+// Gain in dB, ramped with a 5 ms time constant; at 0 dB (and settled) it
+// costs nothing.
+class GainNode : public DspNode {
+public:
+    GainNode();
+
+    void setGainDb(float gainDb);
+    float gainDb() const { return gainDb_.load(std::memory_order_relaxed); }
+
+    const char* name() const override { return "gain"; }
+    bool prepare(int sampleRate, int channels) override;
+    void reset() override;
+    void process(const AudioBlock& block) override;
+    bool channelsIndependent() const override { return true; }
+    void beginBlock(size_t frames) override;
+    void processChannels(const AudioBlock& part, int first) override;
+
+private:
+    std::atomic<float> gainDb_;
+    int channels_;
+    float gain_;          // current linear gain
+    float gainStep_;      // per-frame smoothing coefficient
+    // beginBlock() -> processChannels(): the ramp's gains, then gain_
+    float ramp_[DspChain::kBlockFrames];
+    size_t rampFrames_;
+};
+
+// Square mixing matrix over the prepared channels: out[o] = sum_i m[o][i] * in[i].
+// A change is crossfaded linearly over ~10 ms (coefficients interpolated per
+// frame); settled, it runs through ChannelMixer's planar SIMD kernel.
+class MatrixNode : public DspNode {
+public:
+    static constexpr int kMaxChannels = ChannelMixer::kMaxChannels;
+
+    MatrixNode();
+
+    // Row-major channels x channels matrix; it applies while the stream has
+    // that many channels (any other stream passes through). An empty matrix
+    // is the identity.
+    void setMatrix(int channels, const std::vector<float>& matrix);
+
+    const char* name() const override { return "matrix"; }
+    bool prepare(int sampleRate, int channels) override;
+    void reset() override;
+    void process(const AudioBlock& block) override;
+
+private:
+    struct Settings {
+        float matrix[kMaxChannels * kMaxChannels] = {};
+        int channels = 0;     // 0 = identity
+    };
+
+    void applySettings(const Settings& settings, bool ramp);
+
+    TripleBuffer<Settings> settings_;
+    int channels_;
+    size_t rampFrames_;
+    size_t rampLeft_;
+    bool identity_;                       // target is the identity
+    PlanarMixKernelFn kernel_;
+    float current_[kMaxChannels * kMaxChannels];
+    float target_[kMaxChannels * kMaxChannels];
+    float step_[kMaxChannels * kMaxChannels];
+    AudioBlockPool pool_;                 // one kBlockFrames scratch block
+    AudioBlock scratch_;
+};
+
+// ParametricEq as a node
+class EqNode : public DspNode {
+public:
+    ParametricEq& eq() { return eq_; }
+
+    const char* name() const override { return "eq"; }
+    bool prepare(int sampleRate, int channels) override { return eq_.prepare(sampleRate, channels); }
+    void reset() override { eq_.reset(); }
+    void process(const AudioBlock& block) override { eq_.process(block); }
+    bool channelsIndependent() const override { return true; }
+    void beginBlock(size_t frames) override { eq_.beginBlock(frames); }
+    void processChannels(const AudioBlock& part, int first) override { eq_.processChannels(part, first); }
+
+private:
+    ParametricEq eq_;
+};
+
+// Convolver as a node; its worker thread's time is the background cost.
+class ConvolverNode : public DspNode {
+public:
+    Convolver& convolver() { return convolver_; }
+
+    const char* name() const override { return "convolver"; }
+    bool prepare(int sampleRate, int channels) override { return convolver_.prepare(sampleRate, channels); }
+    void reset() override { convolver_.reset(); }
+    void process(const AudioBlock& block) override { convolver_.process(block); }
+    bool channelsIndependent() const override { return true; }
+    void beginBlock(size_t) override { convolver_.beginBlock(); }
+    void processChannels(const AudioBlock& part, int first) override { convolver_.processChannels(part, first); }
+    size_t latency() const override { return convolver_.latency(); }
+    size_t tailFrames() const override { return convolver_.tailFrames(); }
+    uint64_t backgroundNanos() const override { return convolver_.workerNanos(); }
+    void setQualityTier(int tier) override {
+        convolver_.setTailLimit(tier > 0 ? std::max<size_t>(1, convolver_.length() >> (2 * tier)) : 0);
+    }
+
+private:
+    Convolver convolver_;
+};
+
+// Limiter as a node
+class LimiterNode : public DspNode {
+public:
+    Limiter& limiter() { return limiter_; }
+
+    const char* name() const override { return "limiter"; }
+    bool prepare(int sampleRate, int channels) override { return limiter_.prepare(sampleRate, channels); }
+    void reset() override { limiter_.reset(); }
+    void process(const AudioBlock& block) override { limiter_.process(block); }
+    size_t latency() const override { return limiter_.latency(); }
+    void setQualityTier(int tier) override { limiter_.setSamplePeak(tier >= 2); }
+
+private:
+    Limiter limiter_;
+};
@@ -0,0 +1,193 @@
+/*
+ dsp_workers.cpp
+
+ Worker threads, task claiming and the spin-then-park hand-offs. See
+ dsp_workers.h.
+
+ Wake-ups without lost signals: a thread about to park increments its
+ counter (parked_, callerParked_) under mutex_ and then checks its
+ condition once more; the other side changes the condition first and then
+ reads the counter, taking the mutex before notifying if it is set. All
+ of these are sequentially consistent, so either the parking thread sees
+ the change or the other side sees it parking.
+*/
+
+#include "dsp_workers.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+inline void cpuRelax() {
+#if defined(__SSE2__) || defined(_M_X64)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+uint64_t steadyNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// CPUs this thread may run on (its affinity mask, which reflects taskset
+// and cpuset cgroups) other than the one it is on now. Without affinity
+// support, cores 1..N-1 are counted but pinToCore() cannot use them.
+std::vector<unsigned> spareCores() {
+    std::vector<unsigned> cores;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return cores;
+    const int self = sched_getcpu();
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set) && cpu != self) cores.push_back(static_cast<unsigned>(cpu));
+    }
+#else
+    for (unsigned cpu = 1; cpu < std::thread::hardware_concurrency(); ++cpu) cores.push_back(cpu);
+#endif
+    return cores;
+}
+
+bool pinToCore(std::thread& thread, unsigned core) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#else
+    (void)thread;
+    (void)core;
+    return false;
+#endif
+}
+
+} // namespace
+
+DspWorkerPool::DspWorkerPool()
+    : pinned_(0),
+      spinNanos_(0),
+      fn_(nullptr),
+      context_(nullptr),
+      remaining_(0),
+      pending_(0),
+      parked_(0),
+      callerParked_(false),
+      stop_(false),
+      wakeups_(0) {}
+
+DspWorkerPool::~DspWorkerPool() {
+    stop();
+}
+
+void DspWorkerPool::start(int workers) {
+    stop();
+    workers = std::max(0, std::min(kMaxWorkers, workers));
+    const std::vector<unsigned> cores = spareCores();
+    const bool spare = cores.size() >= static_cast<size_t>(workers);
+    spinNanos_ = spare ? kSpinNanos : 0;
+    for (int i = 0; i < workers; ++i) {
+        threads_.emplace_back(&DspWorkerPool::workerLoop, this);
+        if (spare && pinToCore(threads_.back(), cores[static_cast<size_t>(i)])) ++pinned_;
+    }
+}
+
+void DspWorkerPool::stop() {
+    if (threads_.empty()) return;
+    stop_.store(true);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    wakeCv_.notify_all();
+    for (std::thread& thread : threads_) thread.join();
+    threads_.clear();
+    pinned_ = 0;
+    stop_.store(false);
+}
+
+// True once `ready()` holds, false if it did not within spinNanos_.
+template <typename Ready>
+bool DspWorkerPool::spinUntil(const Ready& ready) const {
+    if (ready()) return true;
+    if (spinNanos_ == 0) return false;
+    const uint64_t end = steadyNanos() + spinNanos_;
+    for (;;) {
+        for (int i = 0; i < 64; ++i) {
+            cpuRelax();
+            if (ready()) return true;
+        }
+        if (steadyNanos() >= end) return false;
+    }
+}
+
+void DspWorkerPool::run(int tasks, TaskFn fn, void* context) {
+    if (tasks <= 0) return;
+    if (threads_.empty() || tasks == 1) {
+        for (int i = 0; i < tasks; ++i) fn(context, i);
+        return;
+    }
+    fn_ = fn;
+    context_ = context;
+    pending_.store(tasks, std::memory_order_relaxed);
+    remaining_.store(tasks);
+    if (parked_.load() > 0) {
+        wakeups_.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+        }
+        wakeCv_.notify_all();
+    }
+
+    work();
+
+    // Tasks still running on workers
+    const auto done = [this] { return pending_.load(std::memory_order_acquire) == 0; };
+    if (spinUntil(done)) return;
+    std::unique_lock<std::mutex> lock(mutex_);
+    callerParked_.store(true);
+    doneCv_.wait(lock, done);
+    callerParked_.store(false, std::memory_order_relaxed);
+}
+
+// Claim and run tasks of the current job until none are left.
+void DspWorkerPool::work() {
+    for (;;) {
+        const int left = remaining_.fetch_sub(1, std::memory_order_acq_rel);
+        if (left <= 0) return;
+        fn_(context_, left - 1);
+        if (pending_.fetch_sub(1) == 1 && callerParked_.load()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+            }
+            doneCv_.notify_one();
+        }
+    }
+}
+
+void DspWorkerPool::workerLoop() {
+    const auto ready = [this] {
+        return remaining_.load(std::memory_order_acquire) > 0 || stop_.load(std::memory_order_relaxed);
+    };
+    for (;;) {
+        if (!spinUntil(ready)) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            parked_.fetch_add(1);
+            wakeCv_.wait(lock, [this] { return remaining_.load() > 0 || stop_.load(); });
+            parked_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        if (stop_.load(std::memory_order_relaxed)) return;
+        work();
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+/*
+ dsp_workers.h
+
+ Purpose:
+   - A small pool of worker threads for the DSP stage: DspChain hands it
+     the channel groups of a block (dsp_chain.h) and the calling thread
+     (the decode thread) works along, so a block of independent per-channel
+     work finishes in a fraction of its serial time.
+
+ How:
+   - run() publishes the task count; the workers and the caller claim tasks
+     through one atomic counter until none are left, then the caller waits
+     for the ones still running. Nothing locks or allocates on this path.
+   - Spin-then-park: an idle worker spins (with a pause instruction) for
+     kSpinNanos, so the next fork of the same block or the next block finds
+     it awake, then parks on a condition variable; run() only touches the
+     mutex when a worker is parked. The caller waits for the last task the
+     same way.
+   - Workers are pinned (Linux) to cores from the caller's affinity mask,
+     skipping the core start() runs on, when the mask has one for each of
+     them; otherwise they are not pinned and do not spin (a spinning thread
+     would only take the core from the one it waits for).
+
+ Threads:
+   - start(), stop() and run() belong to one thread (the chain's processing
+     thread, or the control thread while nothing processes).
+*/
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class DspWorkerPool {
+public:
+    using TaskFn = void (*)(void* context, int task);
+
+    static constexpr int kMaxWorkers = 16;
+    static constexpr uint64_t kSpinNanos = 50000;   // 50 us
+
+    DspWorkerPool();
+    ~DspWorkerPool();
+
+    DspWorkerPool(const DspWorkerPool&) = delete;
+    DspWorkerPool& operator=(const DspWorkerPool&) = delete;
+
+    // Start `workers` threads (clamped to 0..kMaxWorkers), replacing the
+    // running ones; with 0 run() does all tasks on the caller.
+    void start(int workers);
+    void stop();
+
+    int workers() const { return static_cast<int>(threads_.size()); }
+    // Workers pinned to a core of their own
+    int pinned() const { return pinned_; }
+
+    // fn(context, task) for every task in [0, tasks), spread over the
+    // workers and the calling thread; returns when all are done.
+    void run(int tasks, TaskFn fn, void* context);
+
+    // Calls to run() that had to wake a parked worker.
+    uint64_t wakeups() const { return wakeups_.load(std::memory_order_relaxed); }
+
+private:
+    template <typename Ready>
+    bool spinUntil(const Ready& ready) const;
+    void workerLoop();
+    void work();
+
+    std::vector<std::thread> threads_;
+    int pinned_;
+    uint64_t spinNanos_;              // kSpinNanos, or 0 without spare cores
+
+    // current job; fn_ and context_ are written before remaining_ is set
+    TaskFn fn_;
+    void* context_;
+    std::atomic<int> remaining_;      // tasks not yet claimed (may go below 0)
+    std::atomic<int> pending_;        // tasks not yet finished
+
+    std::mutex mutex_;
+    std::condition_variable wakeCv_;  // caller -> parked workers
+    std::condition_variable doneCv_;  // last task -> parked caller
+    std::atomic<int> parked_;         // workers waiting on wakeCv_
+    std::atomic<bool> callerParked_;
+    std::atomic<bool> stop_;
+    std::atomic<uint64_t> wakeups_;
+};
@@ -0,0 +1,476 @@
+/*
+ fft.cpp
+
+ Stockham passes, the real split/merge passes and the spectrum
+ multiply-accumulate, per SIMD variant. See fft.h.
+
+ Conventions (M = bins(), N = size() = 2M):
+   - Pass with half length m and stride s (m * s = M / 2):
+       a = x[q + s p], b = x[q + s (p + m)]
+       y[q + 2 s p] = a + b,  y[q + s (2p + 1)] = (a - b) w^p,  w = exp(-i pi / m)
+   - Split: Z = FFT(x[2k] + i x[2k+1]); with W = exp(-2 pi i k / N),
+       X[k] = E + W O,  E = (Z[k] + conj Z[M-k]) / 2,  O = (Z[k] - conj Z[M-k]) / 2i
+   - Merge inverts the split; the inverse complex FFT is the forward one with
+     real and imaginary parts swapped on the way in and out.
+*/
+
+#include "fft.h"
+
+#include <cmath>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define FFT_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+#include <immintrin.h>
+// Passes without FMA (the compiler would contract them and lose exactness)
+#define FFT_TARGET_AVX2 __attribute__((target("avx2")))
+#define FFT_TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+#endif
+
+namespace {
+
+// -----------------------------
+// Scalar (reference, small passes, other targets)
+// -----------------------------
+void passScalar(const float* xr, const float* xi, float* yr, float* yi,
+                size_t half, size_t stride, const float* wr, const float* wi) {
+    for (size_t p = 0; p < half; ++p) {
+        const float cr = wr[p];
+        const float ci = wi[p];
+        for (size_t q = 0; q < stride; ++q) {
+            const size_t a = q + stride * p;
+            const size_t b = a + stride * half;
+            const size_t even = q + stride * 2 * p;
+            const size_t odd = even + stride;
+            const float dr = xr[a] - xr[b];
+            const float di = xi[a] - xi[b];
+            yr[even] = xr[a] + xr[b];
+            yi[even] = xi[a] + xi[b];
+            yr[odd] = dr * cr - di * ci;
+            yi[odd] = dr * ci + di * cr;
+        }
+    }
+}
+
+void splitScalar(const float* zr, const float* zi, float* xr, float* xi,
+                 size_t bins, const float* wr, const float* wi) {
+    xr[0] = zr[0] + zi[0];
+    xi[0] = zr[0] - zi[0];
+    for (size_t k = 1; k < bins; ++k) {
+        const size_t m = bins - k;
+        const float er = (zr[k] + zr[m]) * 0.5f;
+        const float ei = (zi[k] - zi[m]) * 0.5f;
+        const float orr = (zi[k] + zi[m]) * 0.5f;
+        const float oi = (zr[m] - zr[k]) * 0.5f;
+        xr[k] = er + (wr[k] * orr - wi[k] * oi);
+        xi[k] = ei + (wr[k] * oi + wi[k] * orr);
+    }
+}
+
+void mergeScalar(const float* xr, const float* xi, float* zr, float* zi,
+                 size_t bins, const float* wr, const float* wi) {
+    zr[0] = (xr[0] + xi[0]) * 0.5f;
+    zi[0] = (xr[0] - xi[0]) * 0.5f;
+    for (size_t k = 1; k < bins; ++k) {
+        const size_t m = bins - k;
+        const float er = (xr[k] + xr[m]) * 0.5f;
+        const float ei = (xi[k] - xi[m]) * 0.5f;
+        const float dr = (xr[k] - xr[m]) * 0.5f;
+        const float di = (xi[k] + xi[m]) * 0.5f;
+        const float orr = wr[k] * dr + wi[k] * di;
+        const float oi = wr[k] * di - wi[k] * dr;
+        zr[k] = er - oi;
+        zi[k] = ei + orr;
+    }
+}
+
+void macScalar(const float* xr, const float* xi, const float* hr, const float* hi,
+               float* yr, float* yi, size_t bins) {
+    // Bin 0 holds two real bins (DC, Nyquist)
+    const float dc = yr[0] + xr[0] * hr[0];
+    const float nyquist = yi[0] + xi[0] * hi[0];
+    for (size_t k = 0; k < bins; ++k) {
+        const float r = xr[k] * hr[k] - xi[k] * hi[k];
+        const float i = xr[k] * hi[k] + xi[k] * hr[k];
+        yr[k] += r;
+        yi[k] += i;
+    }
+    yr[0] = dc;
+    yi[0] = nyquist;
+}
+
+void deinterleaveScalar(const float* x, float* re, float* im, size_t bins) {
+    for (size_t k = 0; k < bins; ++k) {
+        re[k] = x[2 * k];
+        im[k] = x[2 * k + 1];
+    }
+}
+
+void interleaveScalar(const float* re, const float* im, float* x, size_t bins) {
+    for (size_t k = 0; k < bins; ++k) {
+        x[2 * k] = re[k];
+        x[2 * k + 1] = im[k];
+    }
+}
+
+#if defined(FFT_USE_SSE2)
+// -----------------------------
+// SSE2 (same operation order as scalar)
+// -----------------------------
+inline __m128 reversed(__m128 v) {
+    return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+void passSse2(const float* xr, const float* xi, float* yr, float* yi,
+              size_t half, size_t stride, const float* wr, const float* wi) {
+    if (stride >= 4) {
+        // Four q per step, one twiddle per p
+        for (size_t p = 0; p < half; ++p) {
+            const __m128 cr = _mm_set1_ps(wr[p]);
+            const __m128 ci = _mm_set1_ps(wi[p]);
+            const size_t a0 = stride * p;
+            const size_t b0 = a0 + stride * half;
+            const size_t e0 = stride * 2 * p;
+            const size_t o0 = e0 + stride;
+            for (size_t q = 0; q < stride; q += 4) {
+                const __m128 ar = _mm_loadu_ps(xr + a0 + q), ai = _mm_loadu_ps(xi + a0 + q);
+                const __m128 br = _mm_loadu_ps(xr + b0 + q), bi = _mm_loadu_ps(xi + b0 + q);
+                const __m128 dr = _mm_sub_ps(ar, br), di = _mm_sub_ps(ai, bi);
+                _mm_storeu_ps(yr + e0 + q, _mm_add_ps(ar, br));
+                _mm_storeu_ps(yi + e0 + q, _mm_add_ps(ai, bi));
+                _mm_storeu_ps(yr + o0 + q, _mm_sub_ps(_mm_mul_ps(dr, cr), _mm_mul_ps(di, ci)));
+                _mm_storeu_ps(yi + o0 + q, _mm_add_ps(_mm_mul_ps(dr, ci), _mm_mul_ps(di, cr)));
+            }
+        }
+    } else if (stride == 2 && half >= 2) {
+        // Two p x two q per step: outputs (p,0) (p,1) | odd (p,0) (p,1) | ...
+        for (size_t p = 0; p < half; p += 2) {
+            const __m128 w2r = _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(wr + p)));
+            const __m128 w2i = _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(wi + p)));
+            const __m128 cr = _mm_unpacklo_ps(w2r, w2r);   // w_p w_p w_p+1 w_p+1
+            const __m128 ci = _mm_unpacklo_ps(w2i, w2i);
+            const size_t a0 = 2 * p;
+            const size_t b0 = a0 + 2 * half;
+            const __m128 ar = _mm_loadu_ps(xr + a0), ai = _mm_loadu_ps(xi + a0);
+            const __m128 br = _mm_loadu_ps(xr + b0), bi = _mm_loadu_ps(xi + b0);
+            const __m128 sr = _mm_add_ps(ar, br), si = _mm_add_ps(ai, bi);
+            const __m128 dr = _mm_sub_ps(ar, br), di = _mm_sub_ps(ai, bi);
+            const __m128 tr = _mm_sub_ps(_mm_mul_ps(dr, cr), _mm_mul_ps(di, ci));
+            const __m128 ti = _mm_add_ps(_mm_mul_ps(dr, ci), _mm_mul_ps(di, cr));
+            _mm_storeu_ps(yr + 4 * p, _mm_movelh_ps(sr, tr));
+            _mm_storeu_ps(yi + 4 * p, _mm_movelh_ps(si, ti));
+            _mm_storeu_ps(yr + 4 * p + 4, _mm_movehl_ps(tr, sr));
+            _mm_storeu_ps(yi + 4 * p + 4, _mm_movehl_ps(ti, si));
+        }
+    } else if (stride == 1 && half >= 4) {
+        // Four p per step: outputs interleave even/odd
+        for (size_t p = 0; p < half; p += 4) {
+            const __m128 cr = _mm_loadu_ps(wr + p), ci = _mm_loadu_ps(wi + p);
+            const __m128 ar = _mm_loadu_ps(xr + p), ai = _mm_loadu_ps(xi + p);
+            const __m128 br = _mm_loadu_ps(xr + p + half), bi = _mm_loadu_ps(xi + p + half);
+            const __m128 sr = _mm_add_ps(ar, br), si = _mm_add_ps(ai, bi);
+            const __m128 dr = _mm_sub_ps(ar, br), di = _mm_sub_ps(ai, bi);
+            const __m128 tr = _mm_sub_ps(_mm_mul_ps(dr, cr), _mm_mul_ps(di, ci));
+            const __m128 ti = _mm_add_ps(_mm_mul_ps(dr, ci), _mm_mul_ps(di, cr));
+            _mm_storeu_ps(yr + 2 * p, _mm_unpacklo_ps(sr, tr));
+            _mm_storeu_ps(yi + 2 * p, _mm_unpacklo_ps(si, ti));
+            _mm_storeu_ps(yr + 2 * p + 4, _mm_unpackhi_ps(sr, tr));
+            _mm_storeu_ps(yi + 2 * p + 4, _mm_unpackhi_ps(si, ti));
+        }
+    } else {
+        passScalar(xr, xi, yr, yi, half, stride, wr, wi);
+    }
+}
+
+void splitSse2(const float* zr, const float* zi, float* xr, float* xi,
+               size_t bins, const float* wr, const float* wi) {
+    xr[0] = zr[0] + zi[0];
+    xi[0] = zr[0] - zi[0];
+    const __m128 halfScale = _mm_set1_ps(0.5f);
+    size_t k = 1;
+    for (; k + 4 <= bins; k += 4) {
+        const size_t m = bins - k - 3;   // Z[M-k-3 .. M-k], reversed below
+        const __m128 ar = _mm_loadu_ps(zr + k), ai = _mm_loadu_ps(zi + k);
+        const __m128 br = reversed(_mm_loadu_ps(zr + m)), bi = reversed(_mm_loadu_ps(zi + m));
+        const __m128 cr = _mm_loadu_ps(wr + k), ci = _mm_loadu_ps(wi + k);
+        const __m128 er = _mm_mul_ps(_mm_add_ps(ar, br), halfScale);
+        const __m128 ei = _mm_mul_ps(_mm_sub_ps(ai, bi), halfScale);
+        const __m128 orr = _mm_mul_ps(_mm_add_ps(ai, bi), halfScale);
+        const __m128 oi = _mm_mul_ps(_mm_sub_ps(br, ar), halfScale);
+        _mm_storeu_ps(xr + k, _mm_add_ps(er, _mm_sub_ps(_mm_mul_ps(cr, orr), _mm_mul_ps(ci, oi))));
+        _mm_storeu_ps(xi + k, _mm_add_ps(ei, _mm_add_ps(_mm_mul_ps(cr, oi), _mm_mul_ps(ci, orr))));
+    }
+    for (; k < bins; ++k) {
+        const size_t m = bins - k;
+        const float er = (zr[k] + zr[m]) * 0.5f;
+        const float ei = (zi[k] - zi[m]) * 0.5f;
+        const float orr = (zi[k] + zi[m]) * 0.5f;
+        const float oi = (zr[m] - zr[k]) * 0.5f;
+        xr[k] = er + (wr[k] * orr - wi[k] * oi);
+        xi[k] = ei + (wr[k] * oi + wi[k] * orr);
+    }
+}
+
+void mergeSse2(const float* xr, const float* xi, float* zr, float* zi,
+               size_t bins, const float* wr, const float* wi) {
+    zr[0] = (xr[0] + xi[0]) * 0.5f;
+    zi[0] = (xr[0] - xi[0]) * 0.5f;
+    const __m128 halfScale = _mm_set1_ps(0.5f);
+    size_t k = 1;
+    for (; k + 4 <= bins; k += 4) {
+        const size_t m = bins - k - 3;
+        const __m128 ar = _mm_loadu_ps(xr + k), ai = _mm_loadu_ps(xi + k);
+        const __m128 br = reversed(_mm_loadu_ps(xr + m)), bi = reversed(_mm_loadu_ps(xi + m));
+        const __m128 cr = _mm_loadu_ps(wr + k), ci = _mm_loadu_ps(wi + k);
+        const __m128 er = _mm_mul_ps(_mm_add_ps(ar, br), halfScale);
+        const __m128 ei = _mm_mul_ps(_mm_sub_ps(ai, bi), halfScale);
+        const __m128 dr = _mm_mul_ps(_mm_sub_ps(ar, br), halfScale);
+        const __m128 di = _mm_mul_ps(_mm_add_ps(ai, bi), halfScale);
+        const __m128 orr = _mm_add_ps(_mm_mul_ps(cr, dr), _mm_mul_ps(ci, di));
+        const __m128 oi = _mm_sub_ps(_mm_mul_ps(cr, di), _mm_mul_ps(ci, dr));
+        _mm_storeu_ps(zr + k, _mm_sub_ps(er, oi));
+        _mm_storeu_ps(zi + k, _mm_add_ps(ei, orr));
+    }
+    for (; k < bins; ++k) {
+        const size_t m = bins - k;
+        const float er = (xr[k] + xr[m]) * 0.5f;
+        const float ei = (xi[k] - xi[m]) * 0.5f;
+        const float dr = (xr[k] - xr[m]) * 0.5f;
+        const float di = (xi[k] + xi[m]) * 0.5f;
+        const float orr = wr[k] * dr + wi[k] * di;
+        const float oi = wr[k] * di - wi[k] * dr;
+        zr[k] = er - oi;
+        zi[k] = ei + orr;
+    }
+}
+
+void macSse2(const float* xr, const float* xi, const float* hr, const float* hi,
+             float* yr, float* yi, size_t bins) {
+    const float dc = yr[0] + xr[0] * hr[0];
+    const float nyquist = yi[0] + xi[0] * hi[0];
+    size_t k = 0;
+    for (; k + 4 <= bins; k += 4) {
+        const __m128 ar = _mm_loadu_ps(xr + k), ai = _mm_loadu_ps(xi + k);
+        const __m128 br = _mm_loadu_ps(hr + k), bi = _mm_loadu_ps(hi + k);
+        const __m128 r = _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi));
+        const __m128 i = _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br));
+        _mm_storeu_ps(yr + k, _mm_add_ps(_mm_loadu_ps(yr + k), r));
+        _mm_storeu_ps(yi + k, _mm_add_ps(_mm_loadu_ps(yi + k), i));
+    }
+    for (; k < bins; ++k) {
+        const float r = xr[k] * hr[k] - xi[k] * hi[k];
+        const float i = xr[k] * hi[k] + xi[k] * hr[k];
+        yr[k] += r;
+        yi[k] += i;
+    }
+    yr[0] = dc;
+    yi[0] = nyquist;
+}
+
+void deinterleaveSse2(const float* x, float* re, float* im, size_t bins) {
+    size_t k = 0;
+    for (; k + 4 <= bins; k += 4) {
+        const __m128 lo = _mm_loadu_ps(x + 2 * k);
+        const __m128 hi = _mm_loadu_ps(x + 2 * k + 4);
+        _mm_storeu_ps(re + k, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(im + k, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    deinterleaveScalar(x + 2 * k, re + k, im + k, bins - k);
+}
+
+void interleaveSse2(const float* re, const float* im, float* x, size_t bins) {
+    size_t k = 0;
+    for (; k + 4 <= bins; k += 4) {
+        const __m128 r = _mm_loadu_ps(re + k);
+        const __m128 i = _mm_loadu_ps(im + k);
+        _mm_storeu_ps(x + 2 * k, _mm_unpacklo_ps(r, i));
+        _mm_storeu_ps(x + 2 * k + 4, _mm_unpackhi_ps(r, i));
+    }
+    interleaveScalar(re + k, im + k, x + 2 * k, bins - k);
+}
+#endif // FFT_USE_SSE2
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+// -----------------------------
+// AVX2 (+ FMA in the multiply-accumulate); narrow passes go to SSE2
+// -----------------------------
+FFT_TARGET_AVX2 void passAvx2(const float* xr, const float* xi, float* yr, float* yi,
+                              size_t half, size_t stride, const float* wr, const float* wi) {
+    if (stride < 8) {
+        passSse2(xr, xi, yr, yi, half, stride, wr, wi);
+        return;
+    }
+    for (size_t p = 0; p < half; ++p) {
+        const __m256 cr = _mm256_set1_ps(wr[p]);
+        const __m256 ci = _mm256_set1_ps(wi[p]);
+        const size_t a0 = stride * p;
+        const size_t b0 = a0 + stride * half;
+        const size_t e0 = stride * 2 * p;
+        const size_t o0 = e0 + stride;
+        for (size_t q = 0; q < stride; q += 8) {
+            const __m256 ar = _mm256_loadu_ps(xr + a0 + q), ai = _mm256_loadu_ps(xi + a0 + q);
+            const __m256 br = _mm256_loadu_ps(xr + b0 + q), bi = _mm256_loadu_ps(xi + b0 + q);
+            const __m256 dr = _mm256_sub_ps(ar, br), di = _mm256_sub_ps(ai, bi);
+            _mm256_storeu_ps(yr + e0 + q, _mm256_add_ps(ar, br));
+            _mm256_storeu_ps(yi + e0 + q, _mm256_add_ps(ai, bi));
+            _mm256_storeu_ps(yr + o0 + q, _mm256_sub_ps(_mm256_mul_ps(dr, cr), _mm256_mul_ps(di, ci)));
+            _mm256_storeu_ps(yi + o0 + q, _mm256_add_ps(_mm256_mul_ps(dr, ci), _mm256_mul_ps(di, cr)));
+        }
+    }
+}
+
+FFT_TARGET_AVX2_FMA void macAvx2(const float* xr, const float* xi, const float* hr, const float* hi,
+                             float* yr, float* yi, size_t bins) {
+    const float dc = yr[0] + xr[0] * hr[0];
+    const float nyquist = yi[0] + xi[0] * hi[0];
+    size_t k = 0;
+    for (; k + 8 <= bins; k += 8) {
+        const __m256 ar = _mm256_loadu_ps(xr + k), ai = _mm256_loadu_ps(xi + k);
+        const __m256 br = _mm256_loadu_ps(hr + k), bi = _mm256_loadu_ps(hi + k);
+        __m256 r = _mm256_loadu_ps(yr + k);
+        __m256 i = _mm256_loadu_ps(yi + k);
+        r = _mm256_fnmadd_ps(ai, bi, _mm256_fmadd_ps(ar, br, r));
+        i = _mm256_fmadd_ps(ai, br, _mm256_fmadd_ps(ar, bi, i));
+        _mm256_storeu_ps(yr + k, r);
+        _mm256_storeu_ps(yi + k, i);
+    }
+    for (; k < bins; ++k) {
+        const float r = xr[k] * hr[k] - xi[k] * hi[k];
+        const float i = xr[k] * hi[k] + xi[k] * hr[k];
+        yr[k] += r;
+        yi[k] += i;
+    }
+    yr[0] = dc;
+    yi[0] = nyquist;
+}
+#endif // MUSIC_PLAYER_X86_DISPATCH
+
+} // namespace
+
+// -----------------------------
+// RealFft
+// -----------------------------
+RealFft::RealFft()
+    : size_(0),
+      pass_(&passScalar),
+      split_(&splitScalar),
+      merge_(&mergeScalar),
+      variant_("scalar"),
+      sse2_(false)
+{}
+
+bool RealFft::init(size_t size, SimdLevel level) {
+    if (size < kMinSize || (size & (size - 1)) != 0) return false;
+    if (level > detectedSimdLevel()) level = detectedSimdLevel();
+    size_ = size;
+
+    pass_ = &passScalar;
+    split_ = &splitScalar;
+    merge_ = &mergeScalar;
+    variant_ = "scalar";
+    sse2_ = false;
+#if defined(FFT_USE_SSE2)
+    if (level >= SimdLevel::SSE2) {
+        sse2_ = true;
+        pass_ = &passSse2;
+        split_ = &splitSse2;
+        merge_ = &mergeSse2;
+        variant_ = "sse2";
+    }
+#endif
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+    if (level >= SimdLevel::AVX2) {
+        pass_ = &passAvx2;
+        variant_ = "avx2";
+    }
+#endif
+
+    const double pi = 3.14159265358979323846;
+    const size_t bins = size / 2;
+    passTwiddles_.clear();
+    for (size_t half = bins / 2; half >= 1; half /= 2) {
+        const size_t base = passTwiddles_.size();
+        passTwiddles_.resize(base + 2 * half);
+        for (size_t p = 0; p < half; ++p) {
+            passTwiddles_[base + p] = static_cast<float>(std::cos(pi * p / half));
+            passTwiddles_[base + half + p] = static_cast<float>(-std::sin(pi * p / half));
+        }
+    }
+    splitTwiddles_.resize(2 * bins);
+    for (size_t k = 0; k < bins; ++k) {
+        splitTwiddles_[k] = static_cast<float>(std::cos(2.0 * pi * k / size));
+        splitTwiddles_[bins + k] = static_cast<float>(-std::sin(2.0 * pi * k / size));
+    }
+    scratch_.assign(4 * bins, 0.0f);
+    return true;
+}
+
+void RealFft::complexTransform(float*& re, float*& im) {
+    const size_t bins = size_ / 2;
+    float* a[2] = { re, im };
+    float* b[2] = { scratch_.data() + 2 * bins, scratch_.data() + 3 * bins };
+    const float* w = passTwiddles_.data();
+    size_t stride = 1;
+    for (size_t half = bins / 2; half >= 1; half /= 2) {
+        pass_(a[0], a[1], b[0], b[1], half, stride, w, w + half);
+        w += 2 * half;
+        stride *= 2;
+        std::swap(a[0], b[0]);
+        std::swap(a[1], b[1]);
+    }
+    re = a[0];
+    im = a[1];
+}
+
+void RealFft::forward(const float* x, float* re, float* im) {
+    const size_t bins = size_ / 2;
+    float* zr = scratch_.data();
+    float* zi = scratch_.data() + bins;
+#if defined(FFT_USE_SSE2)
+    if (sse2_) deinterleaveSse2(x, zr, zi, bins);
+    else
+#endif
+    deinterleaveScalar(x, zr, zi, bins);
+    complexTransform(zr, zi);
+    split_(zr, zi, re, im, bins, splitTwiddles_.data(), splitTwiddles_.data() + bins);
+}
+
+void RealFft::inverse(const float* re, const float* im, float* x) {
+    const size_t bins = size_ / 2;
+    float* zr = scratch_.data();
+    float* zi = scratch_.data() + bins;
+    merge_(re, im, zr, zi, bins, splitTwiddles_.data(), splitTwiddles_.data() + bins);
+    // Inverse transform = forward transform with re/im swapped in and out
+    float* outIm = zi;
+    float* outRe = zr;
+    complexTransform(outIm, outRe);
+#if defined(FFT_USE_SSE2)
+    if (sse2_) interleaveSse2(outRe, outIm, x, bins);
+    else
+#endif
+    interleaveScalar(outRe, outIm, x, bins);
+}
+
+SpectrumMacFn RealFft::selectMac(SimdLevel level, const char** variant) {
+    if (level > detectedSimdLevel()) level = detectedSimdLevel();
+    const char* name = "scalar";
+    SpectrumMacFn fn = &macScalar;
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+    if (level >= SimdLevel::AVX2) {
+        fn = &macAvx2;
+        name = "avx2";
+    } else
+#endif
+#if defined(FFT_USE_SSE2)
+    if (level >= SimdLevel::SSE2) {
+        fn = &macSse2;
+        name = "sse2";
+    }
+#endif
+    if (variant) *variant = name;
+    return fn;
+}
@@ -0,0 +1,82 @@
+#pragma once
+/*
+ fft.h
+
+ Purpose:
+   - Real FFT for the fast convolution in convolver.h: N real samples to
+     N/2 + 1 complex bins and back, single precision, split format (real and
+     imaginary parts in separate arrays).
+
+ How:
+   - A complex FFT of N/2 points on the even/odd sample pairs, then one pass
+     that splits it into the real spectrum (and the reverse for inverse()).
+   - The complex FFT is a radix-2 Stockham FFT: every pass reads one buffer
+     and writes the other in natural order, so there is no bit-reversal step
+     and each pass runs over contiguous data. Passes, the split pass and the
+     spectrum multiply-accumulate have scalar, SSE2 and AVX2 variants picked
+     through simdLevel() (cpu_features.h). SSE2 and AVX2 transforms match the
+     scalar one exactly; the AVX2 multiply-accumulate uses FMA.
+
+ Notes:
+   - Bin 0 packs the two real-valued bins: DC in re[0], Nyquist in im[0].
+     multiplyAccumulate() knows about it.
+   - inverse(forward(x)) returns x scaled by N/2 (no normalization pass;
+     fold 2/N into one of the spectra instead).
+   - An instance is not thread-safe (it owns the scratch buffers); use one
+     per thread.
+*/
+
+#include <cstddef>
+#include <vector>
+
+#include "../utils/cpu_features.h"
+
+// y += x * h over `bins` split-format bins (bin 0 packed, see above).
+using SpectrumMacFn = void (*)(const float* xr, const float* xi, const float* hr, const float* hi,
+                               float* yr, float* yi, size_t bins);
+
+class RealFft {
+public:
+    static constexpr size_t kMinSize = 16;
+
+    RealFft();
+
+    // Set up transforms of `size` real samples (a power of two >= kMinSize)
+    // with the widest variant at or below `level` (capped to the host).
+    bool init(size_t size, SimdLevel level = simdLevel());
+
+    size_t size() const { return size_; }
+    size_t bins() const { return size_ / 2; }   // re/im array length
+
+    // x: size() samples -> re/im: bins() values each.
+    void forward(const float* x, float* re, float* im);
+
+    // re/im: bins() values each -> x: size() samples, scaled by size() / 2.
+    void inverse(const float* re, const float* im, float* x);
+
+    // Variant in use ("scalar", "sse2", "avx2").
+    const char* variant() const { return variant_; }
+
+    // Multiply-accumulate kernel, widest variant at or below `level`.
+    static SpectrumMacFn selectMac(SimdLevel level, const char** variant = nullptr);
+
+private:
+    using PassFn = void (*)(const float* xr, const float* xi, float* yr, float* yi,
+                            size_t half, size_t stride, const float* wr, const float* wi);
+    using SplitFn = void (*)(const float* zr, const float* zi, float* xr, float* xi,
+                             size_t bins, const float* wr, const float* wi);
+
+    // Complex FFT of bins() points in place on two of the first two scratch
+    // arrays; re/im are updated to the pair holding the result.
+    void complexTransform(float*& re, float*& im);
+
+    size_t size_;
+    PassFn pass_;
+    SplitFn split_;
+    SplitFn merge_;
+    const char* variant_;
+    bool sse2_;                          // SSE2 (de)interleave
+    std::vector<float> passTwiddles_;    // per pass: re[half] then im[half]
+    std::vector<float> splitTwiddles_;   // re[bins] then im[bins]: exp(-2 pi i k / size)
+    std::vector<float> scratch_;         // ar, ai, br, bi (bins() each)
+};
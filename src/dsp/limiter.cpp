@@ -0,0 +1,358 @@
+/*
+ limiter.cpp
+
+ True-peak detector kernels and the lookahead gain computer. See limiter.h.
+
+ Timing of one processed frame (L = lookahead, H = L + kTaps - 1):
+   - required[t] is the gain the true peak detected at frame t needs. That
+     peak is interpolated from the kTaps input frames t - kTaps + 1 .. t,
+     and all of them must get at most that gain (a gain that changes across
+     them would move the peak between samples).
+   - hold[t] = min(required[t - H + 1 .. t]); the gain at frame t is the
+     average of hold over the last L frames, so it is <= required[p] for
+     every t in [p + L - 1, p + H - 1]; the release only ever lowers it
+     further. With an audio delay of L + kTaps - 2 frames those are exactly
+     the output frames carrying inputs p - kTaps + 1 .. p.
+*/
+
+#include "limiter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define LIM_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+#include <immintrin.h>
+#define LIM_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace {
+
+constexpr int kTaps = Limiter::kTaps;
+constexpr int kCentre = kTaps / 2 - 1;   // x[i + kCentre] is the detected sample
+constexpr int kPhases = 3;
+
+// -----------------------------
+// Interpolator: Kaiser-windowed sinc, one filter per fractional position
+// -----------------------------
+double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+struct Interpolator {
+    float taps[kPhases * kTaps];
+
+    Interpolator() {
+        const double pi = 3.14159265358979323846;
+        const double beta = 6.0;
+        const double halfWidth = kTaps / 2.0;
+        for (int p = 0; p < kPhases; ++p) {
+            const double frac = (p + 1) / 4.0;
+            double h[kTaps];
+            double sum = 0.0;
+            for (int k = 0; k < kTaps; ++k) {
+                const double t = (k - kCentre) - frac;
+                const double sinc = std::sin(pi * t) / (pi * t);
+                const double r = t / halfWidth;
+                const double window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(beta);
+                h[k] = sinc * window;
+                sum += h[k];
+            }
+            for (int k = 0; k < kTaps; ++k) taps[p * kTaps + k] = static_cast<float>(h[k] / sum);
+        }
+    }
+};
+
+// -----------------------------
+// Scalar (reference, tails, other targets)
+// -----------------------------
+void truePeakScalar(const float* x, float* peak, size_t n, const float* taps) {
+    for (size_t i = 0; i < n; ++i) {
+        float m = std::fabs(x[i + kCentre]);
+        for (int p = 0; p < kPhases; ++p) {
+            const float* t = taps + p * kTaps;
+            float acc = t[0] * x[i];
+            for (int k = 1; k < kTaps; ++k) acc += t[k] * x[i + k];
+            m = std::max(m, std::fabs(acc));
+        }
+        peak[i] = std::max(peak[i], m);
+    }
+}
+
+// Sample peaks only (the governor's cheaper tiers): the two samples the
+// interpolated points lie between, no interpolation. Same signature as the
+// true-peak kernels; the compiler vectorizes it.
+void samplePeakOnly(const float* x, float* peak, size_t n, const float*) {
+    for (size_t i = 0; i < n; ++i) {
+        const float m = std::max(std::fabs(x[i + kCentre]), std::fabs(x[i + kCentre + 1]));
+        peak[i] = std::max(peak[i], m);
+    }
+}
+
+#if defined(LIM_USE_SSE2)
+// -----------------------------
+// SSE2 (4 samples per step, same summation order as scalar)
+// -----------------------------
+void truePeakSse2(const float* x, float* peak, size_t n, const float* taps) {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 t[kPhases * kTaps];
+    for (int k = 0; k < kPhases * kTaps; ++k) t[k] = _mm_set1_ps(taps[k]);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 xs[kTaps];
+        for (int k = 0; k < kTaps; ++k) xs[k] = _mm_loadu_ps(x + i + k);
+        __m128 m = _mm_andnot_ps(signMask, xs[kCentre]);
+        for (int p = 0; p < kPhases; ++p) {
+            __m128 acc = _mm_mul_ps(t[p * kTaps], xs[0]);
+            for (int k = 1; k < kTaps; ++k) acc = _mm_add_ps(acc, _mm_mul_ps(t[p * kTaps + k], xs[k]));
+            m = _mm_max_ps(m, _mm_andnot_ps(signMask, acc));
+        }
+        _mm_storeu_ps(peak + i, _mm_max_ps(_mm_loadu_ps(peak + i), m));
+    }
+    truePeakScalar(x + i, peak + i, n - i, taps);
+}
+#endif // LIM_USE_SSE2
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+// -----------------------------
+// AVX2 + FMA (8 samples per step)
+// -----------------------------
+LIM_TARGET_AVX2 void truePeakAvx2(const float* x, float* peak, size_t n, const float* taps) {
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 xs[kTaps];
+        for (int k = 0; k < kTaps; ++k) xs[k] = _mm256_loadu_ps(x + i + k);
+        __m256 m = _mm256_andnot_ps(signMask, xs[kCentre]);
+        for (int p = 0; p < kPhases; ++p) {
+            const float* t = taps + p * kTaps;
+            __m256 acc = _mm256_mul_ps(_mm256_broadcast_ss(t), xs[0]);
+            for (int k = 1; k < kTaps; ++k) acc = _mm256_fmadd_ps(_mm256_broadcast_ss(t + k), xs[k], acc);
+            m = _mm256_max_ps(m, _mm256_andnot_ps(signMask, acc));
+        }
+        _mm256_storeu_ps(peak + i, _mm256_max_ps(_mm256_loadu_ps(peak + i), m));
+    }
+#if defined(LIM_USE_SSE2)
+    truePeakSse2(x + i, peak + i, n - i, taps);
+#else
+    truePeakScalar(x + i, peak + i, n - i, taps);
+#endif
+}
+#endif // MUSIC_PLAYER_X86_DISPATCH
+
+} // namespace
+
+const float* Limiter::interpolatorTaps() {
+    static const Interpolator interpolator;
+    return interpolator.taps;
+}
+
+TruePeakFn Limiter::selectKernel(SimdLevel level, const char** variant) {
+    if (level > detectedSimdLevel()) level = detectedSimdLevel();
+    const char* name = "scalar";
+    TruePeakFn fn = &truePeakScalar;
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+    if (level >= SimdLevel::AVX2) {
+        fn = &truePeakAvx2;
+        name = "avx2";
+    } else
+#endif
+#if defined(LIM_USE_SSE2)
+    if (level >= SimdLevel::SSE2) {
+        fn = &truePeakSse2;
+        name = "sse2";
+    }
+#endif
+    if (variant) *variant = name;
+    return fn;
+}
+
+// -----------------------------
+// Limiter
+// -----------------------------
+Limiter::Limiter()
+    : inputGain_(1.0f),
+      ceiling_(std::pow(10.0f, kDefaultCeilingDb / 20.0f)),
+      enabled_(true),
+      reductionDb_(0.0f),
+      channels_(0),
+      lookahead_(1),
+      holdWindow_(1),
+      delay_(0),
+      gain_(1.0f),
+      gainStep_(1.0f),
+      release_(1.0),
+      envelope_(1.0),
+      boxSum_(1.0),
+      boxPos_(0),
+      detect_(nullptr),
+      variant_("scalar"),
+      samplePeak_(false)
+{}
+
+void Limiter::setInputGain(float gain) {
+    inputGain_.store(std::max(0.0f, gain), std::memory_order_relaxed);
+}
+
+void Limiter::setCeiling(float dbTruePeak) {
+    dbTruePeak = std::min(0.0f, std::max(-20.0f, dbTruePeak));
+    ceiling_.store(std::pow(10.0f, dbTruePeak / 20.0f), std::memory_order_relaxed);
+}
+
+void Limiter::setEnabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+bool Limiter::prepare(int sampleRate, int channels) {
+    if (channels < 1 || channels > kMaxChannels || sampleRate <= 0) return false;
+    channels_ = channels;
+    lookahead_ = std::max<size_t>(1, static_cast<size_t>(std::lround(0.0015 * sampleRate)));   // 1.5 ms
+    holdWindow_ = lookahead_ + kTaps - 1;
+    delay_ = lookahead_ + kTaps - 2;
+    gainStep_ = static_cast<float>(1.0 - std::exp(-1.0 / (0.005 * sampleRate)));   // 5 ms
+    release_ = 1.0 - std::exp(-1.0 / (0.080 * sampleRate));                        // 80 ms
+    detect_ = selectKernel(simdLevel(), &variant_);
+    samplePeak_ = false;
+
+    const size_t window = holdWindow_ - 1 + kMaxBlockFrames;
+    gains_.assign(kMaxBlockFrames, 1.0f);
+    peak_.assign(kMaxBlockFrames, 0.0f);
+    required_.assign(window, 1.0f);
+    prefix_.assign(window, 1.0f);
+    suffix_.assign(window, 1.0f);
+    hold_.assign(kMaxBlockFrames, 1.0f);
+    box_.assign(lookahead_, 1.0f);
+    delayed_.assign((delay_ + kMaxBlockFrames) * static_cast<size_t>(channels), 0.0f);
+    reset();
+    return true;
+}
+
+void Limiter::reset() {
+    std::fill(required_.begin(), required_.end(), 1.0f);
+    std::fill(box_.begin(), box_.end(), 1.0f);
+    std::fill(delayed_.begin(), delayed_.end(), 0.0f);
+    boxSum_ = static_cast<double>(lookahead_);
+    boxPos_ = 0;
+    envelope_ = 1.0;
+    gain_ = inputGain_.load(std::memory_order_relaxed);
+    reductionDb_.store(0.0f, std::memory_order_relaxed);
+}
+
+void Limiter::setSamplePeak(bool on) {
+    samplePeak_ = on;
+}
+
+void Limiter::process(const AudioBlock& block) {
+    if (!detect_ || block.channels != channels_) return;
+    for (size_t done = 0; done < block.frames; done += kMaxBlockFrames) {
+        processChunk(block.slice(done, std::min(block.frames - done, kMaxBlockFrames)));
+    }
+}
+
+// hold_[i] = min(required_[i .. i + H - 1]) (van Herk / Gil-Werman: prefix
+// and suffix minima over blocks of H, then one min per output).
+void Limiter::slidingMin(size_t frames) {
+    const size_t window = holdWindow_;
+    const size_t total = frames + window - 1;
+    const float* a = required_.data();
+    float* prefix = prefix_.data();
+    float* suffix = suffix_.data();
+    for (size_t start = 0; start < total; start += window) {
+        const size_t end = std::min(start + window, total);
+        prefix[start] = a[start];
+        for (size_t j = start + 1; j < end; ++j) prefix[j] = std::min(prefix[j - 1], a[j]);
+        suffix[end - 1] = a[end - 1];
+        for (size_t j = end - 1; j > start; --j) suffix[j - 1] = std::min(suffix[j], a[j - 1]);
+    }
+    for (size_t i = 0; i < frames; ++i) hold_[i] = std::min(suffix[i], prefix[i + window - 1]);
+}
+
+void Limiter::processChunk(const AudioBlock& block) {
+    const size_t channels = static_cast<size_t>(channels_);
+    const size_t frames = block.frames;
+    const size_t stride = delay_ + kMaxBlockFrames;
+
+    // Input gain (volume boost), smoothed per frame, applied on the way into
+    // the delay line: [delay_ old frames | this chunk] per channel
+    const float target = inputGain_.load(std::memory_order_relaxed);
+    const bool scaled = gain_ != target || gain_ != 1.0f;
+    if (scaled) {
+        for (size_t f = 0; f < frames; ++f) {
+            gain_ += (target - gain_) * gainStep_;
+            if (std::fabs(target - gain_) < 1e-6f) gain_ = target;
+            gains_[f] = gain_;
+        }
+    }
+    for (size_t c = 0; c < channels; ++c) {
+        const float* in = block.channel[c];
+        float* line = delayed_.data() + c * stride + delay_;
+        if (scaled) {
+            for (size_t f = 0; f < frames; ++f) line[f] = in[f] * gains_[f];
+        } else {
+            std::memcpy(line, in, frames * sizeof(float));
+        }
+    }
+
+    // True peaks, loudest channel per frame; the interpolator's history is
+    // the end of the delayed frames
+    const bool on = enabled_.load(std::memory_order_relaxed);
+    const float ceiling = ceiling_.load(std::memory_order_relaxed);
+    const size_t keep = kTaps - 1;
+    const float* taps = interpolatorTaps();
+    const TruePeakFn detect = samplePeak_ ? &samplePeakOnly : detect_;
+    if (on) {
+        std::fill(peak_.begin(), peak_.begin() + frames, 0.0f);
+        for (size_t c = 0; c < channels; ++c) {
+            detect(delayed_.data() + c * stride + delay_ - keep, peak_.data(), frames, taps);
+        }
+    }
+
+    // Gain each detected frame needs, held over the lookahead plus the
+    // interpolator's span (every sample a true peak is made of gets at least
+    // that reduction) and averaged over the lookahead
+    float* required = required_.data() + holdWindow_ - 1;
+    for (size_t i = 0; i < frames; ++i) {
+        required[i] = on && peak_[i] > ceiling ? ceiling / peak_[i] : 1.0f;
+    }
+    slidingMin(frames);
+    std::memmove(required_.data(), required_.data() + frames, (holdWindow_ - 1) * sizeof(float));
+
+    const double inverseWindow = 1.0 / static_cast<double>(lookahead_);
+    double lowest = 1.0;
+    for (size_t i = 0; i < frames; ++i) {
+        boxSum_ += hold_[i] - box_[boxPos_];
+        box_[boxPos_] = hold_[i];
+        if (++boxPos_ == lookahead_) {
+            // Re-sum once per window so rounding cannot build up.
+            boxPos_ = 0;
+            boxSum_ = 0.0;
+            for (float g : box_) boxSum_ += g;
+        }
+        const double average = boxSum_ * inverseWindow;
+        envelope_ = average < envelope_ ? average : envelope_ + (average - envelope_) * release_;
+        hold_[i] = static_cast<float>(envelope_);
+        lowest = std::min(lowest, envelope_);
+    }
+
+    // Output the oldest frames with the gain, keep the tail
+    const float* hold = hold_.data();
+    for (size_t c = 0; c < channels; ++c) {
+        float* line = delayed_.data() + c * stride;
+        float* out = block.channel[c];
+        for (size_t f = 0; f < frames; ++f) out[f] = line[f] * hold[f];
+        std::memmove(line, line + frames, delay_ * sizeof(float));
+    }
+
+    reductionDb_.store(static_cast<float>(20.0 * std::log10(std::max(lowest, 1e-6))), std::memory_order_relaxed);
+}
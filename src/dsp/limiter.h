@@ -0,0 +1,137 @@
+#pragma once
+/*
+ limiter.h
+
+ Purpose:
+   - Lookahead brickwall limiter with true-peak detection, the last
+     processor of the player's DSP stage (decode thread, after the EQ). It
+     applies the volume boost (input gain above 1) and keeps the result,
+     including the peaks between samples, under the ceiling, so a boosted or
+     EQ'd signal never reaches the output's hard clamp (sample_format.h).
+
+ How:
+   - Detection: every sample and three points between it and the next one
+     (4x oversampling, 12-tap windowed-sinc interpolators as in ITU-R
+     BS.1770) are checked per channel; the loudest channel sets the gain for
+     all (linked, no image shift). The detector is the hot loop and has
+     scalar, SSE2 and AVX2+FMA variants (selectKernel(), simdLevel()).
+   - Gain: the gain each sample needs is held for the lookahead window plus
+     the interpolator's span (sliding minimum) and averaged over the
+     lookahead, so the gain is already down for every sample a true peak is
+     made of when it leaves the delay line, with a smooth attack; it
+     recovers with an exponential release.
+   - setSamplePeak() (DspChain's governor, through LimiterNode) swaps the
+     detector for a plain sample-peak check, several times cheaper; peaks
+     between samples may then pass the ceiling (by ~3 dB for a tone at a
+     quarter of the sample rate, far less on music) and are left to the
+     output's clamp.
+   - The audio goes through a delay of latency() frames (lookahead plus the
+     interpolator's length, ~1.7 ms at 48 kHz), one line per channel; the
+     detector reads its history straight from the line.
+
+ Threads:
+   - setInputGain(), setCeiling(), setEnabled() may be called from any
+     thread (atomics); the input gain is smoothed per sample.
+   - prepare(), reset(), setSamplePeak() and process() belong to the
+     processing thread.
+
+ Notes:
+   - Disabled, the limiter still delays the audio (so toggling it does not
+     jump) but never reduces the gain; samples past full scale are then
+     clamped by the output again.
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "../audio/planar.h"
+#include "../utils/cpu_features.h"
+
+// Raise peak[i] to the largest magnitude of x[i + 5] and the three
+// interpolated points between x[i + 5] and x[i + 6], for i in [0, n).
+// `x` holds n + 11 samples; `taps` holds 3 x 12 interpolator taps.
+using TruePeakFn = void (*)(const float* x, float* peak, size_t n, const float* taps);
+
+class Limiter {
+public:
+    static constexpr int kMaxChannels = 8;
+    static constexpr size_t kMaxBlockFrames = 4096;   // process() splits larger calls
+    static constexpr int kTaps = 12;                  // per interpolation phase
+    static constexpr float kDefaultCeilingDb = -1.0f;
+
+    Limiter();
+
+    // ---- control side (any thread) ----
+    // Linear gain applied before limiting (volume boost; 1 = none).
+    void setInputGain(float gain);
+    // Ceiling in dBTP (-20..0).
+    void setCeiling(float dbTruePeak);
+    void setEnabled(bool enabled);
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // Largest gain reduction of the last processed block, in dB (<= 0).
+    float gainReductionDb() const { return reductionDb_.load(std::memory_order_relaxed); }
+
+    // ---- processing side ----
+    // Size the delay line and scratch buffers for a stream and pick the
+    // detector kernel; false for a channel count outside 1..kMaxChannels.
+    bool prepare(int sampleRate, int channels);
+
+    // Empty the delay line and release the gain (e.g. after a seek).
+    void reset();
+
+    // Detect sample peaks instead of true peaks (see above); reset by
+    // prepare().
+    void setSamplePeak(bool on);
+    bool samplePeak() const { return samplePeak_; }
+
+    // Limit a block of the prepared channel count in place (other blocks
+    // pass through). The output lags the input by latency() frames.
+    void process(const AudioBlock& block);
+
+    size_t latency() const { return delay_; }
+
+    // Detector variant in use ("scalar", "sse2", "avx2").
+    const char* variant() const { return variant_; }
+
+    // Detector kernel, widest variant at or below `level` (capped to the host).
+    static TruePeakFn selectKernel(SimdLevel level, const char** variant = nullptr);
+
+    // The 3 x kTaps interpolator taps (phases 1/4, 2/4, 3/4).
+    static const float* interpolatorTaps();
+
+private:
+    void processChunk(const AudioBlock& block);
+    void slidingMin(size_t frames);
+
+    // control
+    std::atomic<float> inputGain_;
+    std::atomic<float> ceiling_;   // linear
+    std::atomic<bool> enabled_;
+    std::atomic<float> reductionDb_;
+
+    // processing
+    int channels_;
+    size_t lookahead_;             // L: average window
+    size_t holdWindow_;            // H = L + kTaps - 1: hold window
+    size_t delay_;                 // L + kTaps - 2 frames
+    float gain_;                   // smoothed input gain
+    float gainStep_;               // per-frame smoothing coefficient
+    double release_;               // per-frame release coefficient
+    double envelope_;
+    double boxSum_;
+    size_t boxPos_;
+    TruePeakFn detect_;
+    const char* variant_;
+    bool samplePeak_;
+
+    std::vector<float> gains_;     // kMaxBlockFrames smoothed input gains
+    std::vector<float> peak_;      // kMaxBlockFrames
+    std::vector<float> required_;  // L - 1 history + kMaxBlockFrames required gains
+    std::vector<float> prefix_;    // sliding-minimum scratch
+    std::vector<float> suffix_;
+    std::vector<float> hold_;      // kMaxBlockFrames
+    std::vector<float> box_;       // L held gains (running average)
+    std::vector<float> delayed_;   // per channel: delay_ + kMaxBlockFrames samples
+};
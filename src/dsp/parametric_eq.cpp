@@ -0,0 +1,684 @@
+/*
+ parametric_eq.cpp
+
+ Band design, settings hand-off and the per-channel-count kernels. See
+ parametric_eq.h.
+
+ Kernel layout: one frame per step, channel c in lane c. Samples are
+ widened to double for the filters: in single precision the rounding noise
+ of a low shelf or peak (poles close to z = 1) reaches -85 dB, in double it
+ stays far below the 24-bit floor. Every band is a transposed direct form II
+ biquad
+     y  = b0 x + s1
+     s1 = b1 x - a1 y + s2
+     s2 = b2 x - a2 y
+ run on the whole frame vector, the output feeding the next band. Frames
+ are the outer loop so consecutive frames overlap in the pipeline (band k
+ of frame n+1 does not wait for band k+1 of frame n).
+   - scalar: per channel, same operation order as SSE2 (bit-identical).
+   - sse2: two channels per register.
+   - avx2: FMA, four channels per register.
+ The block is planar, so the SIMD kernels read four frames of each channel
+ at a time and transpose them into frame vectors in registers (unpack for
+ pairs, a 4x4 transpose for quads), and transpose back on the store.
+*/
+
+#include "parametric_eq.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define EQ_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+#include <immintrin.h>
+#define EQ_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace {
+
+constexpr int kMaxBands = ParametricEq::kMaxBands;
+constexpr int kLanes = 8;   // state values per band and register (s1 or s2)
+
+// -----------------------------
+// Scalar (reference, other targets)
+// -----------------------------
+template <int C>
+void eqScalar(const AudioBlock& block, size_t frames, const BiquadCoeffs* k, int bands, double* state) {
+    for (int c = 0; c < C; ++c) {
+        float* p = block.channel[c];
+        for (size_t f = 0; f < frames; ++f) {
+            double x = p[f];
+            for (int b = 0; b < bands; ++b) {
+                double& s1 = state[b * 2 * kLanes + c];
+                double& s2 = state[b * 2 * kLanes + kLanes + c];
+                const double y = k[b].b0 * x + s1;
+                s1 = (k[b].b1 * x - k[b].a1 * y) + s2;
+                s2 = k[b].b2 * x - k[b].a2 * y;
+                x = y;
+            }
+            p[f] = static_cast<float>(x);
+        }
+    }
+}
+
+#if defined(EQ_USE_SSE2)
+// -----------------------------
+// SSE2 (two channels per register)
+// -----------------------------
+struct Coeffs2 {
+    __m128d b0, b1, b2, a1, a2;
+};
+
+// Frames f..f+3 of channels a and b (N = 1: no b, zero lane) as four
+// [a b] pairs.
+template <int N>
+inline void loadPairs4(const float* a, const float* b, size_t f, __m128d out[4]) {
+    const __m128 x = _mm_loadu_ps(a + f);
+    const __m128 y = N == 2 ? _mm_loadu_ps(b + f) : _mm_setzero_ps();
+    const __m128 lo = _mm_unpacklo_ps(x, y);   // a0 b0 a1 b1
+    const __m128 hi = _mm_unpackhi_ps(x, y);   // a2 b2 a3 b3
+    out[0] = _mm_cvtps_pd(lo);
+    out[1] = _mm_cvtps_pd(_mm_movehl_ps(lo, lo));
+    out[2] = _mm_cvtps_pd(hi);
+    out[3] = _mm_cvtps_pd(_mm_movehl_ps(hi, hi));
+}
+
+template <int N>
+inline void storePairs4(float* a, float* b, size_t f, const __m128d in[4]) {
+    const __m128 lo = _mm_movelh_ps(_mm_cvtpd_ps(in[0]), _mm_cvtpd_ps(in[1]));
+    const __m128 hi = _mm_movelh_ps(_mm_cvtpd_ps(in[2]), _mm_cvtpd_ps(in[3]));
+    _mm_storeu_ps(a + f, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+    if (N == 2) _mm_storeu_ps(b + f, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+template <int C>
+void eqSse2(const AudioBlock& block, size_t frames, const BiquadCoeffs* k, int bands, double* state) {
+    constexpr int V = (C + 1) / 2;
+    constexpr int tail = C - (V - 1) * 2;
+    Coeffs2 coef[kMaxBands];
+    __m128d s1[kMaxBands][V], s2[kMaxBands][V];
+    for (int b = 0; b < bands; ++b) {
+        coef[b] = { _mm_set1_pd(k[b].b0), _mm_set1_pd(k[b].b1), _mm_set1_pd(k[b].b2),
+                    _mm_set1_pd(k[b].a1), _mm_set1_pd(k[b].a2) };
+        for (int v = 0; v < V; ++v) {
+            s1[b][v] = _mm_load_pd(state + b * 2 * kLanes + v * 2);
+            s2[b][v] = _mm_load_pd(state + b * 2 * kLanes + kLanes + v * 2);
+        }
+    }
+    float* a[V];
+    float* bp[V];
+    for (int v = 0; v < V; ++v) {
+        a[v] = block.channel[v * 2];
+        bp[v] = v * 2 + 1 < C ? block.channel[v * 2 + 1] : nullptr;
+    }
+
+    auto run = [&](__m128d* x) {
+        for (int b = 0; b < bands; ++b) {
+            const Coeffs2& c = coef[b];
+            for (int v = 0; v < V; ++v) {
+                const __m128d y = _mm_add_pd(_mm_mul_pd(c.b0, x[v]), s1[b][v]);
+                s1[b][v] = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(c.b1, x[v]), _mm_mul_pd(c.a1, y)), s2[b][v]);
+                s2[b][v] = _mm_sub_pd(_mm_mul_pd(c.b2, x[v]), _mm_mul_pd(c.a2, y));
+                x[v] = y;
+            }
+        }
+    };
+
+    // Four frames per step, transposed in registers; the filter still runs
+    // one frame after the other.
+    size_t f = 0;
+    for (; f + 4 <= frames; f += 4) {
+        __m128d x[4][V];
+        __m128d lanes[4];
+        for (int v = 0; v < V; ++v) {
+            if (v < V - 1) {
+                loadPairs4<2>(a[v], bp[v], f, lanes);
+            } else {
+                loadPairs4<tail>(a[v], bp[v], f, lanes);
+            }
+            for (int i = 0; i < 4; ++i) x[i][v] = lanes[i];
+        }
+        for (int i = 0; i < 4; ++i) run(x[i]);
+        for (int v = 0; v < V; ++v) {
+            for (int i = 0; i < 4; ++i) lanes[i] = x[i][v];
+            if (v < V - 1) {
+                storePairs4<2>(a[v], bp[v], f, lanes);
+            } else {
+                storePairs4<tail>(a[v], bp[v], f, lanes);
+            }
+        }
+    }
+    for (; f < frames; ++f) {
+        __m128d x[V];
+        for (int v = 0; v < V; ++v) x[v] = _mm_cvtps_pd(_mm_setr_ps(a[v][f], bp[v] ? bp[v][f] : 0.0f, 0.0f, 0.0f));
+        run(x);
+        for (int v = 0; v < V; ++v) {
+            const __m128 y = _mm_cvtpd_ps(x[v]);
+            _mm_store_ss(a[v] + f, y);
+            if (bp[v]) _mm_store_ss(bp[v] + f, _mm_shuffle_ps(y, y, _MM_SHUFFLE(1, 1, 1, 1)));
+        }
+    }
+
+    for (int b = 0; b < bands; ++b) {
+        for (int v = 0; v < V; ++v) {
+            _mm_store_pd(state + b * 2 * kLanes + v * 2, s1[b][v]);
+            _mm_store_pd(state + b * 2 * kLanes + kLanes + v * 2, s2[b][v]);
+        }
+    }
+}
+#endif // EQ_USE_SSE2
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+// -----------------------------
+// AVX2 + FMA (four channels per register)
+// -----------------------------
+struct Coeffs4 {
+    __m256d b0, b1, b2, a1, a2;
+};
+
+// Frames f..f+3 of N (1..4) channels (zero lanes for the missing ones) as
+// four frame vectors.
+template <int N>
+EQ_TARGET_AVX2 inline void loadQuads4(float* const* ch, size_t f, __m256d out[4]) {
+    __m128 r0 = _mm_loadu_ps(ch[0] + f);
+    __m128 r1 = N > 1 ? _mm_loadu_ps(ch[1] + f) : _mm_setzero_ps();
+    __m128 r2 = N > 2 ? _mm_loadu_ps(ch[2] + f) : _mm_setzero_ps();
+    __m128 r3 = N > 3 ? _mm_loadu_ps(ch[3] + f) : _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    out[0] = _mm256_cvtps_pd(r0);
+    out[1] = _mm256_cvtps_pd(r1);
+    out[2] = _mm256_cvtps_pd(r2);
+    out[3] = _mm256_cvtps_pd(r3);
+}
+
+template <int N>
+EQ_TARGET_AVX2 inline void storeQuads4(float* const* ch, size_t f, const __m256d in[4]) {
+    __m128 r0 = _mm256_cvtpd_ps(in[0]);
+    __m128 r1 = _mm256_cvtpd_ps(in[1]);
+    __m128 r2 = _mm256_cvtpd_ps(in[2]);
+    __m128 r3 = _mm256_cvtpd_ps(in[3]);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(ch[0] + f, r0);
+    if (N > 1) _mm_storeu_ps(ch[1] + f, r1);
+    if (N > 2) _mm_storeu_ps(ch[2] + f, r2);
+    if (N > 3) _mm_storeu_ps(ch[3] + f, r3);
+}
+
+template <int C>
+EQ_TARGET_AVX2 void eqAvx2(const AudioBlock& block, size_t frames, const BiquadCoeffs* k, int bands, double* state) {
+    constexpr int V = (C + 3) / 4;
+    constexpr int tail = C - (V - 1) * 4;
+    Coeffs4 coef[kMaxBands];
+    __m256d s1[kMaxBands][V], s2[kMaxBands][V];
+    for (int b = 0; b < bands; ++b) {
+        coef[b] = { _mm256_set1_pd(k[b].b0), _mm256_set1_pd(k[b].b1), _mm256_set1_pd(k[b].b2),
+                    _mm256_set1_pd(k[b].a1), _mm256_set1_pd(k[b].a2) };
+        for (int v = 0; v < V; ++v) {
+            s1[b][v] = _mm256_load_pd(state + b * 2 * kLanes + v * 4);
+            s2[b][v] = _mm256_load_pd(state + b * 2 * kLanes + kLanes + v * 4);
+        }
+    }
+    float* ch[V][4];
+    for (int v = 0; v < V; ++v) {
+        for (int i = 0; i < 4; ++i) ch[v][i] = v * 4 + i < C ? block.channel[v * 4 + i] : nullptr;
+    }
+
+    auto run = [&](__m256d* x) EQ_TARGET_AVX2 {
+        for (int b = 0; b < bands; ++b) {
+            const Coeffs4& c = coef[b];
+            for (int v = 0; v < V; ++v) {
+                const __m256d y = _mm256_fmadd_pd(c.b0, x[v], s1[b][v]);
+                s1[b][v] = _mm256_fmadd_pd(c.b1, x[v], _mm256_fnmadd_pd(c.a1, y, s2[b][v]));
+                s2[b][v] = _mm256_fnmadd_pd(c.a2, y, _mm256_mul_pd(c.b2, x[v]));
+                x[v] = y;
+            }
+        }
+    };
+
+    size_t f = 0;
+    for (; f + 4 <= frames; f += 4) {
+        __m256d x[4][V];
+        __m256d lanes[4];
+        for (int v = 0; v < V; ++v) {
+            if (v < V - 1) {
+                loadQuads4<4>(ch[v], f, lanes);
+            } else {
+                loadQuads4<tail>(ch[v], f, lanes);
+            }
+            for (int i = 0; i < 4; ++i) x[i][v] = lanes[i];
+        }
+        for (int i = 0; i < 4; ++i) run(x[i]);
+        for (int v = 0; v < V; ++v) {
+            for (int i = 0; i < 4; ++i) lanes[i] = x[i][v];
+            if (v < V - 1) {
+                storeQuads4<4>(ch[v], f, lanes);
+            } else {
+                storeQuads4<tail>(ch[v], f, lanes);
+            }
+        }
+    }
+    for (; f < frames; ++f) {
+        __m256d x[V];
+        for (int v = 0; v < V; ++v) {
+            float in[4];
+            for (int i = 0; i < 4; ++i) in[i] = ch[v][i] ? ch[v][i][f] : 0.0f;
+            x[v] = _mm256_cvtps_pd(_mm_loadu_ps(in));
+        }
+        run(x);
+        for (int v = 0; v < V; ++v) {
+            float out[4];
+            _mm_storeu_ps(out, _mm256_cvtpd_ps(x[v]));
+            for (int i = 0; i < 4; ++i) {
+                if (ch[v][i]) ch[v][i][f] = out[i];
+            }
+        }
+    }
+
+    for (int b = 0; b < bands; ++b) {
+        for (int v = 0; v < V; ++v) {
+            _mm256_store_pd(state + b * 2 * kLanes + v * 4, s1[b][v]);
+            _mm256_store_pd(state + b * 2 * kLanes + kLanes + v * 4, s2[b][v]);
+        }
+    }
+}
+#endif // MUSIC_PLAYER_X86_DISPATCH
+
+// -----------------------------
+// Kernel table: [channels - 1]
+// -----------------------------
+struct KernelTable {
+    EqKernelFn scalar[ParametricEq::kMaxChannels] = {};
+    EqKernelFn sse2[ParametricEq::kMaxChannels] = {};
+    EqKernelFn avx2[ParametricEq::kMaxChannels] = {};
+};
+
+template <int C>
+void addKernels(KernelTable& t) {
+    t.scalar[C - 1] = &eqScalar<C>;
+#if defined(EQ_USE_SSE2)
+    t.sse2[C - 1] = &eqSse2<C>;
+#endif
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+    t.avx2[C - 1] = &eqAvx2<C>;
+#endif
+    if constexpr (C < ParametricEq::kMaxChannels) addKernels<C + 1>(t);
+}
+
+const KernelTable& kernelTable() {
+    static const KernelTable table = [] {
+        KernelTable t;
+        addKernels<1>(t);
+        return t;
+    }();
+    return table;
+}
+
+bool isFlat(const BiquadCoeffs& k) {
+    return k.b0 == 1.0 && k.b1 == 0.0 && k.b2 == 0.0 && k.a1 == 0.0 && k.a2 == 0.0;
+}
+
+struct TypeName {
+    EqBandType type;
+    const char* name;
+};
+
+const TypeName kTypeNames[] = {
+    { EqBandType::Peak, "peak" },
+    { EqBandType::LowShelf, "lowshelf" },
+    { EqBandType::HighShelf, "highshelf" },
+    { EqBandType::LowPass, "lowpass" },
+    { EqBandType::HighPass, "highpass" },
+};
+
+} // namespace
+
+// -----------------------------
+// Band design (RBJ Audio EQ Cookbook)
+// -----------------------------
+BiquadCoeffs ParametricEq::design(const EqBand& band, int sampleRate) {
+    BiquadCoeffs k;
+    if (!band.enabled || sampleRate <= 0) return k;
+    const bool gainBand = band.type == EqBandType::Peak || band.type == EqBandType::LowShelf ||
+                          band.type == EqBandType::HighShelf;
+    const double gainDb = std::clamp(static_cast<double>(band.gainDb), -24.0, 24.0);
+    if (gainBand && std::fabs(gainDb) < 0.01) return k;
+
+    const double pi = 3.14159265358979323846;
+    const double freq = std::clamp(static_cast<double>(band.frequency), 10.0, 0.49 * sampleRate);
+    const double q = std::clamp(static_cast<double>(band.q), 0.1, 20.0);
+    const double w0 = 2.0 * pi * freq / sampleRate;
+    const double cosw = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * q);
+    const double a = std::pow(10.0, gainDb / 40.0);
+    const double shelf = 2.0 * std::sqrt(a) * alpha;
+
+    double b0 = 1, b1 = 0, b2 = 0, a0 = 1, a1 = 0, a2 = 0;
+    switch (band.type) {
+    case EqBandType::Peak:
+        b0 = 1 + alpha * a;
+        b1 = -2 * cosw;
+        b2 = 1 - alpha * a;
+        a0 = 1 + alpha / a;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha / a;
+        break;
+    case EqBandType::LowShelf:
+        b0 = a * ((a + 1) - (a - 1) * cosw + shelf);
+        b1 = 2 * a * ((a - 1) - (a + 1) * cosw);
+        b2 = a * ((a + 1) - (a - 1) * cosw - shelf);
+        a0 = (a + 1) + (a - 1) * cosw + shelf;
+        a1 = -2 * ((a - 1) + (a + 1) * cosw);
+        a2 = (a + 1) + (a - 1) * cosw - shelf;
+        break;
+    case EqBandType::HighShelf:
+        b0 = a * ((a + 1) + (a - 1) * cosw + shelf);
+        b1 = -2 * a * ((a - 1) + (a + 1) * cosw);
+        b2 = a * ((a + 1) + (a - 1) * cosw - shelf);
+        a0 = (a + 1) - (a - 1) * cosw + shelf;
+        a1 = 2 * ((a - 1) - (a + 1) * cosw);
+        a2 = (a + 1) - (a - 1) * cosw - shelf;
+        break;
+    case EqBandType::LowPass:
+        b0 = (1 - cosw) / 2;
+        b1 = 1 - cosw;
+        b2 = (1 - cosw) / 2;
+        a0 = 1 + alpha;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha;
+        break;
+    case EqBandType::HighPass:
+        b0 = (1 + cosw) / 2;
+        b1 = -(1 + cosw);
+        b2 = (1 + cosw) / 2;
+        a0 = 1 + alpha;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha;
+        break;
+    }
+    k.b0 = b0 / a0;
+    k.b1 = b1 / a0;
+    k.b2 = b2 / a0;
+    k.a1 = a1 / a0;
+    k.a2 = a2 / a0;
+    return k;
+}
+
+EqKernelFn ParametricEq::selectKernel(int channels, SimdLevel level, const char** variant) {
+    if (channels < 1 || channels > kMaxChannels) return nullptr;
+    if (level > detectedSimdLevel()) level = detectedSimdLevel();
+    const KernelTable& t = kernelTable();
+    const int c = channels - 1;
+    const char* name = "scalar";
+    EqKernelFn fn = t.scalar[c];
+    if (level >= SimdLevel::AVX2 && t.avx2[c]) {
+        fn = t.avx2[c];
+        name = "avx2";
+    } else if (level >= SimdLevel::SSE2 && t.sse2[c]) {
+        fn = t.sse2[c];
+        name = "sse2";
+    }
+    if (variant) *variant = name;
+    return fn;
+}
+
+// -----------------------------
+// ParametricEq: control side
+// -----------------------------
+ParametricEq::ParametricEq()
+    : preampDb_(0.0f),
+      enabled_(true),
+      sampleRate_(0),
+      channels_(0),
+      kernel_(nullptr),
+      groupKernels_(),
+      variant_("scalar"),
+      ramping_(false),
+      rampAlpha_(1.0),
+      activeBands_(0),
+      stepCount_(0)
+{
+    std::memset(state_, 0, sizeof(state_));
+}
+
+void ParametricEq::setBands(const std::vector<EqBand>& bands) {
+    bands_.assign(bands.begin(), bands.begin() + std::min<size_t>(bands.size(), kMaxBands));
+    publish();
+}
+
+void ParametricEq::setBand(int index, const EqBand& band) {
+    if (index < 0 || index >= kMaxBands) return;
+    if (static_cast<size_t>(index) >= bands_.size()) {
+        bands_.resize(index + 1);
+    }
+    bands_[index] = band;
+    publish();
+}
+
+void ParametricEq::setPreamp(float gainDb) {
+    preampDb_ = gainDb;
+    publish();
+}
+
+void ParametricEq::setEnabled(bool enabled) {
+    enabled_ = enabled;
+    publish();
+}
+
+void ParametricEq::publish() {
+    Settings s;
+    s.bandCount = static_cast<int>(bands_.size());
+    std::copy(bands_.begin(), bands_.end(), s.bands);
+    s.preampDb = preampDb_;
+    s.enabled = enabled_;
+    settings_.publish(s);
+}
+
+// -----------------------------
+// ParametricEq: processing side
+// -----------------------------
+bool ParametricEq::prepare(int sampleRate, int channels) {
+    const char* variant = nullptr;
+    EqKernelFn kernel = selectKernel(channels, simdLevel(), &variant);
+    if (!kernel || sampleRate <= 0) return false;
+    sampleRate_ = sampleRate;
+    channels_ = channels;
+    kernel_ = kernel;
+    variant_ = variant;
+    for (int c = 1; c <= channels; ++c) groupKernels_[c] = selectKernel(c, simdLevel());
+    // ~10 ms time constant, one step per kRampFrames frames
+    rampAlpha_ = 1.0 - std::exp(-static_cast<double>(kRampFrames) / (0.010 * sampleRate));
+
+    settings_.read();
+    applySettings(settings_.current());
+    std::copy(target_, target_ + kMaxBands, current_);
+    ramping_ = false;
+    updateActiveBands(true);
+    stepCount_ = 0;
+    reset();
+    return true;
+}
+
+void ParametricEq::reset() {
+    std::memset(state_, 0, sizeof(state_));
+}
+
+void ParametricEq::applySettings(const Settings& s) {
+    for (int b = 0; b < kMaxBands; ++b) {
+        target_[b] = s.enabled && b < s.bandCount ? design(s.bands[b], sampleRate_) : BiquadCoeffs();
+    }
+    if (s.enabled && s.preampDb != 0.0f) {
+        const double gain = std::pow(10.0, std::clamp(static_cast<double>(s.preampDb), -24.0, 24.0) / 20.0);
+        target_[0].b0 *= gain;
+        target_[0].b1 *= gain;
+        target_[0].b2 *= gain;
+    }
+    ramping_ = true;
+    updateActiveBands(true);
+}
+
+void ParametricEq::stepRamp() {
+    double maxDelta = 0.0;
+    for (int b = 0; b < activeBands_; ++b) {
+        double* cur = &current_[b].b0;
+        const double* tgt = &target_[b].b0;
+        for (int i = 0; i < 5; ++i) {
+            const double delta = tgt[i] - cur[i];
+            cur[i] += delta * rampAlpha_;
+            maxDelta = std::max(maxDelta, std::fabs(delta));
+        }
+    }
+    if (maxDelta < 1e-6) {
+        std::copy(target_, target_ + kMaxBands, current_);
+        ramping_ = false;
+        updateActiveBands(false);   // the block's step clears the state
+    }
+}
+
+void ParametricEq::updateActiveBands(bool clearDropped) {
+    int active = 0;
+    for (int b = 0; b < kMaxBands; ++b) {
+        if (!isFlat(current_[b]) || !isFlat(target_[b])) active = b + 1;
+    }
+    // Bands dropping out of the cascade start from silence when they return.
+    for (int b = active; clearDropped && b < activeBands_; ++b) {
+        std::memset(state_[b], 0, sizeof(state_[b]));
+    }
+    activeBands_ = active;
+}
+
+void ParametricEq::process(const AudioBlock& block) {
+    if (block.channels != channels_) {
+        beginBlock(0);   // settings only
+        return;
+    }
+    for (size_t done = 0; done < block.frames; done += kMaxBlockFrames) {
+        const size_t n = std::min(block.frames - done, kMaxBlockFrames);
+        beginBlock(n);
+        processChannels(block.slice(done, n), 0);
+    }
+}
+
+void ParametricEq::beginBlock(size_t frames) {
+    if (settings_.read()) applySettings(settings_.current());
+    stepCount_ = 0;
+    if (activeBands_ == 0 || !kernel_) return;
+
+    frames = std::min(frames, kMaxBlockFrames);
+    size_t done = 0;
+    while (ramping_ && done < frames) {
+        Step& step = steps_[stepCount_];
+        step.frames = std::min(kRampFrames, frames - done);
+        step.dropped = activeBands_;
+        stepRamp();
+        step.bands = activeBands_;
+        std::copy(current_, current_ + activeBands_, stepCoeffs_[stepCount_]);
+        step.coeffs = stepCoeffs_[stepCount_];
+        done += step.frames;
+        ++stepCount_;
+    }
+    if (done < frames && activeBands_ > 0) {
+        Step& step = steps_[stepCount_++];
+        step.frames = frames - done;
+        step.bands = activeBands_;
+        step.dropped = activeBands_;
+        step.coeffs = current_;
+    }
+}
+
+void ParametricEq::processChannels(const AudioBlock& part, int first) {
+    if (stepCount_ == 0 || first < 0 || part.channels < 1 || first + part.channels > channels_) return;
+    const EqKernelFn kernel = groupKernels_[part.channels];
+    const int channels = part.channels;
+
+    // A group's lanes are gathered into lanes 0.. of a local state: the
+    // SIMD kernels load and store whole registers, which would reach into
+    // the neighbouring group's lanes.
+    const bool whole = first == 0 && channels == channels_;
+    alignas(32) double local[kMaxBands][2][8];
+    double (*state)[2][8] = whole ? state_ : local;
+    const int bands = std::max(steps_[0].bands, steps_[0].dropped);
+    if (!whole) {
+        for (int b = 0; b < bands; ++b) {
+            for (int s = 0; s < 2; ++s) {
+                std::fill(local[b][s], local[b][s] + 8, 0.0);
+                std::copy(state_[b][s] + first, state_[b][s] + first + channels, local[b][s]);
+            }
+        }
+    }
+
+    ScopedDenormalFlush flush;
+    size_t done = 0;
+    for (int i = 0; i < stepCount_ && done < part.frames; ++i) {
+        const Step& step = steps_[i];
+        const size_t n = std::min(step.frames, part.frames - done);
+        for (int b = step.bands; b < step.dropped; ++b) {
+            for (int s = 0; s < 2; ++s) std::fill(state[b][s], state[b][s] + 8, 0.0);
+        }
+        if (step.bands > 0) kernel(part.slice(done, n), n, step.coeffs, step.bands, &state[0][0][0]);
+        done += n;
+    }
+
+    if (!whole) {
+        for (int b = 0; b < bands; ++b) {
+            for (int s = 0; s < 2; ++s) std::copy(local[b][s], local[b][s] + channels, state_[b][s] + first);
+        }
+    }
+}
+
+// -----------------------------
+// Parsing
+// -----------------------------
+const char* eqBandTypeName(EqBandType type) {
+    for (const TypeName& t : kTypeNames) {
+        if (t.type == type) return t.name;
+    }
+    return "peak";
+}
+
+bool parseEqBands(const std::string& text, std::vector<EqBand>& bands) {
+    std::vector<EqBand> parsed;
+    size_t pos = 0;
+    while (pos <= text.size()) {
+        size_t end = text.find(',', pos);
+        if (end == std::string::npos) end = text.size();
+        const std::string item = text.substr(pos, end - pos);
+        const size_t colon = item.find(':');
+        if (colon == std::string::npos) return false;
+
+        EqBand band;
+        const std::string type = item.substr(0, colon);
+        bool known = false;
+        for (const TypeName& t : kTypeNames) {
+            if (type == t.name) {
+                band.type = t.type;
+                known = true;
+            }
+        }
+        if (!known) return false;
+
+        // freq[:gain[:q]]
+        float* fields[] = { &band.frequency, &band.gainDb, &band.q };
+        const char* p = item.c_str() + colon + 1;
+        for (int i = 0; i < 3 && *p; ++i) {
+            char* next = nullptr;
+            float v = std::strtof(p, &next);
+            if (next == p) return false;
+            *fields[i] = v;
+            p = next;
+            if (*p == ':') ++p;
+            else if (*p) return false;
+        }
+        if (*p || band.frequency <= 0.0f || band.q <= 0.0f) return false;
+        parsed.push_back(band);
+        if (parsed.size() > static_cast<size_t>(ParametricEq::kMaxBands)) return false;
+        pos = end + 1;
+    }
+    bands = std::move(parsed);
+    return true;
+}
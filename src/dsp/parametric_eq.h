@@ -0,0 +1,168 @@
+#pragma once
+/*
+ parametric_eq.h
+
+ Purpose:
+   - Multi-band parametric equalizer for the player's DSP stage (decode
+     thread, after channel mixing and before AudioOutput::write()).
+   - Each band is a biquad (RBJ cookbook peak, shelf or pass filter); the
+     bands run in cascade on planar float blocks (planar.h), in double precision
+     with one SIMD lane per channel (a stereo frame is one SSE2 register,
+     four channels one AVX2 register). The kernel is specialized per
+     channel count and picked through simdLevel() (cpu_features.h) in
+     prepare().
+
+ Threads:
+   - Control side (one thread, e.g. the UI): setBand(), setBands(),
+     setPreamp(), setEnabled(). Each call publishes a new settings snapshot
+     through a TripleBuffer; nothing blocks and nothing allocates.
+   - Processing side (the decode thread): prepare() and process(). process()
+     picks up the newest snapshot, recomputes the target coefficients and
+     moves the running ones towards them in steps of kRampFrames frames
+     (about 10 ms time constant), so slider drags do not click or zipper.
+   - process() is beginBlock() (settings and ramp steps for the block, on
+     the processing thread) followed by processChannels() over all
+     channels; DspChain's workers call processChannels() for disjoint
+     channel groups of the same block concurrently.
+
+ Notes:
+   - A flat EQ (disabled, no bands or every band at 0 dB peak/shelf) costs
+     nothing once the coefficients have settled: process() returns early.
+   - The preamp is folded into the first biquad's numerator.
+*/
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "../audio/planar.h"
+#include "../utils/cpu_features.h"
+#include "../utils/triple_buffer.h"
+
+enum class EqBandType {
+    Peak,
+    LowShelf,
+    HighShelf,
+    LowPass,
+    HighPass
+};
+
+struct EqBand {
+    EqBandType type = EqBandType::Peak;
+    float frequency = 1000.0f;   // Hz (centre, corner or shelf midpoint)
+    float gainDb = 0.0f;         // peak and shelf bands only
+    float q = 0.707f;            // bandwidth / resonance (shelves: slope, 0.707 = maximally steep without overshoot)
+    bool enabled = true;
+};
+
+// Normalized biquad, a0 = 1:
+// y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+struct BiquadCoeffs {
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+};
+
+// Run `bands` biquads in cascade over `frames` frames of a planar block in
+// place (double precision inside). `state` holds 2 x 8 doubles (s1 lanes,
+// s2 lanes) per band, 32-byte aligned.
+using EqKernelFn = void (*)(const AudioBlock& block, size_t frames, const BiquadCoeffs* coeffs, int bands, double* state);
+
+class ParametricEq {
+public:
+    static constexpr int kMaxBands = 16;
+    static constexpr int kMaxChannels = 8;
+    static constexpr size_t kRampFrames = 32;
+    static constexpr size_t kMaxBlockFrames = 1024;   // per beginBlock()
+
+    ParametricEq();
+
+    // ---- control side ----
+    // Replace all bands (at most kMaxBands; extra ones are ignored).
+    void setBands(const std::vector<EqBand>& bands);
+    // Set band `index` (0..kMaxBands-1), adding flat bands up to it if needed.
+    void setBand(int index, const EqBand& band);
+    void setPreamp(float gainDb);
+    void setEnabled(bool enabled);
+    const std::vector<EqBand>& bands() const { return bands_; }
+    float preamp() const { return preampDb_; }
+    bool enabled() const { return enabled_; }
+
+    // ---- processing side ----
+    // Reset the filter state for a stream and pick the kernel; false for a
+    // channel count outside 1..kMaxChannels or a bad sample rate.
+    bool prepare(int sampleRate, int channels);
+
+    // Clear the filter memory (e.g. after a seek); the settings stay.
+    void reset();
+
+    // Filter a block of the prepared channel count in place (other blocks
+    // pass through).
+    void process(const AudioBlock& block);
+
+    // Channel split: take the settings and ramp steps for the next `frames`
+    // (at most kMaxBlockFrames) frames, then filter channels
+    // [first, first + part.channels) of that block; processChannels() calls
+    // for disjoint channels may run concurrently.
+    void beginBlock(size_t frames);
+    void processChannels(const AudioBlock& part, int first);
+
+    // Kernel variant in use ("scalar", "sse2", "avx2").
+    const char* variant() const { return variant_; }
+
+    // Kernel for `channels` lanes, widest variant at or below `level`
+    // (capped to the host); nullptr for counts outside 1..kMaxChannels.
+    static EqKernelFn selectKernel(int channels, SimdLevel level, const char** variant = nullptr);
+
+    // Coefficients of one band at `sampleRate` (flat for a disabled band).
+    static BiquadCoeffs design(const EqBand& band, int sampleRate);
+
+private:
+    struct Settings {
+        EqBand bands[kMaxBands];
+        int bandCount = 0;
+        float preampDb = 0.0f;
+        bool enabled = true;
+    };
+
+    // Frames of a block filtered with one set of coefficients
+    struct Step {
+        size_t frames = 0;
+        int bands = 0;                  // bands in the cascade
+        int dropped = 0;                // bands [bands, dropped) left it at this step
+        const BiquadCoeffs* coeffs = nullptr;
+    };
+    static constexpr int kMaxSteps = static_cast<int>(kMaxBlockFrames / kRampFrames) + 1;
+
+    void publish();
+    void applySettings(const Settings& settings);
+    void stepRamp();
+    void updateActiveBands(bool clearDropped);
+
+    // control side
+    std::vector<EqBand> bands_;
+    float preampDb_;
+    bool enabled_;
+    TripleBuffer<Settings> settings_;
+
+    // processing side
+    int sampleRate_;
+    int channels_;
+    EqKernelFn kernel_;
+    EqKernelFn groupKernels_[kMaxChannels + 1];   // per channel count of a group
+    const char* variant_;
+    bool ramping_;
+    double rampAlpha_;
+    int activeBands_;                   // bands [0, activeBands_) are processed
+    BiquadCoeffs current_[kMaxBands];
+    BiquadCoeffs target_[kMaxBands];
+    alignas(32) double state_[kMaxBands][2][8];
+    Step steps_[kMaxSteps];             // beginBlock() -> processChannels()
+    int stepCount_;
+    BiquadCoeffs stepCoeffs_[kMaxSteps][kMaxBands];
+};
+
+// Parse "type:freq[:gain[:q]]" bands separated by ',' (type = peak,
+// lowshelf, highshelf, lowpass or highpass; gain in dB), e.g.
+// "lowshelf:100:4,peak:3000:-2:1.4,highpass:30". False on a syntax error.
+bool parseEqBands(const std::string& text, std::vector<EqBand>& bands);
+
+const char* eqBandTypeName(EqBandType type);
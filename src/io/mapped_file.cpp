@@ -0,0 +1,135 @@
+/*
+ mapped_file.cpp
+
+ mmap-backed read cursor. See mapped_file.h.
+*/
+
+#include "mapped_file.h"
+#include "../utils/logger.h"
+
+#include <algorithm>
+#include <cstdio>     // SEEK_SET / SEEK_CUR / SEEK_END
+#include <cstring>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile()
+    : data_(nullptr),
+      size_(0),
+      pos_(0),
+      advisedUntil_(0)
+{}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);   // the mapping keeps its own reference
+    if (p == MAP_FAILED) {
+        Logger::instance().log(LogLevel::WARNING, "MappedFile: mmap failed for " + path + ": " + std::strerror(errno));
+        return false;
+    }
+
+    data_ = static_cast<const uint8_t*>(p);
+    size_ = static_cast<size_t>(st.st_size);
+    pos_ = 0;
+    advisedUntil_ = 0;
+    ::madvise(p, size_, MADV_SEQUENTIAL);
+    adviseAhead();
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+void MappedFile::close() {
+#ifndef _WIN32
+    if (data_) {
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+    }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    pos_ = 0;
+    advisedUntil_ = 0;
+}
+
+// Keep at least half a window of WILLNEED ahead of the cursor. Offsets are
+// rounded down to a page boundary as madvise() requires.
+void MappedFile::adviseAhead() {
+#ifndef _WIN32
+    if (!data_ || advisedUntil_ >= size_ || pos_ + kReadaheadBytes / 2 < advisedUntil_) {
+        return;
+    }
+    static const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t start = std::max(pos_, advisedUntil_) & ~(page - 1);
+    size_t end = std::min(size_, pos_ + kReadaheadBytes);
+    if (end > start) {
+        ::madvise(const_cast<uint8_t*>(data_) + start, end - start, MADV_WILLNEED);
+    }
+    advisedUntil_ = end;
+#endif
+}
+
+size_t MappedFile::read(void* dst, size_t n) {
+    if (!data_ || pos_ >= size_) {
+        return 0;
+    }
+    n = std::min(n, size_ - pos_);
+    std::memcpy(dst, data_ + pos_, n);
+    pos_ += n;
+    adviseAhead();
+    return n;
+}
+
+const uint8_t* MappedFile::consume(size_t& n) {
+    if (!data_ || pos_ >= size_) {
+        n = 0;
+        return nullptr;
+    }
+    n = std::min(n, size_ - pos_);
+    const uint8_t* p = data_ + pos_;
+    pos_ += n;
+    adviseAhead();
+    return p;
+}
+
+int64_t MappedFile::seek(int64_t offset, int whence) {
+    int64_t base;
+    switch (whence) {
+        case SEEK_SET: base = 0; break;
+        case SEEK_CUR: base = static_cast<int64_t>(pos_); break;
+        case SEEK_END: base = static_cast<int64_t>(size_); break;
+        default: return -1;
+    }
+    int64_t target = base + offset;
+    if (target < 0 || target > static_cast<int64_t>(size_)) {
+        return -1;
+    }
+    pos_ = static_cast<size_t>(target);
+    // A jump invalidates the window we advised; start a new one here.
+    advisedUntil_ = pos_;
+    adviseAhead();
+    return target;
+}
@@ -0,0 +1,59 @@
+#pragma once
+/*
+ mapped_file.h
+
+ Purpose:
+   - Read-only memory mapping of a local file with a read cursor, used as the
+     backing store of FFmpegDecoder's custom AVIOContext and read directly
+     by PcmDecoder.
+   - Serving demuxer reads from the mapping replaces one read() syscall (and
+     one kernel->user copy into avio's internal buffer) per avio buffer fill.
+
+ Notes:
+   - The whole file is mapped MADV_SEQUENTIAL; a MADV_WILLNEED window is kept
+     ahead of the cursor so page faults are mostly resolved by readahead.
+   - Only meaningful for local filesystems. Paths on slow mounts should be
+     staged first (see StagingCache) instead of mapped over the network.
+*/
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map `path`. Returns false (and stays closed) on failure or empty files.
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return data_ != nullptr; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // Cursor API (mirrors read()/lseek()).
+    // read() copies up to `n` bytes and returns the count (0 at end of file).
+    size_t read(void* dst, size_t n);
+    // whence: SEEK_SET / SEEK_CUR / SEEK_END. Returns new position or -1.
+    int64_t seek(int64_t offset, int whence);
+    // Zero-copy read: returns a pointer to the next `n` bytes and advances
+    // the cursor; `n` is clamped to the bytes left.
+    const uint8_t* consume(size_t& n);
+    size_t tell() const { return pos_; }
+
+    // Size of the WILLNEED window kept ahead of the cursor.
+    static constexpr size_t kReadaheadBytes = 2 * 1024 * 1024;
+
+private:
+    void adviseAhead();
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_;
+    size_t advisedUntil_;   // end of the last WILLNEED window
+};
@@ -0,0 +1,343 @@
+/*
+ pcm_block_cache.cpp
+
+ Block store and caching decoder wrapper. See pcm_block_cache.h.
+*/
+
+#include "pcm_block_cache.h"
+#include "../decoder/audio_decoder.h"
+#include "../decoder/pcm_block_codec.h"
+#include "../decoder/pcm_convert.h"
+#include "../utils/logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <sys/stat.h>
+
+// Memory charged per block on top of its data (list node, index entry).
+static constexpr uint64_t kBlockOverhead = 96;
+
+static uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 1469598103934665603ULL) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Track identity: path, size and mtime of the file plus the output format.
+static uint64_t trackKey(const std::string& path, const AudioDecoder& decoder) {
+    uint64_t h = fnv1a(path.data(), path.size());
+    struct stat st;
+    if (::stat(path.c_str(), &st) == 0) {
+        int64_t fields[3] = {static_cast<int64_t>(st.st_size), static_cast<int64_t>(st.st_mtim.tv_sec),
+                             static_cast<int64_t>(st.st_mtim.tv_nsec)};
+        h = fnv1a(fields, sizeof(fields), h);
+    }
+    int format[2] = {decoder.getSampleRate(), decoder.getChannels()};
+    return fnv1a(format, sizeof(format), h);
+}
+
+// -----------------------------
+// CachingDecoder
+// -----------------------------
+class PcmBlockCache::CachingDecoder : public AudioDecoder {
+public:
+    CachingDecoder(PcmBlockCache* cache, std::unique_ptr<AudioDecoder> inner, uint64_t track)
+        : cache_(cache),
+          inner_(std::move(inner)),
+          track_(track),
+          channels_(inner_->getChannels()),
+          sample_rate_(inner_->getSampleRate()),
+          exact_seek_(std::strcmp(inner_->name(), "flac") == 0 || std::strcmp(inner_->name(), "pcm-cache") == 0),
+          recording_(true),
+          pos_(0),
+          end_(UINT64_MAX),
+          decode_position_(-1),
+          inner_next_(0),
+          asm_start_(0),
+          asm_frames_(0)
+    {
+        asm_.resize(static_cast<size_t>(kBlockFrames) * channels_);
+    }
+
+    bool open(const std::string& filepath) override {
+        // Reopening may change the file; the wrapper is tied to one track.
+        (void)filepath;
+        return false;
+    }
+
+    int decode(std::vector<int16_t>& out_buffer) override {
+        floats_.clear();
+        int n = decodeFloat(floats_);
+        if (n > 0) {
+            size_t start = out_buffer.size();
+            out_buffer.resize(start + static_cast<size_t>(n));
+            convertFloatToS16(floats_.data(), out_buffer.data() + start, static_cast<size_t>(n));
+        }
+        return n;
+    }
+
+    int decodeFloat(std::vector<float>& out_buffer) override {
+        if (pos_ >= end_) return 0;
+
+        // Cached block covering pos_?
+        const uint64_t index = pos_ / kBlockFrames;
+        const uint64_t start = index * kBlockFrames;
+        size_t frames = cache_->fetch(track_, index, block_);
+        if (frames > 0) {
+            if (frames < kBlockFrames) end_ = start + frames;
+            if (pos_ >= start + frames) return 0;
+            size_t skip = static_cast<size_t>(pos_ - start);
+            out_buffer.insert(out_buffer.end(), block_.begin() + skip * channels_, block_.begin() + frames * channels_);
+            decode_position_ = static_cast<int64_t>(pos_);
+            pos_ = start + frames;
+            return static_cast<int>((frames - skip) * channels_);
+        }
+
+        // Not cached: the real decoder must deliver pos_. Reposition it at the
+        // block start (so the block can be recorded whole) unless it is
+        // already a short way before pos_.
+        if (inner_next_ < 0 || static_cast<uint64_t>(inner_next_) > pos_ ||
+            pos_ - static_cast<uint64_t>(inner_next_) >= kBlockFrames) {
+            if (!repositionInner(start)) return 0;
+        }
+
+        while (true) {
+            chunk_.clear();
+            int n = inner_->decodeFloat(chunk_);
+            if (n <= 0) {
+                finishRecording();
+                end_ = std::max<uint64_t>(pos_, static_cast<uint64_t>(std::max<int64_t>(inner_next_, 0)));
+                return 0;
+            }
+            int64_t p = inner_->getDecodePosition();
+            if (p < 0) p = inner_next_;
+            const size_t got = static_cast<size_t>(n) / channels_;
+            record(chunk_.data(), static_cast<uint64_t>(p), got);
+            inner_next_ = p + static_cast<int64_t>(got);
+
+            uint64_t chunkEnd = static_cast<uint64_t>(inner_next_);
+            if (chunkEnd <= pos_) continue;   // still before the target
+            // An inexact seek may resume after pos_: continue from there.
+            if (static_cast<uint64_t>(p) > pos_) pos_ = static_cast<uint64_t>(p);
+            size_t skip = static_cast<size_t>(pos_ - static_cast<uint64_t>(p));
+            out_buffer.insert(out_buffer.end(), chunk_.begin() + skip * channels_, chunk_.begin() + got * channels_);
+            decode_position_ = static_cast<int64_t>(pos_);
+            pos_ = chunkEnd;
+            return static_cast<int>((got - skip) * channels_);
+        }
+    }
+
+    void close() override {
+        discardBufferedFrames();
+        asm_frames_ = 0;
+        inner_->close();
+    }
+
+    int getSampleRate() const override { return sample_rate_; }
+    int getChannels() const override { return channels_; }
+    double getDuration() const override { return inner_->getDuration(); }
+    const char* name() const override { return inner_->name(); }
+
+    bool seek(double seconds) override {
+        discardBufferedFrames();
+        if (seconds < 0.0 || sample_rate_ <= 0) return false;
+        uint64_t frame = static_cast<uint64_t>(std::llround(seconds * sample_rate_));
+        double duration = inner_->getDuration();
+        if (duration > 0.0 && frame > static_cast<uint64_t>(std::llround(duration * sample_rate_))) return false;
+
+        pos_ = frame;
+        if (frame >= end_ || cache_->contains(track_, frame / kBlockFrames)) return true;
+        // Position the decoder now so that an unseekable stream fails here.
+        return repositionInner(frame / kBlockFrames * kBlockFrames);
+    }
+
+    int64_t getDecodePosition() const override { return decode_position_; }
+
+private:
+    bool repositionInner(uint64_t frame) {
+        asm_frames_ = 0;
+        if (!inner_->seek(static_cast<double>(frame) / sample_rate_)) {
+            inner_next_ = -1;
+            return false;
+        }
+        inner_next_ = static_cast<int64_t>(frame);
+        // From frame 0 positions are exact again, as after open().
+        recording_ = exact_seek_ || frame == 0;
+        return true;
+    }
+
+    // Collect decoded frames [p, p + frames) into block-aligned blocks.
+    void record(const float* pcm, uint64_t p, size_t frames) {
+        if (!recording_) return;
+        while (frames > 0) {
+            const uint64_t blockStart = p / kBlockFrames * kBlockFrames;
+            if (asm_frames_ == 0 || asm_start_ != blockStart || asm_start_ + asm_frames_ != p) {
+                if (p != blockStart) {
+                    // Joined mid-block: skip to the next block boundary.
+                    size_t skip = static_cast<size_t>(std::min<uint64_t>(frames, blockStart + kBlockFrames - p));
+                    asm_frames_ = 0;
+                    pcm += skip * channels_;
+                    p += skip;
+                    frames -= skip;
+                    continue;
+                }
+                asm_start_ = blockStart;
+                asm_frames_ = 0;
+            }
+            size_t take = std::min<size_t>(frames, kBlockFrames - asm_frames_);
+            std::memcpy(asm_.data() + asm_frames_ * channels_, pcm, take * channels_ * sizeof(float));
+            asm_frames_ += take;
+            pcm += take * channels_;
+            p += take;
+            frames -= take;
+            if (asm_frames_ == kBlockFrames) {
+                cache_->store(track_, asm_start_ / kBlockFrames, asm_.data(), kBlockFrames, channels_);
+                asm_frames_ = 0;
+            }
+        }
+    }
+
+    // EOF: the partial last block marks the end of the track.
+    void finishRecording() {
+        if (recording_ && asm_frames_ > 0 && static_cast<int64_t>(asm_start_ + asm_frames_) == inner_next_) {
+            cache_->store(track_, asm_start_ / kBlockFrames, asm_.data(), asm_frames_, channels_);
+        }
+        asm_frames_ = 0;
+    }
+
+private:
+    PcmBlockCache* cache_;
+    std::unique_ptr<AudioDecoder> inner_;
+    uint64_t track_;
+    size_t channels_;
+    int sample_rate_;
+    bool exact_seek_;          // inner positions stay sample-exact after seeks
+    bool recording_;
+
+    uint64_t pos_;             // next frame to return
+    uint64_t end_;             // first frame past EOF once known
+    int64_t decode_position_;
+    int64_t inner_next_;       // next frame the inner decoder returns (-1 = unknown)
+
+    std::vector<float> asm_;      // block being assembled
+    uint64_t asm_start_;
+    size_t asm_frames_;
+    std::vector<float> block_;    // decompressed cached block
+    std::vector<float> chunk_;    // inner decoder output
+    std::vector<float> floats_;   // decodeFloat() output for decode()
+};
+
+// -----------------------------
+// PcmBlockCache
+// -----------------------------
+PcmBlockCache::PcmBlockCache(uint64_t budgetBytes)
+    : budgetBytes_(budgetBytes),
+      usedBytes_(0)
+{}
+
+PcmBlockCache::~PcmBlockCache() = default;
+
+std::unique_ptr<AudioDecoder> PcmBlockCache::wrap(std::unique_ptr<AudioDecoder> decoder, const std::string& path) {
+    if (!decoder || budgetBytes_ == 0) return decoder;
+    const char* name = decoder->name();
+    if (std::strcmp(name, "pcm") == 0 || std::strcmp(name, "pcm-cache") == 0) return decoder;
+    const int channels = decoder->getChannels();
+    if (channels < 1 || channels > kPcmBlockMaxChannels || decoder->getSampleRate() <= 0) return decoder;
+
+    uint64_t track = trackKey(path, *decoder);
+    return std::unique_ptr<AudioDecoder>(new CachingDecoder(this, std::move(decoder), track));
+}
+
+uint64_t PcmBlockCache::blockCost(const Block& block) {
+    return block.data.capacity() + kBlockOverhead;
+}
+
+size_t PcmBlockCache::fetch(uint64_t track, uint64_t index, std::vector<float>& pcm) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(Key{track, index});
+    if (it == index_.end()) {
+        ++stats_.misses;
+        return 0;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    const Block& block = *it->second;
+    const size_t samples = static_cast<size_t>(block.frames) * block.channels;
+    samples_.resize(samples);
+    if (!decompressPcmBlock(block.data.data(), block.data.size(), block.frames, block.channels, samples_.data())) {
+        Logger::instance().log(LogLevel::ERROR, "PcmBlockCache: corrupt block dropped");
+        usedBytes_ -= blockCost(block);
+        stats_.rawBytes -= static_cast<uint64_t>(block.frames) * block.channels * sizeof(float);
+        stats_.compressedBytes -= block.data.size();
+        --stats_.blocks;
+        lru_.erase(it->second);
+        index_.erase(it);
+        ++stats_.misses;
+        return 0;
+    }
+    pcm.resize(samples);
+    dequantizePcmBlock(samples_.data(), pcm.data(), samples);
+    ++stats_.hits;
+    return block.frames;
+}
+
+bool PcmBlockCache::contains(uint64_t track, uint64_t index) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.count(Key{track, index}) != 0;
+}
+
+void PcmBlockCache::store(uint64_t track, uint64_t index, const float* pcm, size_t frames, int channels) {
+    if (contains(track, index)) return;
+
+    // Quantize and compress outside the lock.
+    Block block;
+    block.key = Key{track, index};
+    block.frames = static_cast<uint32_t>(frames);
+    block.channels = channels;
+    std::vector<int32_t> samples(frames * static_cast<size_t>(channels));
+    quantizePcmBlock(pcm, samples.data(), samples.size());
+    if (!compressPcmBlock(samples.data(), frames, channels, block.data)) return;
+    block.data.shrink_to_fit();
+    const uint64_t cost = blockCost(block);
+    if (cost > budgetBytes_) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index_.count(block.key)) return;
+    while (usedBytes_ + cost > budgetBytes_ && !lru_.empty()) {
+        const Block& victim = lru_.back();
+        usedBytes_ -= blockCost(victim);
+        stats_.rawBytes -= static_cast<uint64_t>(victim.frames) * victim.channels * sizeof(float);
+        stats_.compressedBytes -= victim.data.size();
+        --stats_.blocks;
+        ++stats_.evictions;
+        index_.erase(victim.key);
+        lru_.pop_back();
+    }
+    usedBytes_ += cost;
+    stats_.rawBytes += static_cast<uint64_t>(frames) * channels * sizeof(float);
+    stats_.compressedBytes += block.data.size();
+    ++stats_.blocks;
+    lru_.push_front(std::move(block));
+    index_[lru_.front().key] = lru_.begin();
+}
+
+PcmBlockCache::Stats PcmBlockCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s = stats_;
+    s.usedBytes = usedBytes_;
+    return s;
+}
+
+void PcmBlockCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    usedBytes_ = 0;
+    stats_.blocks = 0;
+    stats_.rawBytes = 0;
+    stats_.compressedBytes = 0;
+}
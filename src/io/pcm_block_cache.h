@@ -0,0 +1,114 @@
+#pragma once
+/*
+ pcm_block_cache.h
+
+ Purpose:
+   - In-memory cache of decoded PCM in fixed-size blocks, compressed with the
+     block codec (decoder/pcm_block_codec.h). Seeking back into a
+     part of a track that was already heard, A-B loops and replays are then
+     served from RAM instead of decoding again.
+   - wrap() puts a caching AudioDecoder in front of a decoder. Blocks are
+     recorded as the decoder produces them; decodeFloat() after a seek
+     returns cached blocks while they last and repositions the real decoder when it
+     runs into a block that is not cached.
+
+ Design notes:
+   - Blocks are kBlockFrames frames aligned to the start of the stream and
+     keyed by (track, block index). Only whole blocks decoded contiguously
+     from their first frame are stored, plus the final partial block at EOF
+     (which also tells later reads where the track ends).
+   - A track is identified by path, size, mtime and output format.
+   - Decoders with inexact seeking (FFmpeg) only record until their first
+     seek to a position other than 0: post-seek timestamps may be off by a
+     few frames, which would misalign the blocks.
+   - Blocks hold the engine's float output quantized to 24 bits with 18 dB
+     of headroom (see pcm_block_codec.h): 16- and 24-bit sources are stored
+     exactly, and float codecs (MP3, AAC, Vorbis, Opus) keep their peaks
+     above full scale. decode() converts the same frames to int16.
+   - Native WAV/AIFF and the disk PCM cache are not wrapped: their PCM is a
+     memory map away already.
+   - The cache holds a hard byte budget (compressed blocks plus bookkeeping)
+     and evicts least recently used blocks. All methods are thread-safe.
+*/
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+class AudioDecoder;   // decoder/audio_decoder.h
+
+class PcmBlockCache {
+public:
+    // budgetBytes: memory the cache may use for blocks
+    explicit PcmBlockCache(uint64_t budgetBytes);
+    ~PcmBlockCache();
+
+    PcmBlockCache(const PcmBlockCache&) = delete;
+    PcmBlockCache& operator=(const PcmBlockCache&) = delete;
+
+    // Caching decoder around `decoder`, which must already be open on
+    // `path`. Returns `decoder` itself for formats that are not worth
+    // caching. The cache must outlive returned decoders.
+    std::unique_ptr<AudioDecoder> wrap(std::unique_ptr<AudioDecoder> decoder, const std::string& path);
+
+    struct Stats {
+        uint64_t blocks = 0;           // resident blocks
+        uint64_t rawBytes = 0;         // their size as float PCM
+        uint64_t compressedBytes = 0;  // their compressed size
+        uint64_t usedBytes = 0;        // charged against the budget
+        uint64_t hits = 0;             // block reads served from the cache
+        uint64_t misses = 0;           // block reads that needed the decoder
+        uint64_t evictions = 0;
+    };
+    Stats stats() const;
+
+    uint64_t budgetBytes() const { return budgetBytes_; }
+
+    // Drop every block.
+    void clear();
+
+    // Frames per block (~0.37 s at 44.1 kHz; 128 KiB of stereo float PCM).
+    static constexpr uint32_t kBlockFrames = 16384;
+
+private:
+    class CachingDecoder;   // AudioDecoder wrapper (pcm_block_cache.cpp)
+
+    struct Key {
+        uint64_t track;
+        uint64_t index;
+        bool operator==(const Key& o) const { return track == o.track && index == o.index; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            return static_cast<size_t>(k.track ^ (k.index * 0x9E3779B97F4A7C15ULL));
+        }
+    };
+    struct Block {
+        Key key;
+        uint32_t frames;
+        int channels;
+        std::vector<uint8_t> data;   // pcm_block_codec output
+    };
+
+    // Decode block `index` of `track` into `pcm`; returns its frame count,
+    // 0 if it is not cached.
+    size_t fetch(uint64_t track, uint64_t index, std::vector<float>& pcm);
+    bool contains(uint64_t track, uint64_t index) const;
+    // Compress and insert a block (replacing nothing if already present).
+    void store(uint64_t track, uint64_t index, const float* pcm, size_t frames, int channels);
+    static uint64_t blockCost(const Block& block);
+
+private:
+    uint64_t budgetBytes_;
+
+    mutable std::mutex mutex_;                                        // guards everything below
+    std::list<Block> lru_;                                            // front = most recently used
+    std::unordered_map<Key, std::list<Block>::iterator, KeyHash> index_;
+    uint64_t usedBytes_;
+    Stats stats_;
+    std::vector<int32_t> samples_;   // fetch() decompression buffer
+};
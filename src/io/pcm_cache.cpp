@@ -0,0 +1,518 @@
+/*
+ pcm_cache.cpp
+
+ Index, recording and playback of decoded-PCM cache entries. See pcm_cache.h.
+*/
+
+#include "pcm_cache.h"
+#include "mapped_file.h"
+#include "staging_cache.h"
+#include "../decoder/audio_decoder.h"
+#include "../decoder/pcm_convert.h"
+#include "../utils/logger.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+// Bytes hashed from each end of the source file for the content key.
+static constexpr size_t kHashBytes = 64 * 1024;
+// Output settings the cached PCM depends on; bump when they change.
+static const char* const kFormatTag = "f32-interleaved-native-v2";
+static const char* const kInfoMagic = "PCMCACHE2";
+// Frames returned per decode() from a cached entry (same as PcmDecoder).
+static constexpr size_t kFramesPerDecode = 4096;
+
+static uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 1469598103934665603ULL) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string chunkPath(const std::string& dir, size_t index) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%05zu.pcm", index);
+    return dir + name;
+}
+
+// -----------------------------
+// CachedPcmDecoder: plays a complete entry
+// -----------------------------
+namespace {
+
+class CachedPcmDecoder : public AudioDecoder {
+public:
+    // `filepath` is the entry directory.
+    bool open(const std::string& filepath) override {
+        close();
+        std::FILE* info = std::fopen((filepath + "/info").c_str(), "r");
+        if (!info) return false;
+        char magic[16] = {};
+        unsigned long long total = 0;
+        int matched = std::fscanf(info, "%15s %d %d %llu %u", magic, &sample_rate_, &channels_, &total, &chunk_frames_);
+        std::fclose(info);
+        if (matched != 5 || std::strcmp(magic, kInfoMagic) != 0 || sample_rate_ <= 0 || channels_ <= 0 ||
+            chunk_frames_ == 0 || total == 0) {
+            return false;
+        }
+        total_frames_ = total;
+
+        const size_t frameBytes = static_cast<size_t>(channels_) * sizeof(float);
+        const size_t chunks = static_cast<size_t>((total_frames_ + chunk_frames_ - 1) / chunk_frames_);
+        for (size_t i = 0; i < chunks; ++i) {
+            uint64_t frames = std::min<uint64_t>(chunk_frames_, total_frames_ - static_cast<uint64_t>(i) * chunk_frames_);
+            std::unique_ptr<MappedFile> chunk(new MappedFile());
+            if (!chunk->open(chunkPath(filepath, i)) || chunk->size() != frames * frameBytes) {
+                close();
+                return false;
+            }
+            chunks_.push_back(std::move(chunk));
+        }
+        next_frame_ = 0;
+        return true;
+    }
+
+    int decode(std::vector<int16_t>& out_buffer) override {
+        size_t samples = 0;
+        const float* src = next(samples);
+        if (!src) return 0;
+        size_t start = out_buffer.size();
+        out_buffer.resize(start + samples);
+        convertFloatToS16(src, out_buffer.data() + start, samples);
+        return static_cast<int>(samples);
+    }
+
+    int decodeFloat(std::vector<float>& out_buffer) override {
+        size_t samples = 0;
+        const float* src = next(samples);
+        if (!src) return 0;
+        out_buffer.insert(out_buffer.end(), src, src + samples);
+        return static_cast<int>(samples);
+    }
+
+    void close() override {
+        discardBufferedFrames();
+        chunks_.clear();
+        total_frames_ = 0;
+        next_frame_ = 0;
+        decode_position_ = -1;
+    }
+
+    int getSampleRate() const override { return sample_rate_; }
+    int getChannels() const override { return channels_; }
+    double getDuration() const override {
+        return sample_rate_ > 0 ? static_cast<double>(total_frames_) / sample_rate_ : 0.0;
+    }
+    const char* name() const override { return "pcm-cache"; }
+
+    bool seek(double seconds) override {
+        discardBufferedFrames();
+        if (seconds < 0.0 || chunks_.empty()) return false;
+        uint64_t frame = static_cast<uint64_t>(std::llround(seconds * sample_rate_));
+        if (frame > total_frames_) return false;
+        next_frame_ = frame;
+        return true;
+    }
+
+    int64_t getDecodePosition() const override { return decode_position_; }
+
+private:
+    // Up to kFramesPerDecode frames from next_frame_, within one chunk;
+    // nullptr at the end.
+    const float* next(size_t& samples) {
+        if (next_frame_ >= total_frames_) return nullptr;
+        const size_t frameBytes = static_cast<size_t>(channels_) * sizeof(float);
+        MappedFile& chunk = *chunks_[static_cast<size_t>(next_frame_ / chunk_frames_)];
+        size_t offset = static_cast<size_t>(next_frame_ % chunk_frames_) * frameBytes;
+        if (chunk.tell() != offset) chunk.seek(static_cast<int64_t>(offset), SEEK_SET);
+
+        size_t bytes = kFramesPerDecode * frameBytes;
+        const float* src = reinterpret_cast<const float*>(chunk.consume(bytes));
+        samples = bytes / sizeof(float);
+        decode_position_ = static_cast<int64_t>(next_frame_);
+        next_frame_ += bytes / frameBytes;
+        return src;
+    }
+
+    std::vector<std::unique_ptr<MappedFile>> chunks_;
+    int sample_rate_ = 0;
+    int channels_ = 0;
+    unsigned chunk_frames_ = 0;
+    uint64_t total_frames_ = 0;
+    uint64_t next_frame_ = 0;
+    int64_t decode_position_ = -1;
+};
+
+} // namespace
+
+// -----------------------------
+// Recorder: records a decoder's output into "<key>.part"
+// -----------------------------
+class PcmCache::Recorder : public AudioDecoder {
+public:
+    Recorder(PcmCache* cache, std::unique_ptr<AudioDecoder> inner, const std::string& key, const std::string& partDir)
+        : cache_(cache),
+          inner_(std::move(inner)),
+          key_(key),
+          part_dir_(partDir),
+          recording_(true),
+          fd_(-1),
+          chunk_index_(0),
+          chunk_frames_(0),
+          frames_(0),
+          bytes_(0)
+    {}
+
+    ~Recorder() override {
+        abandon();
+    }
+
+    bool open(const std::string& filepath) override {
+        abandon();
+        return inner_->open(filepath);
+    }
+
+    int decode(std::vector<int16_t>& out_buffer) override {
+        size_t before = out_buffer.size();
+        int n = inner_->decode(out_buffer);
+        if (recording_) {
+            if (n > 0) {
+                floats_.resize(static_cast<size_t>(n));
+                convertS16ToFloat(out_buffer.data() + before, floats_.data(), floats_.size());
+                append(floats_.data(), floats_.size());
+            } else {
+                finish();
+            }
+        }
+        return n;
+    }
+
+    int decodeFloat(std::vector<float>& out_buffer) override {
+        size_t before = out_buffer.size();
+        int n = inner_->decodeFloat(out_buffer);
+        if (recording_) {
+            if (n > 0) {
+                append(out_buffer.data() + before, static_cast<size_t>(n));
+            } else {
+                finish();
+            }
+        }
+        return n;
+    }
+
+    void close() override {
+        discardBufferedFrames();
+        abandon();
+        inner_->close();
+    }
+
+    int getSampleRate() const override { return inner_->getSampleRate(); }
+    int getChannels() const override { return inner_->getChannels(); }
+    double getDuration() const override { return inner_->getDuration(); }
+    const char* name() const override { return inner_->name(); }
+
+    bool seek(double seconds) override {
+        // The recording must be one contiguous pass from the start.
+        discardBufferedFrames();
+        abandon();
+        return inner_->seek(seconds);
+    }
+
+    int64_t getDecodePosition() const override { return inner_->getDecodePosition(); }
+
+private:
+    void append(const float* samples, size_t count) {
+        const size_t channels = static_cast<size_t>(inner_->getChannels());
+        size_t frames = count / channels;
+        if (bytes_ + count * sizeof(float) > cache_->budgetBytes_) {
+            Logger::instance().log(LogLevel::INFO, "PcmCache: track exceeds the cache budget, not recording");
+            abandon();
+            return;
+        }
+        while (frames > 0) {
+            if (fd_ < 0 || chunk_frames_ == kChunkFrames) {
+                if (fd_ >= 0) ::close(fd_);
+                fd_ = ::open(chunkPath(part_dir_, chunk_index_++).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                chunk_frames_ = 0;
+                if (fd_ < 0) {
+                    Logger::instance().log(LogLevel::WARNING, "PcmCache: cannot write to " + part_dir_ + ": " + std::strerror(errno));
+                    abandon();
+                    return;
+                }
+            }
+            size_t take = std::min<size_t>(frames, kChunkFrames - chunk_frames_);
+            const char* data = reinterpret_cast<const char*>(samples);
+            size_t length = take * channels * sizeof(float);
+            for (size_t written = 0; written < length; ) {
+                ssize_t w = ::write(fd_, data + written, length - written);
+                if (w < 0 && errno == EINTR) continue;
+                if (w <= 0) {
+                    abandon();
+                    return;
+                }
+                written += static_cast<size_t>(w);
+            }
+            samples += take * channels;
+            frames -= take;
+            chunk_frames_ += static_cast<uint32_t>(take);
+            frames_ += take;
+            bytes_ += length;
+        }
+    }
+
+    void finish() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        recording_ = false;
+        if (frames_ == 0) {
+            abandon();
+            return;
+        }
+        std::string infoPath = part_dir_ + "/info";
+        std::FILE* info = std::fopen(infoPath.c_str(), "w");
+        if (!info) {
+            abandon();
+            return;
+        }
+        std::fprintf(info, "%s %d %d %llu %u\n", kInfoMagic, inner_->getSampleRate(), inner_->getChannels(),
+                     static_cast<unsigned long long>(frames_), kChunkFrames);
+        long infoBytes = std::ftell(info);
+        bool ok = std::fclose(info) == 0 && infoBytes > 0;
+        if (!ok || !cache_->commit(key_, part_dir_, bytes_ + static_cast<uint64_t>(infoBytes))) {
+            abandon();
+        }
+        part_dir_.clear();
+    }
+
+    void abandon() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        recording_ = false;
+        if (!part_dir_.empty()) {
+            std::error_code ec;
+            fs::remove_all(part_dir_, ec);
+            part_dir_.clear();
+        }
+    }
+
+private:
+    PcmCache* cache_;
+    std::unique_ptr<AudioDecoder> inner_;
+    std::string key_;
+    std::string part_dir_;   // empty once committed or abandoned
+    bool recording_;
+    int fd_;                 // current chunk file
+    size_t chunk_index_;
+    uint32_t chunk_frames_;  // frames in the current chunk
+    uint64_t frames_;
+    uint64_t bytes_;
+    std::vector<float> floats_;   // decode() output converted for recording
+};
+
+// -----------------------------
+// Constructor / Destructor
+// -----------------------------
+PcmCache::PcmCache(const std::string& directory, uint64_t budgetBytes)
+    : directory_(directory),
+      budgetBytes_(budgetBytes),
+      tick_(0),
+      usedBytes_(0)
+{
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    if (ec) {
+        Logger::instance().log(LogLevel::WARNING, "PcmCache: cannot create " + directory_ + ": " + ec.message());
+    }
+    loadIndex();
+}
+
+PcmCache::~PcmCache() = default;
+
+std::string PcmCache::defaultDirectory() {
+    std::string base;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        base = xdg;
+    } else if (const char* home = std::getenv("HOME")) {
+        base = std::string(home) + "/.cache";
+    } else {
+        base = "/tmp";
+    }
+    return base + "/music_player/pcm";
+}
+
+bool PcmCache::contentKey(const std::string& path, std::string& key) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    const uint64_t size = static_cast<uint64_t>(st.st_size);
+    std::vector<char> buffer(kHashBytes);
+
+    uint64_t hash = fnv1a(kFormatTag, std::strlen(kFormatTag));
+    hash = fnv1a(&size, sizeof(size), hash);
+    const off_t tail = size > kHashBytes ? static_cast<off_t>(size - kHashBytes) : 0;
+    for (off_t offset : { static_cast<off_t>(0), tail }) {
+        ssize_t n = ::pread(fd, buffer.data(), buffer.size(), offset);
+        if (n < 0) {
+            ::close(fd);
+            return false;
+        }
+        hash = fnv1a(buffer.data(), static_cast<size_t>(n), hash);
+    }
+    ::close(fd);
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    key = hex;
+    return true;
+}
+
+// -----------------------------
+// Index
+// -----------------------------
+void PcmCache::loadIndex() {
+    std::error_code ec;
+    std::vector<std::pair<fs::file_time_type, Entry>> found;
+    std::vector<std::string> keys;
+    for (const auto& entry : fs::directory_iterator(directory_, ec)) {
+        if (!entry.is_directory(ec)) continue;
+        if (entry.path().extension() == ".part" || !fs::exists(entry.path() / "info", ec)) {
+            fs::remove_all(entry.path(), ec);   // interrupted recording from a previous run
+            continue;
+        }
+        Entry e;
+        e.dir = entry.path().string();
+        e.size = 0;
+        for (const auto& file : fs::directory_iterator(entry.path(), ec)) {
+            e.size += file.file_size(ec);
+        }
+        found.emplace_back(entry.last_write_time(ec), e);
+        keys.push_back(entry.path().filename().string());
+    }
+    // Oldest first so the LRU ticks follow last use across restarts.
+    std::vector<size_t> order(found.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return found[a].first < found[b].first; });
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i : order) {
+        found[i].second.lastUse = ++tick_;
+        usedBytes_ += found[i].second.size;
+        entries_[keys[i]] = found[i].second;
+    }
+    makeRoom(0);
+    Logger::instance().log(LogLevel::INFO, "PcmCache: " + std::to_string(entries_.size()) +
+        " cached tracks (" + std::to_string(usedBytes_.load() >> 20) + " MiB) in " + directory_);
+}
+
+// Evict least-recently-used entries until `bytes` more fit in the budget.
+// Caller holds mutex_. Readers keep working: their chunks stay mapped.
+bool PcmCache::makeRoom(uint64_t bytes) {
+    if (bytes > budgetBytes_) return false;
+    while (usedBytes_.load() + bytes > budgetBytes_ && !entries_.empty()) {
+        auto victim = entries_.begin();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (it->second.lastUse < victim->second.lastUse) victim = it;
+        }
+        std::error_code ec;
+        fs::remove_all(victim->second.dir, ec);
+        usedBytes_ -= victim->second.size;
+        Logger::instance().log(LogLevel::INFO, "PcmCache: evicted " + victim->second.dir);
+        entries_.erase(victim);
+    }
+    return usedBytes_.load() + bytes <= budgetBytes_;
+}
+
+bool PcmCache::commit(const std::string& key, const std::string& partDir, uint64_t bytes) {
+    std::string finalDir = directory_ + "/" + key;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.count(key) || !makeRoom(bytes)) {
+        return false;
+    }
+    if (std::rename(partDir.c_str(), finalDir.c_str()) != 0) {
+        Logger::instance().log(LogLevel::WARNING, "PcmCache: cannot commit " + finalDir + ": " + std::strerror(errno));
+        return false;
+    }
+    Entry e;
+    e.dir = finalDir;
+    e.size = bytes;
+    e.lastUse = ++tick_;
+    entries_[key] = e;
+    usedBytes_ += bytes;
+    Logger::instance().log(LogLevel::INFO, "PcmCache: cached " + finalDir + " (" + std::to_string(bytes >> 10) + " KiB)");
+    return true;
+}
+
+// -----------------------------
+// Public API
+// -----------------------------
+bool PcmCache::contains(const std::string& path, StagingCache* staging) {
+    std::string key;
+    if (!contentKey(staging ? staging->resolve(path) : path, key)) return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.count(key) != 0;
+}
+
+std::unique_ptr<AudioDecoder> PcmCache::openFile(const std::string& path, StagingCache* staging) {
+    std::string key;
+    if (contentKey(staging ? staging->resolve(path) : path, key)) {
+        std::string dir;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(key);
+            if (it != entries_.end()) {
+                it->second.lastUse = ++tick_;
+                dir = it->second.dir;
+                ::utimensat(AT_FDCWD, dir.c_str(), nullptr, 0);  // persist LRU order
+            }
+        }
+        if (!dir.empty()) {
+            std::unique_ptr<AudioDecoder> cached(new CachedPcmDecoder());
+            if (cached->open(dir)) {
+                Logger::instance().log(LogLevel::INFO, "PcmCache: serving " + path + " from " + dir);
+                return cached;
+            }
+            Logger::instance().log(LogLevel::WARNING, "PcmCache: dropping unreadable entry " + dir);
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(key);
+            if (it != entries_.end()) {
+                std::error_code ec;
+                fs::remove_all(it->second.dir, ec);
+                usedBytes_ -= it->second.size;
+                entries_.erase(it);
+            }
+        }
+    }
+
+    std::unique_ptr<AudioDecoder> decoder = AudioDecoder::openFile(path, staging);
+    if (!decoder || key.empty() || std::strcmp(decoder->name(), "pcm") == 0) {
+        return decoder;
+    }
+    // mkdir fails if another decoder is already recording this track.
+    std::string partDir = directory_ + "/" + key + ".part";
+    if (::mkdir(partDir.c_str(), 0755) != 0) {
+        return decoder;
+    }
+    return std::unique_ptr<AudioDecoder>(new Recorder(this, std::move(decoder), key, partDir));
+}
@@ -0,0 +1,92 @@
+#pragma once
+/*
+ pcm_cache.h
+
+ Purpose:
+   - Optional on-disk cache of decoded PCM for tracks that are played over
+     and over (kiosk loops, favourites). A cached track is played straight
+     from memory-mapped files: no decode work, and seeks are a pointer move.
+   - openFile() replaces AudioDecoder::openFile() for Player. On a hit it
+     returns a decoder over the cached PCM; on a miss it returns the normal
+     decoder wrapped so that the PCM it produces is recorded, and the entry
+     is committed once decoding reaches EOF.
+
+ Design notes:
+   - Entries are keyed by a content hash (size + first and last 64 KiB of
+     the file) and the decoder output settings, so renamed or copied files
+     still hit and a changed file never serves stale audio.
+   - PCM is stored in the engine format (interleaved float32 at the
+     decoder's native rate, as returned by decodeFloat()) in fixed-size
+     chunk files "<key>/NNNNN.pcm" next to a small "<key>/info" header.
+     Chunks keep every file a moderate size and let a seek map only the part
+     of the track it needs.
+   - Recording goes to "<key>.part/" and is renamed when complete; it is
+     dropped if the decoder seeks, fails, or is closed before EOF.
+   - Float storage keeps 24-bit sources exact and the peaks above full scale
+     that lossy codecs (MP3, AAC) produce. Native WAV/AIFF input is not
+     recorded: it already is PCM.
+   - Eviction is LRU under a byte budget; use time persists as the entry
+     directory's mtime.
+*/
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <atomic>
+#include <cstdint>
+
+class AudioDecoder;   // decoder/audio_decoder.h
+class StagingCache;   // io/staging_cache.h
+
+class PcmCache {
+public:
+    // directory:   where entries are kept (created if missing)
+    // budgetBytes: total size the cache may occupy on disk
+    PcmCache(const std::string& directory, uint64_t budgetBytes);
+    ~PcmCache();
+
+    PcmCache(const PcmCache&) = delete;
+    PcmCache& operator=(const PcmCache&) = delete;
+
+    // Decoder for `path`: cached PCM if available, otherwise a recording
+    // wrapper around AudioDecoder::openFile(path, staging). nullptr if the
+    // file cannot be decoded. The cache must outlive returned decoders.
+    std::unique_ptr<AudioDecoder> openFile(const std::string& path, StagingCache* staging = nullptr);
+
+    // True if a complete entry for `path` exists.
+    bool contains(const std::string& path, StagingCache* staging = nullptr);
+
+    // Default location: $XDG_CACHE_HOME/music_player/pcm (or ~/.cache/...).
+    static std::string defaultDirectory();
+
+    uint64_t usedBytes() const { return usedBytes_.load(); }
+
+    // Frames per chunk file (~24 s of 44.1 kHz audio; 8 MiB for stereo).
+    static constexpr uint32_t kChunkFrames = 1u << 20;
+
+private:
+    class Recorder;   // recording AudioDecoder wrapper (pcm_cache.cpp)
+
+    struct Entry {
+        std::string dir;
+        uint64_t size;
+        uint64_t lastUse;   // LRU tick
+    };
+
+    static bool contentKey(const std::string& path, std::string& key);
+    // Move a finished "<key>.part" directory into place. `bytes` is its size.
+    bool commit(const std::string& key, const std::string& partDir, uint64_t bytes);
+    bool makeRoom(uint64_t bytes);
+    void loadIndex();
+
+private:
+    std::string directory_;
+    uint64_t budgetBytes_;
+
+    std::mutex mutex_;                                  // guards everything below
+    std::unordered_map<std::string, Entry> entries_;    // key -> complete entry
+    uint64_t tick_;
+
+    std::atomic<uint64_t> usedBytes_;
+};
@@ -0,0 +1,132 @@
+/*
+ queue_prefetcher.cpp
+
+ Page-cache prewarming for upcoming queue entries. See queue_prefetcher.h.
+*/
+
+#include "queue_prefetcher.h"
+#include "staging_cache.h"
+#include "../utils/logger.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Formats whose demuxer reads from the end of the file while opening.
+static bool needsTail(const std::string& path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext == ".mp3" || ext == ".m4a" || ext == ".mp4" || ext == ".aac";
+}
+
+static void hintRange(int fd, uint64_t offset, uint64_t length) {
+#ifdef __linux__
+    ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_WILLNEED);
+    // readahead() queues the reads immediately instead of leaving it to the
+    // kernel's discretion, which matters on a cold rotational disk.
+    ::readahead(fd, static_cast<off64_t>(offset), static_cast<size_t>(length));
+#else
+    (void)fd; (void)offset; (void)length;
+#endif
+}
+
+// -----------------------------
+// Constructor / Destructor
+// -----------------------------
+QueuePrefetcher::QueuePrefetcher(size_t depth, uint64_t headBytes, uint64_t tailBytes)
+    : depth_(depth),
+      headBytes_(headBytes),
+      tailBytes_(tailBytes),
+      generation_(0),
+      stop_(false),
+      prewarmedBytes_(0)
+{
+    worker_ = std::thread(&QueuePrefetcher::workerLoop, this);
+}
+
+QueuePrefetcher::~QueuePrefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+// -----------------------------
+// Public API
+// -----------------------------
+void QueuePrefetcher::setQueue(const std::vector<std::string>& upcoming) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t n = std::min(upcoming.size(), depth_);
+        queue_.assign(upcoming.begin(), upcoming.begin() + n);
+        ++generation_;
+    }
+    cv_.notify_all();
+}
+
+uint64_t QueuePrefetcher::prewarm(const std::string& path, uint64_t headBytes, uint64_t tailBytes) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return 0;
+    }
+
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+    uint64_t head = std::min(size, headBytes);
+    uint64_t hinted = 0;
+    if (head > 0) {
+        hintRange(fd, 0, head);
+        hinted += head;
+    }
+    if (tailBytes > 0 && size > head && needsTail(path)) {
+        uint64_t tailStart = std::max(head, size > tailBytes ? size - tailBytes : 0);
+        hintRange(fd, tailStart, size - tailStart);
+        hinted += size - tailStart;
+    }
+    ::close(fd);
+    return hinted;
+}
+
+// -----------------------------
+// Worker
+// -----------------------------
+void QueuePrefetcher::workerLoop() {
+    uint64_t seen = 0;
+    while (true) {
+        std::vector<std::string> queue;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+            queue = queue_;
+        }
+
+        for (const auto& path : queue) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stop_ || generation_ != seen) break;
+            }
+            if (StagingCache::isSlowPath(path)) continue;
+            uint64_t hinted = prewarm(path, headBytes_, tailBytes_);
+            if (hinted > 0) {
+                prewarmedBytes_ += hinted;
+                Logger::instance().log(LogLevel::DEBUG, "QueuePrefetcher: prewarmed " +
+                    std::to_string(hinted >> 10) + " KiB of " + path);
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+/*
+ queue_prefetcher.h
+
+ Purpose:
+   - Warm the page cache for the next tracks in the play queue so a track
+     change does not start with cold disk reads.
+   - Only the byte ranges the decoder touches first are prewarmed: the head
+     of the file (container header + first packets) and, for formats whose
+     demuxer reads trailing metadata at open time (ID3v1/APE tags on MP3,
+     a trailing 'moov' atom on MP4/M4A), a short tail range.
+
+ Design notes:
+   - A background thread issues posix_fadvise(WILLNEED) and, on Linux,
+     readahead() for each range. Both are hints served by the kernel's I/O
+     scheduler; nothing is copied into user space.
+   - The currently playing file is not handled here: MappedFile keeps its
+     own WILLNEED window ahead of the decoder.
+   - Paths on slow mounts are skipped; StagingCache copies those instead.
+*/
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+class QueuePrefetcher {
+public:
+    // depth:     how many upcoming tracks to prewarm
+    // headBytes: bytes prewarmed from the start of each track (the budget)
+    // tailBytes: bytes prewarmed from the end for formats with trailing metadata
+    QueuePrefetcher(size_t depth, uint64_t headBytes, uint64_t tailBytes = 64 * 1024);
+    ~QueuePrefetcher();
+
+    // Replace the list of upcoming tracks (excluding the current one).
+    void setQueue(const std::vector<std::string>& upcoming);
+
+    // Synchronously issue prewarm hints for one file. Returns the number of
+    // bytes hinted (0 on failure). Used by the worker and by benchmarks.
+    static uint64_t prewarm(const std::string& path, uint64_t headBytes, uint64_t tailBytes);
+
+    // Total bytes hinted since construction.
+    uint64_t prewarmedBytes() const { return prewarmedBytes_.load(); }
+
+private:
+    void workerLoop();
+
+private:
+    size_t depth_;
+    uint64_t headBytes_;
+    uint64_t tailBytes_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::string> queue_;
+    uint64_t generation_;
+    bool stop_;
+
+    std::atomic<uint64_t> prewarmedBytes_;
+    std::thread worker_;
+};
@@ -0,0 +1,323 @@
+/*
+ staging_cache.cpp
+
+ Background copier + LRU index for StagingCache. See staging_cache.h.
+*/
+
+#include "staging_cache.h"
+#include "../utils/logger.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Sequential copy chunk. Large reads amortize the per-request round trip of
+// 9P / SMB, which dominates small-read throughput on those mounts.
+static constexpr size_t kCopyChunkBytes = 4 * 1024 * 1024;
+
+static uint64_t fnv1a(const std::string& data, uint64_t hash = 1469598103934665603ULL) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// -----------------------------
+// Constructor / Destructor
+// -----------------------------
+StagingCache::StagingCache(const std::string& directory, uint64_t budgetBytes, size_t lookahead)
+    : directory_(directory),
+      budgetBytes_(budgetBytes),
+      lookahead_(lookahead),
+      tick_(0),
+      queueGeneration_(0),
+      stop_(false),
+      usedBytes_(0)
+{
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    if (ec) {
+        Logger::instance().log(LogLevel::WARNING, "StagingCache: cannot create " + directory_ + ": " + ec.message());
+    }
+    loadIndex();
+    worker_ = std::thread(&StagingCache::workerLoop, this);
+}
+
+StagingCache::~StagingCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+// -----------------------------
+// Slow-mount detection
+// -----------------------------
+bool StagingCache::isSlowPath(const std::string& path) {
+#ifdef __linux__
+    struct statfs sfs;
+    if (statfs(path.c_str(), &sfs) == 0) {
+        switch (static_cast<unsigned long>(sfs.f_type)) {
+            case 0x01021997UL:  // V9FS (WSL2 /mnt/<drive>)
+            case 0x00006969UL:  // NFS
+            case 0x0000517BUL:  // SMB
+            case 0xFF534D42UL:  // CIFS
+            case 0xFE534D42UL:  // SMB2
+            case 0x65735546UL:  // FUSE (sshfs, rclone, ...)
+                return true;
+            default:
+                break;
+        }
+    }
+#endif
+    // WSL drive mounts, even when statfs is unavailable or reports drvfs.
+    return path.size() > 7 && path.compare(0, 5, "/mnt/") == 0 &&
+           std::isalpha(static_cast<unsigned char>(path[5])) && path[6] == '/';
+}
+
+std::string StagingCache::defaultDirectory() {
+    std::string base;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        base = xdg;
+    } else if (const char* home = std::getenv("HOME")) {
+        base = std::string(home) + "/.cache";
+    } else {
+        base = "/tmp";
+    }
+    return base + "/music_player/staging";
+}
+
+bool StagingCache::sourceKey(const std::string& path, std::string& key, uint64_t& size) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    size = static_cast<uint64_t>(st.st_size);
+    uint64_t hash = fnv1a(path);
+    hash = fnv1a(std::to_string(size) + ":" + std::to_string(static_cast<long long>(st.st_mtime)), hash);
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    key = hex;
+    return true;
+}
+
+// -----------------------------
+// Index
+// -----------------------------
+void StagingCache::loadIndex() {
+    std::error_code ec;
+    std::vector<std::pair<fs::file_time_type, fs::directory_entry>> files;
+    for (const auto& entry : fs::directory_iterator(directory_, ec)) {
+        if (!entry.is_regular_file(ec)) continue;
+        if (entry.path().extension() == ".part") {
+            fs::remove(entry.path(), ec);   // interrupted copy from a previous run
+            continue;
+        }
+        files.emplace_back(entry.last_write_time(ec), entry);
+    }
+    // Oldest first so the LRU ticks follow last use across restarts.
+    std::sort(files.begin(), files.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& file : files) {
+        Entry e;
+        e.localPath = file.second.path().string();
+        e.size = file.second.file_size(ec);
+        e.lastUse = ++tick_;
+        entries_[file.second.path().stem().string()] = e;
+        usedBytes_ += e.size;
+    }
+    makeRoom(0);
+    Logger::instance().log(LogLevel::INFO, "StagingCache: " + std::to_string(entries_.size()) +
+        " staged files (" + std::to_string(usedBytes_.load() >> 20) + " MiB) in " + directory_);
+}
+
+// Evict least-recently-used, unpinned entries until `bytes` more fit in the
+// budget. Caller holds mutex_.
+bool StagingCache::makeRoom(uint64_t bytes) {
+    if (bytes > budgetBytes_) return false;
+    while (usedBytes_.load() + bytes > budgetBytes_) {
+        auto victim = entries_.end();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (std::find(pinned_.begin(), pinned_.end(), it->first) != pinned_.end()) continue;
+            if (victim == entries_.end() || it->second.lastUse < victim->second.lastUse) victim = it;
+        }
+        if (victim == entries_.end()) return false;
+        std::remove(victim->second.localPath.c_str());
+        usedBytes_ -= victim->second.size;
+        Logger::instance().log(LogLevel::INFO, "StagingCache: evicted " + victim->second.localPath);
+        entries_.erase(victim);
+    }
+    return true;
+}
+
+// -----------------------------
+// Public API
+// -----------------------------
+void StagingCache::setQueue(const std::vector<std::string>& queue) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t n = std::min(queue.size(), lookahead_ + 1);
+        queue_.assign(queue.begin(), queue.begin() + n);
+        ++queueGeneration_;
+    }
+    cv_.notify_all();
+}
+
+std::string StagingCache::resolve(const std::string& path) {
+    if (!isSlowPath(path)) return path;
+
+    std::string key;
+    uint64_t size = 0;
+    if (!sourceKey(path, key, size)) return path;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end() || it->second.size != size) return path;
+
+    it->second.lastUse = ++tick_;
+    ::utimensat(AT_FDCWD, it->second.localPath.c_str(), nullptr, 0);  // persist LRU order
+    Logger::instance().log(LogLevel::INFO, "StagingCache: serving " + path + " from " + it->second.localPath);
+    return it->second.localPath;
+}
+
+// -----------------------------
+// Worker
+// -----------------------------
+void StagingCache::workerLoop() {
+    uint64_t seen = 0;
+    while (true) {
+        std::vector<std::string> queue;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&] { return stop_ || queueGeneration_ != seen; });
+            if (stop_) return;
+            seen = queueGeneration_;
+            queue = queue_;
+        }
+
+        // Resolve keys outside the lock: stat() on a slow mount can take a while.
+        std::vector<std::string> sources, keys;
+        std::vector<uint64_t> sizes;
+        for (const auto& path : queue) {
+            std::string key;
+            uint64_t size = 0;
+            if (!isSlowPath(path) || !sourceKey(path, key, size)) continue;
+            sources.push_back(path);
+            keys.push_back(key);
+            sizes.push_back(size);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queueGeneration_ != seen) continue;
+            pinned_ = keys;
+        }
+
+        for (size_t i = 0; i < sources.size(); ++i) {
+            stageFile(sources[i], keys[i], sizes[i]);
+            // A new queue: re-plan from it (finished copies are kept)
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_ || queueGeneration_ != seen) break;
+        }
+    }
+}
+
+bool StagingCache::stageFile(const std::string& source, const std::string& key, uint64_t size) {
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            it->second.lastUse = ++tick_;
+            return true;
+        }
+        if (!makeRoom(size)) {
+            Logger::instance().log(LogLevel::WARNING, "StagingCache: no room to stage " + source);
+            return false;
+        }
+        generation = queueGeneration_;
+    }
+
+    std::string ext = fs::path(source).extension().string();
+    std::string finalPath = directory_ + "/" + key + ext;
+    std::string partPath = finalPath + ".part";
+
+    int in = ::open(source.c_str(), O_RDONLY);
+    if (in < 0) {
+        Logger::instance().log(LogLevel::WARNING, "StagingCache: cannot open " + source + ": " + std::strerror(errno));
+        return false;
+    }
+#ifdef __linux__
+    ::posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    int out = ::open(partPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        Logger::instance().log(LogLevel::WARNING, "StagingCache: cannot create " + partPath + ": " + std::strerror(errno));
+        ::close(in);
+        return false;
+    }
+
+    std::vector<char> buffer(kCopyChunkBytes);
+    uint64_t copied = 0;
+    bool ok = true;
+    while (ok) {
+        {
+            // A new queue cancels the copy only if the file dropped out of
+            // it; the next track's copy survives track changes and edits
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_) { ok = false; break; }
+            if (queueGeneration_ != generation) {
+                if (std::find(queue_.begin(), queue_.end(), source) == queue_.end()) { ok = false; break; }
+                generation = queueGeneration_;
+            }
+        }
+        ssize_t n = ::read(in, buffer.data(), buffer.size());
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) { ok = (n == 0); break; }
+        for (ssize_t written = 0; written < n; ) {
+            ssize_t w = ::write(out, buffer.data() + written, static_cast<size_t>(n - written));
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) { ok = false; break; }
+            written += w;
+        }
+        copied += static_cast<uint64_t>(n);
+    }
+    ::close(in);
+    ::close(out);
+
+    if (!ok || copied != size || std::rename(partPath.c_str(), finalPath.c_str()) != 0) {
+        std::remove(partPath.c_str());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry e;
+    e.localPath = finalPath;
+    e.size = size;
+    e.lastUse = ++tick_;
+    entries_[key] = e;
+    usedBytes_ += size;
+    Logger::instance().log(LogLevel::INFO, "StagingCache: staged " + source + " (" + std::to_string(size >> 10) + " KiB)");
+    return true;
+}
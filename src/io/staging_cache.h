@@ -0,0 +1,86 @@
+#pragma once
+/*
+ staging_cache.h
+
+ Purpose:
+   - Keep local-disk copies of tracks that live on slow mounts (WSL /mnt/<drive>
+     paths served over the 9P bridge, NFS/SMB shares, FUSE filesystems).
+   - A background thread copies the current and upcoming queue entries with
+     large sequential reads, so decoding never stalls on the remote mount.
+   - resolve() hands FFmpegDecoder the local copy once it is complete, and
+     the original path otherwise.
+
+ Design notes:
+   - Cache files are named by a hash of (source path, size, mtime), so a file
+     that changed on the share is never served stale and the index can be
+     rebuilt from the directory listing at startup.
+   - Copies are written to "<name>.part" and renamed when complete; readers
+     never see a partial file.
+   - Eviction is LRU under a byte budget. Entries in the current queue are
+     pinned and never evicted to make room for each other.
+*/
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+class StagingCache {
+public:
+    // directory:   where local copies are kept (created if missing)
+    // budgetBytes: total size the cache may occupy on disk
+    // lookahead:   how many queue entries after the current one to stage
+    StagingCache(const std::string& directory, uint64_t budgetBytes, size_t lookahead = 2);
+    ~StagingCache();
+
+    // Replace the staging queue. queue[0] is the current track; the worker
+    // stages it first, then up to `lookahead` following entries that live on
+    // slow mounts. Copies of entries that dropped out of the queue are cancelled.
+    void setQueue(const std::vector<std::string>& queue);
+
+    // Return the path of a complete local copy of `path`, or `path` itself
+    // if it is not staged (yet).
+    std::string resolve(const std::string& path);
+
+    // True if `path` lives on a mount that benefits from staging.
+    static bool isSlowPath(const std::string& path);
+
+    // Default location: $XDG_CACHE_HOME/music_player/staging (or ~/.cache/...).
+    static std::string defaultDirectory();
+
+    uint64_t usedBytes() const { return usedBytes_.load(); }
+
+private:
+    struct Entry {
+        std::string localPath;
+        uint64_t size;
+        uint64_t lastUse;   // LRU tick
+    };
+
+    void workerLoop();
+    bool stageFile(const std::string& source, const std::string& key, uint64_t size);
+    bool makeRoom(uint64_t bytes);
+    void loadIndex();
+    static bool sourceKey(const std::string& path, std::string& key, uint64_t& size);
+
+private:
+    std::string directory_;
+    uint64_t budgetBytes_;
+    size_t lookahead_;
+
+    std::mutex mutex_;                         // guards everything below
+    std::condition_variable cv_;
+    std::unordered_map<std::string, Entry> entries_;   // key -> complete copy
+    std::vector<std::string> queue_;                   // current staging queue
+    std::vector<std::string> pinned_;                  // keys of queued entries
+    uint64_t tick_;
+    uint64_t queueGeneration_;
+    bool stop_;
+
+    std::atomic<uint64_t> usedBytes_;
+    std::thread worker_;
+};
@@ -0,0 +1,343 @@
+/*
+ library_scanner.cpp
+
+ File enumeration plus the ThreadPool and io_uring metadata backends.
+ See library_scanner.h.
+*/
+
+#include "library_scanner.h"
+#include "tag_reader.h"
+#include "../utils/logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef MUSIC_PLAYER_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Header probes per file (first block + follow-ups for large tags/chunks).
+static constexpr int kMaxProbeRounds = 4;
+
+namespace {
+
+struct ScanJob {
+    TrackInfo info;
+    uint64_t offset = 0;   // next read position
+    int rounds = 0;
+    int fd = -1;
+    bool statted = false;  // size known
+    bool probed = false;   // at least one header block parsed
+    bool done = false;
+};
+
+// Feed one read result (`n` bytes, or a negative error) into the job's
+// probe state machine.
+void advanceProbe(ScanJob& job, const uint8_t* data, long n) {
+    ++job.rounds;
+    if (n <= 0) {
+        job.done = true;
+        return;
+    }
+    job.probed = true;
+    TagProbe probe = probeTrackHeader(data, static_cast<size_t>(n), job.offset, job.info.sizeBytes, job.info);
+    if (probe.status == ProbeStatus::NeedRead && job.rounds < kMaxProbeRounds &&
+        probe.nextOffset != job.offset && probe.nextOffset < job.info.sizeBytes) {
+        job.offset = probe.nextOffset;
+    } else {
+        job.done = true;
+    }
+}
+
+void scanThreadPool(std::vector<ScanJob>& jobs, unsigned threads);
+bool scanIoUring(std::vector<ScanJob>& jobs, unsigned queueDepth);
+
+} // namespace
+
+// -----------------------------
+// Construction / backend selection
+// -----------------------------
+LibraryScanner::LibraryScanner(Backend backend, unsigned threads)
+    : active_(Backend::ThreadPool),
+      threads_(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+    if (backend == Backend::Auto || backend == Backend::IoUring) {
+        if (ioUringAvailable()) {
+            active_ = Backend::IoUring;
+        } else if (backend == Backend::IoUring) {
+            Logger::instance().log(LogLevel::WARNING, "LibraryScanner: io_uring unavailable, using thread pool");
+        }
+    }
+}
+
+const char* LibraryScanner::backendName(Backend backend) {
+    switch (backend) {
+        case Backend::Auto:       return "auto";
+        case Backend::ThreadPool: return "thread-pool";
+        case Backend::IoUring:    return "io_uring";
+    }
+    return "unknown";
+}
+
+bool LibraryScanner::ioUringAvailable() {
+#ifdef MUSIC_PLAYER_HAVE_LIBURING
+    // Kernels without io_uring, or sandboxes that block it (seccomp,
+    // io_uring_disabled sysctl), fail the ring set-up. STATX, OPENAT, READ
+    // and CLOSE only arrived in 5.6 (io_uring itself in 5.1), and so did the
+    // opcode probe: without it, or without one of them, use the pool.
+    static const bool available = [] {
+        struct io_uring ring;
+        if (io_uring_queue_init(2, &ring, 0) < 0) return false;
+        io_uring_queue_exit(&ring);
+        struct io_uring_probe* probe = io_uring_get_probe();
+        if (!probe) return false;
+        const bool supported = io_uring_opcode_supported(probe, IORING_OP_STATX) &&
+            io_uring_opcode_supported(probe, IORING_OP_OPENAT) &&
+            io_uring_opcode_supported(probe, IORING_OP_READ) &&
+            io_uring_opcode_supported(probe, IORING_OP_CLOSE);
+        io_uring_free_probe(probe);
+        return supported;
+    }();
+    return available;
+#else
+    return false;
+#endif
+}
+
+// -----------------------------
+// Enumeration
+// -----------------------------
+std::vector<std::string> LibraryScanner::listAudioFiles(const std::string& root, bool recursive) {
+    std::vector<std::string> files;
+    std::error_code ec;
+    if (fs::is_regular_file(root, ec)) {
+        if (TrackLibrary::formatFromPath(root) != TrackFormat::Unknown) files.push_back(root);
+        return files;
+    }
+
+    auto consider = [&](const fs::directory_entry& entry) {
+        std::error_code fileEc;
+        if (entry.is_regular_file(fileEc) &&
+            TrackLibrary::formatFromPath(entry.path().string()) != TrackFormat::Unknown) {
+            files.push_back(fs::absolute(entry.path(), fileEc).string());
+        }
+    };
+    const auto options = fs::directory_options::skip_permission_denied;
+    if (recursive) {
+        for (auto it = fs::recursive_directory_iterator(root, options, ec);
+             !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            consider(*it);
+        }
+    } else {
+        for (auto it = fs::directory_iterator(root, options, ec);
+             !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            consider(*it);
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// -----------------------------
+// scan()
+// -----------------------------
+size_t LibraryScanner::scan(const std::vector<std::string>& files, TrackLibrary& library) {
+    auto t0 = std::chrono::steady_clock::now();
+
+    std::vector<ScanJob> jobs(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        jobs[i].info.path = files[i];
+        jobs[i].info.format = TrackLibrary::formatFromPath(files[i]);
+    }
+
+    Backend used = active_;
+    if (used == Backend::IoUring && !scanIoUring(jobs, kQueueDepth)) {
+        used = Backend::ThreadPool;
+        for (ScanJob& job : jobs) {
+            std::string path = job.info.path;
+            TrackFormat format = job.info.format;
+            job = ScanJob();
+            job.info.path = path;
+            job.info.format = format;
+        }
+    }
+    if (used == Backend::ThreadPool) {
+        scanThreadPool(jobs, threads_);
+    }
+
+    size_t withMetadata = 0;
+    for (const ScanJob& job : jobs) {
+        if (!job.statted) continue;
+        library.addOrUpdate(job.info);
+        if (job.probed) ++withMetadata;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    Logger::instance().log(LogLevel::INFO, "LibraryScanner: " + std::to_string(files.size()) + " files (" +
+        std::to_string(withMetadata) + " with metadata) in " + std::to_string(static_cast<long>(ms)) +
+        " ms using " + backendName(used));
+    return withMetadata;
+}
+
+// -----------------------------
+// ThreadPool backend
+// -----------------------------
+namespace {
+
+void scanThreadPool(std::vector<ScanJob>& jobs, unsigned threads) {
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        std::vector<uint8_t> buffer(kTagProbeBytes);
+        for (size_t i = next++; i < jobs.size(); i = next++) {
+            ScanJob& job = jobs[i];
+            int fd = ::open(job.info.path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) continue;
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+                job.info.sizeBytes = static_cast<uint64_t>(st.st_size);
+                job.statted = true;
+                while (!job.done) {
+                    ssize_t n = ::pread(fd, buffer.data(), buffer.size(), static_cast<off_t>(job.offset));
+                    advanceProbe(job, buffer.data(), n);
+                }
+            }
+            ::close(fd);
+        }
+    };
+
+    unsigned count = static_cast<unsigned>(std::min<size_t>(threads, jobs.size()));
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < count; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& th : pool) {
+        th.join();
+    }
+}
+
+// -----------------------------
+// io_uring backend
+//   Per batch of kQueueDepth files:
+//     1. statx + openat for every file      (2 SQEs per file)
+//     2. pread rounds until all probes done (1 SQE per pending file)
+//     3. close                              (1 SQE per open file)
+// -----------------------------
+bool scanIoUring(std::vector<ScanJob>& jobs, unsigned queueDepth) {
+#ifdef MUSIC_PLAYER_HAVE_LIBURING
+    struct io_uring ring;
+    if (io_uring_queue_init(queueDepth * 2, &ring, 0) < 0) {
+        return false;
+    }
+
+    std::vector<uint8_t> buffers(static_cast<size_t>(queueDepth) * kTagProbeBytes);
+    std::vector<struct statx> stx(queueDepth);
+
+    // Submit everything queued and reap `expected` completions.
+    auto submitAndReap = [&](unsigned expected, auto&& onComplete) {
+        io_uring_submit(&ring);
+        for (unsigned k = 0; k < expected; ++k) {
+            struct io_uring_cqe* cqe = nullptr;
+            if (io_uring_wait_cqe(&ring, &cqe) < 0) break;
+            onComplete(cqe->user_data, cqe->res);
+            io_uring_cqe_seen(&ring, cqe);
+        }
+    };
+
+    for (size_t base = 0; base < jobs.size(); base += queueDepth) {
+        unsigned batch = static_cast<unsigned>(std::min<size_t>(queueDepth, jobs.size() - base));
+
+        // Stage 1: statx + openat
+        for (unsigned j = 0; j < batch; ++j) {
+            const char* path = jobs[base + j].info.path.c_str();
+            struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+            io_uring_prep_statx(sqe, AT_FDCWD, path, 0, STATX_TYPE | STATX_SIZE, &stx[j]);
+            sqe->user_data = (static_cast<uint64_t>(j) << 1) | 0;
+            sqe = io_uring_get_sqe(&ring);
+            io_uring_prep_openat(sqe, AT_FDCWD, path, O_RDONLY | O_CLOEXEC, 0);
+            sqe->user_data = (static_cast<uint64_t>(j) << 1) | 1;
+        }
+        bool unsupported = false;
+        submitAndReap(batch * 2, [&](uint64_t data, int res) {
+            ScanJob& job = jobs[base + (data >> 1)];
+            unsupported = unsupported || res == -EINVAL || res == -EOPNOTSUPP;
+            if ((data & 1) == 0) {
+                const struct statx& s = stx[data >> 1];
+                if (res == 0 && S_ISREG(s.stx_mode)) {
+                    job.info.sizeBytes = s.stx_size;
+                    job.statted = true;
+                }
+            } else {
+                job.fd = res;   // negative errno on failure
+            }
+        });
+        if (base == 0 && unsupported) {
+            // The kernel rejects the opcodes after all: let scan() redo
+            // everything on the thread pool
+            for (unsigned j = 0; j < batch; ++j) {
+                if (jobs[j].fd >= 0) ::close(jobs[j].fd);
+                jobs[j].fd = -1;
+            }
+            io_uring_queue_exit(&ring);
+            return false;
+        }
+        // Like the thread pool, skip files that can be stat'ed but not
+        // opened (EACCES): they are not added to the library
+        for (unsigned j = 0; j < batch; ++j) {
+            ScanJob& job = jobs[base + j];
+            if (job.fd < 0) job.statted = false;
+        }
+
+        // Stage 2: header reads
+        while (true) {
+            unsigned pending = 0;
+            for (unsigned j = 0; j < batch; ++j) {
+                ScanJob& job = jobs[base + j];
+                if (job.done || job.fd < 0 || !job.statted) continue;
+                struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+                io_uring_prep_read(sqe, job.fd, buffers.data() + static_cast<size_t>(j) * kTagProbeBytes,
+                                   static_cast<unsigned>(kTagProbeBytes), job.offset);
+                sqe->user_data = j;
+                ++pending;
+            }
+            if (pending == 0) break;
+            submitAndReap(pending, [&](uint64_t j, int res) {
+                advanceProbe(jobs[base + j], buffers.data() + j * kTagProbeBytes, res);
+            });
+        }
+
+        // Stage 3: close
+        unsigned opened = 0;
+        for (unsigned j = 0; j < batch; ++j) {
+            ScanJob& job = jobs[base + j];
+            if (job.fd < 0) continue;
+            struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+            io_uring_prep_close(sqe, job.fd);
+            sqe->user_data = j;
+            job.fd = -1;
+            ++opened;
+        }
+        submitAndReap(opened, [](uint64_t, int) {});
+    }
+
+    io_uring_queue_exit(&ring);
+    return true;
+#else
+    (void)jobs;
+    (void)queueDepth;
+    return false;
+#endif
+}
+
+} // namespace
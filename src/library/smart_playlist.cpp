@@ -0,0 +1,600 @@
+/*
+ smart_playlist.cpp
+
+ Rule parser, block-wise predicate evaluator and incremental result
+ maintenance for SmartPlaylist. See smart_playlist.h for the rule syntax.
+*/
+
+#include "smart_playlist.h"
+#include "../utils/logger.h"
+
+#include <fstream>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <type_traits>
+#include <cctype>
+#include <cstdlib>
+
+// Time-relative rules are fully re-evaluated at most this often.
+static constexpr int64_t kTimeRefreshSeconds = 60;
+
+static std::string toLower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return s;
+}
+
+// -----------------------------
+// Tokenizer
+// -----------------------------
+namespace {
+
+struct Token {
+    enum class Type { Word, Number, Op, String, LParen, RParen, End };
+    Type type = Type::End;
+    std::string text;   // word / operator / string contents / number unit
+    double number = 0.0;
+};
+
+bool tokenize(const std::string& rule, std::vector<Token>& tokens, std::string* error) {
+    size_t i = 0;
+    const size_t n = rule.size();
+    while (i < n) {
+        unsigned char c = static_cast<unsigned char>(rule[i]);
+        if (std::isspace(c)) { ++i; continue; }
+
+        Token tok;
+        if (c == '(' || c == ')') {
+            tok.type = (c == '(') ? Token::Type::LParen : Token::Type::RParen;
+            ++i;
+        } else if (c == '"' || c == '\'') {
+            size_t end = rule.find(static_cast<char>(c), i + 1);
+            if (end == std::string::npos) {
+                if (error) *error = "unterminated string";
+                return false;
+            }
+            tok.type = Token::Type::String;
+            tok.text = toLower(rule.substr(i + 1, end - i - 1));
+            i = end + 1;
+        } else if (std::isdigit(c) || (c == '.' && i + 1 < n && std::isdigit(static_cast<unsigned char>(rule[i + 1])))) {
+            size_t start = i;
+            while (i < n && (std::isdigit(static_cast<unsigned char>(rule[i])) || rule[i] == '.')) ++i;
+            tok.type = Token::Type::Number;
+            tok.number = std::strtod(rule.substr(start, i - start).c_str(), nullptr);
+            size_t unitStart = i;
+            while (i < n && std::isalpha(static_cast<unsigned char>(rule[i]))) ++i;
+            tok.text = toLower(rule.substr(unitStart, i - unitStart));
+        } else if (c == '<' || c == '>' || c == '=' || c == '!') {
+            tok.type = Token::Type::Op;
+            tok.text = std::string(1, static_cast<char>(c));
+            ++i;
+            if (i < n && rule[i] == '=') { tok.text += '='; ++i; }
+            if (tok.text == "!") { tok.type = Token::Type::Word; tok.text = "not"; }
+        } else if ((c == '&' || c == '|') && i + 1 < n && rule[i + 1] == static_cast<char>(c)) {
+            tok.type = Token::Type::Word;
+            tok.text = (c == '&') ? "and" : "or";
+            i += 2;
+        } else if (std::isalpha(c) || c == '_') {
+            size_t start = i;
+            while (i < n && (std::isalnum(static_cast<unsigned char>(rule[i])) || rule[i] == '_')) ++i;
+            tok.type = Token::Type::Word;
+            tok.text = toLower(rule.substr(start, i - start));
+        } else {
+            if (error) *error = std::string("unexpected character '") + static_cast<char>(c) + "'";
+            return false;
+        }
+        tokens.push_back(tok);
+    }
+    tokens.push_back(Token());
+    return true;
+}
+
+bool formatFromName(const std::string& word, TrackFormat& out) {
+    static const TrackFormat all[] = {
+        TrackFormat::Wav, TrackFormat::Aiff, TrackFormat::Flac, TrackFormat::Mp3,
+        TrackFormat::Ogg, TrackFormat::Opus, TrackFormat::M4a
+    };
+    for (TrackFormat f : all) {
+        if (word == TrackLibrary::formatName(f)) { out = f; return true; }
+    }
+    if (word == "aif") { out = TrackFormat::Aiff; return true; }
+    if (word == "aac") { out = TrackFormat::M4a; return true; }
+    return false;
+}
+
+bool fieldFromName(const std::string& word, TrackField& out) {
+    if (word == "duration" || word == "length" || word == "time") { out = TrackField::Duration; return true; }
+    if (word == "samplerate" || word == "rate")                   { out = TrackField::SampleRate; return true; }
+    if (word == "channels")                                       { out = TrackField::Channels; return true; }
+    if (word == "bitrate")                                        { out = TrackField::Bitrate; return true; }
+    if (word == "size")                                           { out = TrackField::Size; return true; }
+    if (word == "plays" || word == "playcount")                   { out = TrackField::PlayCount; return true; }
+    if (word == "format")                                         { out = TrackField::Format; return true; }
+    return false;
+}
+
+// Seconds per unit for "played in N <unit>" windows. Default unit is days.
+bool windowUnitSeconds(const std::string& unit, int64_t& out) {
+    if (unit.empty() || unit == "d" || unit == "day" || unit == "days")      { out = 86400; return true; }
+    if (unit == "s" || unit == "sec" || unit == "secs" || unit == "seconds") { out = 1; return true; }
+    if (unit == "min" || unit == "mins" || unit == "minutes")                { out = 60; return true; }
+    if (unit == "h" || unit == "hr" || unit == "hrs" || unit == "hours")     { out = 3600; return true; }
+    if (unit == "w" || unit == "week" || unit == "weeks")                    { out = 7 * 86400; return true; }
+    if (unit == "mo" || unit == "month" || unit == "months")                 { out = 30 * 86400; return true; }
+    if (unit == "y" || unit == "year" || unit == "years")                    { out = 365 * 86400; return true; }
+    return false;
+}
+
+// Scale factor that converts "<n><unit>" to the column's stored unit.
+bool fieldUnitScale(TrackField field, const std::string& unit, double& out) {
+    switch (field) {
+        case TrackField::Duration:
+            if (unit.empty() || unit == "s" || unit == "sec" || unit == "secs" || unit == "seconds") { out = 1000.0; return true; }
+            if (unit == "ms")                                                      { out = 1.0; return true; }
+            if (unit == "m" || unit == "min" || unit == "mins" || unit == "minutes") { out = 60000.0; return true; }
+            if (unit == "h" || unit == "hr" || unit == "hrs" || unit == "hours")     { out = 3600000.0; return true; }
+            return false;
+        case TrackField::Size:
+            if (unit.empty() || unit == "b")  { out = 1.0; return true; }
+            if (unit == "k" || unit == "kb")  { out = 1024.0; return true; }
+            if (unit == "m" || unit == "mb")  { out = 1024.0 * 1024.0; return true; }
+            if (unit == "g" || unit == "gb")  { out = 1024.0 * 1024.0 * 1024.0; return true; }
+            return false;
+        case TrackField::SampleRate:
+            if (unit.empty() || unit == "hz") { out = 1.0; return true; }
+            if (unit == "k" || unit == "khz") { out = 1000.0; return true; }
+            return false;
+        case TrackField::Bitrate:
+            if (unit.empty() || unit == "k" || unit == "kbps") { out = 1.0; return true; }
+            return false;
+        default:
+            out = 1.0;
+            return unit.empty();
+    }
+}
+
+bool isUnitWord(const std::string& word) {
+    double scale;
+    int64_t secs;
+    return windowUnitSeconds(word, secs) ||
+           fieldUnitScale(TrackField::Duration, word, scale) ||
+           fieldUnitScale(TrackField::Size, word, scale) ||
+           fieldUnitScale(TrackField::SampleRate, word, scale);
+}
+
+} // namespace
+
+// -----------------------------
+// Parser (recursive descent -> postfix program)
+// -----------------------------
+class SmartQueryParser {
+public:
+    SmartQueryParser(SmartQuery& query, const std::vector<Token>& tokens)
+        : q_(query), tokens_(tokens), pos_(0), depth_(0) {}
+
+    bool parse(std::string* error) {
+        if (peek().type == Token::Type::End) return fail(error, "empty rule");
+        if (!parseOr(error)) return false;
+        if (peek().type != Token::Type::End) return fail(error, "unexpected '" + peek().text + "'");
+        return true;
+    }
+
+private:
+    const Token& peek() const { return tokens_[pos_]; }
+    const Token& next() { return tokens_[pos_ < tokens_.size() - 1 ? pos_++ : pos_]; }
+    bool peekWord(const char* w) const { return peek().type == Token::Type::Word && peek().text == w; }
+
+    static bool fail(std::string* error, const std::string& msg) {
+        if (error) *error = msg;
+        return false;
+    }
+
+    void emit(SmartQuery::OpCode op, uint32_t leaf = 0) {
+        q_.program_.push_back({ op, leaf });
+        if (op == SmartQuery::OpCode::Leaf) {
+            q_.maxDepth_ = std::max(q_.maxDepth_, ++depth_);
+        } else if (op != SmartQuery::OpCode::Not) {
+            --depth_;
+        }
+    }
+
+    void emitLeaf(const SmartQuery::Predicate& p) {
+        q_.predicates_.push_back(p);
+        if (p.relativeToNow) q_.dependsOnTime_ = true;
+        emit(SmartQuery::OpCode::Leaf, static_cast<uint32_t>(q_.predicates_.size() - 1));
+    }
+
+    bool startsTerm() const {
+        const Token& t = peek();
+        if (t.type == Token::Type::LParen || t.type == Token::Type::String) return true;
+        return t.type == Token::Type::Word && t.text != "and" && t.text != "or";
+    }
+
+    bool parseOr(std::string* error) {
+        if (!parseAnd(error)) return false;
+        while (peekWord("or")) {
+            next();
+            if (!parseAnd(error)) return false;
+            emit(SmartQuery::OpCode::Or);
+        }
+        return true;
+    }
+
+    bool parseAnd(std::string* error) {
+        if (!parseUnary(error)) return false;
+        while (true) {
+            if (peekWord("and")) {
+                next();
+            } else if (!startsTerm()) {
+                break;
+            }
+            if (!parseUnary(error)) return false;
+            emit(SmartQuery::OpCode::And);
+        }
+        return true;
+    }
+
+    bool parseUnary(std::string* error) {
+        if (peekWord("not")) {
+            next();
+            if (!parseUnary(error)) return false;
+            emit(SmartQuery::OpCode::Not);
+            return true;
+        }
+        if (peek().type == Token::Type::LParen) {
+            next();
+            if (!parseOr(error)) return false;
+            if (peek().type != Token::Type::RParen) return fail(error, "missing ')'");
+            next();
+            return true;
+        }
+        return parseTerm(error);
+    }
+
+    // Number token plus an optional detached unit word ("30 days").
+    bool parseQuantity(double& value, std::string& unit, std::string* error) {
+        if (peek().type != Token::Type::Number) return fail(error, "expected a number");
+        const Token& num = next();
+        value = num.number;
+        unit = num.text;
+        if (unit.empty() && peek().type == Token::Type::Word && isUnitWord(peek().text)) {
+            unit = next().text;
+        }
+        return true;
+    }
+
+    bool parseTerm(std::string* error) {
+        const Token& tok = peek();
+        SmartQuery::Predicate p;
+
+        if (tok.type == Token::Type::String) {
+            p.kind = SmartQuery::Predicate::Kind::PathContains;
+            p.text = next().text;
+            emitLeaf(p);
+            return true;
+        }
+        if (tok.type != Token::Type::Word) return fail(error, "expected a term");
+
+        std::string word = next().text;
+        TrackFormat format;
+
+        if (formatFromName(word, format)) {
+            p.field = TrackField::Format;
+            p.op = CompareOp::Equal;
+            p.value = static_cast<int64_t>(format);
+            emitLeaf(p);
+            return true;
+        }
+
+        if (word == "never" || word == "unplayed") {
+            if (word == "never") {
+                if (!peekWord("played")) return fail(error, "expected 'played' after 'never'");
+                next();
+            }
+            p.field = TrackField::PlayCount;
+            p.op = CompareOp::Equal;
+            p.value = 0;
+            emitLeaf(p);
+            return true;
+        }
+
+        if (word == "path") {
+            if (!peekWord("contains")) return fail(error, "expected 'contains' after 'path'");
+            next();
+            if (peek().type != Token::Type::String) return fail(error, "expected a quoted string");
+            p.kind = SmartQuery::Predicate::Kind::PathContains;
+            p.text = next().text;
+            emitLeaf(p);
+            return true;
+        }
+
+        if (word == "played" || word == "added") {
+            if (!peekWord("in") && !peekWord("within")) return fail(error, "expected 'in' after '" + word + "'");
+            next();
+            if (peekWord("last")) next();
+            double amount;
+            std::string unit;
+            int64_t unitSeconds;
+            if (!parseQuantity(amount, unit, error)) return false;
+            if (!windowUnitSeconds(unit, unitSeconds)) return fail(error, "unknown time unit '" + unit + "'");
+            p.field = (word == "played") ? TrackField::LastPlayed : TrackField::AddedAt;
+            p.op = CompareOp::GreaterEqual;
+            p.value = static_cast<int64_t>(amount * static_cast<double>(unitSeconds));
+            p.relativeToNow = true;
+            emitLeaf(p);
+            return true;
+        }
+
+        TrackField field;
+        if (!fieldFromName(word, field)) return fail(error, "unknown term '" + word + "'");
+        if (peek().type != Token::Type::Op) return fail(error, "expected a comparison after '" + word + "'");
+        std::string op = next().text;
+        if      (op == "<")                p.op = CompareOp::Less;
+        else if (op == "<=")               p.op = CompareOp::LessEqual;
+        else if (op == ">")                p.op = CompareOp::Greater;
+        else if (op == ">=")               p.op = CompareOp::GreaterEqual;
+        else if (op == "=" || op == "==")  p.op = CompareOp::Equal;
+        else if (op == "!=")               p.op = CompareOp::NotEqual;
+        else return fail(error, "unknown operator '" + op + "'");
+        p.field = field;
+
+        if (field == TrackField::Format) {
+            if (peek().type != Token::Type::Word || !formatFromName(peek().text, format)) {
+                return fail(error, "expected a format name");
+            }
+            next();
+            p.value = static_cast<int64_t>(format);
+        } else {
+            double amount, scale;
+            std::string unit;
+            if (!parseQuantity(amount, unit, error)) return false;
+            if (!fieldUnitScale(field, unit, scale)) return fail(error, "unknown unit '" + unit + "' for '" + word + "'");
+            p.value = static_cast<int64_t>(amount * scale + 0.5);
+        }
+        emitLeaf(p);
+        return true;
+    }
+
+private:
+    SmartQuery& q_;
+    const std::vector<Token>& tokens_;
+    size_t pos_;
+    size_t depth_;
+};
+
+// -----------------------------
+// SmartQuery
+// -----------------------------
+SmartQuery::SmartQuery()
+    : maxDepth_(0),
+      dependsOnTime_(false)
+{}
+
+bool SmartQuery::compile(const std::string& rule, std::string* error) {
+    predicates_.clear();
+    program_.clear();
+    maxDepth_ = 0;
+    dependsOnTime_ = false;
+
+    std::vector<Token> tokens;
+    if (!tokenize(rule, tokens, error)) return false;
+
+    SmartQueryParser parser(*this, tokens);
+    if (!parser.parse(error)) {
+        predicates_.clear();
+        program_.clear();
+        return false;
+    }
+
+    stack_.assign(maxDepth_ * kBlockRows, 0);
+    return true;
+}
+
+// Compare a typed column against `v`. Values outside T's range are folded to
+// a constant result so the loop itself compares at T's native width, which
+// keeps u8/u32 columns at full SIMD width.
+template <typename T>
+static void compareColumn(const T* col, size_t n, CompareOp op, int64_t v, uint8_t* out) {
+    bool below = v < static_cast<int64_t>(std::numeric_limits<T>::min());
+    bool above = false;
+    if (sizeof(T) < sizeof(int64_t)) {
+        above = v > static_cast<int64_t>(std::numeric_limits<T>::max());
+    }
+    if (below || above) {
+        bool colGreater = below;  // every column value is greater than v
+        bool result = false;
+        switch (op) {
+            case CompareOp::Less:         result = !colGreater; break;
+            case CompareOp::LessEqual:    result = !colGreater; break;
+            case CompareOp::Greater:      result = colGreater; break;
+            case CompareOp::GreaterEqual: result = colGreater; break;
+            case CompareOp::Equal:        result = false; break;
+            case CompareOp::NotEqual:     result = true; break;
+        }
+        std::fill(out, out + n, static_cast<uint8_t>(result));
+        return;
+    }
+
+    const T t = static_cast<T>(v);
+    switch (op) {
+        case CompareOp::Less:         for (size_t i = 0; i < n; ++i) out[i] = col[i] <  t; break;
+        case CompareOp::LessEqual:    for (size_t i = 0; i < n; ++i) out[i] = col[i] <= t; break;
+        case CompareOp::Greater:      for (size_t i = 0; i < n; ++i) out[i] = col[i] >  t; break;
+        case CompareOp::GreaterEqual: for (size_t i = 0; i < n; ++i) out[i] = col[i] >= t; break;
+        case CompareOp::Equal:        for (size_t i = 0; i < n; ++i) out[i] = col[i] == t; break;
+        case CompareOp::NotEqual:     for (size_t i = 0; i < n; ++i) out[i] = col[i] != t; break;
+    }
+}
+
+void SmartQuery::evaluatePredicate(const Predicate& p, const TrackLibrary& library,
+                                   size_t begin, size_t count, int64_t now, uint8_t* out) const {
+    if (p.kind == Predicate::Kind::PathContains) {
+        const auto& paths = library.pathColumn();
+        auto ieq = [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) == static_cast<unsigned char>(b);
+        };
+        for (size_t i = 0; i < count; ++i) {
+            const std::string& s = paths[begin + i];
+            out[i] = std::search(s.begin(), s.end(), p.text.begin(), p.text.end(), ieq) != s.end();
+        }
+        return;
+    }
+
+    int64_t value = p.relativeToNow ? now - p.value : p.value;
+    ColumnView col = library.column(p.field);
+    switch (col.type) {
+        case ColumnView::Type::U8:
+            compareColumn(static_cast<const uint8_t*>(col.data) + begin, count, p.op, value, out);
+            break;
+        case ColumnView::Type::U32:
+            compareColumn(static_cast<const uint32_t*>(col.data) + begin, count, p.op, value, out);
+            break;
+        case ColumnView::Type::U64:
+            compareColumn(static_cast<const uint64_t*>(col.data) + begin, count, p.op, value, out);
+            break;
+        case ColumnView::Type::I64:
+            compareColumn(static_cast<const int64_t*>(col.data) + begin, count, p.op, value, out);
+            break;
+    }
+}
+
+void SmartQuery::evaluateBlock(const TrackLibrary& library, size_t begin, size_t count,
+                               int64_t now, uint8_t* out) const {
+    uint8_t* base = stack_.data();
+    size_t sp = 0;
+
+    for (const Instr& ins : program_) {
+        switch (ins.op) {
+            case OpCode::Leaf:
+                evaluatePredicate(predicates_[ins.leaf], library, begin, count, now, base + sp * kBlockRows);
+                ++sp;
+                break;
+            case OpCode::And: {
+                uint8_t* a = base + (sp - 2) * kBlockRows;
+                const uint8_t* b = base + (sp - 1) * kBlockRows;
+                for (size_t i = 0; i < count; ++i) a[i] &= b[i];
+                --sp;
+                break;
+            }
+            case OpCode::Or: {
+                uint8_t* a = base + (sp - 2) * kBlockRows;
+                const uint8_t* b = base + (sp - 1) * kBlockRows;
+                for (size_t i = 0; i < count; ++i) a[i] |= b[i];
+                --sp;
+                break;
+            }
+            case OpCode::Not: {
+                uint8_t* a = base + (sp - 1) * kBlockRows;
+                for (size_t i = 0; i < count; ++i) a[i] ^= 1;
+                break;
+            }
+        }
+    }
+
+    const uint8_t* live = library.liveColumn() + begin;
+    for (size_t i = 0; i < count; ++i) out[i] = base[i] & live[i];
+}
+
+void SmartQuery::evaluate(const TrackLibrary& library, size_t begin, size_t count,
+                          int64_t now, uint8_t* out) const {
+    if (program_.empty()) {
+        std::fill(out, out + count, static_cast<uint8_t>(0));
+        return;
+    }
+    for (size_t done = 0; done < count; done += kBlockRows) {
+        size_t n = std::min(kBlockRows, count - done);
+        evaluateBlock(library, begin + done, n, now, out + done);
+    }
+}
+
+// -----------------------------
+// SmartPlaylist
+// -----------------------------
+SmartPlaylist::SmartPlaylist(const std::string& name, const std::string& rule)
+    : name_(name),
+      rule_(rule),
+      count_(0),
+      cursor_(0),
+      synced_(false),
+      evaluatedAt_(0),
+      tracksDirty_(true)
+{
+    if (!query_.compile(rule_, &error_)) {
+        Logger::instance().log(LogLevel::WARNING, "SmartPlaylist: '" + name_ + "' has an invalid rule: " + error_);
+    }
+}
+
+void SmartPlaylist::evaluateAll(const TrackLibrary& library, int64_t now) {
+    member_.assign(library.rowCount(), 0);
+    query_.evaluate(library, 0, member_.size(), now, member_.data());
+    count_ = std::accumulate(member_.begin(), member_.end(), size_t(0));
+    cursor_ = library.changeCursor();
+    synced_ = true;
+    evaluatedAt_ = now;
+    tracksDirty_ = true;
+}
+
+void SmartPlaylist::refresh(const TrackLibrary& library, int64_t now) {
+    if (!isValid()) return;
+
+    bool full = !synced_ || (query_.dependsOnTime() && now - evaluatedAt_ >= kTimeRefreshSeconds);
+    if (!full && !library.changesSince(cursor_, changed_)) full = true;
+    // A bulk import touches most rows; one block-wise pass is cheaper than
+    // replaying row by row.
+    if (!full && changed_.size() > SmartQuery::kBlockRows && changed_.size() > library.rowCount() / 8) full = true;
+
+    if (full) {
+        evaluateAll(library, now);
+        return;
+    }
+    if (changed_.empty()) return;
+
+    member_.resize(library.rowCount(), 0);
+    for (TrackId id : changed_) {
+        uint8_t match = 0;
+        query_.evaluate(library, id, 1, now, &match);
+        if (match != member_[id]) {
+            member_[id] = match;
+            if (match) ++count_; else --count_;
+            tracksDirty_ = true;
+        }
+    }
+    cursor_ = library.changeCursor();
+}
+
+const std::vector<TrackId>& SmartPlaylist::tracks() {
+    if (tracksDirty_) {
+        tracks_.clear();
+        tracks_.reserve(count_);
+        for (size_t i = 0; i < member_.size(); ++i) {
+            if (member_[i]) tracks_.push_back(static_cast<TrackId>(i));
+        }
+        tracksDirty_ = false;
+    }
+    return tracks_;
+}
+
+// -----------------------------
+// Persistence
+// -----------------------------
+bool loadSmartPlaylists(const std::string& filename, std::vector<SmartPlaylist>& out) {
+    std::ifstream in(filename);
+    if (!in.is_open()) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t tab = line.find('\t');
+        if (line.empty() || tab == std::string::npos) continue;
+        out.emplace_back(line.substr(0, tab), line.substr(tab + 1));
+    }
+    return true;
+}
+
+bool saveSmartPlaylists(const std::string& filename, const std::vector<SmartPlaylist>& lists) {
+    std::ofstream out(filename);
+    if (!out.is_open()) return false;
+    for (const auto& list : lists) {
+        out << list.name() << '\t' << list.rule() << '\n';
+    }
+    return true;
+}
@@ -0,0 +1,139 @@
+#pragma once
+/*
+ smart_playlist.h
+
+ Purpose:
+   - Rule-based ("smart") playlists evaluated against TrackLibrary columns.
+   - A rule such as
+
+         flac AND duration > 10min AND NOT played in 30 days
+
+     is parsed once into a small postfix program (SmartQuery). Evaluation runs
+     over blocks of rows: every leaf predicate is a tight loop over one column
+     that writes a byte mask, and AND/OR/NOT combine masks byte-wise. Both
+     loops are branch-free and auto-vectorize.
+   - SmartPlaylist keeps the membership mask and replays only the rows the
+     library reports as changed, so results stay current without rescanning
+     millions of tracks on every edit.
+
+ Rule syntax (case-insensitive):
+   term     := <format>                      flac, mp3, wav, aiff, ogg, opus, m4a
+             | <field> <op> <value>[unit]    duration > 10min, size >= 20mb,
+                                             samplerate >= 96k, channels = 2,
+                                             bitrate < 192, plays > 3
+             | played in <n>[unit]           last played within the window
+             | added in <n>[unit]            added to the library within the window
+             | never played
+             | "text"  /  path contains "text"
+   expr     := term | NOT expr | expr AND expr | expr OR expr | ( expr )
+   Adjacent terms without an operator are ANDed.
+   Units: ms s min h d w (time), kb mb gb (size), k (rates).
+
+ Notes:
+   - Not thread-safe: a SmartQuery owns scratch buffers reused between calls.
+   - Rules with "played in" / "added in" depend on the wall clock; they are
+     fully re-evaluated at most once a minute in addition to incremental updates.
+*/
+
+#include "track_library.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+enum class CompareOp : uint8_t { Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual };
+
+class SmartQuery {
+public:
+    SmartQuery();
+
+    // Parse and compile `rule`. On failure returns false and fills `error`.
+    bool compile(const std::string& rule, std::string* error);
+
+    // Evaluate rows [begin, begin + count) into `out` (1 = match, 0 = no
+    // match). Removed rows never match. `now` is used for time-relative terms.
+    void evaluate(const TrackLibrary& library, size_t begin, size_t count,
+                  int64_t now, uint8_t* out) const;
+
+    bool isCompiled() const { return !program_.empty(); }
+    bool dependsOnTime() const { return dependsOnTime_; }
+
+    // Rows evaluated per block; sized so the mask stack stays in L1/L2.
+    static constexpr size_t kBlockRows = 4096;
+
+private:
+    friend class SmartQueryParser;
+
+    struct Predicate {
+        enum class Kind : uint8_t { Compare, PathContains };
+        Kind kind = Kind::Compare;
+        TrackField field = TrackField::Format;
+        CompareOp op = CompareOp::Equal;
+        int64_t value = 0;           // compared value, or window length in seconds
+        bool relativeToNow = false;  // value is "now - value" at evaluation time
+        std::string text;            // PathContains needle (lower-case)
+    };
+
+    enum class OpCode : uint8_t { Leaf, And, Or, Not };
+    struct Instr {
+        OpCode op;
+        uint32_t leaf;  // index into predicates_ for OpCode::Leaf
+    };
+
+    void evaluateBlock(const TrackLibrary& library, size_t begin, size_t count,
+                       int64_t now, uint8_t* out) const;
+    void evaluatePredicate(const Predicate& p, const TrackLibrary& library,
+                           size_t begin, size_t count, int64_t now, uint8_t* out) const;
+
+    std::vector<Predicate> predicates_;
+    std::vector<Instr> program_;   // postfix
+    size_t maxDepth_;
+    bool dependsOnTime_;
+
+    mutable std::vector<uint8_t> stack_;  // maxDepth_ * kBlockRows scratch masks
+};
+
+class SmartPlaylist {
+public:
+    SmartPlaylist(const std::string& name, const std::string& rule);
+
+    const std::string& name() const { return name_; }
+    const std::string& rule() const { return rule_; }
+    bool isValid() const { return query_.isCompiled(); }
+    const std::string& error() const { return error_; }
+
+    // Bring the result set up to date with `library`. Replays the library's
+    // change log when possible; falls back to a full evaluation when the log
+    // was compacted, a bulk change touched a large share of rows, or
+    // time-relative terms are more than a minute stale.
+    void refresh(const TrackLibrary& library, int64_t now);
+
+    // Number of matching tracks as of the last refresh().
+    size_t size() const { return count_; }
+
+    // Matching track ids in library order (materialized lazily).
+    const std::vector<TrackId>& tracks();
+
+private:
+    void evaluateAll(const TrackLibrary& library, int64_t now);
+
+    std::string name_;
+    std::string rule_;
+    std::string error_;
+    SmartQuery query_;
+
+    std::vector<uint8_t> member_;   // one byte per library row
+    size_t count_;
+    uint64_t cursor_;               // library change cursor we are synced to
+    bool synced_;
+    int64_t evaluatedAt_;           // `now` of the last full evaluation
+
+    std::vector<TrackId> changed_;  // scratch for change-log replay
+    std::vector<TrackId> tracks_;
+    bool tracksDirty_;
+};
+
+// Saved smart playlists: one "name<TAB>rule" per line.
+bool loadSmartPlaylists(const std::string& filename, std::vector<SmartPlaylist>& out);
+bool saveSmartPlaylists(const std::string& filename, const std::vector<SmartPlaylist>& lists);
@@ -0,0 +1,309 @@
+/*
+ tag_reader.cpp
+
+ Header parsers for the formats listed in tag_reader.h. Every parser works
+ on a bounded byte block and never reads past `n`.
+*/
+
+#include "tag_reader.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+// -----------------------------
+// Byte helpers
+// -----------------------------
+static inline uint32_t le16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+static inline uint32_t le32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24); }
+static inline uint64_t le64(const uint8_t* p) { return le32(p) | (static_cast<uint64_t>(le32(p + 4)) << 32); }
+static inline uint32_t be16(const uint8_t* p) { return (p[0] << 8) | p[1]; }
+static inline uint32_t be32(const uint8_t* p) { return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+
+static inline TagProbe done() { return { ProbeStatus::Done, 0 }; }
+static inline TagProbe needRead(uint64_t offset) { return { ProbeStatus::NeedRead, offset }; }
+static inline TagProbe unsupported() { return { ProbeStatus::Unsupported, 0 }; }
+
+static void setDuration(TrackInfo& info, double seconds) {
+    if (seconds <= 0.0) return;
+    info.durationMs = static_cast<uint32_t>(std::min(seconds * 1000.0, 4294967295.0));
+    if (info.bitrateKbps == 0 && info.sizeBytes > 0) {
+        info.bitrateKbps = static_cast<uint32_t>(static_cast<double>(info.sizeBytes) * 8.0 / seconds / 1000.0);
+    }
+}
+
+// -----------------------------
+// WAV (RIFF / RF64)
+// -----------------------------
+static TagProbe probeWav(const uint8_t* d, size_t n, uint64_t offset, uint64_t fileSize, TrackInfo& info) {
+    size_t pos = 0;
+    if (offset == 0) {
+        if (n < 12 || (std::memcmp(d, "RIFF", 4) != 0 && std::memcmp(d, "RF64", 4) != 0) ||
+            std::memcmp(d + 8, "WAVE", 4) != 0) {
+            return unsupported();
+        }
+        pos = 12;
+    }
+
+    uint64_t ds64DataSize = 0;
+    uint32_t byteRate = 0;
+    while (pos + 8 <= n) {
+        const uint8_t* c = d + pos;
+        uint64_t size = le32(c + 4);
+        if (std::memcmp(c, "ds64", 4) == 0 && pos + 8 + 16 <= n) {
+            ds64DataSize = le64(c + 16);
+        } else if (std::memcmp(c, "fmt ", 4) == 0) {
+            if (pos + 8 + 16 > n) return needRead(offset + pos);
+            info.channels = static_cast<uint8_t>(le16(c + 10));
+            info.sampleRate = le32(c + 12);
+            byteRate = le32(c + 16);
+            info.bitrateKbps = byteRate * 8 / 1000;
+        } else if (std::memcmp(c, "data", 4) == 0) {
+            if (size == 0xFFFFFFFFULL && ds64DataSize) size = ds64DataSize;
+            uint64_t dataStart = offset + pos + 8;
+            if (fileSize > dataStart) size = std::min(size, fileSize - dataStart);
+            if (byteRate) {
+                setDuration(info, static_cast<double>(size) / byteRate);
+            } else if (info.bitrateKbps) {
+                setDuration(info, static_cast<double>(size) * 8.0 / (info.bitrateKbps * 1000.0));
+            }
+            return done();
+        }
+        uint64_t next = pos + 8 + size + (size & 1);
+        if (next >= n) {
+            uint64_t abs = offset + next;
+            return abs + 8 <= fileSize ? needRead(abs) : done();
+        }
+        pos = static_cast<size_t>(next);
+    }
+    return offset + pos + 8 <= fileSize ? needRead(offset + pos) : done();
+}
+
+// -----------------------------
+// AIFF / AIFC
+// -----------------------------
+static double extended80(const uint8_t* p) {
+    int exponent = static_cast<int>(be16(p) & 0x7FFF);
+    uint64_t mantissa = (static_cast<uint64_t>(be32(p + 2)) << 32) | be32(p + 6);
+    if (exponent == 0 && mantissa == 0) return 0.0;
+    double v = std::ldexp(static_cast<double>(mantissa), exponent - 16383 - 63);
+    return (p[0] & 0x80) ? -v : v;
+}
+
+static TagProbe probeAiff(const uint8_t* d, size_t n, uint64_t offset, uint64_t fileSize, TrackInfo& info) {
+    size_t pos = 0;
+    if (offset == 0) {
+        if (n < 12 || std::memcmp(d, "FORM", 4) != 0 ||
+            (std::memcmp(d + 8, "AIFF", 4) != 0 && std::memcmp(d + 8, "AIFC", 4) != 0)) {
+            return unsupported();
+        }
+        pos = 12;
+    }
+    while (pos + 8 <= n) {
+        const uint8_t* c = d + pos;
+        uint64_t size = be32(c + 4);
+        if (std::memcmp(c, "COMM", 4) == 0) {
+            if (pos + 8 + 18 > n) return needRead(offset + pos);
+            info.channels = static_cast<uint8_t>(be16(c + 8));
+            uint32_t frames = be32(c + 10);
+            uint32_t bits = be16(c + 14);
+            double rate = extended80(c + 16);
+            if (rate > 0.0) {
+                info.sampleRate = static_cast<uint32_t>(rate + 0.5);
+                info.bitrateKbps = static_cast<uint32_t>(rate * info.channels * bits / 1000.0);
+                setDuration(info, frames / rate);
+            }
+            return done();
+        }
+        uint64_t next = pos + 8 + size + (size & 1);
+        if (next >= n) {
+            uint64_t abs = offset + next;
+            return abs + 8 <= fileSize ? needRead(abs) : done();
+        }
+        pos = static_cast<size_t>(next);
+    }
+    return done();
+}
+
+// -----------------------------
+// FLAC
+// -----------------------------
+static TagProbe probeFlac(const uint8_t* d, size_t n, TrackInfo& info) {
+    if (n < 4 + 4 + 18 || std::memcmp(d, "fLaC", 4) != 0 || (d[4] & 0x7F) != 0) {
+        return unsupported();
+    }
+    const uint8_t* s = d + 8;   // STREAMINFO body
+    uint32_t sampleRate = (static_cast<uint32_t>(s[10]) << 12) | (s[11] << 4) | (s[12] >> 4);
+    uint32_t channels = ((s[12] >> 1) & 0x07) + 1;
+    uint64_t totalSamples = (static_cast<uint64_t>(s[13] & 0x0F) << 32) | be32(s + 14);
+    info.sampleRate = sampleRate;
+    info.channels = static_cast<uint8_t>(channels);
+    if (sampleRate > 0 && totalSamples > 0) {
+        setDuration(info, static_cast<double>(totalSamples) / sampleRate);
+    }
+    return done();
+}
+
+// -----------------------------
+// MP3
+// -----------------------------
+struct Mp3Header {
+    int version;          // 1 = MPEG1, 2 = MPEG2, 25 = MPEG2.5
+    int layer;            // 1..3
+    uint32_t bitrate;     // bit/s
+    uint32_t sampleRate;
+    int channels;
+    uint32_t frameBytes;
+    uint32_t samplesPerFrame;
+};
+
+static bool parseMp3Header(const uint8_t* p, Mp3Header& h) {
+    static const uint16_t kBitrates[5][16] = {
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0 },  // V1 L1
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 0 },     // V1 L2
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 },      // V1 L3
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0 },     // V2 L1
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 }           // V2 L2/L3
+    };
+    static const uint32_t kRates[3] = { 44100, 48000, 32000 };
+
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) return false;
+    int versionBits = (p[1] >> 3) & 3;
+    int layerBits = (p[1] >> 1) & 3;
+    int bitrateIdx = p[2] >> 4;
+    int rateIdx = (p[2] >> 2) & 3;
+    if (versionBits == 1 || layerBits == 0 || bitrateIdx == 0 || bitrateIdx == 15 || rateIdx == 3) return false;
+
+    h.version = versionBits == 3 ? 1 : (versionBits == 2 ? 2 : 25);
+    h.layer = 4 - layerBits;
+    int table = h.version == 1 ? h.layer - 1 : (h.layer == 1 ? 3 : 4);
+    h.bitrate = kBitrates[table][bitrateIdx] * 1000u;
+    h.sampleRate = kRates[rateIdx] >> (h.version == 1 ? 0 : (h.version == 2 ? 1 : 2));
+    h.channels = ((p[3] >> 6) == 3) ? 1 : 2;
+    int padding = (p[2] >> 1) & 1;
+
+    if (h.layer == 1) {
+        h.samplesPerFrame = 384;
+        h.frameBytes = (12 * h.bitrate / h.sampleRate + padding) * 4;
+    } else {
+        h.samplesPerFrame = (h.layer == 3 && h.version != 1) ? 576 : 1152;
+        h.frameBytes = h.samplesPerFrame / 8 * h.bitrate / h.sampleRate + padding;
+    }
+    return h.frameBytes > 4;
+}
+
+static TagProbe probeMp3(const uint8_t* d, size_t n, uint64_t offset, uint64_t fileSize, TrackInfo& info) {
+    for (size_t i = 0; i + 4 <= n; ++i) {
+        Mp3Header h;
+        if (!parseMp3Header(d + i, h)) continue;
+
+        // Require a second sync where the next frame should start, unless it
+        // lies beyond this block, to skip false syncs inside tag data.
+        size_t nextFrame = i + h.frameBytes;
+        Mp3Header h2;
+        if (nextFrame + 4 <= n && !parseMp3Header(d + nextFrame, h2)) continue;
+
+        info.sampleRate = h.sampleRate;
+        info.channels = static_cast<uint8_t>(h.channels);
+
+        // Xing / Info (VBR frame count) follows the side information.
+        size_t sideInfo = (h.version == 1) ? (h.channels == 1 ? 17 : 32) : (h.channels == 1 ? 9 : 17);
+        size_t xing = i + 4 + sideInfo;
+        uint32_t frames = 0;
+        if (xing + 12 <= n && (std::memcmp(d + xing, "Xing", 4) == 0 || std::memcmp(d + xing, "Info", 4) == 0)) {
+            if (be32(d + xing + 4) & 1) frames = be32(d + xing + 8);
+        } else if (i + 36 + 18 <= n && std::memcmp(d + i + 36, "VBRI", 4) == 0) {
+            frames = be32(d + i + 36 + 14);
+        }
+
+        uint64_t audioStart = offset + i;
+        uint64_t audioBytes = fileSize > audioStart ? fileSize - audioStart : 0;
+        if (frames > 0) {
+            double seconds = static_cast<double>(frames) * h.samplesPerFrame / h.sampleRate;
+            info.bitrateKbps = static_cast<uint32_t>(audioBytes * 8.0 / seconds / 1000.0);
+            setDuration(info, seconds);
+        } else {
+            info.bitrateKbps = h.bitrate / 1000;
+            setDuration(info, audioBytes * 8.0 / h.bitrate);
+        }
+        return done();
+    }
+    return done();
+}
+
+// -----------------------------
+// Ogg (Vorbis / Opus)
+// -----------------------------
+static TagProbe probeOggTail(const uint8_t* d, size_t n, TrackInfo& info) {
+    // The last page's granule position is the stream length in samples.
+    for (size_t i = n >= 27 ? n - 27 : 0; ; --i) {
+        if (std::memcmp(d + i, "OggS", 4) == 0) {
+            uint64_t granule = le64(d + i + 6);
+            double rate = (info.format == TrackFormat::Opus) ? 48000.0 : info.sampleRate;
+            if (rate > 0.0 && granule != ~0ULL) {
+                setDuration(info, static_cast<double>(granule) / rate);
+            }
+            return done();
+        }
+        if (i == 0) break;
+    }
+    return done();
+}
+
+static TagProbe probeOgg(const uint8_t* d, size_t n, uint64_t offset, uint64_t fileSize, TrackInfo& info) {
+    if (offset > 0) {
+        return n >= 27 ? probeOggTail(d, n, info) : done();
+    }
+    if (n < 28 || std::memcmp(d, "OggS", 4) != 0) return unsupported();
+    size_t segments = d[26];
+    size_t packet = 27 + segments;
+    if (packet + 19 > n) return done();
+
+    const uint8_t* p = d + packet;
+    if (std::memcmp(p, "\x01vorbis", 7) == 0 && packet + 28 <= n) {
+        info.channels = p[11];
+        info.sampleRate = le32(p + 12);
+        uint32_t nominal = le32(p + 20);
+        if (nominal > 0 && nominal < 0x7FFFFFFF) info.bitrateKbps = nominal / 1000;
+    } else if (std::memcmp(p, "OpusHead", 8) == 0) {
+        info.format = TrackFormat::Opus;   // Opus in a .ogg container
+        info.channels = p[9];
+        info.sampleRate = le32(p + 12);    // original input rate; decoding is at 48 kHz
+    } else {
+        return done();
+    }
+
+    if (fileSize > n) {
+        return needRead(fileSize > kTagProbeBytes ? fileSize - kTagProbeBytes : 0);
+    }
+    return probeOggTail(d, n, info);
+}
+
+// -----------------------------
+// Entry point
+// -----------------------------
+TagProbe probeTrackHeader(const uint8_t* data, size_t n, uint64_t offset,
+                          uint64_t fileSize, TrackInfo& info) {
+    // ID3v2 can prefix MP3 and (non-conforming but common) FLAC files.
+    if (offset == 0 && n >= 10 && std::memcmp(data, "ID3", 3) == 0) {
+        uint64_t tagSize = ((data[6] & 0x7F) << 21) | ((data[7] & 0x7F) << 14) |
+                           ((data[8] & 0x7F) << 7) | (data[9] & 0x7F);
+        tagSize += 10 + ((data[5] & 0x10) ? 10 : 0);
+        if (tagSize >= fileSize) return done();
+        if (tagSize + 10 > n) return needRead(tagSize);
+        return probeTrackHeader(data + tagSize, n - tagSize, tagSize, fileSize, info);
+    }
+
+    switch (info.format) {
+        case TrackFormat::Wav:  return probeWav(data, n, offset, fileSize, info);
+        case TrackFormat::Aiff: return probeAiff(data, n, offset, fileSize, info);
+        case TrackFormat::Flac:
+            // A FLAC stream after an ID3v2 tag is probed at the tag's end.
+            return probeFlac(data, n, info);
+        case TrackFormat::Mp3:  return probeMp3(data, n, offset, fileSize, info);
+        case TrackFormat::Ogg:
+        case TrackFormat::Opus: return probeOgg(data, n, offset, fileSize, info);
+        default:
+            return unsupported();
+    }
+}
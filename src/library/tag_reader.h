@@ -0,0 +1,46 @@
+#pragma once
+/*
+ tag_reader.h
+
+ Purpose:
+   - Extract technical metadata (duration, sample rate, channels, bitrate)
+     from the first bytes of an audio file without opening a decoder.
+   - The reader is a pure function over a byte block so that the library
+     scanner can feed it from any I/O backend (thread pool + pread, or
+     batched io_uring reads).
+
+ Protocol:
+   - The caller reads `n` bytes at `offset` (starting at 0) and calls
+     probeTrackHeader(). If the metadata lies further into the file (large
+     ID3v2 tag, WAV chunks after a big LIST chunk, Ogg end-of-stream granule),
+     the result asks for another read at `nextOffset`.
+
+ Supported: WAV (RIFF/RF64 fmt+data), AIFF/AIFC (COMM), FLAC (STREAMINFO),
+            MP3 (ID3v2 skip, frame header, Xing/Info/VBRI frame count),
+            Ogg Vorbis/Opus (identification header + last granule).
+*/
+
+#include "track_library.h"
+
+#include <cstdint>
+#include <cstddef>
+
+enum class ProbeStatus {
+    Done,          // metadata filled in (as far as the format allows)
+    NeedRead,      // read again at nextOffset and call probe again
+    Unsupported    // unknown format; only path/format/size are known
+};
+
+struct TagProbe {
+    ProbeStatus status;
+    uint64_t nextOffset;
+};
+
+// Bytes a scanner should read per probe round.
+constexpr size_t kTagProbeBytes = 16 * 1024;
+
+// Inspect `n` bytes read from `offset` of a file of `fileSize` bytes and fill
+// the technical fields of `info`. `info.format` must already be set from the
+// path (TrackLibrary::formatFromPath); it selects follow-up parsing.
+TagProbe probeTrackHeader(const uint8_t* data, size_t n, uint64_t offset,
+                          uint64_t fileSize, TrackInfo& info);
@@ -0,0 +1,245 @@
+/*
+ track_library.cpp
+
+ Column-oriented track metadata store. See track_library.h for the layout and
+ the change-log contract used by SmartPlaylist.
+*/
+
+#include "track_library.h"
+#include "../utils/logger.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <chrono>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+static int64_t nowSeconds() {
+    using namespace std::chrono;
+    return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+}
+
+TrackLibrary::TrackLibrary()
+    : liveCount_(0),
+      logBase_(0)
+{}
+
+// -----------------------------
+// Row management
+// -----------------------------
+TrackId TrackLibrary::appendRow(const std::string& path) {
+    TrackId id = static_cast<TrackId>(paths_.size());
+    paths_.push_back(path);
+    format_.push_back(static_cast<uint8_t>(TrackFormat::Unknown));
+    durationMs_.push_back(0);
+    sampleRate_.push_back(0);
+    channels_.push_back(0);
+    bitrateKbps_.push_back(0);
+    sizeBytes_.push_back(0);
+    playCount_.push_back(0);
+    lastPlayed_.push_back(0);
+    addedAt_.push_back(nowSeconds());
+    live_.push_back(1);
+    index_.emplace(path, id);
+    ++liveCount_;
+    return id;
+}
+
+void TrackLibrary::touch(TrackId id) {
+    changeLog_.push_back(id);
+}
+
+TrackId TrackLibrary::addOrUpdate(const TrackInfo& info) {
+    TrackId id;
+    auto it = index_.find(info.path);
+    if (it == index_.end()) {
+        id = appendRow(info.path);
+    } else {
+        id = it->second;
+        if (!live_[id]) {
+            live_[id] = 1;
+            ++liveCount_;
+        }
+    }
+
+    if (info.format != TrackFormat::Unknown) format_[id] = static_cast<uint8_t>(info.format);
+    if (info.durationMs)  durationMs_[id] = info.durationMs;
+    if (info.sampleRate)  sampleRate_[id] = info.sampleRate;
+    if (info.channels)    channels_[id] = info.channels;
+    if (info.bitrateKbps) bitrateKbps_[id] = info.bitrateKbps;
+    if (info.sizeBytes)   sizeBytes_[id] = info.sizeBytes;
+
+    touch(id);
+    return id;
+}
+
+TrackId TrackLibrary::addPath(const std::string& path) {
+    TrackInfo info;
+    info.path = path;
+    info.format = formatFromPath(path);
+    std::error_code ec;
+    auto size = fs::file_size(path, ec);
+    if (!ec) info.sizeBytes = static_cast<uint64_t>(size);
+    return addOrUpdate(info);
+}
+
+bool TrackLibrary::remove(const std::string& path) {
+    auto it = index_.find(path);
+    if (it == index_.end() || !live_[it->second]) return false;
+    live_[it->second] = 0;
+    --liveCount_;
+    touch(it->second);
+    return true;
+}
+
+int64_t TrackLibrary::find(const std::string& path) const {
+    auto it = index_.find(path);
+    if (it == index_.end() || !live_[it->second]) return -1;
+    return it->second;
+}
+
+void TrackLibrary::markPlayed(TrackId id, int64_t when) {
+    if (id >= paths_.size()) return;
+    lastPlayed_[id] = when;
+    ++playCount_[id];
+    touch(id);
+}
+
+void TrackLibrary::setDuration(TrackId id, uint32_t durationMs) {
+    if (id >= paths_.size() || durationMs_[id] == durationMs) return;
+    durationMs_[id] = durationMs;
+    touch(id);
+}
+
+ColumnView TrackLibrary::column(TrackField field) const {
+    switch (field) {
+        case TrackField::Format:     return { ColumnView::Type::U8,  format_.data() };
+        case TrackField::Duration:   return { ColumnView::Type::U32, durationMs_.data() };
+        case TrackField::SampleRate: return { ColumnView::Type::U32, sampleRate_.data() };
+        case TrackField::Channels:   return { ColumnView::Type::U8,  channels_.data() };
+        case TrackField::Bitrate:    return { ColumnView::Type::U32, bitrateKbps_.data() };
+        case TrackField::Size:       return { ColumnView::Type::U64, sizeBytes_.data() };
+        case TrackField::PlayCount:  return { ColumnView::Type::U32, playCount_.data() };
+        case TrackField::LastPlayed: return { ColumnView::Type::I64, lastPlayed_.data() };
+        case TrackField::AddedAt:    return { ColumnView::Type::I64, addedAt_.data() };
+    }
+    return { ColumnView::Type::U8, format_.data() };
+}
+
+// -----------------------------
+// Change log
+// -----------------------------
+bool TrackLibrary::changesSince(uint64_t cursor, std::vector<TrackId>& rows) const {
+    rows.clear();
+    if (cursor < logBase_) return false;
+    size_t from = static_cast<size_t>(cursor - logBase_);
+    if (from > changeLog_.size()) return false;
+    rows.assign(changeLog_.begin() + from, changeLog_.end());
+    return true;
+}
+
+void TrackLibrary::compactChangeLog() {
+    logBase_ += changeLog_.size();
+    changeLog_.clear();
+    changeLog_.shrink_to_fit();
+}
+
+// -----------------------------
+// Formats
+// -----------------------------
+TrackFormat TrackLibrary::formatFromPath(const std::string& path) {
+    std::string ext = fs::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (ext == ".wav")                   return TrackFormat::Wav;
+    if (ext == ".aif" || ext == ".aiff") return TrackFormat::Aiff;
+    if (ext == ".flac")                  return TrackFormat::Flac;
+    if (ext == ".mp3")                   return TrackFormat::Mp3;
+    if (ext == ".ogg")                   return TrackFormat::Ogg;
+    if (ext == ".opus")                  return TrackFormat::Opus;
+    if (ext == ".m4a" || ext == ".aac")  return TrackFormat::M4a;
+    return TrackFormat::Unknown;
+}
+
+const char* TrackLibrary::formatName(TrackFormat format) {
+    switch (format) {
+        case TrackFormat::Wav:     return "wav";
+        case TrackFormat::Aiff:    return "aiff";
+        case TrackFormat::Flac:    return "flac";
+        case TrackFormat::Mp3:     return "mp3";
+        case TrackFormat::Ogg:     return "ogg";
+        case TrackFormat::Opus:    return "opus";
+        case TrackFormat::M4a:     return "m4a";
+        case TrackFormat::Unknown: break;
+    }
+    return "unknown";
+}
+
+// -----------------------------
+// Persistence
+//   path \t format \t durationMs \t sampleRate \t channels \t bitrate \t size
+//        \t playCount \t lastPlayed \t addedAt
+// -----------------------------
+bool TrackLibrary::load(const std::string& filename) {
+    std::ifstream in(filename);
+    if (!in.is_open()) return false;
+
+    std::string line;
+    size_t loaded = 0;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        std::istringstream row(line);
+        std::string path, field;
+        if (!std::getline(row, path, '\t') || path.empty()) continue;
+
+        uint64_t values[9] = {0};
+        for (int i = 0; i < 9 && std::getline(row, field, '\t'); ++i) {
+            values[i] = std::strtoull(field.c_str(), nullptr, 10);
+        }
+
+        TrackInfo info;
+        info.path = path;
+        info.format = static_cast<TrackFormat>(values[0]);
+        info.durationMs = static_cast<uint32_t>(values[1]);
+        info.sampleRate = static_cast<uint32_t>(values[2]);
+        info.channels = static_cast<uint8_t>(values[3]);
+        info.bitrateKbps = static_cast<uint32_t>(values[4]);
+        info.sizeBytes = values[5];
+        TrackId id = addOrUpdate(info);
+        playCount_[id] = static_cast<uint32_t>(values[6]);
+        lastPlayed_[id] = static_cast<int64_t>(values[7]);
+        if (values[8]) addedAt_[id] = static_cast<int64_t>(values[8]);
+        ++loaded;
+    }
+
+    // A freshly loaded library is the baseline; nobody needs to replay it.
+    compactChangeLog();
+    Logger::instance().log(LogLevel::INFO, "TrackLibrary: Loaded " + std::to_string(loaded) + " tracks from " + filename);
+    return true;
+}
+
+bool TrackLibrary::save(const std::string& filename) const {
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        Logger::instance().log(LogLevel::ERROR, "TrackLibrary: Failed to write " + filename);
+        return false;
+    }
+    for (size_t i = 0; i < paths_.size(); ++i) {
+        if (!live_[i]) continue;
+        out << paths_[i] << '\t'
+            << static_cast<unsigned>(format_[i]) << '\t'
+            << durationMs_[i] << '\t'
+            << sampleRate_[i] << '\t'
+            << static_cast<unsigned>(channels_[i]) << '\t'
+            << bitrateKbps_[i] << '\t'
+            << sizeBytes_[i] << '\t'
+            << playCount_[i] << '\t'
+            << lastPlayed_[i] << '\t'
+            << addedAt_[i] << '\n';
+    }
+    return true;
+}
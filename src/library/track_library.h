@@ -0,0 +1,142 @@
+#pragma once
+/*
+ track_library.h
+
+ Purpose:
+   - Keep per-track metadata for everything the player knows about (playlist
+     entries, dropped folders, scanned directories).
+   - Store the metadata column-wise (one contiguous array per field) so that
+     rule-based playlists can evaluate predicates over millions of rows with
+     tight, vectorizable loops.
+   - Record every mutation in a change log so dependent views (SmartPlaylist)
+     can update incrementally instead of re-evaluating the whole library.
+
+ Notes:
+   - Rows are addressed by a dense TrackId (row index). Removing a track only
+     clears its `live` flag; ids are never reused while the library is loaded.
+   - Durations are stored in milliseconds, timestamps in Unix seconds.
+     0 means "unknown" / "never".
+   - Persistence is a plain tab-separated file next to playlist.txt.
+*/
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+using TrackId = uint32_t;
+
+enum class TrackFormat : uint8_t {
+    Unknown = 0,
+    Wav,
+    Aiff,
+    Flac,
+    Mp3,
+    Ogg,
+    Opus,
+    M4a
+};
+
+// Numeric columns that queries can filter on.
+enum class TrackField : uint8_t {
+    Format,
+    Duration,      // ms
+    SampleRate,    // Hz
+    Channels,
+    Bitrate,       // kbit/s
+    Size,          // bytes
+    PlayCount,
+    LastPlayed,    // unix seconds
+    AddedAt        // unix seconds
+};
+
+// Untyped read-only view of one column, used by the query evaluator to pick
+// a type-specialized loop once per column instead of per row.
+struct ColumnView {
+    enum class Type : uint8_t { U8, U32, U64, I64 };
+    Type type;
+    const void* data;
+};
+
+struct TrackInfo {
+    std::string path;
+    TrackFormat format = TrackFormat::Unknown;
+    uint32_t durationMs = 0;
+    uint32_t sampleRate = 0;
+    uint8_t channels = 0;
+    uint32_t bitrateKbps = 0;
+    uint64_t sizeBytes = 0;
+};
+
+class TrackLibrary {
+public:
+    TrackLibrary();
+
+    // Insert a track or refresh its metadata if the path is already known.
+    // Zero-valued fields in `info` do not overwrite known values.
+    TrackId addOrUpdate(const TrackInfo& info);
+
+    // Convenience: derive format from the extension and size from the
+    // filesystem, then addOrUpdate().
+    TrackId addPath(const std::string& path);
+
+    // Mark a track as removed. Returns false if the path is unknown.
+    bool remove(const std::string& path);
+
+    // Returns the id for `path`, or -1 if unknown / removed.
+    int64_t find(const std::string& path) const;
+
+    // Playback bookkeeping
+    void markPlayed(TrackId id, int64_t when);
+    void setDuration(TrackId id, uint32_t durationMs);
+
+    // Row access
+    size_t rowCount() const { return paths_.size(); }
+    size_t liveCount() const { return liveCount_; }
+    bool isLive(TrackId id) const { return id < live_.size() && live_[id] != 0; }
+    const std::string& path(TrackId id) const { return paths_[id]; }
+    const uint8_t* liveColumn() const { return live_.data(); }
+    const std::vector<std::string>& pathColumn() const { return paths_; }
+    ColumnView column(TrackField field) const;
+
+    // Change log: every mutation appends the touched row. Consumers remember
+    // the cursor they last synced to and replay changesSince(cursor).
+    // Returns false if the log was compacted past `cursor` (full refresh needed).
+    uint64_t changeCursor() const { return logBase_ + changeLog_.size(); }
+    bool changesSince(uint64_t cursor, std::vector<TrackId>& rows) const;
+
+    // Drop the change log; consumers behind the new cursor do a full refresh.
+    void compactChangeLog();
+
+    // Persistence (tab-separated, one row per line)
+    bool load(const std::string& filename);
+    bool save(const std::string& filename) const;
+
+    static TrackFormat formatFromPath(const std::string& path);
+    static const char* formatName(TrackFormat format);
+
+private:
+    TrackId appendRow(const std::string& path);
+    void touch(TrackId id);
+
+private:
+    // Columns (all sized rowCount())
+    std::vector<std::string> paths_;
+    std::vector<uint8_t> format_;
+    std::vector<uint32_t> durationMs_;
+    std::vector<uint32_t> sampleRate_;
+    std::vector<uint8_t> channels_;
+    std::vector<uint32_t> bitrateKbps_;
+    std::vector<uint64_t> sizeBytes_;
+    std::vector<uint32_t> playCount_;
+    std::vector<int64_t> lastPlayed_;
+    std::vector<int64_t> addedAt_;
+    std::vector<uint8_t> live_;
+
+    std::unordered_map<std::string, TrackId> index_;  // path -> row
+    size_t liveCount_;
+
+    std::vector<TrackId> changeLog_;  // rows touched since logBase_
+    uint64_t logBase_;                // cursor value of changeLog_[0]
+};
@@ -12,6 +12,13 @@
 #include <SDL_opengl.h>
 
 #include "player/player.h"
+#include "library/track_library.h"
+#include "library/smart_playlist.h"
+#include "library/library_scanner.h"
+#include "io/staging_cache.h"
+#include "io/queue_prefetcher.h"
+#include "io/pcm_cache.h"
+#include "io/pcm_block_cache.h"
 #include "utils/logger.h"
 
 #include <iostream>
@@ -20,10 +27,91 @@
 #include <vector>
 #include <filesystem>
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
 
 namespace fs = std::filesystem;
 
 const std::string PLAYLIST_FILE = "playlist.txt";
+const std::string LIBRARY_FILE = "library.tsv";
+const std::string SMART_PLAYLIST_FILE = "smart_playlists.txt";
+
+// Local copies of tracks on slow mounts (WSL /mnt/<drive>, network shares).
+// Override the disk budget with MUSIC_PLAYER_STAGING_MB.
+const uint64_t STAGING_BUDGET_MB = 2048;
+const size_t STAGING_LOOKAHEAD = 2;
+
+// Page-cache prewarming of the next tracks on local disks.
+// Override the per-track budget with MUSIC_PLAYER_PREWARM_KB.
+const size_t PREWARM_DEPTH = 3;
+const uint64_t PREWARM_HEAD_KB = 1024;
+
+// Decoded-PCM cache for tracks played over and over (off by default).
+// Enable with MUSIC_PLAYER_PCM_CACHE_MB (disk budget in MiB).
+const uint64_t PCM_CACHE_MB = 0;
+
+// Compressed in-memory cache of decoded blocks (seeks back, loops, replays).
+// Override the budget in MiB with MUSIC_PLAYER_BLOCK_CACHE_MB (0 = off).
+const uint64_t BLOCK_CACHE_MB = 64;
+
+// Device sample format tried first (float32, int32, int24 or int16).
+// Override with MUSIC_PLAYER_OUTPUT_FORMAT; unsupported formats fall back.
+const char* const OUTPUT_FORMAT = "float32";
+
+// Output ring buffer storage (float32, int16 or int24; the latter two save
+// memory on small devices). Override with MUSIC_PLAYER_RING_FORMAT.
+const char* const RING_FORMAT = "float32";
+
+// Output channels: 0 opens the device with its own channel count and mixes
+// the source to it. Override with MUSIC_PLAYER_OUTPUT_CHANNELS; a custom
+// matrix ("a,b,...;c,d,..." rows = outputs) with MUSIC_PLAYER_MIX_MATRIX.
+const int OUTPUT_CHANNELS = 0;
+
+// Equalizer bands at start-up ("type:freq[:gain[:q]],..."); empty = the flat
+// 10-band layout below. Override with MUSIC_PLAYER_EQ.
+const char* const EQ_BANDS = "";
+
+// Ceiling of the true-peak limiter that applies the volume boost above 1.0,
+// in dBTP. Override with MUSIC_PLAYER_LIMITER_CEILING.
+const float LIMITER_CEILING_DB = -1.0f;
+
+// Impulse response convolved with the output (room correction filter or
+// reverb; empty = none) and the share of the convolved signal (0..1).
+// Override with MUSIC_PLAYER_IR and MUSIC_PLAYER_IR_MIX.
+const char* const IMPULSE_RESPONSE = "";
+const float IMPULSE_RESPONSE_MIX = 1.0f;
+
+// Worker threads for the DSP stage besides the decode thread (0 = none).
+// Override with MUSIC_PLAYER_DSP_WORKERS.
+const int DSP_WORKERS = 0;
+
+// Lower the DSP quality (convolution tail, true-peak detection) while the
+// stage cannot keep up, rather than drop out. Override with
+// MUSIC_PLAYER_DSP_GOVERNOR (0 = off).
+const bool DSP_GOVERNOR = true;
+
+// Ten octave bands, 31 Hz - 16 kHz, all at 0 dB (a flat EQ costs nothing).
+static std::vector<EqBand> defaultEqBands() {
+    const float centres[] = { 31.0f, 63.0f, 125.0f, 250.0f, 500.0f, 1000.0f, 2000.0f, 4000.0f, 8000.0f, 16000.0f };
+    std::vector<EqBand> bands;
+    for (float centre : centres) {
+        EqBand band;
+        band.frequency = centre;
+        band.q = 1.41f;
+        bands.push_back(band);
+    }
+    bands.front().type = EqBandType::LowShelf;
+    bands.front().q = 0.707f;
+    bands.back().type = EqBandType::HighShelf;
+    bands.back().q = 0.707f;
+    return bands;
+}
+
+static int64_t unixNow() {
+    using namespace std::chrono;
+    return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+}
 
 // Helper to convert Windows paths (e.g. "C:\Music") to WSL paths (e.g. "/mnt/c/Music")
 std::string convertWindowsPathToWSL(std::string path) {
@@ -63,6 +151,30 @@ void loadPlaylist(std::vector<std::string>& playlist) {
     }
 }
 
+// Record a successful start of playback in the library (play count, last
+// played, and the duration the decoder reports).
+void recordPlay(TrackLibrary& library, const Player& player, const std::string& path) {
+    TrackId id = library.addPath(path);
+    double duration = player.getDuration();
+    if (duration > 0.0) {
+        library.setDuration(id, static_cast<uint32_t>(duration * 1000.0));
+    }
+    library.markPlayed(id, unixNow());
+}
+
+bool playTrack(Player& player, TrackLibrary& library, const std::string& path, float speed, float volume) {
+    if (!player.load(path)) {
+        return false;
+    }
+    player.setSpeed(speed);
+    player.setVolume(volume);
+    if (!player.play()) {
+        return false;
+    }
+    recordPlay(library, player, path);
+    return true;
+}
+
 void SetupStyle() {
     ImGuiStyle& style = ImGui::GetStyle();
     style.Colors[ImGuiCol_Text]                   = ImVec4(0.90f, 0.90f, 0.90f, 1.00f);
@@ -166,8 +278,103 @@ int main(int argc, char** argv) {
     ImGui_ImplOpenGL3_Init(glsl_version);
 
     // Player State
+    uint64_t stagingBudgetMB = STAGING_BUDGET_MB;
+    if (const char* env = std::getenv("MUSIC_PLAYER_STAGING_MB")) {
+        stagingBudgetMB = std::strtoull(env, nullptr, 10);
+    }
+    StagingCache staging(StagingCache::defaultDirectory(), stagingBudgetMB << 20, STAGING_LOOKAHEAD);
+    uint64_t prewarmKB = PREWARM_HEAD_KB;
+    if (const char* env = std::getenv("MUSIC_PLAYER_PREWARM_KB")) {
+        prewarmKB = std::strtoull(env, nullptr, 10);
+    }
+    QueuePrefetcher prefetcher(PREWARM_DEPTH, prewarmKB << 10);
+    uint64_t pcmCacheMB = PCM_CACHE_MB;
+    if (const char* env = std::getenv("MUSIC_PLAYER_PCM_CACHE_MB")) {
+        pcmCacheMB = std::strtoull(env, nullptr, 10);
+    }
+    std::unique_ptr<PcmCache> pcmCache;
+    if (pcmCacheMB > 0) {
+        pcmCache.reset(new PcmCache(PcmCache::defaultDirectory(), pcmCacheMB << 20));
+    }
+    uint64_t blockCacheMB = BLOCK_CACHE_MB;
+    if (const char* env = std::getenv("MUSIC_PLAYER_BLOCK_CACHE_MB")) {
+        blockCacheMB = std::strtoull(env, nullptr, 10);
+    }
+    PcmBlockCache blockCache(blockCacheMB << 20);
+    int stagedIndex = -2;
+    size_t stagedPlaylistSize = 0;
+    const std::vector<std::string>* stagedQueue = nullptr;
+
     Player player;
+    player.setStagingCache(&staging);
+    player.setPcmCache(pcmCache.get());
+    player.setBlockCache(&blockCache);
+    const char* outputFormatName = std::getenv("MUSIC_PLAYER_OUTPUT_FORMAT");
+    DeviceFormat outputFormat = DeviceFormat::Float32;
+    if (!parseDeviceFormat(outputFormatName ? outputFormatName : OUTPUT_FORMAT, outputFormat)) {
+        Logger::instance().log(LogLevel::WARNING, std::string("Unknown MUSIC_PLAYER_OUTPUT_FORMAT, using ") + OUTPUT_FORMAT);
+    }
+    player.setOutputFormat(outputFormat);
+    const char* ringFormatName = std::getenv("MUSIC_PLAYER_RING_FORMAT");
+    DeviceFormat ringFormat = DeviceFormat::Float32;
+    if (!parseDeviceFormat(ringFormatName ? ringFormatName : RING_FORMAT, ringFormat)) {
+        Logger::instance().log(LogLevel::WARNING, std::string("Unknown MUSIC_PLAYER_RING_FORMAT, using ") + RING_FORMAT);
+    }
+    player.setRingFormat(ringFormat);
+    int outputChannels = OUTPUT_CHANNELS;
+    if (const char* env = std::getenv("MUSIC_PLAYER_OUTPUT_CHANNELS")) {
+        outputChannels = std::atoi(env);
+    }
+    player.setOutputChannels(outputChannels);
+    if (const char* env = std::getenv("MUSIC_PLAYER_MIX_MATRIX")) {
+        int mixIn = 0;
+        int mixOut = 0;
+        std::vector<float> mixMatrix;
+        if (parseMixMatrix(env, mixIn, mixOut, mixMatrix)) {
+            player.setMixMatrix(mixIn, mixOut, mixMatrix);
+        } else {
+            Logger::instance().log(LogLevel::WARNING, "Invalid MUSIC_PLAYER_MIX_MATRIX, using the standard matrix");
+        }
+    }
+    std::vector<EqBand> eqBands = defaultEqBands();
+    const char* eqEnv = std::getenv("MUSIC_PLAYER_EQ");
+    const std::string eqText = eqEnv ? eqEnv : EQ_BANDS;
+    if (!eqText.empty() && !parseEqBands(eqText, eqBands)) {
+        Logger::instance().log(LogLevel::WARNING, "Invalid MUSIC_PLAYER_EQ, using a flat EQ");
+        eqBands = defaultEqBands();
+    }
+    player.equalizer().setBands(eqBands);
+    float limiterCeiling = LIMITER_CEILING_DB;
+    if (const char* env = std::getenv("MUSIC_PLAYER_LIMITER_CEILING")) {
+        limiterCeiling = static_cast<float>(std::atof(env));
+    }
+    player.limiter().setCeiling(limiterCeiling);
+    const char* irEnv = std::getenv("MUSIC_PLAYER_IR");
+    player.setImpulseResponse(irEnv ? irEnv : IMPULSE_RESPONSE);
+    float irMix = IMPULSE_RESPONSE_MIX;
+    if (const char* env = std::getenv("MUSIC_PLAYER_IR_MIX")) {
+        irMix = static_cast<float>(std::atof(env));
+    }
+    player.convolver().setMix(irMix);
+    int dspWorkers = DSP_WORKERS;
+    if (const char* env = std::getenv("MUSIC_PLAYER_DSP_WORKERS")) {
+        dspWorkers = std::atoi(env);
+    }
+    player.setDspWorkers(dspWorkers);
+    bool dspGovernor = DSP_GOVERNOR;
+    if (const char* env = std::getenv("MUSIC_PLAYER_DSP_GOVERNOR")) {
+        dspGovernor = std::atoi(env) != 0;
+    }
+    player.setDspGovernor(dspGovernor);
+    // The user's playlist (playlist.txt) and a smart playlist's results,
+    // which are never saved. `queue` is the list being played (and indexed
+    // by currentTrackIndex), `shown` the one listed; they differ after
+    // "Back to Playlist" until a playlist track is picked
     std::vector<std::string> playlist;
+    std::vector<std::string> smartQueue;
+    std::string smartQueueName;
+    std::vector<std::string>* queue = &playlist;
+    std::vector<std::string>* shown = &playlist;
     int currentTrackIndex = -1;
     float volume = 1.0f;
     bool loop = false;
@@ -176,6 +383,16 @@ int main(int argc, char** argv) {
     // Load persistent playlist
     loadPlaylist(playlist);
 
+    // Track library (metadata columns for smart playlists) and saved rules
+    TrackLibrary library;
+    library.load(LIBRARY_FILE);
+    for (const auto& path : playlist) {
+        if (library.find(path) < 0) library.addPath(path);
+    }
+    LibraryScanner scanner;
+    std::vector<SmartPlaylist> smartPlaylists;
+    loadSmartPlaylists(SMART_PLAYLIST_FILE, smartPlaylists);
+
     // Scan current directory for audio files (Optional: Remove this if you only want persistent playlist)
     // For now, I'll comment it out to strictly follow "remain permanently until i delete it"
     /*
@@ -211,12 +428,15 @@ int main(int argc, char** argv) {
             currentTrackIndex = std::distance(playlist.begin(), it);
         } else {
             playlist.push_back(argFile);
+            library.addPath(argFile);
             currentTrackIndex = playlist.size() - 1;
             savePlaylist(playlist); // Save immediately
         }
         
         if (player.load(playlist[currentTrackIndex])) {
-            player.play();
+            if (player.play()) {
+                recordPlay(library, player, playlist[currentTrackIndex]);
+            }
         }
     } else if (!playlist.empty()) {
         // If no args but playlist exists, load first track but don't auto-play
@@ -241,20 +461,17 @@ int main(int argc, char** argv) {
                 SDL_free(dropped_file);
                 try {
                     if (fs::is_directory(file_path)) {
-                        for (const auto& entry : fs::directory_iterator(file_path)) {
-                            if (entry.is_regular_file()) {
-                                std::string ext = entry.path().extension().string();
-                                if (ext == ".wav" || ext == ".mp3" || ext == ".flac" || ext == ".ogg") {
-                                    playlist.push_back(fs::absolute(entry.path()).string());
-                                }
-                            }
-                        }
+                        std::vector<std::string> files = LibraryScanner::listAudioFiles(file_path, false);
+                        scanner.scan(files, library);
+                        playlist.insert(playlist.end(), files.begin(), files.end());
                     } else {
                         playlist.push_back(file_path);
+                        scanner.scan({ file_path }, library);
                     }
                     std::sort(playlist.begin(), playlist.end());
                     playlist.erase(std::unique(playlist.begin(), playlist.end()), playlist.end());
                     savePlaylist(playlist);
+                    library.save(LIBRARY_FILE);
                 } catch (...) {
                     Logger::instance().log(LogLevel::ERROR, "Failed to process dropped file");
                 }
@@ -265,20 +482,28 @@ int main(int argc, char** argv) {
         if (player.isFinished()) {
             if (loop && currentTrackIndex >= 0) {
                 // Replay same track
-                if (player.load(playlist[currentTrackIndex])) {
-                    player.setSpeed(speed);
-                    player.setVolume(volume);
-                    player.play();
-                }
-            } else if (currentTrackIndex >= 0 && currentTrackIndex + 1 < (int)playlist.size()) {
+                playTrack(player, library, (*queue)[currentTrackIndex], speed, volume);
+            } else if (currentTrackIndex >= 0 && currentTrackIndex + 1 < (int)queue->size()) {
                 // Next track
                 currentTrackIndex++;
-                if (player.load(playlist[currentTrackIndex])) {
-                    player.setSpeed(speed);
-                    player.setVolume(volume);
-                    player.play();
-                }
+                playTrack(player, library, (*queue)[currentTrackIndex], speed, volume);
+            }
+        }
+
+        // Keep the staging cache and prefetcher working on the current and upcoming tracks
+        if (currentTrackIndex != stagedIndex || queue->size() != stagedPlaylistSize || queue != stagedQueue) {
+            const size_t window = std::max(STAGING_LOOKAHEAD, PREWARM_DEPTH) + 1;
+            std::vector<std::string> upcoming;
+            for (int i = std::max(currentTrackIndex, 0); i < (int)queue->size() && upcoming.size() < window; ++i) {
+                upcoming.push_back((*queue)[i]);
             }
+            staging.setQueue(upcoming);
+            if (!upcoming.empty()) {
+                prefetcher.setQueue(std::vector<std::string>(upcoming.begin() + 1, upcoming.end()));
+            }
+            stagedIndex = currentTrackIndex;
+            stagedPlaylistSize = queue->size();
+            stagedQueue = queue;
         }
 
         // Start the Dear ImGui frame
@@ -300,8 +525,8 @@ int main(int argc, char** argv) {
             ImGui::Spacing();
 
             // Now Playing
-            if (currentTrackIndex >= 0 && currentTrackIndex < (int)playlist.size()) {
-                ImGui::TextColored(ImVec4(0.2f, 0.8f, 0.2f, 1.0f), "Now Playing: %s", playlist[currentTrackIndex].c_str());
+            if (currentTrackIndex >= 0 && currentTrackIndex < (int)queue->size()) {
+                ImGui::TextColored(ImVec4(0.2f, 0.8f, 0.2f, 1.0f), "Now Playing: %s", (*queue)[currentTrackIndex].c_str());
             } else {
                 ImGui::Text("No file loaded.");
             }
@@ -311,11 +536,7 @@ int main(int argc, char** argv) {
             if (ImGui::Button("<< Prev")) {
                 if (currentTrackIndex > 0) {
                     currentTrackIndex--;
-                    if (player.load(playlist[currentTrackIndex])) {
-                        player.setSpeed(speed);
-                        player.setVolume(volume);
-                        player.play();
-                    }
+                    playTrack(player, library, (*queue)[currentTrackIndex], speed, volume);
                 }
             }
             ImGui::SameLine();
@@ -330,19 +551,11 @@ int main(int argc, char** argv) {
                         if (player.isPaused()) {
                             player.resume();
                         } else {
-                            if (player.load(playlist[currentTrackIndex])) {
-                                player.setSpeed(speed);
-                                player.setVolume(volume);
-                                player.play();
-                            }
+                            playTrack(player, library, (*queue)[currentTrackIndex], speed, volume);
                         }
-                    } else if (!playlist.empty()) {
+                    } else if (!queue->empty()) {
                         currentTrackIndex = 0;
-                        if (player.load(playlist[currentTrackIndex])) {
-                            player.setSpeed(speed);
-                            player.setVolume(volume);
-                            player.play();
-                        }
+                        playTrack(player, library, (*queue)[currentTrackIndex], speed, volume);
                     }
                 }
             }
@@ -354,13 +567,9 @@ int main(int argc, char** argv) {
             ImGui::SameLine();
 
             if (ImGui::Button("Next >>")) {
-                if (currentTrackIndex + 1 < (int)playlist.size()) {
+                if (currentTrackIndex + 1 < (int)queue->size()) {
                     currentTrackIndex++;
-                    if (player.load(playlist[currentTrackIndex])) {
-                        player.setSpeed(speed);
-                        player.setVolume(volume);
-                        player.play();
-                    }
+                    playTrack(player, library, (*queue)[currentTrackIndex], speed, volume);
                 }
             }
 
@@ -392,10 +601,94 @@ int main(int argc, char** argv) {
             if (volume > 1.0f) {
                 ImGui::SameLine();
                 ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.0f, 1.0f), "BOOST ACTIVE");
+                // Gain the limiter takes back to keep the boosted peaks under its ceiling
+                ImGui::SameLine();
+                ImGui::TextDisabled("(limiter %.1f dB)", player.limiter().gainReductionDb());
             }
 
             ImGui::Checkbox("Loop Track", &loop);
 
+            // Equalizer: applied in the decode thread, changes are smoothed there
+            if (ImGui::CollapsingHeader("Equalizer")) {
+                ParametricEq& eq = player.equalizer();
+                bool eqEnabled = eq.enabled();
+                if (ImGui::Checkbox("Enabled##eq", &eqEnabled)) {
+                    eq.setEnabled(eqEnabled);
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Flat##eq")) {
+                    std::vector<EqBand> flat = eq.bands();
+                    for (EqBand& band : flat) band.gainDb = 0.0f;
+                    eq.setBands(flat);
+                    eq.setPreamp(0.0f);
+                }
+                float preamp = eq.preamp();
+                if (ImGui::SliderFloat("Preamp##eq", &preamp, -12.0f, 12.0f, "%.1f dB")) {
+                    eq.setPreamp(preamp);
+                }
+                const std::vector<EqBand> bands = eq.bands();
+                for (size_t b = 0; b < bands.size(); ++b) {
+                    EqBand band = bands[b];
+                    ImGui::PushID(static_cast<int>(b));
+                    const bool gainBand = band.type == EqBandType::Peak || band.type == EqBandType::LowShelf ||
+                                          band.type == EqBandType::HighShelf;
+                    char label[48];
+                    std::snprintf(label, sizeof(label), "%s %.0f Hz", eqBandTypeName(band.type), band.frequency);
+                    if (gainBand) {
+                        if (ImGui::SliderFloat(label, &band.gainDb, -12.0f, 12.0f, "%.1f dB")) {
+                            eq.setBand(static_cast<int>(b), band);
+                        }
+                    } else if (ImGui::Checkbox(label, &band.enabled)) {
+                        eq.setBand(static_cast<int>(b), band);
+                    }
+                    ImGui::PopID();
+                }
+            }
+
+            // Convolution: the impulse response is set at start-up, the mix
+            // can change while playing
+            Convolver& convolver = player.convolver();
+            if (convolver.active() && ImGui::CollapsingHeader("Convolution")) {
+                ImGui::Text("%zu taps (%s, %s)", convolver.length(), convolver.describe().c_str(),
+                            convolver.variant());
+                float wet = convolver.mix();
+                if (ImGui::SliderFloat("Wet##ir", &wet, 0.0f, 1.0f, "%.2f")) {
+                    convolver.setMix(wet);
+                }
+            }
+
+            // DSP chain: what each node costs, and a crossfeed node that is
+            // added and removed while playing
+            if (ImGui::CollapsingHeader("DSP")) {
+                static std::shared_ptr<MatrixNode> crossfeed;
+                bool crossfeedOn = crossfeed && player.dsp().indexOf(crossfeed.get()) >= 0;
+                if (ImGui::Checkbox("Crossfeed (stereo)", &crossfeedOn)) {
+                    if (crossfeedOn) {
+                        crossfeed = std::make_shared<MatrixNode>();
+                        crossfeed->setMatrix(2, { 0.8f, 0.2f, 0.2f, 0.8f });
+                        player.addDspNode(crossfeed);
+                    } else {
+                        player.dsp().remove(crossfeed.get());
+                        crossfeed.reset();
+                    }
+                }
+                for (const DspNodeCost& cost : player.dsp().costs()) {
+                    if (cost.background > 0.0) {
+                        ImGui::Text("%-10s %6.3f%% (+%.3f%% worker)", cost.name.c_str(), cost.load, cost.background);
+                    } else {
+                        ImGui::Text("%-10s %6.3f%%", cost.name.c_str(), cost.load);
+                    }
+                }
+                ImGui::Text("Deadline misses: %llu of %llu blocks",
+                            static_cast<unsigned long long>(player.dsp().deadlineMisses()),
+                            static_cast<unsigned long long>(player.dsp().blocks()));
+                if (player.dsp().governor()) {
+                    ImGui::Text("Load: %.0f%% of the deadline, quality tier %d of %d (%llu changes)",
+                                100.0 * player.dsp().load(), player.dsp().qualityTier(), DspChain::kMaxQualityTier,
+                                static_cast<unsigned long long>(player.dsp().tierChanges()));
+                }
+            }
+
             ImGui::Spacing();
             ImGui::Separator();
             ImGui::Spacing();
@@ -408,17 +701,13 @@ int main(int argc, char** argv) {
                 std::string newPath = convertWindowsPathToWSL(pathBuffer);
                 try {
                     if (!newPath.empty() && fs::exists(newPath) && fs::is_directory(newPath)) {
-                        for (const auto& entry : fs::directory_iterator(newPath)) {
-                            if (entry.is_regular_file()) {
-                                std::string ext = entry.path().extension().string();
-                                if (ext == ".wav" || ext == ".mp3" || ext == ".flac" || ext == ".ogg") {
-                                    playlist.push_back(fs::absolute(entry.path()).string());
-                                }
-                            }
-                        }
+                        std::vector<std::string> files = LibraryScanner::listAudioFiles(newPath, false);
+                        scanner.scan(files, library);
+                        playlist.insert(playlist.end(), files.begin(), files.end());
                         std::sort(playlist.begin(), playlist.end());
                         playlist.erase(std::unique(playlist.begin(), playlist.end()), playlist.end());
                         savePlaylist(playlist);
+                        library.save(LIBRARY_FILE);
                         memset(pathBuffer, 0, sizeof(pathBuffer));
                     }
                 } catch (...) {}
@@ -429,24 +718,88 @@ int main(int argc, char** argv) {
             if (ImGui::Button("Clear Playlist")) {
                 player.stop();
                 playlist.clear();
+                queue = &playlist;
+                shown = &playlist;
                 currentTrackIndex = -1;
                 savePlaylist(playlist);
             }
             ImGui::Spacing();
 
+            // Smart Playlists (rule-based views over the library)
+            if (ImGui::CollapsingHeader("Smart Playlists")) {
+                static char smartName[64] = "";
+                static char smartRule[256] = "";
+                static std::string smartError;
+                ImGui::InputTextWithHint("##smartname", "Name", smartName, IM_ARRAYSIZE(smartName));
+                ImGui::InputTextWithHint("##smartrule", "e.g. flac AND duration > 10min AND NOT played in 30 days", smartRule, IM_ARRAYSIZE(smartRule));
+                ImGui::SameLine();
+                if (ImGui::Button("Save Rule") && smartName[0] != '\0') {
+                    SmartPlaylist candidate(smartName, smartRule);
+                    if (candidate.isValid()) {
+                        smartPlaylists.push_back(candidate);
+                        saveSmartPlaylists(SMART_PLAYLIST_FILE, smartPlaylists);
+                        smartError.clear();
+                        memset(smartName, 0, sizeof(smartName));
+                        memset(smartRule, 0, sizeof(smartRule));
+                    } else {
+                        smartError = candidate.error();
+                    }
+                }
+                if (!smartError.empty()) {
+                    ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Invalid rule: %s", smartError.c_str());
+                }
+
+                int64_t now = unixNow();
+                for (size_t s = 0; s < smartPlaylists.size(); ++s) {
+                    SmartPlaylist& smart = smartPlaylists[s];
+                    smart.refresh(library, now);
+                    std::string label = smart.name() + " (" + std::to_string(smart.size()) + ")##smart" + std::to_string(s);
+                    if (ImGui::Selectable(label.c_str(), false)) {
+                        // Play and show the rule's current results; the
+                        // user's playlist stays as it is (and as saved)
+                        player.stop();
+                        smartQueue.clear();
+                        for (TrackId id : smart.tracks()) {
+                            smartQueue.push_back(library.path(id));
+                        }
+                        smartQueueName = smart.name();
+                        queue = &smartQueue;
+                        shown = &smartQueue;
+                        currentTrackIndex = smartQueue.empty() ? -1 : 0;
+                    }
+                    if (ImGui::IsItemHovered()) {
+                        ImGui::SetTooltip("%s", smart.rule().c_str());
+                    }
+                }
+            }
+            ImGui::Spacing();
+
             // Playlist
-            ImGui::Text("Playlist (%zu files)", playlist.size());
+            if (shown == &smartQueue) {
+                ImGui::Text("Smart playlist \"%s\" (%zu files)", smartQueueName.c_str(), smartQueue.size());
+                ImGui::SameLine();
+                if (ImGui::Button("Back to Playlist")) {
+                    // Only the view changes: the smart results keep playing
+                    // until a playlist track is picked
+                    shown = &playlist;
+                }
+            } else {
+                ImGui::Text("Playlist (%zu files)", playlist.size());
+                if (queue == &smartQueue) {
+                    ImGui::SameLine();
+                    if (ImGui::Button("Show Smart Playlist")) {
+                        shown = &smartQueue;
+                    }
+                }
+            }
             ImGui::BeginChild("PlaylistRegion", ImVec2(0, -30), true);
-            for (int i = 0; i < (int)playlist.size(); i++) {
-                bool isSelected = (currentTrackIndex == i);
-                std::string displayName = fs::path(playlist[i]).filename().string();
+            for (int i = 0; i < (int)shown->size(); i++) {
+                bool isSelected = (shown == queue && currentTrackIndex == i);
+                std::string displayName = fs::path((*shown)[i]).filename().string();
                 if (ImGui::Selectable(displayName.c_str(), isSelected)) {
+                    queue = shown;
                     currentTrackIndex = i;
-                    if (player.load(playlist[currentTrackIndex])) {
-                        player.setSpeed(speed);
-                        player.setVolume(volume);
-                        player.play();
-                    }
+                    playTrack(player, library, (*queue)[currentTrackIndex], speed, volume);
                 }
                 if (isSelected) {
                     ImGui::SetItemDefaultFocus();
@@ -472,6 +825,7 @@ int main(int argc, char** argv) {
 
     // Cleanup
     player.stop();
+    library.save(LIBRARY_FILE);
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
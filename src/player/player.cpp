@@ -3,11 +3,12 @@
  *
  * Implementation of Player class. This file explains:
  *  - How decoder -> audio output flow is established
- *  - How the decode thread converts int16 PCM -> float and writes to ring buffer
+ *  - How the decode thread pulls fixed-size float blocks, mixes them, runs the
+ *    DSP stage and writes them to the ring buffer
  *  - Thread lifecycle and synchronization using atomics
  *
  * Key libraries used:
- *  - FFmpegDecoder (decoding, multi-format)
+ *  - AudioDecoder (native WAV/AIFF, FFmpeg for everything else)
  *  - AudioOutput (PortAudio wrapper with SPSC ring buffer)
  *  - Logger for debug/diagnostic messages
  */
@@ -15,14 +16,19 @@
 #include "player.h"
 
 // Concrete includes
-#include "../decoder/ffmpeg_decoder.h"    // FFmpeg decoder interface
+#include "../decoder/audio_decoder.h"     // decoder interface + factory
 #include "../audio/audio_output.h"       // AudioOutput abstraction (PortAudio + ring buffer)
+#include "../audio/planar.h"             // planar blocks of the DSP stage
+#include "../io/pcm_cache.h"             // decoded-PCM disk cache
+#include "../io/pcm_block_cache.h"       // decoded-PCM memory cache
 #include "../utils/logger.h"             // Logger (singleton)
 
 // STL
 #include <vector>
 #include <chrono>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
 
 Player::Player()
     : decoder_(nullptr),
@@ -30,8 +36,15 @@ Player::Player()
       playing_(false),
       paused_(false),
       stopRequested_(false),
-      finished_(false)
-{}
+      finished_(false),
+      eqNode_(std::make_shared<EqNode>()),
+      convolverNode_(std::make_shared<ConvolverNode>()),
+      limiterNode_(std::make_shared<LimiterNode>())
+{
+    dsp_.add(eqNode_);
+    dsp_.add(convolverNode_);
+    dsp_.add(limiterNode_);
+}
 
 Player::~Player() {
     stop();
@@ -44,17 +57,25 @@ bool Player::load(const std::string& filepath) {
     Logger::instance().log(LogLevel::INFO, "Player: Loading file: " + filepath);
 
     // Create decoder and open file
-    decoder_.reset(new FFmpegDecoder());
-    if (!decoder_->open(filepath)) {
-        Logger::instance().log(LogLevel::ERROR, "Player: FFmpegDecoder failed to open file");
-        decoder_.reset();
+    decoder_ = pcmCache_ ? pcmCache_->openFile(filepath, staging_) : AudioDecoder::openFile(filepath, staging_);
+    if (!decoder_) {
+        Logger::instance().log(LogLevel::ERROR, "Player: no decoder could open file");
         return false;
     }
+    if (blockCache_) {
+        decoder_ = blockCache_->wrap(std::move(decoder_), filepath);
+    }
+    loopEnabled_.store(false);
+    seekPending_.store(false);
 
     // Create audio output and initialize with decoder's parameters
     audioOut_.reset(new AudioOutput());
+    audioOut_->setPreferredFormat(outputFormat_);
+    audioOut_->setRingFormat(ringFormat_);
+    audioOut_->setOutputChannels(outputChannels_);
 
-    // Use decoder's sample rate/channels to configure output. AudioOutput expects floats.
+    // Use decoder's sample rate/channels to configure output. AudioOutput expects floats
+    // and opens the device with its own channel count.
     int sr = decoder_->getSampleRate();
     int ch = decoder_->getChannels();
 
@@ -66,13 +87,106 @@ bool Player::load(const std::string& filepath) {
         return false;
     }
 
+    // Source channels -> device channels
+    const int outCh = audioOut_->channels();
+    bool mixerReady = !mixMatrix_.empty() && mixIn_ == ch && mixOut_ == outCh
+        ? mixer_.configure(ch, outCh, mixMatrix_)
+        : mixer_.configure(ch, outCh);
+    if (!mixerReady) {
+        Logger::instance().log(LogLevel::ERROR, "Player: cannot mix " + std::to_string(ch) + " channels to " +
+            std::to_string(outCh) + " (at most " + std::to_string(ChannelMixer::kMaxChannels) + ")");
+        audioOut_.reset();
+        decoder_->close();
+        decoder_.reset();
+        return false;
+    }
+    if (!mixer_.isIdentity()) {
+        Logger::instance().log(LogLevel::INFO, "Player: mixing " + std::to_string(ch) + " -> " + std::to_string(outCh) +
+            " channels (" + mixer_.variant() + "): " + mixer_.describe());
+    }
+    if (irPath_ != loadedIrPath_) {
+        loadImpulseResponse();
+    }
+    if (dspWorkers_.workers() != dspWorkerCount_) {
+        dspWorkers_.start(dspWorkerCount_);
+    }
+    dsp_.setWorkers(dspWorkers_.workers() > 0 ? &dspWorkers_ : nullptr);
+    if (dspWorkers_.workers() > 0) {
+        Logger::instance().log(LogLevel::INFO, "Player: DSP on " + std::to_string(dspWorkers_.workers()) +
+            " worker threads (" + std::to_string(dspWorkers_.pinned()) + " pinned) and the decode thread");
+    }
+    if (!dsp_.prepare(sr, outCh)) {
+        Logger::instance().log(LogLevel::WARNING, "Player: a DSP node cannot process " + std::to_string(outCh) +
+            " channels at " + std::to_string(sr) + " Hz and is skipped");
+    }
+    const ParametricEq& eq = eqNode_->eq();
+    if (eq.enabled() && !eq.bands().empty()) {
+        Logger::instance().log(LogLevel::INFO, "Player: EQ " + std::to_string(eq.bands().size()) +
+            " bands (" + eq.variant() + ")");
+    }
+    const Convolver& convolver = convolverNode_->convolver();
+    if (convolver.active()) {
+        Logger::instance().log(LogLevel::INFO, "Player: convolution " + std::to_string(convolver.length()) +
+            " taps, partitions " + convolver.describe() + ", latency " + std::to_string(convolver.latency()) +
+            " frames (" + convolver.variant() + ")");
+    }
+    setVolume(volume_);
+    Logger::instance().log(LogLevel::INFO, "Player: limiter latency " + std::to_string(limiterNode_->latency()) +
+        " frames (" + limiterNode_->limiter().variant() + "), DSP latency " + std::to_string(dsp_.latency()) +
+        " frames");
+
     currentFile_ = filepath;
     Logger::instance().log(LogLevel::INFO,
         "Player: Loaded successfully (sr=" + std::to_string(sr) +
-        ", ch=" + std::to_string(ch) + ")");
+        ", ch=" + std::to_string(ch) + ", decoder=" + decoder_->name() + ")");
+    return true;
+}
+
+bool Player::loadImpulseResponse() {
+    // Remember the path even if it fails, so a bad file is reported once
+    loadedIrPath_ = irPath_;
+    Convolver& convolver = convolverNode_->convolver();
+    convolver.clearImpulseResponse();
+    if (irPath_.empty()) return true;
+
+    std::unique_ptr<AudioDecoder> ir = AudioDecoder::openFile(irPath_, staging_, DecodeWorkload::Offline);
+    if (!ir) {
+        Logger::instance().log(LogLevel::WARNING, "Player: cannot open impulse response " + irPath_);
+        return false;
+    }
+    const size_t channels = static_cast<size_t>(ir->getChannels());
+    const int rate = ir->getSampleRate();
+    std::vector<float> samples;
+    std::vector<float> block(kBlockFrames * channels);
+    size_t frames = 0;
+    while (frames <= Convolver::kMaxLength) {
+        size_t got = ir->decodeFrames(block.data(), kBlockFrames);
+        if (got == 0) break;
+        samples.insert(samples.end(), block.begin(), block.begin() + got * channels);
+        frames += got;
+    }
+    ir->close();
+    if (frames > Convolver::kMaxLength) {
+        Logger::instance().log(LogLevel::WARNING, "Player: impulse response cut to " +
+            std::to_string(Convolver::kMaxLength) + " frames");
+        frames = Convolver::kMaxLength;
+        samples.resize(frames * channels);
+    }
+    if (!convolver.setImpulseResponse(samples.data(), frames, static_cast<int>(channels), rate)) {
+        Logger::instance().log(LogLevel::WARNING, "Player: unusable impulse response " + irPath_ + " (" +
+            std::to_string(frames) + " frames, " + std::to_string(channels) + " channels)");
+        return false;
+    }
+    Logger::instance().log(LogLevel::INFO, "Player: impulse response " + irPath_ + " (" + std::to_string(frames) +
+        " frames, " + std::to_string(channels) + " ch, " + std::to_string(rate) + " Hz)");
     return true;
 }
 
+bool Player::addDspNode(std::shared_ptr<DspNode> node) {
+    const int limiterIndex = dsp_.indexOf(limiterNode_.get());
+    return dsp_.insert(limiterIndex < 0 ? DspChain::kMaxNodes : static_cast<size_t>(limiterIndex), std::move(node));
+}
+
 bool Player::play() {
     if (!decoder_ || !audioOut_) {
         Logger::instance().log(LogLevel::ERROR, "Player: No file loaded or audio output unavailable");
@@ -143,9 +257,56 @@ void Player::stop() {
     playing_.store(false);
     stopRequested_.store(false);
 
+    // What each DSP node cost over the track
+    std::string costs;
+    for (const DspNodeCost& cost : dsp_.costs()) {
+        if (cost.frames == 0) continue;
+        char text[96];
+        std::snprintf(text, sizeof(text), "%s%s %.3f%%", costs.empty() ? "" : ", ", cost.name.c_str(), cost.load);
+        costs += text;
+        if (cost.background > 0.0) {
+            std::snprintf(text, sizeof(text), " (+%.3f%% worker)", cost.background);
+            costs += text;
+        }
+    }
+    if (!costs.empty()) {
+        Logger::instance().log(LogLevel::INFO, "Player: DSP cost per node (share of one core): " + costs);
+    }
+    if (dsp_.blocks() > 0) {
+        Logger::instance().log(dsp_.deadlineMisses() > 0 ? LogLevel::WARNING : LogLevel::INFO,
+            "Player: DSP missed the block deadline " + std::to_string(dsp_.deadlineMisses()) + " times in " +
+            std::to_string(dsp_.blocks()) + " blocks");
+    }
+    if (dsp_.governor() || dsp_.tierChanges() > 0) {
+        std::string tiers;
+        for (int t = 0; t <= DspChain::kMaxQualityTier; ++t) {
+            tiers += (t == 0 ? "" : "/") + std::to_string(dsp_.tierBlocks(t));
+        }
+        Logger::instance().log(LogLevel::INFO, "Player: DSP quality tier changes " +
+            std::to_string(dsp_.tierChanges()) + ", blocks per tier 0.." +
+            std::to_string(DspChain::kMaxQualityTier) + ": " + tiers);
+    }
+
     Logger::instance().log(LogLevel::INFO, "Player: Playback stopped and resources released");
 }
 
+// The governor moved the DSP stage from tier `from` to `to` (decode thread)
+void Player::logDspTier(int from, int to) {
+    const Convolver& convolver = convolverNode_->convolver();
+    char text[160];
+    std::snprintf(text, sizeof(text), "Player: DSP load %.0f%% of the block deadline, quality tier %d -> %d",
+                  100.0 * dsp_.load(), from, to);
+    std::string message = text;
+    if (convolver.active()) {
+        message += ", convolving " + std::to_string(convolver.activeLength()) + " of " +
+            std::to_string(convolver.length()) + " taps";
+    }
+    if (limiterNode_->limiter().enabled()) {
+        message += limiterNode_->limiter().samplePeak() ? ", limiter on sample peaks" : ", limiter on true peaks";
+    }
+    Logger::instance().log(to > from ? LogLevel::WARNING : LogLevel::INFO, message);
+}
+
 void Player::pause() {
     if (playing_.load() && !paused_.load()) {
         paused_.store(true);
@@ -163,8 +324,14 @@ void Player::resume() {
 }
 
 void Player::setVolume(float volume) {
+    if (volume < 0.0f) volume = 0.0f;
+    if (volume > 2.0f) volume = 2.0f;
+    volume_ = volume;
+    // Attenuation stays in the output callback (takes effect at once); the
+    // boost goes through the limiter in the decode thread.
+    limiterNode_->limiter().setInputGain(std::max(volume, 1.0f));
     if (audioOut_) {
-        audioOut_->setVolume(volume);
+        audioOut_->setVolume(std::min(volume, 1.0f));
     }
 }
 
@@ -189,59 +356,163 @@ void Player::setSpeed(float speed) {
     }
 }
 
+double Player::getDuration() const {
+    return decoder_ ? decoder_->getDuration() : 0.0;
+}
+
+bool Player::seek(double seconds) {
+    if (!decoder_ || seconds < 0.0) {
+        return false;
+    }
+    if (playing_.load()) {
+        // The decoder belongs to the decode thread while playing.
+        seekTarget_.store(seconds);
+        seekPending_.store(true);
+        return true;
+    }
+    return decoder_->seek(seconds);
+}
+
+bool Player::setLoop(double startSeconds, double endSeconds) {
+    if (!decoder_ || startSeconds < 0.0 || endSeconds <= startSeconds) {
+        return false;
+    }
+    loopStart_.store(startSeconds);
+    loopEnd_.store(endSeconds);
+    loopEnabled_.store(true);
+    Logger::instance().log(LogLevel::INFO,
+        "Player: A-B loop " + std::to_string(startSeconds) + "s - " + std::to_string(endSeconds) + "s");
+    return true;
+}
+
+void Player::clearLoop() {
+    loopEnabled_.store(false);
+}
+
 // decodeThreadFunc:
-// - Repeatedly calls decoder_->readSamples(...) to fetch up to framesPerRead frames
-// - Converts int16_t PCM -> float in [-1.0, +1.0]
-// - Calls audioOut_->write() to push frames into ring buffer
+// - Repeatedly calls decoder_->decodeFrames(...) for blocks of exactly kBlockFrames
+//   float frames (in [-1.0, +1.0)); only the last block before EOF is shorter
+// - Deinterleaves each block into a planar one, mixes it to the output's
+//   channels and runs the DSP stage (dsp_) on it
+// - Calls audioOut_->writePlanar() to interleave the frames into the ring buffer
 //
 // Thread safety:
-// - This is a producer thread (non-RT). audioOut_->write() is designed to be called from non-RT thread.
+// - This is a producer thread (non-RT). audioOut_->writePlanar() is designed to be called from non-RT thread.
 // - audioOut_'s callback (consumer) is running in PortAudio RT thread and is lock-free.
 void Player::decodeThreadFunc() {
-    int channels = decoder_->getChannels();
+    const size_t channels = static_cast<size_t>(decoder_->getChannels());
+    const int sampleRate = decoder_->getSampleRate();
+    const bool mixing = !mixer_.isIdentity();
+    const size_t outChannels = static_cast<size_t>(mixer_.outChannels());
+
+    // One fixed-size interleaved block from the decoder, reused every round,
+    // its planar copy and that copy's mix to the output's channels (aligned
+    // pool blocks, allocated once here)
+    std::vector<float> block(kBlockFrames * channels);
+    const PlanarKernels planar = selectPlanarKernels(static_cast<int>(channels));
+    AudioBlockPool sourcePool;
+    AudioBlockPool outPool;
+    if (mixing) sourcePool.init(static_cast<int>(channels), kBlockFrames, 1);
+    outPool.init(static_cast<int>(outChannels), kBlockFrames, 1);
+    const AudioBlock source = sourcePool.acquire();
+    const AudioBlock output = outPool.acquire();
+    if (!planar.deinterleave || output.channels == 0) {
+        Logger::instance().log(LogLevel::ERROR, "Player: cannot process " + std::to_string(channels) + " -> " +
+            std::to_string(outChannels) + " channels");
+        finished_.store(true);
+        return;
+    }
 
-    // Temporary buffers
-    std::vector<int16_t> intBuf;
-    std::vector<float> floatBuf;
+    // Push frames into audioOut_ (frameCount = frames, not samples); keep
+    // trying until all frames are written or stop is requested.
+    auto writeAll = [&](const AudioBlock& data, size_t frames) {
+        size_t writtenFrames = 0;
+        while (writtenFrames < frames && !stopRequested_.load()) {
+            size_t canWrite = audioOut_->writePlanar(data.slice(writtenFrames, frames - writtenFrames),
+                                                     frames - writtenFrames);
+            if (canWrite == 0) {
+                // Buffer full: wait briefly (non-RT wait); avoid busy spin.
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                continue;
+            }
+            writtenFrames += canWrite;
+        }
+    };
 
+    int dspTier = dsp_.qualityTier();   // last logged
     while (!stopRequested_.load()) {
+        if (seekPending_.exchange(false)) {
+            if (decoder_->seek(seekTarget_.load())) {
+                audioOut_->flush();
+                dsp_.reset();
+            } else {
+                Logger::instance().log(LogLevel::WARNING, "Player: seek failed");
+            }
+        }
+
         if (paused_.load()) {
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
             continue;
         }
 
-        // decoder_->readSamples expects a sample count = frames * channels (implementation-defined).
-        // Here we call decode(out_buffer) which returns number of samples (interleaved int16).
-        int nSamples = decoder_->decode(intBuf);
-        if (nSamples <= 0) {
+        size_t totalFrames = decoder_->decodeFrames(block.data(), kBlockFrames);
+
+        // A-B loop: cut the block at B and jump back to A. The audio up to B
+        // is still queued, so the jump is seamless.
+        if (loopEnabled_.load()) {
+            int64_t endFrame = std::llround(loopEnd_.load() * sampleRate);
+            int64_t position = decoder_->getFramesPosition();
+            bool pastEnd = totalFrames == 0;
+            if (totalFrames > 0 && position >= 0 && position + static_cast<int64_t>(totalFrames) >= endFrame) {
+                totalFrames = static_cast<size_t>(std::max<int64_t>(0, endFrame - position));
+                pastEnd = true;
+            }
+            if (pastEnd && decoder_->seek(loopStart_.load())) {
+                if (totalFrames == 0) continue;
+            }
+        }
+
+        if (totalFrames == 0) {
             // EOF or error
             Logger::instance().log(LogLevel::INFO, "Player: Decoder returned 0 samples (EOF)");
+            // The DSP stage still holds audio (convolver block and reverb
+            // tail, limiter lookahead): push silence through it until the
+            // delays are flushed and the output has died away.
+            const size_t delay = dsp_.latency();
+            const size_t tailFrames = dsp_.tailFrames();
+            size_t done = 0;
+            while (done < tailFrames && !stopRequested_.load()) {
+                const size_t frames = std::min(kBlockFrames, tailFrames - done);
+                const AudioBlock tail = output.slice(0, frames);
+                tail.clear();
+                dsp_.process(tail);
+                writeAll(tail, frames);
+                done += frames;
+                float peak = 0.0f;
+                for (int c = 0; c < tail.channels; ++c) {
+                    for (size_t f = 0; f < frames; ++f) peak = std::max(peak, std::fabs(tail.channel[c][f]));
+                }
+                if (done >= delay && peak < 1e-5f) break;   // below -100 dBFS
+            }
             finished_.store(true);
             break;
         }
 
-        // Convert int16 -> float normalized
-        floatBuf.resize(nSamples);
-        for (int i = 0; i < nSamples; ++i) {
-            // 32768.0f ensures normalization in [-1.0, +1.0)
-            floatBuf[i] = static_cast<float>(intBuf[i]) / 32768.0f;
+        // Planar from here until the ring: mix to the output's channels, then
+        // the DSP stage in place
+        const AudioBlock in = mixing ? source.slice(0, totalFrames) : output.slice(0, totalFrames);
+        planar.deinterleave(block.data(), in, totalFrames);
+        if (mixing) {
+            mixer_.process(in, output, totalFrames);
         }
-
-        // Now push frames into audioOut_. audioOut_->write expects frameCount (frames = samples / channels).
-        size_t totalFrames = static_cast<size_t>(nSamples) / static_cast<size_t>(channels);
-        size_t writtenFrames = 0;
-        const float* dataPtr = floatBuf.data();
-
-        // Keep trying until all frames written or stop requested
-        while (writtenFrames < totalFrames && !stopRequested_.load()) {
-            size_t canWrite = audioOut_->write(dataPtr + writtenFrames * channels, totalFrames - writtenFrames);
-            if (canWrite == 0) {
-                // Buffer full: wait briefly (non-RT wait); avoid busy spin.
-                std::this_thread::sleep_for(std::chrono::milliseconds(5));
-                continue;
-            }
-            writtenFrames += canWrite;
+        const AudioBlock out = output.slice(0, totalFrames);
+        dsp_.process(out);
+        if (dsp_.qualityTier() != dspTier) {
+            logDspTier(dspTier, dsp_.qualityTier());
+            dspTier = dsp_.qualityTier();
         }
+
+        writeAll(out, totalFrames);
     } // end decode loop
 
     // Signal end-of-stream: no more data will be written. We leave any remaining frames to drain in audioOut_.
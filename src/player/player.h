@@ -5,15 +5,28 @@
  * High-level Player class that ties decoder -> audio output -> playback control.
  *
  * Responsibilities:
- *  - Load an audio file using FFmpegDecoder
- *  - Initialize audio output (AudioOutput) with decoder's sample rate/channels
+ *  - Load an audio file using AudioDecoder::openFile (native PCM or FFmpeg),
+ *    or through the decoded-PCM cache (PcmCache) when one is attached
+ *  - Keep decoded blocks in RAM (PcmBlockCache) so seeks back, A-B loops and
+ *    replays do not decode again
+ *  - Initialize audio output (AudioOutput) with decoder's sample rate; the
+ *    device keeps its own channel count and a ChannelMixer maps the source's
+ *    channels to it (standard down/upmix or a custom matrix)
+ *  - Run the DSP stage, a DspChain (ParametricEq, Convolver, nodes added at
+ *    run time, then Limiter), on the mixed blocks before they are queued; the
+ *    limiter applies the volume boost above 1.0. With setDspWorkers() the
+ *    channel-independent nodes run on a pool of worker threads; with
+ *    setDspGovernor() the stage lowers its quality under CPU pressure
  *  - Launch a background decoding thread that pushes decoded PCM into AudioOutput
  *  - Provide play/stop/pause lifecycle APIs
  *
  * Design notes:
  *  - Decoder runs on a non-RT thread (producer).
  *  - AudioOutput::write() is lock-free and real-time safe (consumer is PortAudio callback).
- *  - PCM format used internally: interleaved float32 ([-1.0,1.0]), converted from int16_t return of decoder.
+ *  - PCM format used internally: interleaved float32 ([-1.0,1.0]), pulled from the decoder in
+ *    fixed blocks of kBlockFrames frames (AudioDecoder::decodeFrames). The decode thread
+ *    deinterleaves each block once; mixing and the DSP stage work on planar, 64-byte
+ *    aligned blocks (planar.h), interleaved again only when written into the ring.
  *
  * Usage:
  *   Player player;
@@ -26,10 +39,21 @@
 #include <thread>
 #include <atomic>
 #include <memory>
+#include <cstddef>
+#include <vector>
+
+#include "../audio/sample_format.h"   // DeviceFormat
+#include "../audio/channel_mixer.h"
+#include "../dsp/dsp_chain.h"
+#include "../dsp/dsp_nodes.h"
+#include "../dsp/dsp_workers.h"
 
 // Forward declarations of modules (include concrete headers in .cpp)
 class AudioOutput;         // audio/audio_output.h
-class FFmpegDecoder;       // decoder/ffmpeg_decoder.h
+class AudioDecoder;        // decoder/audio_decoder.h
+class StagingCache;        // io/staging_cache.h
+class PcmCache;            // io/pcm_cache.h
+class PcmBlockCache;       // io/pcm_block_cache.h
 
 class Player {
 public:
@@ -51,13 +75,93 @@ public:
     // Resume playback
     void resume();
 
-    // Set volume (0.0 - 1.0)
+    // Set volume (0.0 - 2.0). Up to 1.0 the output scales the samples; the
+    // part above 1.0 is a boost applied by the limiter, which keeps the
+    // boosted peaks under its ceiling instead of clipping them.
     void setVolume(float volume);
 
     // Set playback speed (0.5x - 2.0x)
     void setSpeed(float speed);
     float getSpeed() const { return speed_; }
 
+    // Duration of the loaded file in seconds (0 if unknown or nothing loaded)
+    double getDuration() const;
+
+    // Jump to `seconds`. While playing, the decode thread performs the seek
+    // and drops the audio already queued for the device.
+    bool seek(double seconds);
+
+    // Repeat the section [startSeconds, endSeconds) until clearLoop().
+    bool setLoop(double startSeconds, double endSeconds);
+    void clearLoop();
+
+    // Local staging cache for slow mounts, handed to every decoder (not owned)
+    void setStagingCache(StagingCache* cache) { staging_ = cache; }
+
+    // Decoded-PCM disk cache: repeat plays skip decoding (not owned; may be nullptr)
+    void setPcmCache(PcmCache* cache) { pcmCache_ = cache; }
+
+    // In-memory block cache for decoded audio (not owned; may be nullptr)
+    void setBlockCache(PcmBlockCache* cache) { blockCache_ = cache; }
+
+    // Device sample format to request on the next load(); AudioOutput falls
+    // back to the best one the device supports.
+    void setOutputFormat(DeviceFormat format) { outputFormat_ = format; }
+
+    // AudioOutput ring storage for the next load() (Float32, Int16, Int24)
+    void setRingFormat(DeviceFormat format) { ringFormat_ = format; }
+
+    // Output channel count for the next load() (0 = the device's own)
+    void setOutputChannels(int channels) { outputChannels_ = channels; }
+
+    // Custom mixing matrix (row-major outChannels x inChannels) used instead
+    // of the standard one when a source with inChannels plays on an output
+    // with outChannels. An empty matrix clears it.
+    void setMixMatrix(int inChannels, int outChannels, const std::vector<float>& matrix) {
+        mixIn_ = inChannels;
+        mixOut_ = outChannels;
+        mixMatrix_ = matrix;
+    }
+
+    // Equalizer applied in the decode thread. Its setters may be called from
+    // one control thread (the UI) at any time, also while playing.
+    ParametricEq& equalizer() { return eqNode_->eq(); }
+
+    // Impulse response (any file AudioDecoder opens) convolved with the
+    // output from the next load() on, e.g. a room correction filter or a
+    // reverb. An empty path removes it.
+    void setImpulseResponse(const std::string& path) { irPath_ = path; }
+
+    // Convolution stage after the equalizer (wet/dry mix, cost counters).
+    // setMix() may be called at any time, also while playing.
+    Convolver& convolver() { return convolverNode_->convolver(); }
+
+    // True-peak limiter at the end of the DSP stage (ceiling, on/off, gain
+    // reduction meter). Same threading rules as equalizer().
+    Limiter& limiter() { return limiterNode_->limiter(); }
+
+    // The DSP stage; nodes()/costs() for the UI and logs. Nodes can be added
+    // and removed from the control thread while playing.
+    DspChain& dsp() { return dsp_; }
+
+    // Add `node` to the DSP stage in front of the limiter (so the boost and
+    // the ceiling still apply last).
+    bool addDspNode(std::shared_ptr<DspNode> node);
+
+    // Worker threads for the DSP stage from the next load() on (0 = all on
+    // the decode thread, the default): the EQ, convolver and gain nodes then
+    // process groups of channels in parallel (DspChain::setWorkers()).
+    void setDspWorkers(int workers) { dspWorkerCount_ = workers; }
+
+    // Let the DSP stage trade quality for CPU time under load (off by
+    // default; any time): DspChain's governor steps the convolution tail and
+    // the limiter's detector down and back up, and the decode thread logs
+    // every step.
+    void setDspGovernor(bool enabled) { dsp_.setGovernor(enabled); }
+
+    // Frames per block the decode thread hands to the output (~23 ms at 44.1 kHz)
+    static constexpr size_t kBlockFrames = 1024;
+
     // Query playback state
     bool isPlaying() const { return playing_.load(); }
     bool isPaused() const { return paused_.load(); }
@@ -67,9 +171,15 @@ private:
     // Thread function executed by decoder thread
     void decodeThreadFunc();
 
+    // Decode irPath_ into the convolver (called by load() when the path changed)
+    bool loadImpulseResponse();
+
+    // Log a quality tier change of the DSP stage
+    void logDspTier(int from, int to);
+
 private:
     // Owned components
-    std::unique_ptr<FFmpegDecoder> decoder_;  // ownership of decoder instance
+    std::unique_ptr<AudioDecoder> decoder_;   // ownership of decoder instance
     std::unique_ptr<AudioOutput> audioOut_;   // ownership of audio output
 
     // Control flags
@@ -77,6 +187,11 @@ private:
     std::atomic<bool> paused_;                // true while playback is paused
     std::atomic<bool> stopRequested_;         // set to request stop
     std::atomic<bool> finished_;              // true when playback finished naturally
+    std::atomic<bool> seekPending_{false};    // seekTarget_ waits for the decode thread
+    std::atomic<double> seekTarget_{0.0};
+    std::atomic<bool> loopEnabled_{false};    // A-B loop [loopStart_, loopEnd_)
+    std::atomic<double> loopStart_{0.0};
+    std::atomic<double> loopEnd_{0.0};
 
     // Worker thread that decodes and pushes audio
     std::thread decoderThread_;
@@ -84,4 +199,23 @@ private:
     // File path currently loaded (for logging)
     std::string currentFile_;
     float speed_ = 1.0f;
+    StagingCache* staging_ = nullptr;
+    PcmCache* pcmCache_ = nullptr;
+    PcmBlockCache* blockCache_ = nullptr;
+    DeviceFormat outputFormat_ = DeviceFormat::Float32;
+    DeviceFormat ringFormat_ = DeviceFormat::Float32;
+    int outputChannels_ = 0;
+    int mixIn_ = 0;                           // custom matrix (setMixMatrix())
+    int mixOut_ = 0;
+    std::vector<float> mixMatrix_;
+    ChannelMixer mixer_;                      // decoder channels -> output channels
+    DspChain dsp_;                            // DSP stage, after mixer_
+    DspWorkerPool dspWorkers_;                // setDspWorkers()
+    int dspWorkerCount_ = 0;
+    std::shared_ptr<EqNode> eqNode_;          // first node
+    std::shared_ptr<ConvolverNode> convolverNode_;
+    std::shared_ptr<LimiterNode> limiterNode_;   // last node (volume boost)
+    std::string irPath_;                      // setImpulseResponse()
+    std::string loadedIrPath_;                // response held by the convolver
+    float volume_ = 1.0f;                     // setVolume(), 0..2
 };
@@ -0,0 +1,136 @@
+/*
+ cpu_features.cpp
+
+ cpuid / xgetbv detection and the MUSIC_PLAYER_SIMD cap. See cpu_features.h.
+*/
+
+#include "cpu_features.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+#include <cpuid.h>
+#endif
+
+#if defined(__SSE__) || defined(_M_X64)
+#define CPU_USE_MXCSR 1
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+// XCR0: which register states the OS saves on context switches.
+uint64_t readXcr0() {
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+#endif
+
+CpuFeatures detect() {
+    CpuFeatures f;
+#if defined(MUSIC_PLAYER_X86_DISPATCH)
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return f;
+    f.sse2 = (edx & bit_SSE2) != 0;
+    f.ssse3 = (ecx & bit_SSSE3) != 0;
+    f.sse41 = (ecx & bit_SSE4_1) != 0;
+    const bool osxsave = (ecx & bit_OSXSAVE) != 0;
+    const bool fma = (ecx & bit_FMA) != 0;
+    const bool avx = (ecx & bit_AVX) != 0;
+
+    const uint64_t xcr0 = osxsave ? readXcr0() : 0;
+    const bool ymmState = (xcr0 & 0x6) == 0x6;            // SSE + AVX state
+    const bool zmmState = ymmState && (xcr0 & 0xE0) == 0xE0;   // opmask + ZMM
+
+    f.avx = avx && ymmState;
+    f.fma = fma && f.avx;
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        f.avx2 = f.avx && (ebx & bit_AVX2) != 0;
+        f.avx512f = zmmState && (ebx & bit_AVX512F) != 0;
+        f.avx512bw = f.avx512f && (ebx & bit_AVX512BW) != 0;
+    }
+#endif
+    return f;
+}
+
+SimdLevel levelOf(const CpuFeatures& f) {
+    if (f.avx512f && f.avx512bw && f.avx2 && f.fma) return SimdLevel::AVX512;
+    if (f.avx2 && f.fma) return SimdLevel::AVX2;
+    if (f.sse2) return SimdLevel::SSE2;
+    return SimdLevel::Scalar;
+}
+
+// -1 = not read from the environment yet
+std::atomic<int> g_limit(-1);
+
+int limitFromEnvironment() {
+    SimdLevel level = SimdLevel::AVX512;
+    if (const char* env = std::getenv("MUSIC_PLAYER_SIMD")) {
+        parseSimdLevel(env, level);
+    }
+    return static_cast<int>(level);
+}
+
+} // namespace
+
+const CpuFeatures& cpuFeatures() {
+    static const CpuFeatures features = detect();
+    return features;
+}
+
+SimdLevel detectedSimdLevel() {
+    static const SimdLevel level = levelOf(cpuFeatures());
+    return level;
+}
+
+SimdLevel simdLevel() {
+    int limit = g_limit.load(std::memory_order_relaxed);
+    if (limit < 0) {
+        int fromEnv = limitFromEnvironment();
+        g_limit.compare_exchange_strong(limit, fromEnv, std::memory_order_relaxed);
+        limit = g_limit.load(std::memory_order_relaxed);
+    }
+    SimdLevel detected = detectedSimdLevel();
+    return static_cast<int>(detected) < limit ? detected : static_cast<SimdLevel>(limit);
+}
+
+void setSimdLevelLimit(SimdLevel limit) {
+    g_limit.store(static_cast<int>(limit), std::memory_order_relaxed);
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::SSE2: return "sse2";
+    case SimdLevel::AVX2: return "avx2";
+    case SimdLevel::AVX512: return "avx512";
+    default: return "scalar";
+    }
+}
+
+bool parseSimdLevel(const char* name, SimdLevel& level) {
+    const SimdLevel all[] = { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 };
+    for (SimdLevel l : all) {
+        if (std::strcmp(name, simdLevelName(l)) == 0) {
+            level = l;
+            return true;
+        }
+    }
+    return false;
+}
+
+#if defined(CPU_USE_MXCSR)
+ScopedDenormalFlush::ScopedDenormalFlush() : saved_(_mm_getcsr()) {
+    _mm_setcsr(saved_ | 0x8040);   // FTZ (bit 15) | DAZ (bit 6)
+}
+
+ScopedDenormalFlush::~ScopedDenormalFlush() {
+    _mm_setcsr(saved_);
+}
+#else
+ScopedDenormalFlush::ScopedDenormalFlush() : saved_(0) {}
+ScopedDenormalFlush::~ScopedDenormalFlush() {}
+#endif
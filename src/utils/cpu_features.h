@@ -0,0 +1,74 @@
+#pragma once
+/*
+ cpu_features.h
+
+ Purpose:
+   - Runtime CPU feature detection for the SIMD kernels, and the instruction
+     set level kernel dispatchers pick their variant from.
+   - The binary is built for the baseline (SSE2 on x86-64); kernels that
+     have wider variants compile them with per-function target attributes
+     and choose one through a function pointer when a stream is set up, so
+     the same build runs on SSE4-only, AVX2 and AVX-512 hosts.
+
+ Notes:
+   - x86: cpuid for the instruction sets plus xgetbv to check that the OS
+     saves the YMM/ZMM state. Other targets report Scalar (their compile-time
+     SIMD paths, e.g. NEON, are not dispatched).
+   - MUSIC_PLAYER_SIMD=scalar|sse2|avx2|avx512 caps the level at startup
+     (setSimdLevelLimit() does the same at run time), for testing or to
+     step around a misbehaving variant.
+*/
+
+#include <cstdint>
+
+// Wider variants are compiled with GCC/Clang target attributes on x86.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MUSIC_PLAYER_X86_DISPATCH 1
+#endif
+
+enum class SimdLevel {
+    Scalar = 0,
+    SSE2,
+    AVX2,      // AVX2 + FMA
+    AVX512     // AVX-512 F + BW
+};
+
+struct CpuFeatures {
+    bool sse2 = false;
+    bool ssse3 = false;
+    bool sse41 = false;
+    bool avx = false;
+    bool avx2 = false;
+    bool fma = false;
+    bool avx512f = false;
+    bool avx512bw = false;
+};
+
+// Detected once, on first use.
+const CpuFeatures& cpuFeatures();
+
+// Best level this CPU and OS support.
+SimdLevel detectedSimdLevel();
+
+// Level kernels should use: detectedSimdLevel() capped by the limit.
+SimdLevel simdLevel();
+
+// Cap simdLevel() (SimdLevel::AVX512 = no cap).
+void setSimdLevelLimit(SimdLevel limit);
+
+const char* simdLevelName(SimdLevel level);
+bool parseSimdLevel(const char* name, SimdLevel& level);
+
+// Flush-to-zero / denormals-are-zero on the calling thread while in scope
+// (x86; a no-op elsewhere), so recursive filters decaying into silence do
+// not hit the slow denormal path. Restores the previous mode on exit.
+class ScopedDenormalFlush {
+public:
+    ScopedDenormalFlush();
+    ~ScopedDenormalFlush();
+    ScopedDenormalFlush(const ScopedDenormalFlush&) = delete;
+    ScopedDenormalFlush& operator=(const ScopedDenormalFlush&) = delete;
+
+private:
+    unsigned saved_;
+};
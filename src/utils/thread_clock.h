@@ -0,0 +1,31 @@
+#pragma once
+/*
+ thread_clock.h
+
+ Purpose:
+   - CPU time of the calling thread, for the cost counters of the DSP stage
+     (convolver, DspChain): time the thread spends preempted by others on a
+     shared core is not counted.
+
+ Notes:
+   - Falls back to the steady clock where there is no per-thread clock
+     (Windows builds), which does count preemption.
+*/
+
+#include <chrono>
+#include <cstdint>
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+inline uint64_t threadCpuNanos() {
+#ifndef _WIN32
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+    }
+#endif
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
@@ -0,0 +1,54 @@
+#pragma once
+/*
+ triple_buffer.h
+
+ Purpose:
+   - Hand a settings snapshot from one control thread (UI) to one processing
+     thread without locks or allocation: the writer fills its own slot and
+     swaps it into the middle; the reader swaps the middle out when it is
+     newer than what it has.
+   - Neither side ever waits, and the reader always sees a complete
+     snapshot (the latest one published before its read()).
+
+ Notes:
+   - Exactly one writer thread and one reader thread. T must be copyable;
+     publish() copies it into the writer's slot.
+*/
+
+#include <atomic>
+
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : middle_(1), back_(0), front_(2) {}
+
+    explicit TripleBuffer(const T& initial) : TripleBuffer() {
+        for (T& slot : slots_) slot = initial;
+    }
+
+    // Writer: make `value` the latest snapshot.
+    void publish(const T& value) {
+        slots_[back_] = value;
+        back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kIndex;
+    }
+
+    // Reader: take the latest snapshot if one was published since the last
+    // read(); returns false (and leaves current() as it was) otherwise.
+    bool read() {
+        if ((middle_.load(std::memory_order_relaxed) & kFresh) == 0) return false;
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+        return true;
+    }
+
+    // Reader: snapshot taken by the last successful read().
+    const T& current() const { return slots_[front_]; }
+
+private:
+    static constexpr int kIndex = 3;
+    static constexpr int kFresh = 4;   // middle slot not yet read
+
+    T slots_[3];
+    std::atomic<int> middle_;
+    int back_;    // writer only
+    int front_;   // reader only
+};